@@ -30,7 +30,12 @@ struct odb_block_group_desc {
 
 	// see ODB_SPEC_FLAG_GROUP_* constants
 	uint16_t flags;
-	uint32_t rsvd0;
+
+	// striping: the volume is striped across stripec files and this group's
+	// file is the stripei'th one. A stripec of 0 is read as 1 (volumes created
+	// before striping).
+	uint16_t stripec;
+	uint16_t stripei;
 
 	struct odb_block blocks[1023];
 
@@ -39,7 +39,25 @@ typedef uint64_t odb_bid;
 typedef uint64_t odb_gid; // group
 static const odb_bid ODB_BID_END = 0xFFFFFFFFFFFFFFFF;
 
+// the maximum amount of files a single volume can be striped across. See
+// odb_openv.
+#define ODB_STRIPEMAX 16
+
 export odb_err odb_open(const char *file, odb_ioflags flags, odb_desc **o_descriptor);
+
+/**
+ * odb_openv opens a volume that is striped across filec files. Groups are
+ * dealt out round-robin: group g lives inside filev[g % filec]. Thus
+ * putting each file on its own device lets checkouts and commits that span
+ * many groups run their I/O against multiple devices at once.
+ *
+ * The order of filev matters and must be the same every time the volume is
+ * opened. odb_open(file, ...) is the same as odb_openv(&file, 1, ...).
+ */
+export odb_err odb_openv(const char *const *filev
+                         , int filec
+                         , odb_ioflags flags
+                         , odb_desc **o_descriptor);
 export void odb_close(odb_desc *desc);
 
 /**
@@ -103,4 +103,72 @@ export odb_err odbh_buffer_versions_current(odb_buf *buffer
 export odb_err odb_buffer_free(odb_buf *buffer);
 
 
+/**
+ * The completion queue (odb_cq) lets you submit checkouts and commits without
+ * waiting for them to finish. The work is done by a pool of workerc threads
+ * each with their own handle on the volume (so they lock blocks against each
+ * other, and against desc, like seperate processes would). At most depth
+ * submissions can be outstanding (submitted but not reaped) at once, after
+ * which submitting returns ODB_EAGAIN.
+ *
+ * Each finished submission produces an odb_cqe which can be reaped with
+ * odb_cq_poll (never blocks) or odb_cq_wait (blocks until there's at least 1).
+ * odb_cq_fd returns an eventfd(2) that is readable so long that there's
+ * completions to be reaped, so you can stick it in your own poll(2)/epoll(7).
+ * Do not read from it yourself.
+ *
+ * A buffer must not be used for anything else until the submission it was
+ * given to has been reaped. Completions are not necessarily in the order of
+ * submission.
+ *
+ * desc must outlive the cq. odb_cq_free waits for anything that was submitted
+ * to be carried out, the completions for those are dropped.
+ */
+typedef struct odb_cq odb_cq;
+
+struct odb_cqe {
+	void    *userdata;
+	odb_err  err;
+
+	// 1 if this was a odbb_commit_async, 0 if odbb_checkout_async.
+	int      commit;
+
+	odb_buf *buffer;
+	odb_bid  bid;
+	int      blockc;
+
+	// the versions of the blocks. For checkouts, these are the versions
+	// checked out. For commits, these are the new versions or, if err is
+	// ODB_EVERSION, the current versions that conflicted. Points into buffer.
+	const odb_ver *versionv;
+};
+
+export odb_err odb_cq_new(odb_desc *desc
+                          , int depth
+                          , int workerc
+                          , odb_cq **o_cq);
+export void odb_cq_free(odb_cq *cq);
+export int odb_cq_fd(odb_cq *cq);
+
+export odb_err odbb_checkout_async(odb_cq *cq
+                                   , odb_buf *buffer
+                                   , odb_bid bid
+                                   , int blockc
+                                   , void *userdata);
+export odb_err odbb_commit_async(odb_cq *cq
+                                 , odb_buf *buffer
+                                 , odb_bid bid
+                                 , int blockc
+                                 , void *userdata);
+
+export odb_err odb_cq_poll(odb_cq *cq
+                           , struct odb_cqe *o_cqev
+                           , int cqec
+                           , int *o_cqec);
+export odb_err odb_cq_wait(odb_cq *cq
+                           , struct odb_cqe *o_cqev
+                           , int cqec
+                           , int *o_cqec);
+
+
 #endif
@@ -104,6 +104,13 @@ typedef enum odb_err {
 	ODB_EMAPPED,
 
 	ODB_ENMAP,
+
+	/// Waiting on a lock would never end (a deadlock). Let go of whatever
+	/// else is locked and try again.
+	ODB_EDEADLK,
+
+	/// Waited on a lock for too long. Try again.
+	ODB_ETIMEDOUT,
 } odb_err;
 
 export const char *odb_errstr(odb_err error);
@@ -32,6 +32,7 @@ typedef enum odbtelem_class_t {
 	ODBTELEM_WORKR_PUNLOAD,
 	ODBTELEM_JOBS_ADDED,
 	ODBTELEM_JOBS_COMPLETED,
+	ODBTELEM_PAGES_CORRUPT,
 	_ODBTELEM_LAST,
 } odbtelem_class_t;
 struct odbtelem_data {
@@ -57,6 +58,156 @@ odb_err odbtelem_poll(struct odbtelem_data *o_data);
 typedef void(*odbtelem_cb)(struct odbtelem_data);
 odb_err odbtelem_bind(odbtelem_class_t class, odbtelem_cb cb);
 
+/// The number of buckets in odbtelem_cachestats.faultlatencyv.
+#define ODBTELEM_LATENCYC 16
+
+/**
+ * \brief Counters of the host's page cache.
+ *
+ * These are kept by each worker on its own and the host adds them up into
+ * the image about every 100 milliseconds (not on every event), so they can
+ * be that far behind. They never go down (workers that have closed are
+ * still counted).
+ */
+struct odbtelem_cachestats {
+
+	/// pages that were found in the cache.
+	uint64_t hits;
+
+	/// pages that had to be loaded in from the file.
+	uint64_t misses;
+
+	/// pages that were still dirty when they were swapped out and had to be
+	/// written out first.
+	uint64_t dirtyevictions;
+
+	/// times a worker had to wait on someone else loading in (or writing
+	/// out) a page it wanted.
+	uint64_t swapwaits;
+
+	/// how long loading pages in took. faultlatencyv[0] counts the loads that
+	/// took less than a microsecond, faultlatencyv[i] counts the loads that
+	/// took 2^(i-1) to 2^i microseconds. The last one also counts anything
+	/// longer.
+	uint64_t faultlatencyv[ODBTELEM_LATENCYC];
+
+	/// of the misses, how many were found in the compressed tier (and so
+	/// didn't have to go to the file).
+	uint64_t zhits;
+
+	/// pages put into the compressed tier, zrawbytes of pages that were
+	/// compressed down to zbytes. zrawbytes / zbytes is the compression
+	/// ratio.
+	uint64_t zstores;
+	uint64_t zrawbytes;
+	uint64_t zbytes;
+
+	/// nanoseconds spent decompressing all zhits pages.
+	uint64_t zdecompressns;
+};
+
+/**
+ * \brief How long workers have waited on each other's locks.
+ *
+ * Same as \ref odbtelem_cachestats, these only go up. Locks that were
+ * placed without having to wait aren't counted at all.
+ */
+struct odbtelem_lockstats {
+
+	/// times a worker had to wait for a lock.
+	uint64_t waits;
+
+	/// nanoseconds spent waiting, all together.
+	uint64_t waitns;
+
+	/// how long the waits took, in the same buckets as
+	/// odbtelem_cachestats.faultlatencyv.
+	uint64_t waitlatencyv[ODBTELEM_LATENCYC];
+
+	/// waits that were given up because they would have never ended.
+	uint64_t deadlocks;
+
+	/// waits that were given up because they took too long.
+	uint64_t timeouts;
+
+	/// times an intention lock on an entity was turned into a shared or
+	/// exclusive one because of how many page/row locks were under it.
+	uint64_t escalations;
+};
+
+/// The number of lock types in odbtelem_lockprofile.typev (there's room
+/// for more than there are).
+#define ODBTELEM_LOCKTYPEC 16
+
+/// The number of locks in odbtelem_lockprofile.hotv.
+#define ODBTELEM_LOCKHOTC 8
+
+/**
+ * \brief Where the time in the locks goes, for one type of lock.
+ *
+ * Only counted while telemetry is enabled (see \ref odbtelem_lockprofile).
+ */
+struct odbtelem_locktype {
+
+	/// locks placed, and the nanoseconds it took to place them (waits and
+	/// all) in the same buckets as odbtelem_cachestats.faultlatencyv.
+	uint64_t acquires;
+	uint64_t acquirens;
+	uint64_t acquirelatencyv[ODBTELEM_LATENCYC];
+
+	/// of the acquires, how many had to wait.
+	uint64_t waits;
+
+	/// how many others were already waiting on the same lock when one of
+	/// the waits started, all together (waiters / waits is the average)
+	/// and the most there ever were.
+	uint64_t waiters;
+	uint64_t maxwaiters;
+
+	/// locks let go of, and the nanoseconds they were held for.
+	uint64_t releases;
+	uint64_t holdns;
+};
+
+/**
+ * \brief One of the locks that was waited on the most.
+ */
+struct odbtelem_lockhot {
+
+	/// the lock type (index into odbtelem_lockprofile.typev) and the offset
+	/// in the file of the bytes it locks.
+	uint32_t type;
+	uint64_t offset;
+
+	/// how many times it was waited on. This is an estimate that's no more
+	/// than error over the real count.
+	uint64_t waits;
+	uint64_t error;
+
+	/// nanoseconds spent waiting on it since it was last put in the list.
+	uint64_t waitns;
+};
+
+/**
+ * \brief The lock contention profile.
+ *
+ * typev is indexed by the lock type in the order locking.org lists them:
+ * LFILE, LENTCREAT, LSTRUCTCREAT, LENTRY, LENTTRASH, LREF0C,
+ * LLOOKUP_EXISTING, LLOOKUP_NEW, LTRASHOFF, LOBJPRIGHT, LOBJBODY, LROW, and
+ * the arbitrary locks.
+ *
+ * hotv is the most waited on locks (the ones with waits == 0 are unused),
+ * most first. They're found with a space-saving sketch so the host doesn't
+ * have to count every lock there is.
+ *
+ * The profile is only kept while telemetry is enabled (see \ref odbtelem)
+ * and starts over each time it is.
+ */
+struct odbtelem_lockprofile {
+	struct odbtelem_locktype typev[ODBTELEM_LOCKTYPEC];
+	struct odbtelem_lockhot  hotv[ODBTELEM_LOCKHOTC];
+};
+
 /**
  * \brief Get a full in-memory snapshot of the attached host.
  *
@@ -100,6 +251,17 @@ typedef struct odbtelem_image_t {
 	//odb_jobtype_t *job_desc;
 	unsigned int *job_workersv;
 
+	/// the page cache's counters, see \ref odbtelem_cachestats. This and
+	/// the lock counters below are refreshed by the host on a timer, they
+	/// don't change with image_raster's events.
+	struct odbtelem_cachestats cachestats;
+
+	/// the lock waits, see \ref odbtelem_lockstats.
+	struct odbtelem_lockstats lockstats;
+
+	/// the lock contention profile, see \ref odbtelem_lockprofile.
+	struct odbtelem_lockprofile lockprofile;
+
 } odbtelem_image_t;
 odb_err odbtelem_image(odbtelem_image_t *o_image);
 
@@ -233,6 +233,7 @@ odb_err edba_entryset(edba_handle_t *h, odb_spec_index_entry e) {
 		} else {
 			page->parentlookup = lookuppages[i-1];
 		}
+		edbp_mod(edbphandle, EDBP_CACHEHINT, EDBP_HDIRTY);
 
 		edbp_finish(edbphandle);
 	}
@@ -284,7 +285,7 @@ odb_err edba_entrydelete(edba_handle_t *h, odb_eid eid) {
 	edbl_handle_t *lockh = h->lockh;
 	odb_err err;
 
-	edba_u_clutchentry(h, eid, 1);
+	edba_u_clutchentry(h, eid, EDBL_AXL);
 	//**defer: edba_u_clutchentry_release
 
 	// set it to ODB_ELMPEND so we can more easily sniff out corrupted
@@ -305,17 +306,12 @@ odb_err edba_entrydelete(edba_handle_t *h, odb_eid eid) {
 	return 0;
 }
 
-odb_err edba_u_clutchentry(edba_handle_t *handle, odb_eid eid, int xl) {
+odb_err edba_u_clutchentry(edba_handle_t *handle, odb_eid eid, edbl_act act) {
 #ifdef EDB_FUCKUPS
 	if(handle->clutchedentry) {
 		log_critf("attempting to clutch an entry with handle already clutching something. Or perhaps unitialized handle");
 	}
 #endif
-	// SH lock the entry
-	edbl_act act = EDBL_ASH;
-	if(xl) {
-		act = EDBL_AXL;
-	}
 	edbl_set(handle->lockh, act, (edbl_lock){
 		.type = EDBL_LENTRY,
 		.eid = eid,
@@ -369,10 +365,11 @@ odb_err edba_entity_get(edba_handle_t *h
 	*o_entc = 0;
 
 	for(eid = 0; ; eid++) {
-		// SH lock for EDBL_LENTRY.
+		// IS lock for EDBL_LENTRY: only the entry itself is read so writers
+		// to its objects can keep going.
 		lock.type = EDBL_LENTRY;
 		lock.eid = eid;
-		edbl_set(h->lockh, EDBL_ASH, lock);
+		edbl_set(h->lockh, EDBL_AIS, lock);
 		// **defer: edbl_set(h->lockh, EDBL_ARELEASE, lock);
 		err = edbd_index(h->parent->descriptor, eid, &entry);
 		if(err || entry->type == ODB_ELMINIT) {
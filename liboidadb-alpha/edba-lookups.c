@@ -1,51 +1,54 @@
 #include "edba.h"
+#include "edba_u.h"
 #include <oidadb-internal/odbfile.h>
 
-// converts a pid offset to the actual page address
-// note to self: the only error returned by this should be a critical error
-//
-// assumptions:
-//     pidoffset_search is less than the total amount of pages in the edbp_object chapter
-odb_err static edba_u_lookup_rec(edba_handle_t *handle,
-                                 odb_pid lookuproot,
-                                 odb_pid selfpagestartoffset,
-                                 odb_pid chapter_pageoff,
-                                 odb_pid *o_pid,
-                                 int depth) {
-	// install sh lock on first byte of page per Object-Reading spec
-	edbl_lock lock = {
-			.type = EDBL_LLOOKUP_EXISTING,
-			.lookup_pid = lookuproot,
-	};
+// how many times edba_u_lookup_rec reads a lookup page that keeps being
+// written to before it gives up and locks it instead.
+#define EDBA_LOOKUPRETRY 8
 
-	// ** defer: edbl_set(&self->lockdir, lock);
-	edbl_set(handle->lockh, EDBL_ASH, lock);
+// the low byte of a version counter is how many writers are in the page(s)
+// right now, the rest goes up each time one of them is done.
+#define LOOKUPVER_WRITERS 0xFF
+#define LOOKUPVER_DONE    0x100
 
-	// ** defer: edbp_finish(&self->edbphandle);
-	odb_err err = edbp_start(handle->edbphandle, lookuproot);
-	if(err) {
-		edbl_set(handle->lockh, EDBL_ARELEASE, lock);
-		return err;
-	}
-	// set the lookup hint now
-	// generate the proper EDBP_HINDEX... value
-	edbp_hint h = EDBP_HINDEX0 - depth * 0x10;
-	edbp_mod(handle->edbphandle, EDBP_CACHEHINT, h);
-	odb_spec_lookup *l = edbp_graw(handle->edbphandle);
-	odb_spec_lookup_lref *refs = (void*)l + ODB_SPEC_HEADSIZE;
-#ifdef EDB_FUCKUPS
-	if(l->refc == 0) {
-		log_critf("edba_u_lookupoid was called and referenced lookup node has "
-		          "no referenced");
+static uint32_t *lookupver(edba_handle_t *handle, odb_pid lookuppid) {
+	return &handle->parent->lookupverv[lookuppid % EDBA_LOOKUPVERC];
+}
+
+void edba_u_lookupwritebegin(edba_handle_t *handle, odb_pid lookuppid) {
+	__atomic_fetch_add(lookupver(handle, lookuppid), 1, __ATOMIC_RELAXED);
+	// (readers must see the count before they see anything we write)
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void edba_u_lookupwriteend(edba_handle_t *handle, odb_pid lookuppid) {
+	__atomic_fetch_add(lookupver(handle, lookuppid), LOOKUPVER_DONE - 1,
+	                   __ATOMIC_RELEASE);
+}
+
+// the part of edba_u_lookup_rec that reads the page: finds the reference
+// to follow and puts it in *o_pid, and its starting offset in
+// *io_startoff. With depth 0 its the page id we're looking for instead.
+//
+// This can be reading the page while its being written to, so refc is only
+// read once and nothing past refmax is ever looked at. Returns non-0 if what
+// it read doesn't make sense.
+static int lookup_search(const odb_spec_lookup *l, unsigned int refmax,
+                         odb_pid chapter_pageoff, int depth,
+                         odb_pid *io_startoff, odb_pid *o_pid) {
+	const odb_spec_lookup_lref *refs = (const void *)l + ODB_SPEC_HEADSIZE;
+	unsigned int refc = __atomic_load_n(&l->refc, __ATOMIC_RELAXED);
+	if(refc == 0 || refc > refmax) {
+		return 1;
 	}
-#endif
+	unsigned int i;
 
 	if(depth == 0) {
 		// if depth is 0 that means this page is full of leaf node references.
 		// more specifically, full of leaf node /page strait/ references.
 		// We know that pidoffset_search is somewhere in one of these straits.
-		int i;
-		for(i = 0; i < l->refc; i++) {
+		odb_pid selfpagestartoffset = *io_startoff;
+		for(i = 0; i < refc; i++) {
 			// it is now the END offset
 			if(refs[i].startoff_strait >= chapter_pageoff) {
 				// Our offset is in this reference sense its the last page id
@@ -60,6 +63,9 @@ odb_err static edba_u_lookup_rec(edba_handle_t *handle,
 			// equal to the starting offset of the next reference.
 			selfpagestartoffset = refs[i].startoff_strait+1;
 		}
+		if(i == refc) {
+			return 1;
+		}
 		// we know that this reference contains our page in its strait.
 		// So if our offset search is lets say 5, and this strait contained
 		// pageoffsets 4,5,6,7,8 and associating pageids of 42,43,44,45,46.
@@ -77,11 +83,6 @@ odb_err static edba_u_lookup_rec(edba_handle_t *handle,
 		// also note that refc will always be non-null references. So ref[i]
 		// will never be a null reference.
 		*o_pid = refs[i].ref + (chapter_pageoff - selfpagestartoffset);
-
-		// So lets finish out of this page...
-		edbp_finish(handle->edbphandle);
-		// and release the lock
-		edbl_set(handle->lockh, EDBL_ARELEASE, lock);
 		return 0;
 	}
 
@@ -90,9 +91,8 @@ odb_err static edba_u_lookup_rec(edba_handle_t *handle,
 
 	// search in the list of references of this page to find out where we
 	// need to go next.
-	int i;
-	for(i = 0; i < l->refc; i++) {
-		if(i+1 == l->refc || refs[i+1].startoff_strait > chapter_pageoff) {
+	for(i = 0; i < refc; i++) {
+		if(i+1 == refc || refs[i+1].startoff_strait > chapter_pageoff) {
 			// logically, if we're in here that means the next interation (i+1)
 			// will be the end ouf our reference list, or, will be a reference
 			// that has a starting offset that is larger than this current
@@ -103,30 +103,97 @@ odb_err static edba_u_lookup_rec(edba_handle_t *handle,
 			break;
 		}
 	}
-	// note: based on our logic in the if statement, i will never equal l->refc.
-#ifdef EDB_FUCKUPS
-	if(i == l->refc) {
-		log_critf("failed to find child lookup page under the "
-				  "logical assumption that it exists.");
-	}
-#endif
+	// note: based on our logic in the if statement, i will never equal refc.
 
 	// at this point, we know that refs[i] is the reference we must follow.
-	// Lets throw the important number in our stack.
-	lookuproot = refs[i].ref;
-	selfpagestartoffset = refs[i].startoff_strait;
+	*o_pid = refs[i].ref;
+	*io_startoff = refs[i].startoff_strait;
+	return 0;
+}
+
+// converts a pid offset to the actual page address
+// note to self: the only error returned by this should be a critical error
+//
+// The pages are read without locking them (the Object-Reading spec's
+// LLOOKUP_EXISTING(sh)): each page is read and then its version counter
+// (see edba_u_lookupwritebegin) is checked to see that no writer was in it
+// in the meantime. If there was, its read again. Only a page that keeps
+// being written to is locked with LLOOKUP_NEW(sh), which waits for the
+// writer.
+//
+// The version counters are only in this process's memory though, a writer
+// in another process never touches them. So with EDBL_CONFIG_OFD the
+// pages are always read under the lock.
+//
+// assumptions:
+//     pidoffset_search is less than the total amount of pages in the edbp_object chapter
+odb_err static edba_u_lookup_rec(edba_handle_t *handle,
+                                 unsigned int refmax,
+                                 odb_pid lookuproot,
+                                 odb_pid selfpagestartoffset,
+                                 odb_pid chapter_pageoff,
+                                 odb_pid *o_pid,
+                                 int depth) {
+	// ** defer: edbp_finish(&self->edbphandle);
+	odb_err err = edbp_start(handle->edbphandle, lookuproot);
+	if(err) {
+		return err;
+	}
+	// set the lookup hint now
+	// generate the proper EDBP_HINDEX... value
+	edbp_hint h = EDBP_HINDEX0 - depth * 0x10;
+	edbp_mod(handle->edbphandle, EDBP_CACHEHINT, h);
+	const odb_spec_lookup *l = edbp_graw(handle->edbphandle);
+
+	uint32_t *ver = lookupver(handle, lookuproot);
+	odb_pid next, startoff;
+	int tries = edbl_ofd(handle->lockh) ? EDBA_LOOKUPRETRY : 0;
+	for(; tries < EDBA_LOOKUPRETRY; tries++) {
+		uint32_t v = __atomic_load_n(ver, __ATOMIC_ACQUIRE);
+		startoff = selfpagestartoffset;
+		int bad = lookup_search(l, refmax, chapter_pageoff, depth,
+		                        &startoff, &next);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if(!bad && !(v & LOOKUPVER_WRITERS)
+		   && __atomic_load_n(ver, __ATOMIC_RELAXED) == v) {
+			break;
+		}
+	}
+	if(tries == EDBA_LOOKUPRETRY) {
+		edbl_lock lock = {
+				.type = EDBL_LLOOKUP_NEW,
+				.lookup_pid = lookuproot,
+		};
+		if((err = edbl_set(handle->lockh, EDBL_ASH, lock))) {
+			edbp_finish(handle->edbphandle);
+			return err;
+		}
+		startoff = selfpagestartoffset;
+		int bad = lookup_search(l, refmax, chapter_pageoff, depth,
+		                        &startoff, &next);
+		edbl_set(handle->lockh, EDBL_ARELEASE, lock);
+		if(bad) {
+			log_critf("lookup page %ld has no reference to chapter offset %ld",
+			          lookuproot, chapter_pageoff);
+			edbp_finish(handle->edbphandle);
+			return ODB_ECRIT;
+		}
+	}
 
 	// So lets finish out of this page...
 	edbp_finish(handle->edbphandle);
-	// and release the lock
-	edbl_set(handle->lockh, EDBL_ARELEASE, lock);
+	if(depth == 0) {
+		*o_pid = next;
+		return 0;
+	}
 
 	// now we can recurse down to the next lookup page.
 	return edba_u_lookup_rec(handle,
-							 lookuproot,
-							 selfpagestartoffset,
-							 chapter_pageoff,
-							 o_pid, depth-1);
+	                         refmax,
+	                         next,
+	                         startoff,
+	                         chapter_pageoff,
+	                         o_pid, depth-1);
 }
 
 odb_err edba_u_lookupoid(edba_handle_t *handle, odb_spec_index_entry *entry,
@@ -134,8 +201,9 @@ odb_err edba_u_lookupoid(edba_handle_t *handle, odb_spec_index_entry *entry,
 	if(chapter_pageoff >= entry->ref0c) {
 		return ODB_EEOF;
 	}
-	odb_err err = edba_u_lookup_rec(handle, entry->ref1, 0, chapter_pageoff,
-	                                o_pid, entry->memory >> 12);
+	odb_err err = edba_u_lookup_rec(handle, entry->lookupsperpage, entry->ref1,
+	                                0, chapter_pageoff, o_pid,
+	                                entry->memory >> 12);
 #ifdef EDB_FUCKUPS
 	if(*o_pid == 0) {
 		log_critf("o_pid returned 0 from lookup despite it being in page "
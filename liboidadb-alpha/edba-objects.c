@@ -53,7 +53,8 @@ odb_err edba_objectopen(edba_handle_t *h, odb_oid oid, edbf_flags flags) {
 
 	// cluth lock the entry
 	edba_u_oidextract(oid, &eid, &rid);
-	err = edba_u_clutchentry(h, eid, 0);
+	err = edba_u_clutchentry(h, eid,
+	                         flags & EDBA_FWRITE ? EDBL_AIX : EDBL_AIS);
 	if(err) {
 		return err;
 	}
@@ -106,7 +107,7 @@ odb_err edba_objectopenc(edba_handle_t *h, odb_oid *o_oid, edbf_flags flags) {
 	if(eid < EDBD_EIDSTART) {
 		return ODB_EINVAL;
 	}
-	err = edba_u_clutchentry(h, eid, 0);
+	err = edba_u_clutchentry(h, eid, EDBL_AIX);
 	if(err) {
 		return err;
 	}
@@ -207,6 +208,7 @@ odb_err edba_objectopenc(edba_handle_t *h, odb_oid *o_oid, edbf_flags flags) {
 		.type = EDBL_LROW,
 		.object_pid = pageid,
 		.page_ioffset = intrapagebyteoff,
+		.entity = h->clutchedentryeid,
 	};
 	edbl_set(h->lockh, EDBL_ARELEASE, h->lock);
 
@@ -545,6 +547,7 @@ odb_err edba_u_pageload_row(edba_handle_t *h, odb_pid pid,
 			.type = EDBL_LROW,
 			.object_pid = pid,
 			.page_ioffset = page_byteoff,
+			.entity = h->clutchedentryeid,
 	};
 	if(flags & EDBA_FWRITE) {
 		lockaction = EDBL_AXL;
@@ -558,6 +561,10 @@ odb_err edba_u_pageload_row(edba_handle_t *h, odb_pid pid,
 		return err;
 	}
 
+	if(flags & EDBA_FWRITE) {
+		edbp_mod(h->edbphandle, EDBP_CACHEHINT, EDBP_HDIRTY);
+	}
+
 	// set the pointer
 	void *page = edbp_graw(h->edbphandle);
 	assignobject(h, page, page_byteoff, structdat);
@@ -20,7 +20,8 @@ odb_err edba_pageopen(edba_handle_t *h, odb_eid eid, odb_pid offset,
 	h->openflags = flags;
 
 	// cluth lock the entry
-	err = edba_u_clutchentry(h, eid, 0);
+	err = edba_u_clutchentry(h, eid,
+	                         flags & EDBA_FWRITE ? EDBL_AIX : EDBL_AIS);
 	if(err) {
 		return err;
 	}
@@ -42,6 +43,7 @@ odb_err edba_pageopen(edba_handle_t *h, odb_eid eid, odb_pid offset,
 			.type = EDBL_LOBJBODY,
 			.object_pid = foundpid,
 			.page_size  = edbd_size(h->parent->descriptor),
+			.entity     = h->clutchedentryeid,
 	};
 	if(flags & EDBA_FWRITE) {
 		edbl_set(h->lockh, EDBL_AXL, h->lock);
@@ -58,6 +60,15 @@ odb_err edba_pageopen(edba_handle_t *h, odb_eid eid, odb_pid offset,
 		return err;
 	}
 
+	// pages are opened to be browsed through, so don't let that push out
+	// everything else in the cache.
+	if(flags & EDBA_FWRITE) {
+		edbp_mod(h->edbphandle, EDBP_CACHEHINT, EDBP_HDIRTY | EDBP_HSEQUENTIAL);
+	} else {
+		edbp_mod(h->edbphandle, EDBP_CACHEHINT, EDBP_HSEQUENTIAL);
+	}
+	h->readahead = 0;
+
 	// set the pointer, fill out the handle's pointers
 	assignpage(h, foundpid, edbp_graw(h->edbphandle));
 	h->opened = ODB_ELMOBJPAGE;
@@ -96,6 +107,19 @@ odb_err edba_pageadvance(edba_handle_t *h) {
 		return ODB_EEOF;
 	}
 
+	// if the pages so far have been next to each other in the file then
+	// chances are the ones after this will be too (we can't know for sure
+	// until we read their prights). So have the ones we're about to get to
+	// start reading in now, in one go, rather than waiting on each of them
+	// one at a time.
+	if(newpid == h->pagepid + 1 && newpid + EDBA_READAHEAD / 2 >= h->readahead) {
+		odb_pid from = newpid + 1;
+		if(from < h->readahead) from = h->readahead;
+		odb_pid to = newpid + 1 + EDBA_READAHEAD;
+		edbp_prefetch(h->edbphandle, from, (int)(to - from));
+		h->readahead = to;
+	}
+
 	// there is another page after this, lets release the lock from this current page.
 	// We can also deload it sense we don't need any more info from it.
 	edbl_set(h->lockh, EDBL_ARELEASE, h->lock);
@@ -114,6 +138,11 @@ odb_err edba_pageadvance(edba_handle_t *h) {
 		h->pagehead = 0; // let edba_pageclose we don't have a page loaded.
 		return err;
 	}
+	if(h->openflags & EDBA_FWRITE) {
+		edbp_mod(h->edbphandle, EDBP_CACHEHINT, EDBP_HDIRTY | EDBP_HSEQUENTIAL);
+	} else {
+		edbp_mod(h->edbphandle, EDBP_CACHEHINT, EDBP_HSEQUENTIAL);
+	}
 	assignpage(h, newpid, edbp_graw(h->edbphandle));
 
 	return 0;
@@ -35,7 +35,9 @@ static odb_err xlloadlookup(edba_handle_t *handle,
 
 	// we can set this hint now to save us from doing it on the
 	// several exits.
-	edbp_mod(edbp, EDBP_CACHEHINT, EDBP_HINDEX3 * (4-(*lookuphead)->depth));
+	// (dirty: we only load with an XL lock to modify it)
+	edbp_mod(edbp, EDBP_CACHEHINT, EDBP_HDIRTY
+	                               | (EDBP_HINDEX3 * (4-(*lookuphead)->depth)));
 	return 0;
 }
 
@@ -324,8 +326,11 @@ odb_err edba_u_lookupdeepright(edba_handle_t *handle) {
 		} else {
 			// note we don't do refc-1 here because refc is the amount of /non/ null references.
 			// We need the next reference right after the full ones.
+			// (lookups don't lock this page, see edba_u_lookupwritebegin)
+			edba_u_lookupwritebegin(handle, lookuppid);
 			lookuprefs[lookuphead->refc] = newreference;
 			lookuphead->refc++;
+			edba_u_lookupwriteend(handle, lookuppid);
 
 			// note to self: we still have the page locked and loaded
 			// note to self: we always must break in this logic otherwise
@@ -434,7 +439,9 @@ odb_err edba_u_lookupdeepright(edba_handle_t *handle) {
 				  "This will cause this entire chapter to behave unpredictably.",
 				  crit_rollback_pid, entryid);
 	} else {
+		edba_u_lookupwritebegin(handle, crit_rollback_pid);
 		lookuprefs[crit_rollback_refnum].ref = 0;
+		edba_u_lookupwriteend(handle, crit_rollback_pid);
 		edbp_mod(edbp, EDBP_CACHEHINT, EDBP_HDIRTY);
 		deloadlookup(handle, &lookuppagelock);
 	}
@@ -455,10 +462,14 @@ odb_err edba_u_lookupdeepright(edba_handle_t *handle) {
 	});
 
 	// delete the lookup pages
+	// (a lookup may have followed the reference we just took out and still be
+	// reading one, this makes it start over)
 	for(int d = 0; d < createdlookupsc; d++) {
+		edba_u_lookupwritebegin(handle, createdlookups[d]);
 		if (edbd_del(handle->parent->descriptor, 1, createdlookups[d])) {
 			log_critf("page leak: pid %ld", createdlookups[d]);
 		}
+		edba_u_lookupwriteend(handle, createdlookups[d]);
 	}
 
 	// delete the object pages
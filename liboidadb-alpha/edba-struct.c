@@ -24,7 +24,7 @@ odb_err edba_structopen(edba_handle_t *h, odb_sid sid) {
 	h->openflags = EDBA_FWRITE;
 
 	// as per spec we lock the creation structure index.
-	edba_u_clutchentry(h, eid, 1);
+	edba_u_clutchentry(h, eid, EDBL_AXL);
 	uint16_t i;
 
 	unsigned int pageoffset = sid / h->clutchedentry->objectsperpage;
@@ -75,7 +75,7 @@ odb_err edba_structopenc(edba_handle_t *h, uint16_t *o_sid, odb_spec_struct_stru
 	}
 
 	// as per spec we lock the creation structure index.
-	edba_u_clutchentry(h, eid, 1);
+	edba_u_clutchentry(h, eid, EDBL_AXL);
 
 	// but after that lock that's all we need to do. No need to lock anything else.
 
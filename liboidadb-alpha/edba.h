@@ -23,10 +23,20 @@ typedef enum {
 // edba_host_t - for use in edba_handle
 // edba_host_init - initialize a host
 // edba_host_free - deallocate said host
+// how many version counters the host has for the lookup pages, see
+// edba_host_t.lookupverv.
+#define EDBA_LOOKUPVERC 1024
+
 typedef struct edba_host_st {
 	edbl_host_t *lockhost;
 	edbpcache_t *pagecache;
 	edbd_t      *descriptor;
+
+	// version counters of the lookup pages, a page's counter is
+	// lookupverv[pid % EDBA_LOOKUPVERC]. Lookups read pages without locking
+	// them and check these to see if they were being written to at the
+	// same time. See edba_u_lookupwritebegin.
+	uint32_t lookupverv[EDBA_LOOKUPVERC];
 } edba_host_t;
 odb_err edba_host_init(edba_host_t **o_host,
                        edbpcache_t *pagecache,
@@ -57,6 +67,7 @@ typedef struct edba_handle_st {
 	};
 
 	odb_spec_object *pagehead; // ODB_ELMOBJPAGE - pointer to page head.
+	odb_pid readahead; // ODB_ELMOBJPAGE - pages before this were already prefetched.
 
 	// Variables when opened == ODB_ELMSTRCT
 	//
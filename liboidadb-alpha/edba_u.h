@@ -7,15 +7,33 @@
 #include "edba.h"
 #include <oidadb-internal/odbfile.h>
 
+// how many pages edba_pageadvance has read ahead of itself when it looks like
+// it's going through pages that are next to each other in the file.
+#define EDBA_READAHEAD 32
 
+
+// locks the entry with act (see EDBL_AIS for which one to use: EDBL_AIS/AIX
+// if you're going to lock the pages/rows you're using, EDBL_ASH/AXL if you're
+// doing something to the whole entity).
+//
 // returns ODB_EEOF if eid is out of bounds
 //
 // updates: handle->clutchentry
 //          handle->clutchentryeid
 //
-odb_err edba_u_clutchentry(edba_handle_t *handle, odb_eid eid, int xl);
+odb_err edba_u_clutchentry(edba_handle_t *handle, odb_eid eid, edbl_act act);
 void edba_u_clutchentry_release(edba_handle_t *host);
 
+// anything that changes the refc or refs of a lookup page that may already
+// be referenced must do it between these two (and with the LLOOKUP_NEW XL
+// lock, which is what keeps writers apart). Same goes for deleting one.
+// edba_u_lookupoid reads lookup pages without locks and retries if the page
+// was written to while it was reading it.
+//
+// THREADING: MT-safe.
+void edba_u_lookupwritebegin(edba_handle_t *handle, odb_pid lookuppid);
+void edba_u_lookupwriteend(edba_handle_t *handle, odb_pid lookuppid);
+
 // must be called AFTER edba_u_clutchentry
 // must be called AFTER edba_u_entrytrashlk (XL)
 //
@@ -409,6 +409,112 @@ struct odbh_jobret odbh_jobj_read(odbh *handle
 	return ret;
 }
 
+odb_err odbh_jobj_readv(odbh *handle
+		, const odb_oid *oidv
+		, void *const *usrobjv
+		, struct odbh_jobret *o_retv
+		, unsigned int count) {
+	edbs_job_t jobv[EDBS_INSTALLVMAX];
+	// what oidv index and structure each of jobv is for.
+	unsigned int idxv[EDBS_INSTALLVMAX];
+	struct odb_structstat structv[EDBS_INSTALLVMAX];
+	odb_err err;
+
+	// invals
+	if(handle == 0) return ODB_EINVAL;
+	if(count && (!oidv || !usrobjv || !o_retv)) return ODB_EINVAL;
+	for(unsigned int i = 0; i < count; i++) {
+		if(!usrobjv[i]) return ODB_EINVAL;
+	}
+
+	// the structure is only looked up again once the entity changes, which
+	// in most batches is never.
+	struct odb_structstat structstat;
+	odb_eid lasteid = 0;
+	odb_err lasterr = 0;
+	int looked = 0;
+	int installed = 0;
+
+	for(unsigned int next = 0; next < count;) {
+		// gather up the next batch. The ones we can't find the structure of
+		// are done right here.
+		unsigned int n = 0;
+		unsigned int i;
+		for(i = next; i < count && n < EDBS_INSTALLVMAX; i++) {
+			odb_eid eid = odb_oid_get_eid(oidv[i]);
+			if(!looked || eid != lasteid) {
+				lasterr = eid2struct(handle, eid, &structstat, 0);
+				lasteid = eid;
+				looked = 1;
+			}
+			if(lasterr) {
+				o_retv[i].err = lasterr;
+				continue;
+			}
+			idxv[n] = i;
+			structv[n] = structstat;
+			n++;
+		}
+		if(n == 0) {
+			break;
+		}
+
+		// install as many as we can at once, write all of their requests,
+		// then read all of their replies. The workers will be on the first
+		// one by the time we've written the last.
+		unsigned int c;
+		if((err = edbs_jobinstallv(handle->shm, ODB_JREAD, jobv, n, &c))) {
+			if(err == ODB_EJOBDESC) {
+				err = ODB_EVERSION;
+			}
+			if(!installed) {
+				return err;
+			}
+			// the ones we already did still count.
+			for(unsigned int k = 0; k < n; k++) {
+				o_retv[idxv[k]].err = err;
+			}
+			for(; i < count; i++) {
+				o_retv[i].err = err;
+			}
+			return 0;
+		}
+		installed = 1;
+		// whatever didn't get a job is gathered again next time around.
+		next = c < n ? idxv[c] : i;
+
+		// write the oid+SVID of each
+		for(unsigned int k = 0; k < c; k++) {
+			odb_oid oid = oidv[idxv[k]];
+			o_retv[idxv[k]].err = edbs_jobwritev(jobv[k]
+					, &oid, sizeof(oid)
+					, &structv[k].svid, sizeof(structv[k].svid)
+					, 0);
+		}
+
+		// read err+usrobj of each. We have to read every job we installed
+		// even if something went wrong with the others, otherwise the slots
+		// won't be freed.
+		for(unsigned int k = 0; k < c; k++) {
+			struct odbh_jobret *ret = &o_retv[idxv[k]];
+			if(ret->err) {
+				ret->err = edbs_joberr_trunc(ret->err);
+				continue;
+			}
+			odb_err dieerr;
+			if((ret->err = edbs_jobreadv(jobv[k]
+					, &dieerr, sizeof(dieerr)
+					, usrobjv[idxv[k]], structv[k].objc
+					, 0))) {
+				ret->err = edbs_joberr_trunc(ret->err);
+				continue;
+			}
+			ret->err = dieerr;
+		}
+	}
+	return 0;
+}
+
 // helper function to odbh_jobj_selectcb and odbh_jobj_updatecb. They share
 // 90% of the same protocol.
 struct odbh_jobret _odbh_jobj_cb(odbh *handle
@@ -441,7 +547,7 @@ struct odbh_jobret _odbh_jobj_cb(odbh *handle
 		return ret;
 	}
 
-	// write the eid/pagestart/pagecap
+	// write the eid/pagestart/pagecap/SVID
 	// later: have page_start and page_cap avaialbe to the user for
 	//  multi-processing.
 	odb_pid page_start = 0,page_cap = -1;
@@ -449,6 +555,7 @@ struct odbh_jobret _odbh_jobj_cb(odbh *handle
 			, &eid, sizeof(eid)
 			, &page_start, sizeof(page_start)
 			, &page_cap, sizeof(page_cap)
+			, &structstat.svid, sizeof(structstat.svid)
 			, 0))) {
 		ret.err = edbs_joberr_trunc(ret.err);
 		return ret;
@@ -498,8 +605,31 @@ struct odbh_jobret _odbh_jobj_cb(odbh *handle
 			break;
 		}
 
+		// the host sends objc whole objects (see _jupdateselect)
+		int payload = (int)(objc * structstat.fixedc);
+
+		// for selects, the callback reads them right out of the transfer
+		// buffer. Only if they don't fit in there all at once are they
+		// copied out.
+		if(jobtype == ODB_JSELECT) {
+			const void *in;
+			ret.err = edbs_jobreadreserve(job, payload, &in);
+			if(!ret.err) {
+				odb_select_cb *cb_ = cb;
+				cb_(handle->user_cookie, objc, (void *)in);
+				if((ret.err = edbs_jobreadcommit(job, payload))) {
+					ret.err = edbs_joberr_trunc(ret.err);
+					break;
+				}
+				continue;
+			}
+			if(ret.err != ODB_EBUFFSIZE) {
+				ret.err = edbs_joberr_trunc(ret.err);
+				break;
+			}
+		}
+
 		// make sure our buffer is big enough to receive this amount of objects.
-		uint64_t payload = objc * sizeof(structstat.fixedc);
 		if(payload > userbuffq) {
 			free(userobjbuff);
 			userobjbuff = malloc(payload);
@@ -512,7 +642,7 @@ struct odbh_jobret _odbh_jobj_cb(odbh *handle
 		}
 
 		// read in the objects from the stream
-		if ((ret.err = edbs_jobread(job, &userobjbuff, sizeof(payload)))) {
+		if ((ret.err = edbs_jobread(job, userobjbuff, payload))) {
 			ret.err = edbs_joberr_trunc(ret.err);
 			break;
 		}
@@ -533,7 +663,7 @@ struct odbh_jobret _odbh_jobj_cb(odbh *handle
 		// with our updates.
 		if(jobtype == ODB_JUPDATE) {
 			//sense we're updating we must send our changes back to the host.
-			if ((ret.err = edbs_jobwrite(job, &userobjbuff, sizeof(payload)))) {
+			if ((ret.err = edbs_jobwrite(job, userobjbuff, payload))) {
 				ret.err = edbs_joberr_trunc(ret.err);
 				break;
 			}
@@ -40,4 +40,25 @@ struct odbh_jobret odbh_jent_download(odbh *handle
 struct odbh_jobret odbh_jstk_download(odbh *handle
 		, struct odb_structstat **o_stkstat);
 
+// odbh_jobj_read for count objects at once: oidv[i] is read into usrobjv[i]
+// and its result (what odbh_jobj_read would have returned) goes into
+// o_retv[i]. The jobs are installed in batches (edbs_jobinstallv) so this is
+// much cheaper than calling odbh_jobj_read count times.
+//
+// Objects whose entity can't be found (or has no structure) just get
+// ODB_ENOENT in o_retv, the rest of them are still read. The structure is
+// looked up once for each run of oids of the same entity, so keep those
+// together.
+//
+// Returns an error only if none of the reads could be attempted (ODB_EINVAL,
+// ODB_EVERSION, or ODB_ECLOSED). Otherwise check o_retv.
+//
+// later: this belongs next to odbh_jobj_read once the handle api is moved
+//  into oidadb.h.
+odb_err odbh_jobj_readv(odbh *handle
+		, const odb_oid *oidv
+		, void *const *usrobjv
+		, struct odbh_jobret *o_retv
+		, unsigned int count);
+
 #endif
\ No newline at end of file
@@ -3,14 +3,17 @@
 
 #include "edbl.h"
 #include "errors.h"
-#include "pthread.h"
+#include "wrappers.h"
 
 #include <string.h>
+#include <stdarg.h>
+#include <stdatomic.h>
 #include <pthread.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <malloc.h>
+#include <time.h>
 
 
 // edbd special-functions. See namespaces.org, see edbd-edbl.c.
@@ -22,15 +25,199 @@ extern int edbl_reopen(const edbd_t *file, int flags, mode_t mode);
 // returns the byte-offset to the given eid in the file.
 unsigned int edbl_pageoffset(const edbd_t *file, odb_eid eid);
 
+// the host's lock table (see "In-host lock table" in locking.org).
+//
+// Every edbl_lock comes down to a range of bytes in the file (the same ones
+// the fcntl backend locks) and a key that says which bucket it goes in. The
+// key is picked so that locks whose bytes can overlap always land in the same
+// bucket: the eid for the entry locks, the page id for the lookup and object
+// locks. Arbitrary locks go by their starting 4KiB and only ever see each
+// other.
+//
+// Each range that is locked has a lockhead in its bucket saying who holds it.
+// A lock is held by a handle, not a thread, and, same as OFD locks, a handle
+// never conflicts with itself, locking something twice is the same as
+// locking it once, and a single release lets go of it.
+//
+// Handles that have to wait are tracked in a wait-for graph (see
+// deadlock_check) and can be given up on after a while (see
+// EDBL_CONFIG_TIMEOUT).
+#define EDBL_BUCKETS 1024
+#define EDBL_ARBSPAN 12
+
+// how far deadlock_check follows the graph, and how many handles it looks
+// at blocking each one. Anything bigger than that isn't seen, the timeouts
+// are the backstop.
+#define EDBL_DEADLOCKDEPTH 32
+#define EDBL_DEADLOCKFAN   16
+
+// how many counters the space-saving sketch of the most waited on locks has
+// (see profile_hot). Only the top ODBTELEM_LOCKHOTC are reported, the rest
+// are there so those are more likely to be right.
+#define EDBL_HOTC (ODBTELEM_LOCKHOTC * 4)
+
+// the modes a lock can be held in (see edbl_act), as indexes into
+// lockhead.modec and lock_compat.
+enum {
+	EDBL_MIS,
+	EDBL_MIX,
+	EDBL_MS,
+	EDBL_MX,
+	EDBL_MODEC,
+};
+
+// lock_compat[a][b] is non-0 if a handle can be let in with mode a while
+// another holds mode b.
+static const uint8_t lock_compat[EDBL_MODEC][EDBL_MODEC] = {
+		//              IS IX  S  X
+		[EDBL_MIS] = {1, 1, 1, 0},
+		[EDBL_MIX] = {1, 1, 0, 0},
+		[EDBL_MS]  = {1, 0, 1, 0},
+		[EDBL_MX]  = {0, 0, 0, 0},
+};
+
+static int lock_mode(edbl_act act) {
+	switch (act) {
+		case EDBL_AIS: return EDBL_MIS;
+		case EDBL_AIX: return EDBL_MIX;
+		case EDBL_ASH: return EDBL_MS;
+		default:       return EDBL_MX;
+	}
+}
+
+typedef enum edbl_keyclass {
+	EDBL_KFILE,
+	EDBL_KEID,
+	EDBL_KPID,
+	EDBL_KARB,
+} edbl_keyclass;
+
+// what a edbl_lock turns into.
+typedef struct edbl_region {
+	off64_t  start;
+	off64_t  len; // 0 means to the end of the file, like fcntl.
+	uint64_t key;
+	edbl_keyclass keyclass;
+	edbl_type type;
+
+	// the fcntl backend locks the byte before start first (see fcntl-LENTRY)
+	int      clutch;
+} edbl_region;
+
+typedef struct edbl_held edbl_held;
+
+typedef struct edbl_lockhead {
+	off64_t  start;
+	off64_t  len;
+	edbl_keyclass keyclass;
+
+	uint32_t modec[EDBL_MODEC]; // how many handles hold it in each mode
+	edbl_held *holderv;         // and which ones (see edbl_held.hnext)
+
+	// threads sleeping on this head. xwaiters are the ones that want it
+	// exclusive, new lockers of the other modes wait behind them so a
+	// steady stream of shared locks can't starve them out (what the clutch
+	// is for in the fcntl backend).
+	uint32_t waiters;
+	uint32_t xwaiters;
+
+	struct edbl_lockhead *next;
+} edbl_lockhead;
+
+typedef struct edbl_bucket {
+	pthread_mutex_t mutex;
+
+	// bumped every time something in this bucket is let go. Waiters sleep on
+	// it with futex_wait.
+	uint32_t futex;
+	uint32_t waiters;
+
+	edbl_lockhead *headv;
+	edbl_lockhead *freev; // unused heads to save a malloc
+} __attribute__((aligned(64))) edbl_bucket;
+
 typedef struct edbl_host_t {
 	const edbd_t *fd;
-	pthread_mutex_t mutex_index;
-	pthread_mutex_t mutex_struct;
+
+	// see EDBL_CONFIG_OFD
+	atomic_int ofd;
+
+	// see EDBL_CONFIG_TIMEOUT, in milliseconds.
+	unsigned int timeoutv[EDBL_LARBITRARY + 1];
+
+	// see EDBL_CONFIG_ESCALATE
+	unsigned int escalate;
+
+	// graphmutex is held while looking for deadlocks. Its always locked
+	// before any bucket mutex. The handles are listed here to follow the
+	// graph, and are only linked or unlinked with it locked.
+	pthread_mutex_t graphmutex;
+	edbl_handle_t  *handlev;
+	uint64_t        visitgen;
+
+	// updated with __atomic adds, only ever after a wait.
+	struct odbtelem_lockstats stats;
+
+	// see EDBL_CONFIG_PROFILE. profilev is updated with __atomic adds,
+	// hotv (see profile_hot) only with profilemutex locked.
+	atomic_int               profile;
+	struct odbtelem_locktype profilev[EDBL_LARBITRARY + 1];
+	pthread_mutex_t          profilemutex;
+	struct odbtelem_lockhot  hotv[EDBL_HOTC];
+
+	edbl_bucket bucketv[EDBL_BUCKETS];
 } edbl_host_t;
 
+// a lock a handle holds.
+typedef struct edbl_held {
+	edbl_handle_t *handle;
+	edbl_lockhead *head;
+	edbl_bucket   *bucket;
+	edbl_act       act;
+	edbl_type      type;
+	uint64_t       key; // see edbl_region.key
+
+	// when it was placed, if the profile was being kept then (0 if not).
+	uint64_t       granted;
+
+	// next holder of head (under the bucket's mutex), and the next lock the
+	// handle holds (or the next free one).
+	struct edbl_held *hnext;
+	struct edbl_held *next;
+} edbl_held;
+
 typedef struct edbl_handle_t {
 	edbl_host_t *parent;
+
+	// only opened with EDBL_CONFIG_OFD, -1 until then.
 	int fd_d;
+
+	edbl_held *heldv;
+	edbl_held *freev;
+
+	// the LENTRY this handle has (the last one, if it has more than one) and
+	// how many LROW and LOBJBODY locks have been placed under it. See
+	// lock_escalate.
+	edbl_held   *entry;
+	unsigned int childc;
+
+	// what this handle is waiting on, for deadlock_check. Only touched with
+	// graphmutex locked. waiting is 0 while its not waiting, that one is also
+	// cleared by host_acquire with the bucket locked the moment the wait is
+	// over (so wait_blockers doesn't see a lock we just got as still being
+	// waited on).
+	int          waiting;
+	edbl_region  waitregion;
+	edbl_act     waitact;
+	edbl_bucket *waitbucket;
+	uint64_t     waitstart;
+	uint64_t     visit;
+
+	// set when deadlock_check picked this handle to give up its wait.
+	atomic_int   deadlocked;
+
+	struct edbl_handle_t *hnext;
+	struct edbl_handle_t *hprev;
 } edbl_handle_t;
 
 odb_err edbl_host_init(edbl_host_t **o_lockdir, const edbd_t *file) {
@@ -41,7 +228,7 @@ odb_err edbl_host_init(edbl_host_t **o_lockdir, const edbd_t *file) {
 	}
 
 	// ret
-	edbl_host_t *ret = malloc(sizeof(edbl_host_t));
+	edbl_host_t *ret = memalign(_Alignof(edbl_bucket), sizeof(edbl_host_t));
 	if(ret == 0) {
 		if (errno == ENOMEM) {
 			return ODB_ENOMEM;
@@ -50,52 +237,153 @@ odb_err edbl_host_init(edbl_host_t **o_lockdir, const edbd_t *file) {
 		return ODB_ECRIT;
 	}
 	bzero(ret, sizeof(edbl_host_t));
-	*o_lockdir = ret;
 	// **defer-on-error: free(ret);
 	ret->fd = file;
+	ret->escalate = EDBL_ESCALATE_DEFAULT;
 
 	// mutexes.
-	int err = pthread_mutex_init(&ret->mutex_struct,0);
+	int err = pthread_mutex_init(&ret->graphmutex, 0);
 	if(err) {
 		log_critf("failed to initialize pthread");
 		free(ret);
 		return ODB_ECRIT;
 	}
-	err = pthread_mutex_init(&ret->mutex_index,0);
+	err = pthread_mutex_init(&ret->profilemutex, 0);
 	if(err) {
-		pthread_mutex_destroy(&ret->mutex_struct);
-		free(ret);
 		log_critf("failed to initialize pthread");
-		return ODB_ECRIT;
-	}
-	err = pthread_mutex_init(&ret->mutex_index,0);
-	if(err) {
-		pthread_mutex_destroy(&ret->mutex_struct);
+		pthread_mutex_destroy(&ret->graphmutex);
 		free(ret);
-		log_critf("failed to initialize pthread");
 		return ODB_ECRIT;
 	}
+	for(int i = 0; i < EDBL_BUCKETS; i++) {
+		err = pthread_mutex_init(&ret->bucketv[i].mutex, 0);
+		if(err) {
+			log_critf("failed to initialize pthread");
+			while(i--) {
+				pthread_mutex_destroy(&ret->bucketv[i].mutex);
+			}
+			pthread_mutex_destroy(&ret->profilemutex);
+			pthread_mutex_destroy(&ret->graphmutex);
+			free(ret);
+			return ODB_ECRIT;
+		}
+	}
+	*o_lockdir = ret;
 	return 0;
 }
 void    edbl_host_free(edbl_host_t *h) {
-	pthread_mutex_destroy(&h->mutex_struct);
-	pthread_mutex_destroy(&h->mutex_struct);
+	for(int i = 0; i < EDBL_BUCKETS; i++) {
+		edbl_bucket *bucket = &h->bucketv[i];
+		pthread_mutex_destroy(&bucket->mutex);
+		// (any heads left are from handles that were never freed)
+		edbl_lockhead *lists[2] = {bucket->headv, bucket->freev};
+		for(int j = 0; j < 2; j++) {
+			edbl_lockhead *head = lists[j];
+			while(head) {
+				edbl_lockhead *next = head->next;
+				free(head);
+				head = next;
+			}
+		}
+	}
+	pthread_mutex_destroy(&h->profilemutex);
+	pthread_mutex_destroy(&h->graphmutex);
 	free(h);
 }
-odb_err edbl_handle_init(edbl_host_t *host, edbl_handle_t **oo_handle) {
-	if(!host || !oo_handle) {
+
+odb_err edbl_host_config(edbl_host_t *host, edbl_config_opts opts, ...) {
+	if(!host) return ODB_EINVAL;
+
+	va_list args;
+	va_start(args, opts);
+	odb_err err = 0;
+	switch (opts) {
+		case EDBL_CONFIG_OFD:
+			host->ofd = va_arg(args, int) != 0;
+			break;
+		case EDBL_CONFIG_TIMEOUT: {
+			edbl_type type = va_arg(args, edbl_type);
+			unsigned int ms = va_arg(args, unsigned int);
+			if(type > EDBL_LARBITRARY) {
+				err = ODB_EINVAL;
+				break;
+			}
+			__atomic_store_n(&host->timeoutv[type], ms, __ATOMIC_RELAXED);
+			break;
+		}
+		case EDBL_CONFIG_ESCALATE:
+			__atomic_store_n(&host->escalate, va_arg(args, unsigned int),
+			                 __ATOMIC_RELAXED);
+			break;
+		case EDBL_CONFIG_PROFILE: {
+			int on = va_arg(args, int) != 0;
+			pthread_mutex_lock(&host->profilemutex);
+			if(on && !host->profile) {
+				// (a lock or two from before can still slip in, its a
+				// profile)
+				bzero(host->profilev, sizeof(host->profilev));
+				bzero(host->hotv, sizeof(host->hotv));
+			}
+			host->profile = on;
+			pthread_mutex_unlock(&host->profilemutex);
+			break;
+		}
+		default:
+			err = ODB_EINVAL;
+			break;
+	}
+	va_end(args);
+	return err;
+}
+
+odb_err edbl_host_stats(edbl_host_t *host, struct odbtelem_lockstats *o_stats) {
+	if(!host || !o_stats) {
 		return ODB_EINVAL;
 	}
+	const uint64_t *src = (const uint64_t *)&host->stats;
+	uint64_t *dst = (uint64_t *)o_stats;
+	for(int i = 0; i < sizeof(*o_stats) / sizeof(uint64_t); i++) {
+		dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+	}
+	return 0;
+}
 
-	// We use O_DIRECT just cuz why not. We're never going to call read(2)
-	// nor even mmap with this fd so let just make it as bare-bones as possible.
-	int fd = edbl_reopen(host->fd, O_RDWR
-	                               | O_DIRECT
-								   | O_LARGEFILE
-								   , 0666);
-	if(fd == -1) {
-		log_critf("failed to create open file descriptor");
-		return ODB_ECRIT;
+odb_err edbl_host_profile(edbl_host_t *host,
+                          struct odbtelem_lockprofile *o_profile) {
+	if(!host || !o_profile) {
+		return ODB_EINVAL;
+	}
+	bzero(o_profile, sizeof(*o_profile));
+	const uint64_t *src = (const uint64_t *)host->profilev;
+	uint64_t *dst = (uint64_t *)o_profile->typev;
+	size_t n = (EDBL_LARBITRARY + 1) * sizeof(struct odbtelem_locktype)
+	           / sizeof(uint64_t);
+	for(int i = 0; i < n; i++) {
+		dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+	}
+
+	// the top of the sketch, most waits first.
+	pthread_mutex_lock(&host->profilemutex);
+	for(int i = 0; i < EDBL_HOTC; i++) {
+		struct odbtelem_lockhot hot = host->hotv[i];
+		int j = ODBTELEM_LOCKHOTC;
+		while(j && o_profile->hotv[j - 1].waits < hot.waits) {
+			if(j < ODBTELEM_LOCKHOTC) {
+				o_profile->hotv[j] = o_profile->hotv[j - 1];
+			}
+			j--;
+		}
+		if(j < ODBTELEM_LOCKHOTC) {
+			o_profile->hotv[j] = hot;
+		}
+	}
+	pthread_mutex_unlock(&host->profilemutex);
+	return 0;
+}
+
+odb_err edbl_handle_init(edbl_host_t *host, edbl_handle_t **oo_handle) {
+	if(!host || !oo_handle) {
+		return ODB_EINVAL;
 	}
 
 	// malloc the return value
@@ -110,171 +398,826 @@ odb_err edbl_handle_init(edbl_host_t *host, edbl_handle_t **oo_handle) {
 	bzero(h, sizeof(edbl_handle_t));
 	*oo_handle = h;
 	h->parent = host;
-	h->fd_d = fd;
+	h->fd_d = -1;
+
+	pthread_mutex_lock(&host->graphmutex);
+	h->hnext = host->handlev;
+	if(h->hnext) h->hnext->hprev = h;
+	host->handlev = h;
+	pthread_mutex_unlock(&host->graphmutex);
 	return 0;
 }
+
+// the handle's descriptor for OFD locks, opened the first time its needed.
+// returns -1 if it can't be opened.
+static int handle_fd(edbl_handle_t *h) {
+	if(h->fd_d != -1) {
+		return h->fd_d;
+	}
+	// We use O_DIRECT just cuz why not. We're never going to call read(2)
+	// nor even mmap with this fd so let just make it as bare-bones as possible.
+	h->fd_d = edbl_reopen(h->parent->fd, O_RDWR
+	                                     | O_DIRECT
+	                                     | O_LARGEFILE
+	                                     , 0666);
+	if(h->fd_d == -1) {
+		log_critf("failed to create open file descriptor");
+	}
+	return h->fd_d;
+}
+
+static void host_release(edbl_handle_t *h, edbl_held *held);
+
 void    edbl_handle_free(edbl_handle_t *handle) {
 	if(handle == 0 || handle->parent == 0) {
 		return;
 	}
 	// unlock everything
-	struct flock64 f = {
-			.l_type = F_UNLCK,
-			.l_start = sysconf(_SC_PAGESIZE),
-			.l_len = 0,
-			.l_whence = SEEK_SET,
-			.l_pid = 0,
-	};
-	fcntl64(handle->fd_d, F_OFD_SETLK, &f);
-	close(handle->fd_d);
-	free(handle);
-}
-
-// extracted so can be used between edbl_set and edbl_test functions.
-// if test is non-null then will run fcntl(fd, F_OFD_GETLK, test), otherwise
-// F_OFD_SETLKW will be used and nothing outputted.
-static odb_err _edbl_set(edbl_handle_t *h, edbl_act action, edbl_lock lock,
-                         struct flock64 *test) {
-	struct flock64 *flock;
-	struct flock64 flock_noptr;
-	int cmd;
-	if(!test) {
-		flock = &flock_noptr;
-		cmd = F_OFD_SETLKW;
-	} else {
-		flock = test;
-		cmd = F_OFD_GETLK;
+	while(handle->heldv) {
+		host_release(handle, handle->heldv);
 	}
-	flock->l_whence = SEEK_SET;
-	flock->l_pid = 0;
-	if(test) {
-		cmd = F_OFD_GETLK;
+	while(handle->freev) {
+		edbl_held *next = handle->freev->next;
+		free(handle->freev);
+		handle->freev = next;
 	}
-	switch (action) {
-		case EDBL_ARELEASE:
-			flock->l_type = F_UNLCK;
-			break;
-		case EDBL_AXL:
-			flock->l_type = F_WRLCK;
-			break;
-		case EDBL_ASH:
-			flock->l_type = F_RDLCK;
-			break;
-		default:
-			log_critf("edbl_set INVAL");
-			return ODB_ECRIT;
+	edbl_host_t *host = handle->parent;
+	pthread_mutex_lock(&host->graphmutex);
+	if(handle->hprev) handle->hprev->hnext = handle->hnext;
+	else host->handlev = handle->hnext;
+	if(handle->hnext) handle->hnext->hprev = handle->hprev;
+	pthread_mutex_unlock(&host->graphmutex);
+	if(handle->fd_d != -1) {
+		struct flock64 f = {
+				.l_type = F_UNLCK,
+				.l_start = sysconf(_SC_PAGESIZE),
+				.l_len = 0,
+				.l_whence = SEEK_SET,
+				.l_pid = 0,
+		};
+		fcntl64(handle->fd_d, F_OFD_SETLK, &f);
+		close(handle->fd_d);
 	}
+	free(handle);
+}
 
-	// note: don't trust this after the switch statement.
-	int fd = h->fd_d;
-	const unsigned int pagesize = edbd_size(h->parent->fd);
-
-	// set l_len and l_start
-	flock->l_len = 1;
+// works out the bytes of the lock (see the fcntl backend in locking.org)
+static odb_err lock_region(edbl_handle_t *h, edbl_lock lock, edbl_region *o) {
+	o->len = 1;
+	o->clutch = 0;
+	o->type = lock.type;
 	switch (lock.type) {
 		case EDBL_LFILE:
-			flock->l_start = 0;
-			if(fcntl64(fd, F_OFD_SETLKW, flock) == -1) break;
+			o->start = 0;
+			o->key = 0;
+			o->keyclass = EDBL_KFILE;
 			return 0;
 
 		case EDBL_LENTCREAT:
-			flock->l_start = 0;
+			o->start = 0;
 			lock.eid = EDBD_EIDINDEX;
 			goto lock_entry_byte;
 		case EDBL_LSTRUCTCREAT:
-			flock->l_start = 0;
+			o->start = 0;
 			lock.eid = EDBD_EIDSTRUCT;
 			goto lock_entry_byte;
 		case EDBL_LENTTRASH:
 			// lets get cheeky.
-			flock->l_start = offsetof(odb_spec_index_entry, trashlast);
+			o->start = offsetof(odb_spec_index_entry, trashlast);
 			goto lock_entry_byte; // very cheeky.
 		case EDBL_LREF0C:
 			// ... keep it cheeky.
-			flock->l_start = offsetof(odb_spec_index_entry, ref0c);
+			o->start = offsetof(odb_spec_index_entry, ref0c);
+			goto lock_entry_byte;
+		case EDBL_LENTRY:
+			// clutch lock: what's held is the second byte.
+			o->start = 1;
+			o->clutch = 1;
 			goto lock_entry_byte;
 
 		lock_entry_byte:
-			flock->l_start += edbl_pageoffset(h->parent->fd, lock.eid);
-			if(fcntl64(fd, cmd, flock) == -1) break;
+			o->start += edbl_pageoffset(h->parent->fd, lock.eid);
+			o->key = lock.eid;
+			o->keyclass = EDBL_KEID;
 			return 0;
 
-		case EDBL_LENTRY:
-			// clutch lock.
-			flock->l_start = edbl_pageoffset(h->parent->fd, lock.eid);
-			if(flock->l_type == F_UNLCK) {
-				// simply release the second-byte lock.
-				flock->l_start++;
-				if(fcntl64(fd, cmd, flock) == -1) break;
-				return 0;
-			}
-			// Engage the first-byte lock
-			if(fcntl64(fd, cmd, flock) == -1) break;
-			// engage the second-byte lock
-			flock->l_start++;
-			if(fcntl64(fd, cmd, flock) == -1) break;
-			// release the first-byte lock.
-			flock->l_start--;
-			flock->l_type = F_UNLCK;
-			if(fcntl64(fd, cmd, flock) == -1) break;
-			return 0;
+		default:
+			break;
+	}
 
+	const unsigned int pagesize = edbd_size(h->parent->fd);
+	o->key = lock.object_pid; // (same as lookup_pid)
+	o->keyclass = EDBL_KPID;
+	switch (lock.type) {
 		case EDBL_LLOOKUP_EXISTING:
-			flock->l_start = pagesize * (off64_t)lock.lookup_pid;
-			if(fcntl64(fd, cmd, flock) == -1) break;
+			o->start = pagesize * (off64_t)lock.lookup_pid;
 			return 0;
 
 		case EDBL_LLOOKUP_NEW:
-			flock->l_start = pagesize * (off64_t)lock.lookup_pid + 1;
-			if(fcntl64(fd, cmd, flock) == -1) break;
+			o->start = pagesize * (off64_t)lock.lookup_pid + 1;
 			return 0;
 
 		case EDBL_LTRASHOFF:
-			flock->l_start = pagesize * (off64_t)lock.object_pid;
-			flock->l_start += offsetof(odb_spec_object, trashstart_off);
-			if(fcntl64(fd, cmd, flock) == -1) break;
+			o->start = pagesize * (off64_t)lock.object_pid;
+			o->start += offsetof(odb_spec_object, trashstart_off);
 			return 0;
 
 		case EDBL_LOBJPRIGHT:
-			flock->l_start = pagesize * (off64_t)lock.object_pid;
-			flock->l_start += offsetof(odb_spec_object, head.pright);
-			if(fcntl64(fd, cmd, flock) == -1) break;
+			o->start = pagesize * (off64_t)lock.object_pid;
+			o->start += offsetof(odb_spec_object, head.pright);
 			return 0;
 
 		case EDBL_LOBJBODY:
-			flock->l_start = pagesize * (off64_t)lock.object_pid;
-			flock->l_start += ODB_SPEC_HEADSIZE;
-			flock->l_len = lock.page_size - ODB_SPEC_HEADSIZE;
-			if(fcntl64(fd, cmd, flock) == -1) break;
+			o->start = pagesize * (off64_t)lock.object_pid;
+			o->start += ODB_SPEC_HEADSIZE;
+			o->len = lock.page_size - ODB_SPEC_HEADSIZE;
 			return 0;
 
 		case EDBL_LROW:
-			flock->l_start = pagesize * (off64_t)lock.object_pid;
-			flock->l_start += lock.page_ioffset;
-			if(fcntl64(fd, cmd, flock) == -1) break;
+			o->start = pagesize * (off64_t)lock.object_pid;
+			o->start += lock.page_ioffset;
 			return 0;
 
 		case EDBL_LARBITRARY:
-			flock->l_start = lock.l_start;
-			flock->l_len   = lock.l_len;
-			if(fcntl64(fd, cmd, flock) == -1) break;
+			o->start = lock.l_start;
+			o->len   = lock.l_len;
+			o->key   = (uint64_t)lock.l_start >> EDBL_ARBSPAN;
+			o->keyclass = EDBL_KARB;
 			return 0;
 
 		default:
 			log_critf("edbl_set INVAL");
 			return ODB_ECRIT;
 	}
-	// if we're here then the above switch statement had an error.
-	log_critf("critical error in edbl_set lock-phase switch");
+}
+
+static edbl_bucket *host_bucket(edbl_host_t *host, const edbl_region *r) {
+	uint64_t x = r->key * 0x9E3779B97F4A7C15ULL + r->keyclass;
+	x ^= x >> 29;
+	return &host->bucketv[x & (EDBL_BUCKETS - 1)];
+}
+
+static int region_overlaps(const edbl_lockhead *head, const edbl_region *r) {
+	if(head->keyclass != r->keyclass) return 0;
+	if(head->len && r->start >= head->start + head->len) return 0;
+	if(r->len && head->start >= r->start + r->len) return 0;
+	return 1;
+}
+
+// returns the lock the handle holds on head, or null.
+static edbl_held *handle_held(edbl_handle_t *h, const edbl_lockhead *head) {
+	for(edbl_held *held = h->heldv; held; held = held->next) {
+		if(held->head == head) {
+			return held;
+		}
+	}
+	return 0;
+}
+
+// returns non-0 if h can't get act on the region because of another
+// handle. head is the head for the region if it has one.
+//
+// bucket must be locked.
+static int host_conflicts(edbl_handle_t *h, edbl_bucket *bucket,
+                          const edbl_lockhead *head, const edbl_region *r,
+                          edbl_act act) {
+	int mode = lock_mode(act);
+	for(edbl_lockhead *o = bucket->headv; o; o = o->next) {
+		if(!region_overlaps(o, r)) continue;
+		edbl_held *held = handle_held(h, o);
+		int mine = held ? lock_mode(held->act) : -1;
+		for(int m = 0; m < EDBL_MODEC; m++) {
+			uint32_t c = o->modec[m] - (m == mine);
+			if(c && !lock_compat[mode][m]) {
+				return 1;
+			}
+		}
+		if(o == head && mode != EDBL_MX && o->xwaiters && !held) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// finds the head for the region in the bucket, or makes one.
+//
+// bucket must be locked.
+static odb_err bucket_head(edbl_bucket *bucket, const edbl_region *r,
+                           edbl_lockhead **o_head) {
+	edbl_lockhead *head;
+	for(head = bucket->headv; head; head = head->next) {
+		if(head->start == r->start && head->len == r->len
+		   && head->keyclass == r->keyclass) {
+			*o_head = head;
+			return 0;
+		}
+	}
+	head = bucket->freev;
+	if(head) {
+		bucket->freev = head->next;
+	} else {
+		head = malloc(sizeof(edbl_lockhead));
+		if(head == 0) {
+			return ODB_ENOMEM;
+		}
+	}
+	bzero(head, sizeof(edbl_lockhead));
+	head->start = r->start;
+	head->len = r->len;
+	head->keyclass = r->keyclass;
+	head->next = bucket->headv;
+	bucket->headv = head;
+	*o_head = head;
+	return 0;
+}
+
+// puts the head back in the free list if nothing holds or waits on it.
+//
+// bucket must be locked.
+static void bucket_tidy(edbl_bucket *bucket, edbl_lockhead *head) {
+	if(head->holderv || head->waiters) {
+		return;
+	}
+	edbl_lockhead **l = &bucket->headv;
+	while(*l != head) l = &(*l)->next;
+	*l = head->next;
+	head->next = bucket->freev;
+	bucket->freev = head;
+}
+
+// wakes everything waiting in the bucket.
+//
+// bucket must be locked.
+static void bucket_wake(edbl_bucket *bucket) {
+	bucket->futex++;
+	if(bucket->waiters) {
+		futex_wake(&bucket->futex, INT32_MAX);
+	}
+}
+
+static uint64_t lock_now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// the bucket of latencyv that ns goes in (see
+// odbtelem_cachestats.faultlatencyv).
+static int lock_latencyb(uint64_t ns) {
+	uint64_t usec = ns / 1000;
+	int b = usec ? 64 - __builtin_clzll(usec) : 0;
+	if(b >= ODBTELEM_LATENCYC) b = ODBTELEM_LATENCYC - 1;
+	return b;
+}
+
+// counts a wait of waitns on the lock in the space-saving sketch of the most
+// waited on locks: if its in there its count goes up, if not it takes the
+// place of the one with the smallest count (and takes that count plus 1,
+// with that count being how far off it can be).
+static void profile_hot(edbl_host_t *host, const edbl_region *r,
+                        uint64_t waitns) {
+	pthread_mutex_lock(&host->profilemutex);
+	struct odbtelem_lockhot *min = &host->hotv[0];
+	for(int i = 0; i < EDBL_HOTC; i++) {
+		struct odbtelem_lockhot *hot = &host->hotv[i];
+		if(hot->waits && hot->type == r->type
+		   && hot->offset == (uint64_t)r->start) {
+			hot->waits++;
+			hot->waitns += waitns;
+			pthread_mutex_unlock(&host->profilemutex);
+			return;
+		}
+		if(hot->waits < min->waits) {
+			min = hot;
+		}
+	}
+	*min = (struct odbtelem_lockhot){
+			.type = r->type,
+			.offset = r->start,
+			.waits = min->waits + 1,
+			.error = min->waits,
+			.waitns = waitns,
+	};
+	pthread_mutex_unlock(&host->profilemutex);
+}
+
+// counts a lock that was placed in the profile. t0 is when edbl_set started
+// on it, waitstart when it started waiting (0 if it didn't) and waitersc
+// how many were waiting on it before that.
+static void profile_acquire(edbl_host_t *host, const edbl_region *r,
+                            uint64_t t0, uint64_t now, uint64_t waitstart,
+                            uint32_t waitersc) {
+	struct odbtelem_locktype *p = &host->profilev[r->type];
+	__atomic_fetch_add(&p->acquires, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&p->acquirens, now - t0, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&p->acquirelatencyv[lock_latencyb(now - t0)], 1,
+	                   __ATOMIC_RELAXED);
+	if(!waitstart) {
+		return;
+	}
+	__atomic_fetch_add(&p->waits, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&p->waiters, waitersc, __ATOMIC_RELAXED);
+	uint64_t max = __atomic_load_n(&p->maxwaiters, __ATOMIC_RELAXED);
+	while(waitersc > max
+	      && !__atomic_compare_exchange_n(&p->maxwaiters, &max, waitersc, 1,
+	                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+	profile_hot(host, r, now - waitstart);
+}
+
+// lets go of what the handle holds in the host.
+static void host_release(edbl_handle_t *h, edbl_held *held) {
+	edbl_bucket *bucket = held->bucket;
+	edbl_lockhead *head = held->head;
+	pthread_mutex_lock(&bucket->mutex);
+	head->modec[lock_mode(held->act)]--;
+	if(h->entry == held) {
+		h->entry = 0;
+	}
+	edbl_held **l = &head->holderv;
+	while(*l != held) l = &(*l)->hnext;
+	*l = held->hnext;
+	l = &h->heldv;
+	while(*l != held) l = &(*l)->next;
+	*l = held->next;
+	held->next = h->freev;
+	h->freev = held;
+	bucket_tidy(bucket, head);
+	bucket_wake(bucket);
+	pthread_mutex_unlock(&bucket->mutex);
+
+	if(held->granted && __atomic_load_n(&h->parent->profile,
+	                                    __ATOMIC_RELAXED)) {
+		struct odbtelem_locktype *p = &h->parent->profilev[held->type];
+		__atomic_fetch_add(&p->releases, 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&p->holdns, lock_now() - held->granted,
+		                   __ATOMIC_RELAXED);
+	}
+}
+
+// writes into blockv the handles that g has to wait on (see
+// host_conflicts), returns how many (no more than EDBL_DEADLOCKFAN).
+//
+// graphmutex must be locked, g must be waiting.
+static int wait_blockers(edbl_host_t *host, edbl_handle_t *g,
+                         edbl_handle_t **blockv) {
+	int blockc = 0;
+	const edbl_region *r = &g->waitregion;
+	edbl_bucket *bucket = g->waitbucket;
+	pthread_mutex_lock(&bucket->mutex);
+	if(!__atomic_load_n(&g->waiting, __ATOMIC_RELAXED)) {
+		// (got it while we weren't looking)
+		goto full;
+	}
+	for(edbl_lockhead *o = bucket->headv; o; o = o->next) {
+		if(!region_overlaps(o, r)) continue;
+		for(edbl_held *n = o->holderv; n; n = n->hnext) {
+			if(n->handle == g) continue;
+			if(lock_compat[lock_mode(g->waitact)][lock_mode(n->act)]) continue;
+			if(blockc == EDBL_DEADLOCKFAN) goto full;
+			blockv[blockc++] = n->handle;
+		}
+	}
+	// everything else also waits behind the exclusive lockers waiting on the
+	// same lock.
+	if(g->waitact != EDBL_AXL) {
+		for(edbl_handle_t *k = host->handlev; k; k = k->hnext) {
+			if(k == g || !__atomic_load_n(&k->waiting, __ATOMIC_RELAXED)
+			   || k->waitact != EDBL_AXL
+			   || k->waitbucket != bucket
+			   || k->waitregion.start != r->start
+			   || k->waitregion.len != r->len
+			   || k->waitregion.keyclass != r->keyclass) {
+				continue;
+			}
+			if(blockc == EDBL_DEADLOCKFAN) goto full;
+			blockv[blockc++] = k;
+		}
+	}
+	full:
+	pthread_mutex_unlock(&bucket->mutex);
+	return blockc;
+}
+
+// helper to deadlock_check: follows the graph from g looking for a way back
+// to h. pathv holds the handles on the way to g. Returns the youngest waiter
+// in the cycle (the one that started waiting last) if there is one.
+//
+// graphmutex must be locked.
+static edbl_handle_t *wait_cycle(edbl_host_t *host, edbl_handle_t *h,
+                                 edbl_handle_t *g,
+                                 edbl_handle_t **pathv, int pathc) {
+	if(!__atomic_load_n(&g->waiting, __ATOMIC_RELAXED) || g->deadlocked
+	   || pathc == EDBL_DEADLOCKDEPTH) {
+		return 0;
+	}
+	pathv[pathc++] = g;
+	edbl_handle_t *blockv[EDBL_DEADLOCKFAN];
+	int blockc = wait_blockers(host, g, blockv);
+	for(int i = 0; i < blockc; i++) {
+		edbl_handle_t *b = blockv[i];
+		if(b == h) {
+			edbl_handle_t *youngest = h;
+			for(int j = 0; j < pathc; j++) {
+				if(pathv[j]->waitstart > youngest->waitstart) {
+					youngest = pathv[j];
+				}
+			}
+			return youngest;
+		}
+		if(b->visit == host->visitgen) continue;
+		b->visit = host->visitgen;
+		edbl_handle_t *victim = wait_cycle(host, h, b, pathv, pathc);
+		if(victim) return victim;
+	}
+	return 0;
+}
+
+// notes that h is about to wait for act on r and looks for a deadlock that
+// doing so would cause. If there is one, the youngest waiter in it gives up:
+// if thats h then ODB_EDEADLK is returned, otherwise the other one is woken
+// up to find its deadlocked flag set.
+//
+// Any new deadlock has to go through the handle that just started waiting,
+// so thats the only place it needs to look. It's a snapshot though: a
+// handle that has just been woken up but hasn't noted it yet can still be
+// taken as waiting, so now and then a wait may be given up that would have
+// gone through. Thats fine, the error says to try again.
+//
+// bucket must NOT be locked (graphmutex is locked first).
+static odb_err deadlock_check(edbl_handle_t *h, edbl_bucket *bucket,
+                              const edbl_region *r, edbl_act act,
+                              uint64_t waitstart) {
+	edbl_host_t *host = h->parent;
+	pthread_mutex_lock(&host->graphmutex);
+	if(h->deadlocked) {
+		pthread_mutex_unlock(&host->graphmutex);
+		return ODB_EDEADLK;
+	}
+	__atomic_store_n(&h->waiting, 1, __ATOMIC_RELAXED);
+	h->waitregion = *r;
+	h->waitact = act;
+	h->waitbucket = bucket;
+	h->waitstart = waitstart;
+
+	edbl_handle_t *pathv[EDBL_DEADLOCKDEPTH];
+	host->visitgen++;
+	h->visit = host->visitgen;
+	edbl_handle_t *victim = wait_cycle(host, h, h, pathv, 0);
+	if(victim == h) {
+		pthread_mutex_unlock(&host->graphmutex);
+		return ODB_EDEADLK;
+	}
+	if(victim) {
+		victim->deadlocked = 1;
+		edbl_bucket *vb = victim->waitbucket;
+		pthread_mutex_lock(&vb->mutex);
+		bucket_wake(vb);
+		pthread_mutex_unlock(&vb->mutex);
+	}
+	pthread_mutex_unlock(&host->graphmutex);
+	return 0;
+}
+
+// h is done waiting (err says how it went). Takes it out of the graph and
+// counts the wait.
+//
+// bucket must NOT be locked.
+static void wait_done(edbl_handle_t *h, uint64_t waitstart, odb_err err) {
+	edbl_host_t *host = h->parent;
+	pthread_mutex_lock(&host->graphmutex);
+	__atomic_store_n(&h->waiting, 0, __ATOMIC_RELAXED);
+	h->deadlocked = 0;
+	pthread_mutex_unlock(&host->graphmutex);
+
+	struct odbtelem_lockstats *stats = &host->stats;
+	uint64_t ns = lock_now() - waitstart;
+	__atomic_fetch_add(&stats->waits, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&stats->waitns, ns, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&stats->waitlatencyv[lock_latencyb(ns)], 1,
+	                   __ATOMIC_RELAXED);
+	if(err == ODB_EDEADLK) {
+		__atomic_fetch_add(&stats->deadlocks, 1, __ATOMIC_RELAXED);
+	} else if(err == ODB_ETIMEDOUT) {
+		__atomic_fetch_add(&stats->timeouts, 1, __ATOMIC_RELAXED);
+	}
+}
+
+// gets act (anything but EDBL_ARELEASE) on the region in the host, waiting
+// on other handles if need be.
+//
+// Returns ODB_EDEADLK or ODB_ETIMEDOUT if the wait was given up on.
+static odb_err host_acquire(edbl_handle_t *h, edbl_act act,
+                            const edbl_region *r) {
+	edbl_host_t *host = h->parent;
+	int profile = __atomic_load_n(&host->profile, __ATOMIC_RELAXED);
+	uint64_t t0 = profile ? lock_now() : 0;
+	uint32_t waitersc = 0;
+
+	edbl_held *node = h->freev;
+	if(node) {
+		h->freev = node->next;
+	} else {
+		node = malloc(sizeof(edbl_held));
+		if(node == 0) {
+			return ODB_ENOMEM;
+		}
+	}
+
+	edbl_bucket *bucket = host_bucket(host, r);
+	edbl_lockhead *head;
+	pthread_mutex_lock(&bucket->mutex);
+	odb_err err = bucket_head(bucket, r, &head);
+	if(err) {
+		pthread_mutex_unlock(&bucket->mutex);
+		node->next = h->freev;
+		h->freev = node;
+		return err;
+	}
+
+	edbl_held *held = handle_held(h, head);
+	if(held && held->act == act) {
+		pthread_mutex_unlock(&bucket->mutex);
+		node->next = h->freev;
+		h->freev = node;
+		return 0;
+	}
+
+	uint64_t waitstart = 0;
+	while(host_conflicts(h, bucket, head, r, act)) {
+		if(!waitstart) {
+			waitstart = lock_now();
+			waitersc = head->waiters;
+		}
+
+		// sleep no longer than whats left of the timeout.
+		struct timespec ts, *tsp = 0;
+		uint64_t timeout = __atomic_load_n(&host->timeoutv[r->type],
+		                                   __ATOMIC_RELAXED);
+		if(timeout) {
+			uint64_t waited = lock_now() - waitstart;
+			timeout *= 1000000;
+			if(waited >= timeout) {
+				err = ODB_ETIMEDOUT;
+				break;
+			}
+			ts.tv_sec = (time_t)((timeout - waited) / 1000000000);
+			ts.tv_nsec = (long)((timeout - waited) % 1000000000);
+			tsp = &ts;
+		}
+
+		uint32_t seq = bucket->futex;
+		bucket->waiters++;
+		head->waiters++;
+		if(act == EDBL_AXL) head->xwaiters++;
+		pthread_mutex_unlock(&bucket->mutex);
+		err = deadlock_check(h, bucket, r, act, waitstart);
+		if(!err) {
+			futex_wait_timeout(&bucket->futex, seq, tsp);
+		}
+		pthread_mutex_lock(&bucket->mutex);
+		bucket->waiters--;
+		head->waiters--;
+		if(act == EDBL_AXL) head->xwaiters--;
+		if(!err && h->deadlocked) {
+			err = ODB_EDEADLK;
+		}
+		if(err) {
+			break;
+		}
+	}
+	if(waitstart) {
+		__atomic_store_n(&h->waiting, 0, __ATOMIC_RELAXED);
+	}
+
+	if(err) {
+		bucket_tidy(bucket, head);
+		// (others may have been waiting behind us as an xwaiter)
+		bucket_wake(bucket);
+		pthread_mutex_unlock(&bucket->mutex);
+		node->next = h->freev;
+		h->freev = node;
+		wait_done(h, waitstart, err);
+		return err;
+	}
+
+	if(held) {
+		// converting what we already have.
+		head->modec[lock_mode(held->act)]--;
+		head->modec[lock_mode(act)]++;
+		held->act = act;
+		// (it may have been a step down)
+		bucket_wake(bucket);
+		node->next = h->freev;
+		h->freev = node;
+	} else {
+		head->modec[lock_mode(act)]++;
+		*node = (edbl_held){
+				.handle = h,
+				.head = head,
+				.bucket = bucket,
+				.act = act,
+				.type = r->type,
+				.key = r->key,
+				.granted = profile ? lock_now() : 0,
+				.hnext = head->holderv,
+				.next = h->heldv,
+		};
+		head->holderv = node;
+		h->heldv = node;
+		if(r->type == EDBL_LENTRY) {
+			h->entry = node;
+			h->childc = 0;
+		}
+	}
+	pthread_mutex_unlock(&bucket->mutex);
+	if(waitstart) {
+		wait_done(h, waitstart, 0);
+	}
+	if(profile) {
+		profile_acquire(host, r, t0, lock_now(), waitstart, waitersc);
+	}
+	return 0;
+}
+
+// returns non-0 if the handle's entry lock is the one over lock: lock is
+// a LROW/LOBJBODY that names that entry as its entity.
+static int lock_under(edbl_handle_t *h, edbl_lock lock) {
+	return h->entry
+	       && (lock.type == EDBL_LROW || lock.type == EDBL_LOBJBODY)
+	       && lock.entity != 0
+	       && h->entry->key == lock.entity;
+}
+
+int edbl_ofd(edbl_handle_t *h) {
+	return h->parent->ofd;
+}
+
+// returns non-0 if the lock is already covered by the entry lock the handle
+// has (see EDBL_AIS) and doesn't need placing.
+//
+// With EDBL_CONFIG_OFD nothing is covered: other processes only know about
+// the locks they can see.
+static int lock_covered(edbl_handle_t *h, edbl_lock lock, edbl_act act) {
+	if(!lock_under(h, lock) || h->parent->ofd) {
+		return 0;
+	}
+	return h->entry->act == EDBL_AXL
+	       || (h->entry->act == EDBL_ASH && act == EDBL_ASH);
+}
+
+// counts a LROW/LOBJBODY lock placed under the handle's entry, and once
+// there's been EDBL_CONFIG_ESCALATE of them, turns the entry lock from IS
+// to S (or IX to X) so that the ones after that are covered by it. This
+// never waits: if another handle is in the way then its tried again after
+// another EDBL_CONFIG_ESCALATE.
+//
+// The locks placed before are kept as they are, they're still released like
+// normal.
+static void lock_escalate(edbl_handle_t *h, edbl_lock lock) {
+	edbl_host_t *host = h->parent;
+	edbl_held *entry = h->entry;
+	if(!lock_under(h, lock)) {
+		return;
+	}
+	unsigned int escalate = __atomic_load_n(&host->escalate, __ATOMIC_RELAXED);
+	if(!escalate || ++h->childc % escalate) {
+		return;
+	}
+	// (nothing is covered with OFD anyway, see lock_covered)
+	if(host->ofd) {
+		return;
+	}
+	edbl_act act;
+	switch (entry->act) {
+		case EDBL_AIS: act = EDBL_ASH; break;
+		case EDBL_AIX: act = EDBL_AXL; break;
+		default: return;
+	}
+
+	edbl_bucket *bucket = entry->bucket;
+	edbl_lockhead *head = entry->head;
+	edbl_region r = {
+			.start = head->start,
+			.len = head->len,
+			.keyclass = head->keyclass,
+			.type = EDBL_LENTRY,
+	};
+	pthread_mutex_lock(&bucket->mutex);
+	if(!host_conflicts(h, bucket, head, &r, act)) {
+		head->modec[lock_mode(entry->act)]--;
+		head->modec[lock_mode(act)]++;
+		entry->act = act;
+		__atomic_fetch_add(&host->stats.escalations, 1, __ATOMIC_RELAXED);
+	}
+	pthread_mutex_unlock(&bucket->mutex);
+}
+
+// returns ODB_EAGAIN if another handle of the host is in the way of act.
+static odb_err host_test(edbl_handle_t *h, edbl_act act, const edbl_region *r) {
+	edbl_bucket *bucket = host_bucket(h->parent, r);
+	pthread_mutex_lock(&bucket->mutex);
+	edbl_lockhead *head;
+	for(head = bucket->headv; head; head = head->next) {
+		if(head->start == r->start && head->len == r->len
+		   && head->keyclass == r->keyclass) {
+			break;
+		}
+	}
+	int c = act != EDBL_ARELEASE && host_conflicts(h, bucket, head, r, act);
+	pthread_mutex_unlock(&bucket->mutex);
+	return c ? ODB_EAGAIN : 0;
+}
+
+// the lock on other processes (EDBL_CONFIG_OFD) with the handle's own
+// descriptor, the way the fcntl backend in locking.org describes it.
+//
+// if test is non-null then will run fcntl(fd, F_OFD_GETLK, test), otherwise
+// F_OFD_SETLKW will be used and nothing outputted.
+static odb_err ofd_set(edbl_handle_t *h, edbl_act action, const edbl_region *r,
+                       struct flock64 *test) {
+	struct flock64 flock_noptr;
+	struct flock64 *flock = test ? test : &flock_noptr;
+	int cmd = test ? F_OFD_GETLK : F_OFD_SETLKW;
+	int fd = handle_fd(h);
+	if(fd == -1) {
+		return ODB_ECRIT;
+	}
+
+	flock->l_whence = SEEK_SET;
+	flock->l_pid = 0;
+	// fcntl only has the 2 modes. Everything but EDBL_AXL goes in as shared:
+	// anything the lock table lets 2 handles have at once can't be exclusive
+	// here, or the handles would block each other in the kernel. So other
+	// processes don't see an EDBL_ASH keeping out EDBL_AIX, they still see
+	// the row/page locks under it though (see lock_covered).
+	switch (action) {
+		case EDBL_AIS:
+		case EDBL_AIX:
+		case EDBL_ASH:
+			flock->l_type = F_RDLCK;
+			break;
+		case EDBL_AXL:
+			flock->l_type = F_WRLCK;
+			break;
+		default:
+			flock->l_type = F_UNLCK;
+			break;
+	}
+	flock->l_start = r->start;
+	flock->l_len = r->len;
+	if(r->clutch && flock->l_type != F_UNLCK) {
+		if(test) {
+			// test both bytes at once.
+			flock->l_start--;
+			flock->l_len = 2;
+			if(fcntl64(fd, cmd, flock) == -1) goto crit;
+			return 0;
+		}
+		// Engage the first-byte lock
+		flock->l_start--;
+		if(fcntl64(fd, cmd, flock) == -1) goto crit;
+		// engage the second-byte lock
+		flock->l_start++;
+		if(fcntl64(fd, cmd, flock) == -1) goto crit;
+		// release the first-byte lock.
+		flock->l_start--;
+		flock->l_type = F_UNLCK;
+		if(fcntl64(fd, cmd, flock) == -1) goto crit;
+		return 0;
+	}
+	// (releasing a clutch lock simply releases the second-byte lock)
+	if(fcntl64(fd, cmd, flock) == -1) goto crit;
+	return 0;
+
+	crit:
+	log_critf("critical error in edbl_set fcntl(2): %d", errno);
 	return ODB_ECRIT;
 }
 
 odb_err edbl_test(edbl_handle_t *h, edbl_act action, edbl_lock lock) {
-	struct flock64 test;
-	odb_err err = _edbl_set(h, action, lock, &test);
+	// (intention locks are only for entries)
+	if((action == EDBL_AIS || action == EDBL_AIX)
+	   && lock.type != EDBL_LENTRY) {
+		return ODB_EINVAL;
+	}
+	edbl_region r;
+	odb_err err = lock_region(h, lock, &r);
 	if(err) {
 		return err;
 	}
+	if(lock_covered(h, lock, action)) {
+		return 0;
+	}
+	if((err = host_test(h, action, &r))) {
+		return err;
+	}
+	if(!h->parent->ofd || action == EDBL_ARELEASE) {
+		return 0;
+	}
+	struct flock64 test;
+	if((err = ofd_set(h, action, &r, &test))) {
+		return err;
+	}
 	if(test.l_type == F_UNLCK) {
 		return 0;
 	} else {
@@ -283,5 +1226,61 @@ odb_err edbl_test(edbl_handle_t *h, edbl_act action, edbl_lock lock) {
 
 }
 odb_err edbl_set(edbl_handle_t *h, edbl_act action, edbl_lock lock) {
-	return _edbl_set(h, action, lock, 0);
-}
\ No newline at end of file
+	switch (action) {
+		case EDBL_AIS:
+		case EDBL_AIX:
+		case EDBL_ASH:
+		case EDBL_AXL:
+		case EDBL_ARELEASE:
+			break;
+		default:
+			log_critf("edbl_set INVAL");
+			return ODB_ECRIT;
+	}
+	if((action == EDBL_AIS || action == EDBL_AIX)
+	   && lock.type != EDBL_LENTRY) {
+		return ODB_EINVAL;
+	}
+	edbl_region r;
+	odb_err err = lock_region(h, lock, &r);
+	if(err) {
+		return err;
+	}
+
+	if(action == EDBL_ARELEASE) {
+		if(h->fd_d != -1) {
+			ofd_set(h, action, &r, 0);
+		}
+		edbl_bucket *bucket = host_bucket(h->parent, &r);
+		for(edbl_held *held = h->heldv; held; held = held->next) {
+			edbl_lockhead *head = held->head;
+			if(held->bucket == bucket
+			   && head->start == r.start && head->len == r.len
+			   && head->keyclass == r.keyclass) {
+				host_release(h, held);
+				break;
+			}
+		}
+		return 0;
+	}
+
+	if(lock_covered(h, lock, action)) {
+		return 0;
+	}
+	if((err = host_acquire(h, action, &r))) {
+		if(err == ODB_EDEADLK || err == ODB_ETIMEDOUT) {
+			return err;
+		}
+		if(err == ODB_ENOMEM) {
+			log_critf("no memory for lock");
+			err = ODB_ECRIT;
+		}
+		return err;
+	}
+	if(h->parent->ofd && (err = ofd_set(h, action, &r, 0))) {
+		edbl_set(h, EDBL_ARELEASE, lock);
+		return err;
+	}
+	lock_escalate(h, lock);
+	return 0;
+}
@@ -3,6 +3,7 @@
 #include "options.h"
 #include "edbd.h"
 #include <oidadb/oidadb.h>
+#include <oidadb/telemetry.h>
 
 #include <unistd.h>
 #include <fcntl.h>
@@ -41,7 +42,32 @@ typedef enum edbl_act {
 	EDBL_AXL = F_WRLCK,
 
 	// Remove whatever lock was placed.
-	EDBL_ARELEASE = F_UNLCK
+	EDBL_ARELEASE = F_UNLCK,
+
+	// Intention locks, only for EDBL_LENTRY. These say that the handle is
+	// going to place EDBL_ASH (intention-shared) or EDBL_ASH/EDBL_AXL
+	// (intention-exclusive) locks on the entity's pages and rows
+	// (EDBL_LOBJBODY, EDBL_LROW) rather than locking the whole entity. They
+	// only block each other the way the matrix says:
+	//
+	//           IS  IX  SH  XL
+	//      IS   y   y   y   n
+	//      IX   y   y   n   n
+	//      SH   y   n   y   n
+	//      XL   n   n   n   n
+	//
+	// So an EDBL_ASH on an entry lets all the other readers in but keeps
+	// out anyone with the intention to write, and an EDBL_AXL keeps
+	// everyone out.
+	//
+	// A handle that holds EDBL_ASH on an entry doesn't need to place shared
+	// page/row locks under it, and with EDBL_AXL it doesn't need to place any
+	// at all: edbl_set returns 0 without touching them. That's only for the
+	// page/row locks that name the entry as their edbl_lock.entity, and
+	// only the entry the handle locked last. See EDBL_CONFIG_ESCALATE for
+	// when intention locks are turned into these.
+	EDBL_AIS = 3,
+	EDBL_AIX = 4,
 } edbl_act;
 
 /*typedef struct {
@@ -50,6 +76,70 @@ typedef enum edbl_act {
 	unsigned int l_len;
 } edbl_lockref;*/
 
+typedef enum edbl_config_opts {
+	EDBL_CONFIG_OFD,
+	EDBL_CONFIG_TIMEOUT,
+	EDBL_CONFIG_ESCALATE,
+	EDBL_CONFIG_PROFILE,
+} edbl_config_opts;
+
+#define EDBL_ESCALATE_DEFAULT 64
+
+// Locks between the handles of a host are kept in a lock table in the host
+// (see "In-host lock table" in locking.org) and never touch the kernel.
+//
+// EDBL_CONFIG_OFD (int): non-0 means locks are also placed as OFD locks
+// (fcntl(2)) on the file, the way the fcntl backend in locking.org describes
+// them, so other processes that have the file open can see them. Each handle
+// opens a descriptor of its own for this the first time it needs it. Off by
+// default: odb_host write-locks the entire file to itself (see odb_host(3))
+// so there's nothing outside the host to see them. Turn it on if you're
+// using edbl on a file without that lock.
+//
+// EDBL_CONFIG_TIMEOUT (edbl_type, unsigned int): the most milliseconds
+// edbl_set will wait for a lock of that type before it gives up with
+// ODB_ETIMEDOUT. 0 (the default) waits for as long as it takes, with
+// deadlocks still being caught.
+//
+// EDBL_CONFIG_ESCALATE (unsigned int): after a handle has placed this many
+// EDBL_LOBJBODY/EDBL_LROW locks while having an intention lock on their
+// entry (named by edbl_lock.entity), the entry lock is turned from EDBL_AIS to EDBL_ASH (or EDBL_AIX to
+// EDBL_AXL) so the ones after it are covered by it (see EDBL_AIS). This
+// never waits, if other handles are in the way it just tries again after
+// another so many. 0 never escalates. EDBL_ESCALATE_DEFAULT by default.
+// Does nothing with EDBL_CONFIG_OFD.
+//
+// EDBL_CONFIG_PROFILE (int): non-0 starts keeping the lock contention
+// profile (see edbl_host_profile) from scratch, 0 stops it. Off by default,
+// and while its off all it costs is checking that its off.
+//
+// ERRORS:
+//  - ODB_EINVAL - host is null or opts isn't an option, or (with
+//                 EDBL_CONFIG_TIMEOUT) the type isn't one.
+//
+// THREADING: EDBL_CONFIG_OFD should be done before any locks are placed,
+// the others can be done whenever.
+odb_err edbl_host_config(edbl_host_t *host, edbl_config_opts opts, ...);
+
+// copies the host's lock wait counters into o_stats. See
+// odbtelem_lockstats.
+//
+// ERRORS:
+//  - ODB_EINVAL - host or o_stats is null
+//
+// THREADING: MT-safe.
+odb_err edbl_host_stats(edbl_host_t *host, struct odbtelem_lockstats *o_stats);
+
+// copies the host's lock contention profile into o_profile. See
+// odbtelem_lockprofile and EDBL_CONFIG_PROFILE.
+//
+// ERRORS:
+//  - ODB_EINVAL - host or o_profile is null
+//
+// THREADING: MT-safe.
+odb_err edbl_host_profile(edbl_host_t *host,
+                          struct odbtelem_lockprofile *o_profile);
+
 // See locking.org. I'll only be documenting the arguments here, not the
 // purpose of them.
 typedef enum edbl_type {
@@ -72,10 +162,10 @@ typedef enum edbl_type {
 	EDBL_LTRASHOFF,
 	EDBL_LOBJPRIGHT,
 
-	// object_pid, page_size
+	// object_pid, page_size (, entity)
 	EDBL_LOBJBODY,
 
-	// object_pid, page_ioffset
+	// object_pid, page_ioffset (, entity)
 	EDBL_LROW,
 
 	// l_start, l_len
@@ -95,10 +185,20 @@ typedef struct edbl_lock {
 		unsigned int l_len;
 		unsigned int page_size;
 	};
+
+	// EDBL_LOBJBODY/EDBL_LROW: the entity the page/row belongs to, 0 if
+	// not said. They're only ever covered by the handle's entry lock (see
+	// EDBL_AIS) when this is that entry's eid.
+	odb_eid entity;
 } edbl_lock;
 
 // see locking.org.
 //
+// A lock is held by the handle. Same as with OFD locks, a handle never
+// blocks on itself, placing a lock it already has is the same as placing it
+// once (or changes it to the new action) and a single
+// EDBL_ARELEASE lets go of it.
+//
 // edbl_test will not place any lock but only return ODB_EAGAIN if such a
 // lock described will result in blocking. Or will return 0 if such a lock
 // would have been successful placed. (May also return CRIT, see RETURNS)
@@ -109,9 +209,25 @@ typedef struct edbl_lock {
 //   using them (ODB_EINVAL). If you're getting errors, then read the
 //   documentation better. Otherwise, you can always assume no errors.
 //
+//   ODB_EINVAL is also returned for EDBL_AIS/EDBL_AIX on anything other
+//   than EDBL_LENTRY.
+//
+//   Except that edbl_set can give up on waiting:
+//    - ODB_EDEADLK - waiting would never end because whoever has the lock
+//                    is (eventually) waiting on us. Nothing was locked. Let
+//                    go of the other locks the job has and start it over.
+//    - ODB_ETIMEDOUT - waited longer than the EDBL_CONFIG_TIMEOUT of the
+//                      lock's type. Nothing was locked.
+//
 // THREADING:
 //    Thread safe per-handle.
 odb_err edbl_set(edbl_handle_t *, edbl_act action, edbl_lock lock);
 odb_err edbl_test(edbl_handle_t *, edbl_act action, edbl_lock lock);
 
+// returns non-0 if the handle's host has EDBL_CONFIG_OFD on, meaning there
+// may be other processes locking the same file.
+//
+// THREADING: MT-safe.
+int edbl_ofd(edbl_handle_t *);
+
 #endif
\ No newline at end of file
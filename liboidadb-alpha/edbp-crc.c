@@ -0,0 +1,168 @@
+#include "edbp_u.h"
+
+#include <pthread.h>
+#include <string.h>
+
+// crc32c (castagnoli) used for the page checksums (see page_seal). Uses the
+// sse4.2 crc32 instruction if the cpu has it, otherwise slicing-by-8 with
+// tables.
+//
+// Everything in here works with the raw crc register: no inverting going in
+// or coming out, the caller does that.
+
+#define CRC32C_POLY 0x82F63B78 // (reflected)
+
+// the hardware version does 3 streams of this many bytes at once (the crc32
+// instruction has a latency of 3 but can start a new one every cycle) and
+// then stitches them back together with crc_shift. 3 of them cover all but
+// the last few bytes of a 4096 byte page.
+#define CRC32C_STREAM 1360
+
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+// slicing-by-8 tables.
+static uint32_t crc_table[8][256];
+
+// crc_shifttab[k][b] is what the byte b in byte k of the register turns into
+// after CRC32C_STREAM zero bytes go through it.
+static uint32_t crc_shifttab[4][256];
+
+static uint32_t (*crc_impl)(uint32_t crc, const uint8_t *buf, size_t len);
+
+static uint32_t crc_sw(uint32_t crc, const uint8_t *buf, size_t len) {
+	// byte at a time until we're aligned
+	while(len && ((uintptr_t)buf & 7)) {
+		crc = crc_table[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+		len--;
+	}
+	while(len >= 8) {
+		uint64_t w;
+		memcpy(&w, buf, 8);
+		w ^= crc;
+		crc = crc_table[7][w & 0xff]
+		      ^ crc_table[6][(w >> 8) & 0xff]
+		      ^ crc_table[5][(w >> 16) & 0xff]
+		      ^ crc_table[4][(w >> 24) & 0xff]
+		      ^ crc_table[3][(w >> 32) & 0xff]
+		      ^ crc_table[2][(w >> 40) & 0xff]
+		      ^ crc_table[1][(w >> 48) & 0xff]
+		      ^ crc_table[0][w >> 56];
+		buf += 8;
+		len -= 8;
+	}
+	while(len--) {
+		crc = crc_table[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+	}
+	return crc;
+}
+
+// crc through CRC32C_STREAM zero bytes.
+static inline uint32_t crc_shift(uint32_t crc) {
+	return crc_shifttab[0][crc & 0xff]
+	       ^ crc_shifttab[1][(crc >> 8) & 0xff]
+	       ^ crc_shifttab[2][(crc >> 16) & 0xff]
+	       ^ crc_shifttab[3][crc >> 24];
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t crc_hw(uint32_t crc, const uint8_t *buf, size_t len) {
+	uint64_t c0 = crc;
+	while(len && ((uintptr_t)buf & 7)) {
+		c0 = __builtin_ia32_crc32qi((uint32_t)c0, *buf++);
+		len--;
+	}
+	while(len >= 3 * CRC32C_STREAM) {
+		uint64_t c1 = 0, c2 = 0, w;
+		const uint8_t *b0 = buf;
+		const uint8_t *b1 = buf + CRC32C_STREAM;
+		const uint8_t *b2 = buf + 2 * CRC32C_STREAM;
+		for(int i = 0; i < CRC32C_STREAM; i += 8) {
+			memcpy(&w, b0 + i, 8);
+			c0 = __builtin_ia32_crc32di(c0, w);
+			memcpy(&w, b1 + i, 8);
+			c1 = __builtin_ia32_crc32di(c1, w);
+			memcpy(&w, b2 + i, 8);
+			c2 = __builtin_ia32_crc32di(c2, w);
+		}
+		// crc(a||b) = shift(crc(a), len(b)) ^ crc(b) when b starts at 0.
+		c0 = crc_shift(crc_shift((uint32_t)c0) ^ (uint32_t)c1)
+		     ^ (uint32_t)c2;
+		buf += 3 * CRC32C_STREAM;
+		len -= 3 * CRC32C_STREAM;
+	}
+	while(len >= 8) {
+		uint64_t w;
+		memcpy(&w, buf, 8);
+		c0 = __builtin_ia32_crc32di(c0, w);
+		buf += 8;
+		len -= 8;
+	}
+	while(len--) {
+		c0 = __builtin_ia32_crc32qi((uint32_t)c0, *buf++);
+	}
+	return (uint32_t)c0;
+}
+#endif
+
+static void crc_init() {
+	for(uint32_t b = 0; b < 256; b++) {
+		uint32_t c = b;
+		for(int i = 0; i < 8; i++) {
+			c = (c >> 1) ^ (CRC32C_POLY & -(c & 1));
+		}
+		crc_table[0][b] = c;
+	}
+	for(uint32_t b = 0; b < 256; b++) {
+		for(int k = 1; k < 8; k++) {
+			uint32_t c = crc_table[k - 1][b];
+			crc_table[k][b] = crc_table[0][c & 0xff] ^ (c >> 8);
+		}
+	}
+
+	// the shift is linear so only the 32 single bits need to be run through
+	// the zeros, everything else is xor'd together from them.
+	static const uint8_t zeros[CRC32C_STREAM];
+	uint32_t bits[32];
+	for(int i = 0; i < 32; i++) {
+		bits[i] = crc_sw(1u << i, zeros, CRC32C_STREAM);
+	}
+	for(int k = 0; k < 4; k++) {
+		for(uint32_t b = 0; b < 256; b++) {
+			uint32_t c = 0;
+			for(int i = 0; i < 8; i++) {
+				if(b & (1u << i)) c ^= bits[k * 8 + i];
+			}
+			crc_shifttab[k][b] = c;
+		}
+	}
+
+	crc_impl = crc_sw;
+#if defined(__x86_64__)
+	if(__builtin_cpu_supports("sse4.2")) {
+		crc_impl = crc_hw;
+	}
+#endif
+}
+
+uint32_t edbp_crc32c(uint32_t crc, const void *buf, size_t len) {
+	pthread_once(&crc_once, crc_init);
+	return ~crc_impl(~crc, buf, len);
+}
+
+uint32_t edbp_crc32c_sw(uint32_t crc, const void *buf, size_t len) {
+	pthread_once(&crc_once, crc_init);
+	return ~crc_sw(~crc, buf, len);
+}
+
+int edbp_crc32c_hw(uint32_t crc, const void *buf, size_t len,
+                   uint32_t *o_crc) {
+	pthread_once(&crc_once, crc_init);
+#if defined(__x86_64__)
+	if(crc_impl == crc_hw) {
+		*o_crc = ~crc_hw(~crc, buf, len);
+		return 1;
+	}
+#endif
+	return 0;
+}
@@ -0,0 +1,199 @@
+#include "edbp_u.h"
+
+#include <string.h>
+
+// the codec for the compressed tier (see EDBP_CONFIG_ZPOOL). LZ77 in the
+// same spirit as lz4: no entropy coding, just literals and back-references,
+// so it goes about as fast as memcpy. Pages are mostly zero padding so that's
+// all we need.
+//
+// The compressed data is a list of sequences, each one is:
+//
+//   - a token byte: the high 4 bits are the count of literals, the low 4
+//     bits are the match length minus EDBPLZ_MINMATCH. 15 in either means
+//     more bytes follow (see lz_putlen).
+//   - the literal count's extra bytes, then the literals.
+//   - a 2 byte (little endian) offset back to where the match is copied from.
+//   - the match length's extra bytes.
+//
+// The last sequence stops after its literals.
+
+#define EDBPLZ_MINMATCH 4
+#define EDBPLZ_HASHLOG 12
+#define EDBPLZ_MAXOFF 0xFFFF
+
+static inline uint32_t lz_read32(const uint8_t *p) {
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint64_t lz_read64(const uint8_t *p) {
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline unsigned int lz_hash(uint32_t v) {
+	return (v * 2654435761u) >> (32 - EDBPLZ_HASHLOG);
+}
+
+// writes the bytes past the 15 in the token for len (which already had 15
+// taken off of it): 255 until whats left is less than 255.
+//
+// returns null if there's not enough room before oend.
+static uint8_t *lz_putlen(uint8_t *op, const uint8_t *oend, size_t len) {
+	while(len >= 255) {
+		if(op == oend) return 0;
+		*op++ = 255;
+		len -= 255;
+	}
+	if(op == oend) return 0;
+	*op++ = (uint8_t)len;
+	return op;
+}
+
+// reads what lz_putlen wrote back into *len.
+//
+// returns null if it runs past iend.
+static const uint8_t *lz_getlen(const uint8_t *ip, const uint8_t *iend,
+                                size_t *len) {
+	uint8_t b;
+	do {
+		if(ip == iend) return 0;
+		b = *ip++;
+		*len += b;
+	} while(b == 255);
+	return ip;
+}
+
+// helper to edbp_lz_compress: writes a sequence. If matchc is 0 then it's
+// the last one (just literals).
+//
+// returns null if there's not enough room before oend.
+static uint8_t *lz_putseq(uint8_t *op, const uint8_t *oend,
+                          const uint8_t *lit, size_t litc,
+                          size_t off, size_t matchc) {
+	if(op == oend) return 0;
+	uint8_t *token = op++;
+	size_t mlen = matchc ? matchc - EDBPLZ_MINMATCH : 0;
+	*token = (uint8_t)((litc < 15 ? litc : 15) << 4
+	                   | (mlen < 15 ? mlen : 15));
+	if(litc >= 15 && !(op = lz_putlen(op, oend, litc - 15))) return 0;
+	if((size_t)(oend - op) < litc) return 0;
+	memcpy(op, lit, litc);
+	op += litc;
+	if(!matchc) {
+		return op;
+	}
+	if(oend - op < 2) return 0;
+	*op++ = (uint8_t)off;
+	*op++ = (uint8_t)(off >> 8);
+	if(mlen >= 15 && !(op = lz_putlen(op, oend, mlen - 15))) return 0;
+	return op;
+}
+
+size_t edbp_lz_compress(const void *src, size_t srcc, void *dst, size_t dstc) {
+	const uint8_t *base = src;
+	const uint8_t *ip = base;
+	const uint8_t *anchor = base; // start of the literals not written yet
+	const uint8_t *iend = base + srcc;
+	uint8_t *op = dst;
+	const uint8_t *oend = op + dstc;
+
+	// the last place each hash of 4 bytes was seen (as an offset from base).
+	// Nothing there is fine: any candidate is checked anyway.
+	uint32_t tablev[1 << EDBPLZ_HASHLOG];
+	memset(tablev, 0, sizeof(tablev));
+
+	while(iend - ip >= EDBPLZ_MINMATCH) {
+		uint32_t seq = lz_read32(ip);
+		unsigned int h = lz_hash(seq);
+		const uint8_t *ref = base + tablev[h];
+		tablev[h] = (uint32_t)(ip - base);
+		if(ref >= ip || ip - ref > EDBPLZ_MAXOFF || lz_read32(ref) != seq) {
+			ip++;
+			continue;
+		}
+
+		// see how far the match goes, 8 bytes at a time while we can.
+		const uint8_t *mp = ip + EDBPLZ_MINMATCH;
+		const uint8_t *rp = ref + EDBPLZ_MINMATCH;
+		while(iend - mp >= 8) {
+			uint64_t diff = lz_read64(mp) ^ lz_read64(rp);
+			if(diff) {
+				mp += __builtin_ctzll(diff) / 8;
+				goto matched;
+			}
+			mp += 8;
+			rp += 8;
+		}
+		while(mp < iend && *mp == *rp) {
+			mp++;
+			rp++;
+		}
+		matched:
+		op = lz_putseq(op, oend, anchor, ip - anchor, ip - ref, mp - ip);
+		if(!op) return 0;
+		ip = mp;
+		anchor = ip;
+	}
+
+	op = lz_putseq(op, oend, anchor, iend - anchor, 0, 0);
+	if(!op) return 0;
+	return op - (uint8_t *)dst;
+}
+
+int edbp_lz_decompress(const void *src, size_t srcc, void *dst, size_t dstc) {
+	const uint8_t *ip = src;
+	const uint8_t *iend = ip + srcc;
+	uint8_t *op = dst;
+	uint8_t *oend = op + dstc;
+
+	for(;;) {
+		if(ip == iend) return -1;
+		uint8_t token = *ip++;
+
+		size_t litc = token >> 4;
+		if(litc == 15 && !(ip = lz_getlen(ip, iend, &litc))) return -1;
+		if((size_t)(iend - ip) < litc || (size_t)(oend - op) < litc) return -1;
+		memcpy(op, ip, litc);
+		ip += litc;
+		op += litc;
+		if(ip == iend) {
+			// the last sequence.
+			break;
+		}
+
+		if(iend - ip < 2) return -1;
+		size_t off = ip[0] | (size_t)ip[1] << 8;
+		ip += 2;
+		size_t matchc = token & 15;
+		if(matchc == 15 && !(ip = lz_getlen(ip, iend, &matchc))) return -1;
+		matchc += EDBPLZ_MINMATCH;
+		if(off == 0 || off > (size_t)(op - (uint8_t *)dst)
+		   || (size_t)(oend - op) < matchc) {
+			return -1;
+		}
+
+		if(off == 1) {
+			// (a run of the same byte, like zero padding)
+			memset(op, op[-1], matchc);
+			op += matchc;
+			continue;
+		}
+		// the match can overlap with what its writing. So the first copy is
+		// no more than off bytes, but then every copy after that can be
+		// twice as long as the last (ref stays put and what's between it and
+		// op is always a whole number of repeats).
+		const uint8_t *ref = op - off;
+		while(matchc) {
+			size_t c = (size_t)(op - ref);
+			if(c > matchc) c = matchc;
+			memcpy(op, ref, c);
+			op += c;
+			matchc -= c;
+		}
+	}
+	return op == oend ? 0 : -1;
+}
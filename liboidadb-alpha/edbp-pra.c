@@ -0,0 +1,1280 @@
+// page replacement algorithms for edbp. See edbp_praops in edbp_u.h.
+//
+// Everything in here (other than edbp_pra_simulate) is called with the
+// shard's mutexpagelock locked.
+
+#include "edbp_u.h"
+
+#include <stdlib.h>
+#include <strings.h>
+#include <errno.h>
+
+// helper to all the algorithms: mallocs and 0s out size bytes into *o_ptr.
+// returns ODB_ENOMEM or ODB_ECRIT.
+static odb_err pra_alloc(void **o_ptr, size_t size) {
+	*o_ptr = malloc(size);
+	if(*o_ptr == 0) {
+		if(errno == ENOMEM)
+			return ODB_ENOMEM;
+		return log_critf("malloc");
+	}
+	bzero(*o_ptr, size);
+	return 0;
+}
+
+// helper to the grow ops: reallocs *ptr to size bytes, 0'ing out everything
+// past oldsize. Leaves *ptr alone on failure.
+//
+// returns ODB_ENOMEM or ODB_ECRIT.
+static odb_err pra_realloc(void **ptr, size_t oldsize, size_t size) {
+	void *n = realloc(*ptr, size);
+	if(n == 0) {
+		if(errno == ENOMEM)
+			return ODB_ENOMEM;
+		return log_critf("realloc");
+	}
+	if(size > oldsize) {
+		bzero(n + oldsize, size - oldsize);
+	}
+	*ptr = n;
+	return 0;
+}
+
+// helper for the bucket tables: the amount of buckets needed (a power of 2
+// and at least 4 times) to hold c ids.
+static uint64_t pra_bucketc(edbp_slotid c) {
+	uint64_t bucketc = 4;
+	while(bucketc < (uint64_t)c * 4) bucketc <<= 1;
+	return bucketc;
+}
+
+// helper to the cold ops: is the slot something the writeback thread can
+// clean.
+static int pra_cleanable(const edbp_slot *slot) {
+	return slot->id != 0 && slot->locks == 0
+	       && __atomic_load_n(&slot->dirty, __ATOMIC_RELAXED);
+}
+
+// doubly linked lists of indexes (slots or entries) for the algorithms that
+// need them. head is the most recently used end. -1 is nil.
+typedef struct {
+	edbp_slotid prev, next;
+} pra_link;
+
+typedef struct {
+	edbp_slotid head, tail;
+	edbp_slotid c;
+} pra_list;
+
+static void list_init(pra_list *l) {
+	l->head = l->tail = -1;
+	l->c = 0;
+}
+
+static void list_pushhead(pra_list *l, pra_link *linkv, edbp_slotid i) {
+	linkv[i].prev = -1;
+	linkv[i].next = l->head;
+	if(l->head != -1) linkv[l->head].prev = i;
+	else l->tail = i;
+	l->head = i;
+	l->c++;
+}
+
+static void list_pushtail(pra_list *l, pra_link *linkv, edbp_slotid i) {
+	linkv[i].next = -1;
+	linkv[i].prev = l->tail;
+	if(l->tail != -1) linkv[l->tail].next = i;
+	else l->head = i;
+	l->tail = i;
+	l->c++;
+}
+
+static void list_remove(pra_list *l, pra_link *linkv, edbp_slotid i) {
+	if(linkv[i].prev != -1) linkv[linkv[i].prev].next = linkv[i].next;
+	else l->head = linkv[i].next;
+	if(linkv[i].next != -1) linkv[linkv[i].next].prev = linkv[i].prev;
+	else l->tail = linkv[i].prev;
+	l->c--;
+}
+
+// puts i (which isn't in a list) where old is in the list.
+static void list_replace(pra_list *l, pra_link *linkv, edbp_slotid old,
+                         edbp_slotid i) {
+	linkv[i] = linkv[old];
+	if(linkv[i].prev != -1) linkv[linkv[i].prev].next = i;
+	else l->head = i;
+	if(linkv[i].next != -1) linkv[linkv[i].next].prev = i;
+	else l->tail = i;
+}
+
+// helper to the grow ops: moves everything in the bucket table to one that
+// can hold c ids (if its not big enough already).
+//
+// returns ODB_ENOMEM or ODB_ECRIT.
+static odb_err pra_rehash(edbp_bucket **bucketv, uint64_t *mask,
+                          edbp_slotid c) {
+	uint64_t bucketc = pra_bucketc(c);
+	if(bucketc <= *mask + 1) {
+		return 0;
+	}
+	edbp_bucket *n;
+	odb_err err = pra_alloc((void **)&n, sizeof(edbp_bucket) * bucketc);
+	if(err) return err;
+	for(uint64_t i = 0; i <= *mask; i++) {
+		if((*bucketv)[i].id) {
+			edbp_bucket_insert(n, bucketc - 1, (*bucketv)[i].id,
+			                   (*bucketv)[i].slot);
+		}
+	}
+	free(*bucketv);
+	*bucketv = n;
+	*mask = bucketc - 1;
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// LRU-K
+//
+// The original. Each slot gets a score when its unlocked from its LRU-2
+// history (see pra_k) plus a boost from its hints. The slot with the lowest
+// score is swapped out.
+
+typedef struct {
+	// min-heap (by pra_score) of all the slots that are not locked. So the
+	// slot to swap out on a page fault is always heapv[0]. Slots are taken
+	// out when they're locked and put back in when they're fully unlocked.
+	edbp_slotid *heapv;
+	edbp_slotid  heapc;
+	edbp_slotid  heapcap; // how many heapv has room for
+} pra_lruk;
+
+static void heap_swap(edbp_shard *shard, edbp_slotid a, edbp_slotid b) {
+	pra_lruk *l = shard->prav;
+	edbp_slotid t = l->heapv[a];
+	l->heapv[a] = l->heapv[b];
+	l->heapv[b] = t;
+	edbp_slotof(shard, l->heapv[a])->pra_heapi = a;
+	edbp_slotof(shard, l->heapv[b])->pra_heapi = b;
+}
+
+static unsigned int heap_score(const edbp_shard *shard, edbp_slotid i) {
+	const pra_lruk *l = shard->prav;
+	return edbp_slotof(shard, l->heapv[i])->pra_score;
+}
+
+static void heap_up(edbp_shard *shard, edbp_slotid i) {
+	while(i > 0) {
+		edbp_slotid parent = (i - 1) / 2;
+		if(heap_score(shard, parent) <= heap_score(shard, i)) {
+			break;
+		}
+		heap_swap(shard, parent, i);
+		i = parent;
+	}
+}
+
+static void heap_down(edbp_shard *shard, edbp_slotid i) {
+	pra_lruk *l = shard->prav;
+	for(;;) {
+		edbp_slotid lc = 2 * i + 1, rc = lc + 1, min = i;
+		if(lc < l->heapc && heap_score(shard, lc) < heap_score(shard, min)) {
+			min = lc;
+		}
+		if(rc < l->heapc && heap_score(shard, rc) < heap_score(shard, min)) {
+			min = rc;
+		}
+		if(min == i) {
+			break;
+		}
+		heap_swap(shard, i, min);
+		i = min;
+	}
+}
+
+static void heap_push(edbp_shard *shard, edbp_slotid slotid) {
+	pra_lruk *l = shard->prav;
+	edbp_slotid i = l->heapc++;
+	l->heapv[i] = slotid;
+	edbp_slotof(shard, slotid)->pra_heapi = i;
+	heap_up(shard, i);
+}
+
+static void heap_remove(edbp_shard *shard, edbp_slotid slotid) {
+	pra_lruk *l = shard->prav;
+	edbp_slotid i = edbp_slotof(shard, slotid)->pra_heapi;
+	edbp_slotid last = --l->heapc;
+	if(i != last) {
+		l->heapv[i] = l->heapv[last];
+		edbp_slotof(shard, l->heapv[i])->pra_heapi = i;
+		heap_down(shard, i);
+		heap_up(shard, i);
+	}
+	edbp_slotof(shard, slotid)->pra_heapi = -1;
+}
+
+static odb_err lruk_init(edbp_shard *shard) {
+	pra_lruk *l;
+	odb_err err = pra_alloc((void **)&l, sizeof(pra_lruk));
+	if(err) return err;
+	err = pra_alloc((void **)&l->heapv, sizeof(edbp_slotid) * shard->slot_count);
+	if(err) {
+		free(l);
+		return err;
+	}
+	// all slots start out empty and unlocked, thus all in the heap. They all
+	// have a score of 0 so any order is a valid heap.
+	for(edbp_slotid i = 0; i < shard->slot_count; i++) {
+		edbp_slotof(shard, i)->pra_heapi = i;
+		l->heapv[i] = i;
+	}
+	l->heapc = shard->slot_count;
+	l->heapcap = shard->slot_count;
+	shard->prav = l;
+	return 0;
+}
+
+static void lruk_free(edbp_shard *shard) {
+	pra_lruk *l = shard->prav;
+	free(l->heapv);
+	free(l);
+	shard->prav = 0;
+}
+
+static void lruk_hit(edbp_shard *shard, edbp_slotid slotid) {
+	edbp_slot *slot = edbp_slotof(shard, slotid);
+	if(slot->locks == 1) {
+		heap_remove(shard, slotid);
+	}
+	// rotate the LRU-1/LRU-2 history.
+	slot->pra_k[1] = slot->pra_k[0];
+	slot->pra_k[0] = shard->opcoutner;
+}
+
+static edbp_slotid lruk_fault(edbp_shard *shard, odb_pid id) {
+	pra_lruk *l = shard->prav;
+	if(l->heapc == 0) {
+		return -1;
+	}
+	edbp_slotid slotid = l->heapv[0];
+	heap_remove(shard, slotid);
+	// reset LRU-K history
+	edbp_slot *slot = edbp_slotof(shard, slotid);
+	slot->pra_k[1] = 0;
+	slot->pra_k[0] = shard->opcoutner;
+	return slotid;
+}
+
+static void lruk_unlocked(edbp_shard *shard, edbp_slotid slotid) {
+	edbp_slot *slot = edbp_slotof(shard, slotid);
+
+	// calculate the pra_score
+	//
+	// This is a complex operation that has a good degree
+	// of statsitical guess-work and will never be perfect.
+	// Let me note this step by step:
+	//
+	// EDBP_HUSESOON - this will cause the LRU-K algo to use
+	// LRU-1 instead of LRU-2.
+	//
+	// EDBP_HDIRTY and EDBP_HINDEX... will be added after the HINDEX is
+	// shifted over 4 bits. After added, it will be devided by the MAXLIF
+	// (which will always be bigger) and then multiplied by slotboost.
+	//
+	// Anything that's in the slot has at least a score of 1 so empty slots
+	// (and EDBP_HRESET) always go first, even before pages that have only
+	// been used once.
+	//
+	// EDBP_HSEQUENTIAL - plain LRU-2 with no boosts, so a page that was only
+	// ever seen by the scan (no LRU-2 history) scores 1 and goes first.
+	if(slot->id == 0 || slot->pra_hints & EDBP_HRESET) {
+		slot->pra_score = 0;
+	} else if(slot->pra_hints & EDBP_HSEQUENTIAL) {
+		slot->pra_score = 1 + slot->pra_k[1];
+	} else {
+		slot->pra_score = 1 + slot->pra_k[1 - (slot->pra_hints & 1)] // see EDBP_HUSESOON
+				+ (
+						(slot->pra_hints&EDBP_HDIRTY) + (slot->pra_hints >> 4)
+				   )
+				   * shard->slotboost
+				   / EDBP_HMAXLIF;
+
+	}
+	heap_push(shard, slotid);
+}
+
+static int lruk_cold(edbp_shard *shard, edbp_slotid *o_slotv, int slotc) {
+	pra_lruk *l = shard->prav;
+	// the front of the heap has the lowest scores (not in order, but close
+	// enough).
+	int c = 0;
+	for(edbp_slotid i = 0; i < l->heapc && i < slotc * 4 && c < slotc; i++) {
+		if(pra_cleanable(edbp_slotof(shard, l->heapv[i]))) {
+			o_slotv[c++] = l->heapv[i];
+		}
+	}
+	return c;
+}
+
+static void lruk_pin(edbp_shard *shard, edbp_slotid slotid) {
+	if(edbp_slotof(shard, slotid)->locks == 1) {
+		heap_remove(shard, slotid);
+	}
+}
+
+static odb_err lruk_grow(edbp_shard *shard, edbp_slotid oldcount) {
+	pra_lruk *l = shard->prav;
+	if(shard->slot_count > l->heapcap) {
+		odb_err err = pra_realloc((void **)&l->heapv,
+		                          sizeof(edbp_slotid) * l->heapcap,
+		                          sizeof(edbp_slotid) * shard->slot_count);
+		if(err) return err;
+		l->heapcap = shard->slot_count;
+	}
+	for(edbp_slotid i = oldcount; i < shard->slot_count; i++) {
+		heap_push(shard, i);
+	}
+	return 0;
+}
+
+static edbp_slotid lruk_shrink(edbp_shard *shard) {
+	pra_lruk *l = shard->prav;
+	edbp_slotid lastid = shard->slot_count;
+	edbp_slot *last = edbp_slotof(shard, lastid);
+	// (the last slot is unlocked, so it's in the heap)
+	edbp_slotid to = l->heapv[0];
+	if(last->id == 0 || to == lastid) {
+		heap_remove(shard, lastid);
+		return lastid;
+	}
+	// to takes the last slot's place in the heap with its score and history.
+	// Nothing moves, its the same score.
+	heap_remove(shard, to);
+	edbp_slot *slot = edbp_slotof(shard, to);
+	slot->pra_k[0] = last->pra_k[0];
+	slot->pra_k[1] = last->pra_k[1];
+	slot->pra_score = last->pra_score;
+	slot->pra_heapi = last->pra_heapi;
+	l->heapv[slot->pra_heapi] = to;
+	last->pra_heapi = -1;
+	return to;
+}
+
+static unsigned int lruk_heat(const edbp_shard *shard, edbp_slotid slotid) {
+	const edbp_slot *slot = edbp_slotof(shard, slotid);
+	// a locked slot's score is from before it was locked, but it's being
+	// used right now.
+	if(slot->locks) {
+		return 1 + slot->pra_k[0];
+	}
+	return slot->pra_score;
+}
+
+const edbp_praops edbp_pra_lruk = {
+		.name     = "lru-k",
+		.init     = lruk_init,
+		.free     = lruk_free,
+		.hit      = lruk_hit,
+		.fault    = lruk_fault,
+		.unlocked = lruk_unlocked,
+		.cold     = lruk_cold,
+		.pin      = lruk_pin,
+		.unpin    = lruk_unlocked, // (same score as before)
+		.grow     = lruk_grow,
+		.shrink   = lruk_shrink,
+		.heat     = lruk_heat,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// CLOCK-Pro
+//
+// (Jiang, Chen, Zhang 2005) Pages are either hot or cold, and a cold page
+// that's accessed again within its test period is made hot. Cold pages that
+// are swapped out during their test period are kept around (without their
+// slot) until the test period runs out so that if they come back they come
+// back hot. All of these are kept in a single clock (ring) with 3 hands:
+//
+//  - the cold hand swaps out cold pages that haven't been referenced
+//  - the hot hand turns hot pages that haven't been referenced cold, and ends
+//    the test periods of the cold pages it passes.
+//  - the test hand ends test periods so there's never more than slot_count
+//    non-resident pages.
+//
+// coldtarget is how many of the slots should be cold, it grows when a page is
+// accessed during its test period and shrinks when test periods run out.
+//
+// Simplifications: the hands move over entries in place rather than the
+// cold hand moving the pages it gives a second chance to the head of the
+// list.
+
+typedef struct {
+	odb_pid     id;
+	edbp_slotid slot; // -1 if non-resident
+	uint8_t     hot;
+	uint8_t     ref;  // set on hits, cleared by the hands
+	uint8_t     test; // in its test period (cold pages only)
+} pra_cpentry;
+
+typedef struct {
+	// slot_count * 2 entries (slot_count resident and up to slot_count
+	// non-resident) and the links for the ring they're in.
+	pra_cpentry *entv;
+	pra_link    *ringv;
+	edbp_slotid  ringc;
+
+	// unused entries and empty slots.
+	edbp_slotid *entfreev;
+	edbp_slotid  entfreec;
+	edbp_slotid *slotfreev;
+	edbp_slotid  slotfreec;
+
+	// slot -> entry. -1 if the slot is empty.
+	edbp_slotid *slotentv;
+
+	// page id -> entry of non-resident pages.
+	edbp_bucket *nonresv;
+	uint64_t     nonres_mask;
+
+	edbp_slotid handhot, handcold, handtest; // -1 if the ring is empty
+
+	edbp_slotid hotc, coldc, nonresc;
+	edbp_slotid coldtarget;
+
+	// the slot_count that the arrays above have room for (entv, ringv and
+	// entfreev have twice this).
+	edbp_slotid cap;
+} pra_clockpro;
+
+static void cp_ringinsert(pra_clockpro *c, edbp_slotid e) {
+	// new entries go in at the head of the list, which is right behind the
+	// hot hand.
+	if(c->ringc == 0) {
+		c->ringv[e].next = c->ringv[e].prev = e;
+		c->handhot = c->handcold = c->handtest = e;
+	} else {
+		edbp_slotid next = c->handhot;
+		edbp_slotid prev = c->ringv[next].prev;
+		c->ringv[e].next = next;
+		c->ringv[e].prev = prev;
+		c->ringv[prev].next = e;
+		c->ringv[next].prev = e;
+	}
+	c->ringc++;
+}
+
+// removes the entry from the ring and frees it.
+static void cp_ringremove(pra_clockpro *c, edbp_slotid e) {
+	edbp_slotid next = c->ringv[e].next;
+	if(next == e) {
+		next = -1;
+	} else {
+		c->ringv[c->ringv[e].prev].next = next;
+		c->ringv[next].prev = c->ringv[e].prev;
+	}
+	if(c->handhot == e) c->handhot = next;
+	if(c->handcold == e) c->handcold = next;
+	if(c->handtest == e) c->handtest = next;
+	c->ringc--;
+	c->entfreev[c->entfreec++] = e;
+}
+
+// removes a non-resident entry.
+static void cp_nonresremove(pra_clockpro *c, edbp_slotid e) {
+	edbp_bucket_delete(c->nonresv, c->nonres_mask, c->entv[e].id);
+	c->nonresc--;
+	cp_ringremove(c, e);
+}
+
+static void cp_coldshrink(pra_clockpro *c) {
+	if(c->coldtarget > 1) c->coldtarget--;
+}
+
+static void cp_coldgrow(pra_clockpro *c, edbp_slotid m) {
+	if(c->coldtarget + 1 < m) c->coldtarget++;
+}
+
+// runs the test hand until a non-resident page is removed. Only called when
+// there's non-resident pages.
+static void cp_handtest(pra_clockpro *c) {
+	// (the ring only ever shrinks as the hands go)
+	edbp_slotid limit = c->ringc * 2;
+	for(edbp_slotid n = 0; n < limit && c->handtest != -1; n++) {
+		edbp_slotid e = c->handtest;
+		pra_cpentry *ent = &c->entv[e];
+		c->handtest = c->ringv[e].next;
+		if(ent->hot || !ent->test) {
+			continue;
+		}
+		ent->test = 0;
+		cp_coldshrink(c);
+		if(ent->slot == -1) {
+			cp_nonresremove(c, e);
+			return;
+		}
+	}
+}
+
+// runs the hot hand until a hot page is turned cold. returns 0 if there
+// wasn't one to turn.
+static int cp_handhot(pra_clockpro *c) {
+	edbp_slotid limit = c->ringc * 2;
+	for(edbp_slotid n = 0; n < limit && c->handhot != -1; n++) {
+		edbp_slotid e = c->handhot;
+		pra_cpentry *ent = &c->entv[e];
+		c->handhot = c->ringv[e].next;
+		if(ent->hot) {
+			if(ent->ref) {
+				ent->ref = 0;
+				continue;
+			}
+			ent->hot = 0;
+			c->hotc--;
+			c->coldc++;
+			return 1;
+		}
+		// cold page: its test period is over.
+		if(ent->test) {
+			ent->test = 0;
+			cp_coldshrink(c);
+			if(ent->slot == -1) {
+				cp_nonresremove(c, e);
+			}
+		}
+	}
+	return 0;
+}
+
+// makes sure there's no more hot pages than slot_count - coldtarget.
+static void cp_balance(edbp_shard *shard) {
+	pra_clockpro *c = shard->prav;
+	while(c->hotc + c->coldtarget > shard->slot_count) {
+		if(!cp_handhot(c)) break;
+	}
+}
+
+static void cp_makehot(edbp_shard *shard, pra_cpentry *ent) {
+	pra_clockpro *c = shard->prav;
+	ent->hot = 1;
+	ent->test = 0;
+	c->coldc--;
+	c->hotc++;
+	cp_balance(shard);
+}
+
+// runs the cold hand until a cold page is swapped out. Returns its slot or -1
+// if every cold page is locked.
+static edbp_slotid cp_handcold(edbp_shard *shard) {
+	pra_clockpro *c = shard->prav;
+	// every entry may need to be passed twice (once to clear its ref), and
+	// the hot hand can make more cold pages as we go.
+	edbp_slotid limit = c->ringc * 3;
+	for(edbp_slotid n = 0; n < limit && c->handcold != -1; n++) {
+		edbp_slotid e = c->handcold;
+		pra_cpentry *ent = &c->entv[e];
+		c->handcold = c->ringv[e].next;
+		if(ent->slot == -1 || ent->hot || edbp_slotof(shard, ent->slot)->locks) {
+			continue;
+		}
+		if(ent->ref) {
+			ent->ref = 0;
+			if(ent->test) {
+				// accessed again during its test period.
+				cp_coldgrow(c, shard->slot_count);
+				cp_makehot(shard, ent);
+			} else {
+				ent->test = 1;
+			}
+			continue;
+		}
+
+		// swap it out. If its in its test period it stays as
+		// non-resident, but make room for it first (which may end its
+		// test period).
+		if(ent->test && c->nonresc >= shard->slot_count) {
+			cp_handtest(c);
+		}
+		edbp_slotid slotid = ent->slot;
+		c->slotentv[slotid] = -1;
+		c->coldc--;
+		if(ent->test) {
+			ent->slot = -1;
+			c->nonresc++;
+			edbp_bucket_insert(c->nonresv, c->nonres_mask, ent->id, e);
+		} else {
+			cp_ringremove(c, e);
+		}
+		return slotid;
+	}
+	return -1;
+}
+
+// an empty slot or the slot of the page the cold hand swaps out. -1 if every
+// slot is locked.
+static edbp_slotid cp_victim(edbp_shard *shard) {
+	pra_clockpro *c = shard->prav;
+	if(c->slotfreec) {
+		return c->slotfreev[--c->slotfreec];
+	}
+	// if all the cold pages are locked, turn hot ones cold until we get one.
+	edbp_slotid slotid;
+	for(edbp_slotid n = 0; (slotid = cp_handcold(shard)) == -1; n++) {
+		if(n == shard->slot_count * 4 || !cp_handhot(c)) {
+			return -1;
+		}
+	}
+	return slotid;
+}
+
+static odb_err clockpro_init(edbp_shard *shard) {
+	edbp_slotid m = shard->slot_count;
+	pra_clockpro *c;
+	odb_err err = pra_alloc((void **)&c, sizeof(pra_clockpro));
+	if(err) return err;
+	uint64_t bucketc = pra_bucketc(m);
+	if((err = pra_alloc((void **)&c->entv, sizeof(pra_cpentry) * m * 2))
+	    || (err = pra_alloc((void **)&c->ringv, sizeof(pra_link) * m * 2))
+	    || (err = pra_alloc((void **)&c->entfreev, sizeof(edbp_slotid) * m * 2))
+	    || (err = pra_alloc((void **)&c->slotfreev, sizeof(edbp_slotid) * m))
+	    || (err = pra_alloc((void **)&c->slotentv, sizeof(edbp_slotid) * m))
+	    || (err = pra_alloc((void **)&c->nonresv, sizeof(edbp_bucket) * bucketc))) {
+		free(c->entv);
+		free(c->ringv);
+		free(c->entfreev);
+		free(c->slotfreev);
+		free(c->slotentv);
+		free(c);
+		return err;
+	}
+	c->nonres_mask = bucketc - 1;
+	for(edbp_slotid i = 0; i < m * 2; i++) {
+		c->entfreev[i] = m * 2 - 1 - i;
+	}
+	c->entfreec = m * 2;
+	for(edbp_slotid i = 0; i < m; i++) {
+		c->slotfreev[i] = m - 1 - i;
+		c->slotentv[i] = -1;
+	}
+	c->slotfreec = m;
+	c->handhot = c->handcold = c->handtest = -1;
+	c->coldtarget = m / 2;
+	if(c->coldtarget == 0) c->coldtarget = 1;
+	c->cap = m;
+	shard->prav = c;
+	return 0;
+}
+
+static void clockpro_free(edbp_shard *shard) {
+	pra_clockpro *c = shard->prav;
+	free(c->entv);
+	free(c->ringv);
+	free(c->entfreev);
+	free(c->slotfreev);
+	free(c->slotentv);
+	free(c->nonresv);
+	free(c);
+	shard->prav = 0;
+}
+
+static void clockpro_hit(edbp_shard *shard, edbp_slotid slotid) {
+	pra_clockpro *c = shard->prav;
+	edbp_slotid e = c->slotentv[slotid];
+	if(e != -1) {
+		c->entv[e].ref = 1;
+	}
+}
+
+static edbp_slotid clockpro_fault(edbp_shard *shard, odb_pid id) {
+	pra_clockpro *c = shard->prav;
+	edbp_slotid slotid = cp_victim(shard);
+	if(slotid == -1) {
+		return -1;
+	}
+
+	// (looked up after the hands have moved, they may have ended its test
+	// period)
+	edbp_slotid e = edbp_bucket_find(c->nonresv, c->nonres_mask, id);
+	if(e != -1) {
+		// non-resident page back during its test period: comes back hot.
+		edbp_bucket_delete(c->nonresv, c->nonres_mask, id);
+		c->nonresc--;
+		cp_ringremove(c, e);
+		c->entfreec--; // (take it right back)
+		c->entv[e] = (pra_cpentry){.id = id, .slot = slotid, .hot = 1};
+		cp_ringinsert(c, e);
+		c->hotc++;
+		cp_coldgrow(c, shard->slot_count);
+		c->slotentv[slotid] = e;
+		cp_balance(shard);
+		return slotid;
+	}
+
+	e = c->entfreev[--c->entfreec];
+	c->entv[e] = (pra_cpentry){.id = id, .slot = slotid, .test = 1};
+	cp_ringinsert(c, e);
+	c->coldc++;
+	c->slotentv[slotid] = e;
+	return slotid;
+}
+
+static void clockpro_unlocked(edbp_shard *shard, edbp_slotid slotid) {
+	pra_clockpro *c = shard->prav;
+	edbp_slot *slot = edbp_slotof(shard, slotid);
+	edbp_slotid e = c->slotentv[slotid];
+
+	if(slot->id == 0) {
+		// failed to load, the slot is empty again.
+		if(e != -1) {
+			if(c->entv[e].hot) c->hotc--;
+			else c->coldc--;
+			cp_ringremove(c, e);
+			c->slotentv[slotid] = -1;
+		}
+		c->slotfreev[c->slotfreec++] = slotid;
+		return;
+	}
+	if(e == -1) {
+		return;
+	}
+
+	pra_cpentry *ent = &c->entv[e];
+	if(slot->pra_hints & EDBP_HRESET) {
+		ent->ref = 0;
+		ent->test = 0;
+		if(ent->hot) {
+			ent->hot = 0;
+			c->hotc--;
+			c->coldc++;
+		}
+	} else if(slot->pra_hints & EDBP_HSEQUENTIAL) {
+		// a cold page a scan went through shouldn't get a second chance or
+		// come back hot. Hot pages stay hot.
+		if(!ent->hot) {
+			ent->ref = 0;
+			ent->test = 0;
+		}
+	} else if(slot->pra_hints >> 4) {
+		// (EDBP_HINDEX...)
+		ent->ref = 1;
+		if(!ent->hot) {
+			cp_makehot(shard, ent);
+		}
+	} else if(slot->pra_hints & (EDBP_HUSESOON | EDBP_HDIRTY)) {
+		ent->ref = 1;
+	}
+}
+
+static int clockpro_cold(edbp_shard *shard, edbp_slotid *o_slotv, int slotc) {
+	pra_clockpro *c = shard->prav;
+	// the resident cold pages coming up on the cold hand.
+	int n = 0;
+	edbp_slotid e = c->handcold;
+	for(edbp_slotid i = 0; e != -1 && i < c->ringc && i < slotc * 4 && n < slotc; i++) {
+		pra_cpentry *ent = &c->entv[e];
+		if(ent->slot != -1 && !ent->hot && pra_cleanable(edbp_slotof(shard, ent->slot))) {
+			o_slotv[n++] = ent->slot;
+		}
+		e = c->ringv[e].next;
+	}
+	return n;
+}
+
+static odb_err clockpro_grow(edbp_shard *shard, edbp_slotid oldcount) {
+	pra_clockpro *c = shard->prav;
+	edbp_slotid m = shard->slot_count;
+	if(m > c->cap) {
+		odb_err err;
+		edbp_slotid o = c->cap;
+		if((err = pra_realloc((void **)&c->entv, sizeof(pra_cpentry) * o * 2, sizeof(pra_cpentry) * m * 2))
+		    || (err = pra_realloc((void **)&c->ringv, sizeof(pra_link) * o * 2, sizeof(pra_link) * m * 2))
+		    || (err = pra_realloc((void **)&c->entfreev, sizeof(edbp_slotid) * o * 2, sizeof(edbp_slotid) * m * 2))
+		    || (err = pra_realloc((void **)&c->slotfreev, sizeof(edbp_slotid) * o, sizeof(edbp_slotid) * m))
+		    || (err = pra_realloc((void **)&c->slotentv, sizeof(edbp_slotid) * o, sizeof(edbp_slotid) * m))
+		    || (err = pra_rehash(&c->nonresv, &c->nonres_mask, m))) {
+			// (whatever did get bigger can stay that way)
+			return err;
+		}
+		for(edbp_slotid e = o * 2; e < m * 2; e++) {
+			c->entfreev[c->entfreec++] = e;
+		}
+		c->cap = m;
+	}
+	for(edbp_slotid i = oldcount; i < m; i++) {
+		c->slotentv[i] = -1;
+		c->slotfreev[c->slotfreec++] = i;
+	}
+	return 0;
+}
+
+static edbp_slotid clockpro_shrink(edbp_shard *shard) {
+	pra_clockpro *c = shard->prav;
+	edbp_slotid lastid = shard->slot_count;
+	edbp_slotid laste = c->slotentv[lastid];
+	if(laste == -1) {
+		// empty, take it out of the free ones.
+		for(edbp_slotid i = 0; i < c->slotfreec; i++) {
+			if(c->slotfreev[i] == lastid) {
+				c->slotfreev[i] = c->slotfreev[--c->slotfreec];
+				break;
+			}
+		}
+		return lastid;
+	}
+
+	edbp_slotid to = cp_victim(shard);
+	if(to == -1 || to == lastid) {
+		return to;
+	}
+	// to takes over the last slot's entry.
+	c->entv[laste].slot = to;
+	c->slotentv[to] = laste;
+	c->slotentv[lastid] = -1;
+	if(c->coldtarget >= shard->slot_count && c->coldtarget > 1) {
+		c->coldtarget = shard->slot_count > 1 ? shard->slot_count - 1 : 1;
+	}
+	cp_balance(shard);
+	return to;
+}
+
+static unsigned int clockpro_heat(const edbp_shard *shard,
+                                  edbp_slotid slotid) {
+	const pra_clockpro *c = shard->prav;
+	if(c->slotentv[slotid] == -1) {
+		return 0;
+	}
+	const pra_cpentry *ent = &c->entv[c->slotentv[slotid]];
+	// hot before cold, referenced before not.
+	return ent->hot * 2 + ent->ref;
+}
+
+// (the hands skip over locked slots, so no pin/unpin)
+const edbp_praops edbp_pra_clockpro = {
+		.name     = "clock-pro",
+		.init     = clockpro_init,
+		.free     = clockpro_free,
+		.hit      = clockpro_hit,
+		.fault    = clockpro_fault,
+		.unlocked = clockpro_unlocked,
+		.cold     = clockpro_cold,
+		.grow     = clockpro_grow,
+		.shrink   = clockpro_shrink,
+		.heat     = clockpro_heat,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// ARC
+//
+// (Megiddo, Modha 2003) Resident pages are in either t1 (seen once recently)
+// or t2 (seen at least twice). When a page is swapped out, its id is
+// remembered in b1 or b2 (ghosts) respectively. A fault on a ghost in b1
+// means t1 should have been bigger, and b2 means t2 should have been bigger,
+// p (the target size of t1) is adapted accordingly.
+//
+// Locked slots can't be swapped out, so when the list that should give up a
+// slot has nothing unlocked in it, the other list will.
+
+enum {
+	ARC_NONE = 0, // empty slot / unused ghost
+	ARC_1    = 1, // t1 / b1
+	ARC_2    = 2, // t2 / b2
+};
+
+typedef struct {
+	// slots: lists[ARC_NONE] are the empty slots.
+	pra_link *slotlinkv;
+	uint8_t  *slotlistv;
+	pra_list  t[3];
+
+	// ghosts (slot_count of them): ghostv[ARC_NONE] are the unused ones.
+	odb_pid     *ghostidv;
+	pra_link    *ghostlinkv;
+	uint8_t     *ghostlistv;
+	pra_list     b[3];
+	edbp_bucket *ghostbucketv; // page id -> ghost
+	uint64_t     ghost_mask;
+
+	edbp_slotid p;
+
+	// the slot_count that the arrays above have room for (and the amount of
+	// ghosts).
+	edbp_slotid cap;
+} pra_arc;
+
+static void arc_ghostdrop(pra_arc *a, edbp_slotid g) {
+	edbp_bucket_delete(a->ghostbucketv, a->ghost_mask, a->ghostidv[g]);
+	list_remove(&a->b[a->ghostlistv[g]], a->ghostlinkv, g);
+	a->ghostlistv[g] = ARC_NONE;
+	list_pushhead(&a->b[ARC_NONE], a->ghostlinkv, g);
+}
+
+// remembers the id in b1 or b2 (list)
+static void arc_ghostadd(pra_arc *a, odb_pid id, uint8_t list) {
+	if(a->b[ARC_NONE].c == 0) {
+		// full. Forget the oldest.
+		arc_ghostdrop(a, a->b[ARC_1].c ? a->b[ARC_1].tail : a->b[ARC_2].tail);
+	}
+	edbp_slotid g = a->b[ARC_NONE].head;
+	list_remove(&a->b[ARC_NONE], a->ghostlinkv, g);
+	a->ghostidv[g] = id;
+	a->ghostlistv[g] = list;
+	list_pushhead(&a->b[list], a->ghostlinkv, g);
+	edbp_bucket_insert(a->ghostbucketv, a->ghost_mask, id, g);
+}
+
+// returns the least recently used unlocked slot in the list, -1 if none.
+static edbp_slotid arc_lru(edbp_shard *shard, uint8_t list) {
+	pra_arc *a = shard->prav;
+	for(edbp_slotid s = a->t[list].tail; s != -1; s = a->slotlinkv[s].prev) {
+		if(edbp_slotof(shard, s)->locks == 0) {
+			return s;
+		}
+	}
+	return -1;
+}
+
+// ARC's REPLACE: takes a resident slot out of t1 or t2. If t1ghost is 0 then
+// a page taken out of t1 won't be remembered in b1.
+static edbp_slotid arc_replace(edbp_shard *shard, int inb2, int t1ghost) {
+	pra_arc *a = shard->prav;
+	uint8_t list = ARC_2;
+	if(a->t[ARC_1].c >= 1
+	   && ((inb2 && a->t[ARC_1].c == a->p) || a->t[ARC_1].c > a->p)) {
+		list = ARC_1;
+	}
+	edbp_slotid s = arc_lru(shard, list);
+	if(s == -1) {
+		list = list == ARC_1 ? ARC_2 : ARC_1;
+		s = arc_lru(shard, list);
+		if(s == -1) {
+			return -1;
+		}
+	}
+	list_remove(&a->t[list], a->slotlinkv, s);
+	a->slotlistv[s] = ARC_NONE;
+	if(list == ARC_2 || t1ghost) {
+		arc_ghostadd(a, edbp_slotof(shard, s)->id, list);
+	}
+	return s;
+}
+
+static odb_err arc_init(edbp_shard *shard) {
+	edbp_slotid m = shard->slot_count;
+	pra_arc *a;
+	odb_err err = pra_alloc((void **)&a, sizeof(pra_arc));
+	if(err) return err;
+	uint64_t bucketc = pra_bucketc(m);
+	if((err = pra_alloc((void **)&a->slotlinkv, sizeof(pra_link) * m))
+	    || (err = pra_alloc((void **)&a->slotlistv, m))
+	    || (err = pra_alloc((void **)&a->ghostidv, sizeof(odb_pid) * m))
+	    || (err = pra_alloc((void **)&a->ghostlinkv, sizeof(pra_link) * m))
+	    || (err = pra_alloc((void **)&a->ghostlistv, m))
+	    || (err = pra_alloc((void **)&a->ghostbucketv, sizeof(edbp_bucket) * bucketc))) {
+		free(a->slotlinkv);
+		free(a->slotlistv);
+		free(a->ghostidv);
+		free(a->ghostlinkv);
+		free(a->ghostlistv);
+		free(a);
+		return err;
+	}
+	a->ghost_mask = bucketc - 1;
+	for(int i = 0; i < 3; i++) {
+		list_init(&a->t[i]);
+		list_init(&a->b[i]);
+	}
+	for(edbp_slotid i = 0; i < m; i++) {
+		list_pushtail(&a->t[ARC_NONE], a->slotlinkv, i);
+		list_pushtail(&a->b[ARC_NONE], a->ghostlinkv, i);
+	}
+	a->cap = m;
+	shard->prav = a;
+	return 0;
+}
+
+static void arc_free(edbp_shard *shard) {
+	pra_arc *a = shard->prav;
+	free(a->slotlinkv);
+	free(a->slotlistv);
+	free(a->ghostidv);
+	free(a->ghostlinkv);
+	free(a->ghostlistv);
+	free(a->ghostbucketv);
+	free(a);
+	shard->prav = 0;
+}
+
+static void arc_hit(edbp_shard *shard, edbp_slotid slotid) {
+	pra_arc *a = shard->prav;
+	uint8_t list = a->slotlistv[slotid];
+	if(list == ARC_NONE) {
+		return;
+	}
+	list_remove(&a->t[list], a->slotlinkv, slotid);
+	a->slotlistv[slotid] = ARC_2;
+	list_pushhead(&a->t[ARC_2], a->slotlinkv, slotid);
+}
+
+static edbp_slotid arc_fault(edbp_shard *shard, odb_pid id) {
+	pra_arc *a = shard->prav;
+	edbp_slotid c = shard->slot_count;
+	edbp_slotid g = edbp_bucket_find(a->ghostbucketv, a->ghost_mask, id);
+	uint8_t ghostlist = g == -1 ? ARC_NONE : a->ghostlistv[g];
+	edbp_slotid t1 = a->t[ARC_1].c, t2 = a->t[ARC_2].c;
+	edbp_slotid b1 = a->b[ARC_1].c, b2 = a->b[ARC_2].c;
+	int t1ghost = 1;
+
+	switch (ghostlist) {
+		case ARC_1: {
+			edbp_slotid delta = b2 > b1 ? b2 / b1 : 1;
+			a->p = a->p + delta > c ? c : a->p + delta;
+			break;
+		}
+		case ARC_2: {
+			edbp_slotid delta = b1 > b2 ? b1 / b2 : 1;
+			a->p = a->p > delta ? a->p - delta : 0;
+			break;
+		}
+		default:
+			// not seen before
+			if(t1 + b1 >= c) {
+				if(b1) {
+					arc_ghostdrop(a, a->b[ARC_1].tail);
+				} else {
+					// t1 is everything, don't remember what's swapped
+					// out of it.
+					t1ghost = 0;
+				}
+			} else if(t1 + t2 + b1 + b2 >= 2 * c && b2) {
+				arc_ghostdrop(a, a->b[ARC_2].tail);
+			}
+			break;
+	}
+
+	edbp_slotid s = a->t[ARC_NONE].head;
+	if(s != -1) {
+		list_remove(&a->t[ARC_NONE], a->slotlinkv, s);
+	} else {
+		s = arc_replace(shard, ghostlist == ARC_2, t1ghost);
+		if(s == -1) {
+			return -1;
+		}
+	}
+	if(ghostlist != ARC_NONE) {
+		// (arc_replace may have dropped it to make room)
+		g = edbp_bucket_find(a->ghostbucketv, a->ghost_mask, id);
+		if(g != -1) arc_ghostdrop(a, g);
+	}
+
+	uint8_t list = ghostlist == ARC_NONE ? ARC_1 : ARC_2;
+	a->slotlistv[s] = list;
+	list_pushhead(&a->t[list], a->slotlinkv, s);
+	return s;
+}
+
+static void arc_unlocked(edbp_shard *shard, edbp_slotid slotid) {
+	pra_arc *a = shard->prav;
+	edbp_slot *slot = edbp_slotof(shard, slotid);
+	uint8_t list = a->slotlistv[slotid];
+
+	if(slot->id == 0) {
+		// failed to load, the slot is empty again.
+		if(list != ARC_NONE) {
+			list_remove(&a->t[list], a->slotlinkv, slotid);
+			a->slotlistv[slotid] = ARC_NONE;
+			list_pushhead(&a->t[ARC_NONE], a->slotlinkv, slotid);
+		}
+		return;
+	}
+	if(list == ARC_NONE) {
+		return;
+	}
+
+	if(slot->pra_hints & EDBP_HRESET) {
+		// first to go.
+		list_remove(&a->t[list], a->slotlinkv, slotid);
+		a->slotlistv[slotid] = ARC_1;
+		list_pushtail(&a->t[ARC_1], a->slotlinkv, slotid);
+	} else if(slot->pra_hints & EDBP_HSEQUENTIAL) {
+		// only seen by the scan, it'll be the next to go from t1. (Pages in
+		// t2 were used before, they stay put)
+		if(list == ARC_1) {
+			list_remove(&a->t[ARC_1], a->slotlinkv, slotid);
+			list_pushtail(&a->t[ARC_1], a->slotlinkv, slotid);
+		}
+	} else if(slot->pra_hints >> 4 || slot->pra_hints & (EDBP_HUSESOON | EDBP_HDIRTY)) {
+		// EDBP_HINDEX... pages are treated as frequently used
+		uint8_t to = slot->pra_hints >> 4 ? ARC_2 : list;
+		list_remove(&a->t[list], a->slotlinkv, slotid);
+		a->slotlistv[slotid] = to;
+		list_pushhead(&a->t[to], a->slotlinkv, slotid);
+	}
+}
+
+static int arc_cold(edbp_shard *shard, edbp_slotid *o_slotv, int slotc) {
+	pra_arc *a = shard->prav;
+	// the least recently used ends of t1 and then t2.
+	int c = 0;
+	for(uint8_t list = ARC_1; list <= ARC_2; list++) {
+		edbp_slotid s = a->t[list].tail;
+		for(int i = 0; s != -1 && i < slotc * 2 && c < slotc; i++) {
+			if(pra_cleanable(edbp_slotof(shard, s))) {
+				o_slotv[c++] = s;
+			}
+			s = a->slotlinkv[s].prev;
+		}
+	}
+	return c;
+}
+
+static odb_err arc_grow(edbp_shard *shard, edbp_slotid oldcount) {
+	pra_arc *a = shard->prav;
+	edbp_slotid m = shard->slot_count;
+	if(m > a->cap) {
+		odb_err err;
+		edbp_slotid o = a->cap;
+		if((err = pra_realloc((void **)&a->slotlinkv, sizeof(pra_link) * o, sizeof(pra_link) * m))
+		    || (err = pra_realloc((void **)&a->slotlistv, o, m))
+		    || (err = pra_realloc((void **)&a->ghostidv, sizeof(odb_pid) * o, sizeof(odb_pid) * m))
+		    || (err = pra_realloc((void **)&a->ghostlinkv, sizeof(pra_link) * o, sizeof(pra_link) * m))
+		    || (err = pra_realloc((void **)&a->ghostlistv, o, m))
+		    || (err = pra_rehash(&a->ghostbucketv, &a->ghost_mask, m))) {
+			// (whatever did get bigger can stay that way)
+			return err;
+		}
+		for(edbp_slotid g = o; g < m; g++) {
+			list_pushtail(&a->b[ARC_NONE], a->ghostlinkv, g);
+		}
+		a->cap = m;
+	}
+	for(edbp_slotid i = oldcount; i < m; i++) {
+		a->slotlistv[i] = ARC_NONE;
+		list_pushtail(&a->t[ARC_NONE], a->slotlinkv, i);
+	}
+	return 0;
+}
+
+static edbp_slotid arc_shrink(edbp_shard *shard) {
+	pra_arc *a = shard->prav;
+	edbp_slotid lastid = shard->slot_count;
+	uint8_t list = a->slotlistv[lastid];
+	if(a->p > shard->slot_count) {
+		a->p = shard->slot_count;
+	}
+	if(list == ARC_NONE) {
+		list_remove(&a->t[ARC_NONE], a->slotlinkv, lastid);
+		return lastid;
+	}
+
+	edbp_slotid to = a->t[ARC_NONE].head;
+	if(to != -1) {
+		list_remove(&a->t[ARC_NONE], a->slotlinkv, to);
+	} else {
+		to = arc_replace(shard, 0, 1);
+		if(to == -1 || to == lastid) {
+			return to;
+		}
+	}
+	// to takes the last slot's place in its list.
+	list_replace(&a->t[list], a->slotlinkv, lastid, to);
+	a->slotlistv[to] = list;
+	a->slotlistv[lastid] = ARC_NONE;
+	return to;
+}
+
+static unsigned int arc_heat(const edbp_shard *shard, edbp_slotid slotid) {
+	const pra_arc *a = shard->prav;
+	// t2 (ARC_2) before t1 (ARC_1).
+	return a->slotlistv[slotid];
+}
+
+// (arc_lru skips over locked slots, so no pin/unpin)
+const edbp_praops edbp_pra_arc = {
+		.name     = "arc",
+		.init     = arc_init,
+		.free     = arc_free,
+		.hit      = arc_hit,
+		.fault    = arc_fault,
+		.unlocked = arc_unlocked,
+		.cold     = arc_cold,
+		.grow     = arc_grow,
+		.shrink   = arc_shrink,
+		.heat     = arc_heat,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+const edbp_praops *edbp_pra_ops(unsigned int pra) {
+	switch (pra) {
+		case EDBP_PRA_LRUK:     return &edbp_pra_lruk;
+		case EDBP_PRA_CLOCKPRO: return &edbp_pra_clockpro;
+		case EDBP_PRA_ARC:      return &edbp_pra_arc;
+		default:                return 0;
+	}
+}
+
+odb_err edbp_pra_simulate(unsigned int pra, unsigned int slotcount,
+                          const edbp_trace *tracev, uint64_t tracec,
+                          uint64_t *o_hits) {
+	const edbp_praops *ops = edbp_pra_ops(pra);
+	if(ops == 0 || slotcount == 0) return ODB_EINVAL;
+
+	// a shard with no pages, no mutex and only ever 1 lock at a time.
+	edbp_shard shard;
+	bzero(&shard, sizeof(shard));
+	uint64_t bucketc = pra_bucketc(slotcount);
+	odb_err err;
+	if((err = edbp_slots_reserve(&shard, slotcount))) {
+		return err;
+	}
+	if((err = pra_alloc((void **)&shard.bucketv, sizeof(edbp_bucket) * bucketc))) {
+		edbp_slots_release(&shard, 0);
+		return err;
+	}
+	shard.slot_count = slotcount;
+	shard.slot_target = slotcount;
+	shard.bucket_mask = bucketc - 1;
+	shard.slotboost = (unsigned int) (EDBP_SLOTBOOSTPER * (float) slotcount);
+	shard.pra = ops;
+	if((err = ops->init(&shard))) {
+		edbp_slots_release(&shard, 0);
+		free(shard.bucketv);
+		return err;
+	}
+
+	uint64_t hits = 0;
+	for(uint64_t i = 0; i < tracec; i++) {
+		odb_pid id = tracev[i].id;
+		if(id == 0) {
+			err = ODB_EINVAL;
+			break;
+		}
+		shard.opcoutner++;
+		edbp_slotid slotid = edbp_bucket_find(shard.bucketv, shard.bucket_mask, id);
+		if(slotid != -1) {
+			hits++;
+			edbp_slotof(&shard, slotid)->locks++;
+			ops->hit(&shard, slotid);
+		} else {
+			slotid = ops->fault(&shard, id);
+			if(slotid == -1) {
+				err = log_critf("simulated page fault with every slot locked");
+				break;
+			}
+			edbp_slot *slot = edbp_slotof(&shard, slotid);
+			if(slot->id) {
+				edbp_bucket_delete(shard.bucketv, shard.bucket_mask, slot->id);
+			}
+			edbp_bucket_insert(shard.bucketv, shard.bucket_mask, id, slotid);
+			slot->id = id;
+			slot->locks = 1;
+		}
+		edbp_slot *slot = edbp_slotof(&shard, slotid);
+		slot->pra_hints = tracev[i].hints;
+		slot->locks--;
+		ops->unlocked(&shard, slotid);
+	}
+
+	ops->free(&shard);
+	edbp_slots_release(&shard, 0);
+	free(shard.bucketv);
+	if(!err) *o_hits = hits;
+	return err;
+}
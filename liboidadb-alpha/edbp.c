@@ -6,281 +6,2160 @@
 #include <stdlib.h>
 #include <pthread.h>
 #include <strings.h>
+#include <string.h>
 #include <sys/mman.h>
 #include <linux/futex.h>
 #include <sys/syscall.h>
 #include <limits.h>
 #include <errno.h>
 #include <stdarg.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <linux/mempolicy.h>
 
-// gets thee pages from either the cache or the file and returns an array of
-// pointers to those pages. Will try to get up to len (at least 1 is guarenteed)
-// but actual count will be set in o_len.
-// o_pageslots should be an array len long, this will be the slots to where
-// the pages were loaded into, thus the pages can be access via cache->pagebufv[o_pageslots[...]]
-// pointers.
+// hash table helpers, see edbp_u.h. For a shard's bucketv, they require the
+// shard's mutexpagelock to be locked.
+
+static uint64_t bucket_hash(uint64_t mask, odb_pid id) {
+	// fibonacci hashing: page ids are often sequential so we need to spread
+	// them out.
+	return ((id * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+}
+
+edbp_slotid edbp_bucket_find(const edbp_bucket *bucketv, uint64_t mask,
+                             odb_pid id) {
+	for(uint64_t i = bucket_hash(mask, id);
+	    bucketv[i].id != 0;
+	    i = (i + 1) & mask) {
+		if(bucketv[i].id == id) {
+			return bucketv[i].slot;
+		}
+	}
+	return -1;
+}
+
+void edbp_bucket_insert(edbp_bucket *bucketv, uint64_t mask,
+                        odb_pid id, edbp_slotid slot) {
+	uint64_t i = bucket_hash(mask, id);
+	while(bucketv[i].id != 0) {
+		i = (i + 1) & mask;
+	}
+	bucketv[i].id = id;
+	bucketv[i].slot = slot;
+}
+
+// We don't use tombstones, instead everything after the removed bucket that
+// would no longer be reachable is shifted back.
+void edbp_bucket_delete(edbp_bucket *bucketv, uint64_t mask, odb_pid id) {
+	uint64_t i = bucket_hash(mask, id);
+	while(bucketv[i].id != id) {
+		if(bucketv[i].id == 0) {
+			return;
+		}
+		i = (i + 1) & mask;
+	}
+	for(uint64_t j = (i + 1) & mask; bucketv[j].id != 0; j = (j + 1) & mask) {
+		uint64_t k = bucket_hash(mask, bucketv[j].id);
+		// can bucket j's home (k) still reach j if we empty i? If not, move
+		// it into i.
+		if((i <= j) ? (k <= i || k > j) : (k <= i && k > j)) {
+			bucketv[i] = bucketv[j];
+			i = j;
+		}
+	}
+	bucketv[i].id = 0;
+}
+
+odb_err edbp_slots_reserve(edbp_shard *shard, edbp_slotid slotc) {
+	while(edbp_slotchunkstart(shard->slotchunkc) < slotc) {
+		unsigned int k = shard->slotchunkc;
+		if(k == EDBP_SLOTCHUNKS) {
+			return log_critf("too many slots (%u)", slotc);
+		}
+		size_t size = sizeof(edbp_slot) * ((size_t)EDBP_SLOTCHUNK << k);
+		edbp_slot *chunk = malloc(size);
+		if(chunk == 0) {
+			if(errno == ENOMEM)
+				return ODB_ENOMEM;
+			return log_critf("malloc");
+		}
+		bzero(chunk, size);
+		shard->slotchunkv[k] = chunk;
+		shard->slotchunkc++;
+	}
+	return 0;
+}
+
+void edbp_slots_release(edbp_shard *shard, edbp_slotid slotc) {
+	while(shard->slotchunkc
+	      && edbp_slotchunkstart(shard->slotchunkc - 1) >= slotc) {
+		unsigned int k = --shard->slotchunkc;
+		free(shard->slotchunkv[k]);
+		shard->slotchunkv[k] = 0;
+	}
+}
+
+static edbp_slotid bucket_find(const edbp_shard *shard, odb_pid id) {
+	return edbp_bucket_find(shard->bucketv, shard->bucket_mask, id);
+}
+static void bucket_insert(edbp_shard *shard, odb_pid id, edbp_slotid slot) {
+	edbp_bucket_insert(shard->bucketv, shard->bucket_mask, id, slot);
+}
+static void bucket_delete(edbp_shard *shard, odb_pid id) {
+	edbp_bucket_delete(shard->bucketv, shard->bucket_mask, id);
+}
+
+// index tier helpers, see edbp_shard.tierv. They all require mutexpagelock.
+
+// which tier list a page finished with these hints belongs in, 0 for none.
+static uint8_t tier_level(edbp_hint hints) {
+	if(hints & EDBP_HRESET) {
+		return 0;
+	}
+	// (depth 0 and 1 are EDBP_HINDEX0 and EDBP_HINDEX1, 2 and 3 the lower
+	// values)
+	switch (hints & (EDBP_HINDEX0 | EDBP_HINDEX1)) {
+		case 0:
+			return 0;
+		case EDBP_HINDEX2:
+		case EDBP_HINDEX3:
+			return EDBP_TIERLOWER;
+		default:
+			return EDBP_TIERUPPER;
+	}
+}
+
+static void tier_pushhead(edbp_shard *shard, edbp_slotid slotid,
+                          uint8_t level) {
+	edbp_slot *slot = edbp_slotof(shard, slotid);
+	slot->tier = level;
+	slot->tier_prev = -1;
+	slot->tier_next = shard->tierv[level].head;
+	if(slot->tier_next != -1) {
+		edbp_slotof(shard, slot->tier_next)->tier_prev = slotid;
+	} else {
+		shard->tierv[level].tail = slotid;
+	}
+	shard->tierv[level].head = slotid;
+}
+
+static void tier_unlink(edbp_shard *shard, edbp_slotid slotid) {
+	edbp_slot *slot = edbp_slotof(shard, slotid);
+	if(slot->tier_prev != -1) {
+		edbp_slotof(shard, slot->tier_prev)->tier_next = slot->tier_next;
+	} else {
+		shard->tierv[slot->tier].head = slot->tier_next;
+	}
+	if(slot->tier_next != -1) {
+		edbp_slotof(shard, slot->tier_next)->tier_prev = slot->tier_prev;
+	} else {
+		shard->tierv[slot->tier].tail = slot->tier_prev;
+	}
+	slot->tier = 0;
+}
+
+// takes the slot out of the tier and gives up the tier's lock on it. If that
+// was the last lock, the pra gets it back: as a use if used is set
+// (a handle just finished with it), otherwise as an unpin.
+static void tier_drop(edbp_shard *shard, edbp_slotid slotid, int used) {
+	edbp_slot *slot = edbp_slotof(shard, slotid);
+	tier_unlink(shard, slotid);
+	shard->tierc--;
+	slot->locks--;
+	if(slot->locks == 0) {
+		if(used) {
+			shard->pra->unlocked(shard, slotid);
+		} else if(shard->pra->unpin) {
+			shard->pra->unpin(shard, slotid);
+		}
+	}
+}
+
+// drops the least recently used tier slot that no handle has locked, depth
+// 2-3 pages first. If upper is 0 then depth 0-1 pages are left alone.
+// returns 0 if there wasn't one to drop.
+static int tier_evict(edbp_shard *shard, int upper) {
+	for(uint8_t level = EDBP_TIERLOWER; level >= EDBP_TIERUPPER; level--) {
+		if(level == EDBP_TIERUPPER && !upper) {
+			break;
+		}
+		edbp_slotid s = shard->tierv[level].tail;
+		while(s != -1 && edbp_slotof(shard, s)->locks != 1) {
+			s = edbp_slotof(shard, s)->tier_prev;
+		}
+		if(s != -1) {
+			tier_drop(shard, s, 0);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// gets the tier back down to tiermax (as best it can).
+static void tier_trim(edbp_shard *shard) {
+	while(shard->tierc > shard->tiermax && tier_evict(shard, 1));
+}
+
+// the slot was just fully unlocked (and the pra has seen it). If it's an
+// index page, it goes into the tier if there's room or a deeper page can
+// give up its place.
+static void tier_admit(edbp_shard *shard, edbp_slotid slotid) {
+	edbp_slot *slot = edbp_slotof(shard, slotid);
+	uint8_t level = tier_level(slot->pra_hints);
+	if(shard->tiermax == 0 || slot->id == 0 || level == 0) {
+		return;
+	}
+	if(shard->tierc >= shard->tiermax) {
+		// depth 0-1 pages never give up their place to a new one, they're
+		// as good as pinned.
+		if(shard->tierv[EDBP_TIERLOWER].tail == -1
+		   || !tier_evict(shard, 0)) {
+			return;
+		}
+	}
+	slot->locks = 1;
+	if(shard->pra->pin) shard->pra->pin(shard, slotid);
+	tier_pushhead(shard, slotid, level);
+	shard->tierc++;
+}
+
+// the compressed tier. See EDBP_CONFIG_ZPOOL and edbp_shard.zbucketv. All
+// of these require mutexpagelock.
+
+// the bucket the page id is in.
+static edbp_zpage **ztier_bucket(edbp_shard *shard, odb_pid id) {
+	return &shard->zbucketv[bucket_hash(shard->zbucket_mask, id)];
+}
+
+static edbp_zpage *ztier_find(edbp_shard *shard, odb_pid id) {
+	if(!shard->zcount) return 0;
+	edbp_zpage *z = *ztier_bucket(shard, id);
+	while(z && z->id != id) z = z->hnext;
+	return z;
+}
+
+// takes z out of the tier (without freeing it).
+static void ztier_unlink(edbp_shard *shard, edbp_zpage *z) {
+	edbp_zpage **p = ztier_bucket(shard, z->id);
+	while(*p != z) p = &(*p)->hnext;
+	*p = z->hnext;
+	if(z->newer) z->newer->older = z->older;
+	else shard->znewest = z->older;
+	if(z->older) z->older->newer = z->newer;
+	else shard->zoldest = z->newer;
+	shard->zcount--;
+	shard->zbytes -= sizeof(edbp_zpage) + z->size;
+}
+
+// frees the oldest pages until the tier fits in zmax.
+static void ztier_trim(edbp_shard *shard) {
+	while(shard->zoldest && shard->zbytes > shard->zmax) {
+		edbp_zpage *z = shard->zoldest;
+		ztier_unlink(shard, z);
+		free(z);
+	}
+}
+
+// puts z into the tier as the newest. Frees it instead if it'd never fit or
+// the hash table can't grow.
+static void ztier_put(edbp_shard *shard, edbp_zpage *z) {
+	if(sizeof(edbp_zpage) + z->size > shard->zmax) {
+		free(z);
+		return;
+	}
+	// keep the table at least as big as the pages in it.
+	if(shard->zcount >= shard->zbucket_mask || !shard->zbucketv) {
+		uint64_t bucketc = shard->zbucketv ? (shard->zbucket_mask + 1) * 2 : 64;
+		edbp_zpage **bucketv = calloc(bucketc, sizeof(edbp_zpage *));
+		if(bucketv == 0) {
+			free(z);
+			return;
+		}
+		for(uint64_t i = 0; shard->zbucketv && i <= shard->zbucket_mask; i++) {
+			for(edbp_zpage *n = shard->zbucketv[i], *next; n; n = next) {
+				next = n->hnext;
+				edbp_zpage **b = &bucketv[bucket_hash(bucketc - 1, n->id)];
+				n->hnext = *b;
+				*b = n;
+			}
+		}
+		free(shard->zbucketv);
+		shard->zbucketv = bucketv;
+		shard->zbucket_mask = bucketc - 1;
+	}
+	edbp_zpage **b = ztier_bucket(shard, z->id);
+	z->hnext = *b;
+	*b = z;
+	z->older = shard->znewest;
+	z->newer = 0;
+	if(shard->znewest) shard->znewest->newer = z;
+	else shard->zoldest = z;
+	shard->znewest = z;
+	shard->zcount++;
+	shard->zbytes += sizeof(edbp_zpage) + z->size;
+	ztier_trim(shard);
+}
+
+// empties the tier and frees its table.
+static void ztier_free(edbp_shard *shard) {
+	while(shard->zoldest) {
+		edbp_zpage *z = shard->zoldest;
+		ztier_unlink(shard, z);
+		free(z);
+	}
+	free(shard->zbucketv);
+	shard->zbucketv = 0;
+}
+
+// helper to lockpages and unlockpage: removes a lock from the slot and puts it
+// back into the pra's hands if it was the last one. Requires mutexpagelock.
+static void slot_release(edbp_shard *shard, edbp_slotid slotid) {
+	edbp_slot *slot = edbp_slotof(shard, slotid);
+	slot->locks--;
+	if(slot->tier && slot->locks == 1) {
+		// the last handle is done with a page in the tier: move it up (or
+		// out if its hints say its not an index page anymore).
+		uint8_t level = tier_level(slot->pra_hints);
+		if(level == 0) {
+			tier_drop(shard, slotid, 1);
+			return;
+		}
+		tier_unlink(shard, slotid);
+		tier_pushhead(shard, slotid, level);
+		return;
+	}
+	if(slot->locks == 0) {
+		shard->pra->unlocked(shard, slotid);
+		tier_admit(shard, slotid);
+	}
+}
+
+#ifdef EDB_OPT_CHECKSUMS
+// the checksum of the page. Never 0, a checksum of 0 is what pages that have
+// never been sealed have.
+static uint32_t page_checksum(const void *page, unsigned int pagesize) {
+	// skip the checksum itself.
+	size_t off = sizeof(((_odb_stdhead *)0)->_checksum);
+	uint32_t sum = edbp_crc32c(0, page + off, pagesize - off);
+	return sum ? sum : 1;
+}
+#endif
+
+// helper to page_writeout: called on a page that was dirty before it's
+// written out.
+static void page_seal(void *page, unsigned int pagesize) {
+	// recalculate checksum only when the page has been marked
+	// as dirty.
+#ifdef EDB_OPT_CHECKSUMS
+	_odb_stdhead *head = (_odb_stdhead *)(page);
+	head->_checksum = page_checksum(page, pagesize);
+#endif
+
+	// later: encrypt the body if page is supposed to be encrypted.
+}
+
+// helper to swapin: checks the checksum of a page that was just loaded into
+// the shard's slot (if cache->verify says to).
+//
+// returns ODB_ECRIT if the page is corrupt.
+static odb_err page_verify(edbpcache_t *cache, edbp_shard *shard,
+                           edbp_slot *slot, odb_pid id) {
+#ifdef EDB_OPT_CHECKSUMS
+	switch(cache->verify) {
+		case EDBP_VERIFY_OFF:
+			return 0;
+		case EDBP_VERIFY_SAMPLED:
+			if(__atomic_fetch_add(&shard->verifyc, 1, __ATOMIC_RELAXED)
+			   % EDBP_VERIFYSAMPLE) {
+				return 0;
+			}
+			break;
+		default:
+			break;
+	}
+	unsigned int pagesize = edbd_size(cache->fd);
+	const _odb_stdhead *head = (const _odb_stdhead *)(slot->page);
+	if(head->_checksum == 0) {
+		// never been sealed.
+		return 0;
+	}
+	uint32_t sum = page_checksum(slot->page, pagesize);
+	if(sum != head->_checksum) {
+		telemetry_pages_corrupt(id);
+		return log_critf("page %ld failed its checksum (%08x, expected %08x)",
+		                 id, sum, head->_checksum);
+	}
+#endif
+	return 0;
+}
+
+// helpers to keep the shard's dirtyc right. slot_dirty returns 1 if the
+// slot wasn't dirty before, slot_clean returns 1 if it was.
+static int slot_dirty(edbp_shard *shard, edbp_slot *slot) {
+	if(__atomic_exchange_n(&slot->dirty, 1, __ATOMIC_ACQ_REL)) {
+		return 0;
+	}
+	__atomic_fetch_add(&shard->dirtyc, 1, __ATOMIC_RELAXED);
+	return 1;
+}
+static int slot_clean(edbp_shard *shard, edbp_slot *slot) {
+	if(!__atomic_exchange_n(&slot->dirty, 0, __ATOMIC_ACQ_REL)) {
+		return 0;
+	}
+	__atomic_fetch_sub(&shard->dirtyc, 1, __ATOMIC_RELAXED);
+	return 1;
+}
+
+// helper to evict, shard_free and the writeback thread: seals the slot's
+// page (id) and writes it out to the file. Does not touch slot->dirty.
+//
+// returns ODB_ECRIT if the page failed to be written (arena mode).
+static odb_err page_writeout(edbpcache_t *cache, edbp_slot *slot, odb_pid id) {
+	unsigned int pagesize = edbd_size(cache->fd);
+	page_seal(slot->page, pagesize);
+	if(!cache->arena) {
+		// even though its a no-op on linux. Lets be a good boy and
+		// explicitly call MS_ASYNC.
+		msync(slot->page, pagesize, MS_ASYNC);
+		return 0;
+	}
+	for(unsigned int done = 0; done < pagesize;) {
+		ssize_t n = pwrite64(cache->fd->descriptor, slot->page + done,
+		                     pagesize - done,
+		                     edbd_pid2off(cache->fd, id) + done);
+		if(n == -1) {
+			if(errno == EINTR) continue;
+			return log_critf("failed to write back page %ld", id);
+		}
+		done += n;
+	}
+	return 0;
+}
+
+static odb_err shard_shrinkstep(edbpcache_t *cache, edbp_shard *shard);
+
+// a page that lockpages has pinned. If fault is 1 then the page wasn't in the
+// cache and a slot was claimed for it, thus it must go through swapin.
+typedef struct {
+	edbp_shard  *shard;
+	edbp_slotid  slotid;
+	odb_pid      id;
+
+	int          fault;
+	odb_pid      oldid; // what was in the slot before, 0 if empty.
+	int          writeback; // see claimpage
+	edbp_slotid *pin; // where the handle has this slot pinned.
+
+	// see EDBP_CONFIG_ZPOOL. z is the page (id) out of the compressed tier.
+	// If zwant is set then oldid goes into it, zput is it compressed (see
+	// swapdone).
+	edbp_zpage  *z;
+	int          zwant;
+	edbp_zpage  *zput;
+} edbp_swap;
+
+// helper to lockpages: pins the page id into a slot of its shard, filling out
+// o_swap.
+//
+// If the page is not in the cache, a slot is claimed for it and marked as
+// undergoing a swap (o_swap->fault is set) and the caller must finish that
+// with swapin. If the page is in the cache, it may still be undergoing a
+// swap by someone else (see lockpages).
+//
+// ERRORS:
+//   ODB_EAGAIN - the page is still being written back out of
+//                o_swap->slotid in arena mode. Nothing is pinned, wait for
+//                that slot's swap to finish and try again.
+//   ODB_ECRIT - every slot is locked.
+static odb_err claimpage(edbpcache_t *cache, odb_pid id, edbp_swap *o_swap) {
+	edbp_shard *shard = edbp_shardof(cache, id);
+	o_swap->shard = shard;
+	o_swap->id = id;
+	o_swap->fault = 0;
+	o_swap->z = 0;
+	o_swap->zwant = 0;
+	o_swap->zput = 0;
+
+	// lock the shard's page mutex until we have our slot locked.
+	pthread_mutex_lock(&shard->mutexpagelock);
+	shard->opcoutner++; // increase the op counter
+	int shrunk = 0;
+
+	// see if we have the page loaded already.
+	lookup:;
+	edbp_slotid mslot = bucket_find(shard, id);
+	if(mslot != -1) {
+		edbp_slot *slot = edbp_slotof(shard, mslot);
+		o_swap->slotid = mslot;
+
+		if(slot->id != id) {
+			pthread_mutex_unlock(&shard->mutexpagelock);
+			return ODB_EAGAIN;
+		}
+
+		// we found our page in the cache. Add a lock so it doesn't deload
+		slot->locks++;
+		slot->gen++;
+		shard->pra->hit(shard, mslot);
+		// quickly unlock the mutex because that's all we need to use it for.
+		pthread_mutex_unlock(&shard->mutexpagelock);
+		return 0;
+	}
+
+	// At this point: Page fault.
+
+	// if the shard is shrinking, give up a slot first (see shard_resize).
+	// That lets go of the mutex, so someone may have loaded the page in
+	// the mean time.
+	if(!shrunk && shard->slot_count > shard->slot_target) {
+		shrunk = 1;
+		if(shard_shrinkstep(cache, shard) != ODB_EAGAIN) {
+			goto lookup;
+		}
+	}
+
+	// The slot to swap out is whatever the pra says.
+	//
+	// Note that there should never be a circumstance where all slots are
+	// locked because every shard has at least straitmax slots per handle
+	// and each handle can only pin straitmax pages at a time. (The index
+	// tier gives slots back when it has to)
+	edbp_slotid slotswap = shard->pra->fault(shard, id);
+	while(slotswap == -1 && tier_evict(shard, 1)) {
+		// the index tier is taking up the slots the handles need.
+		slotswap = shard->pra->fault(shard, id);
+	}
+	if(slotswap == -1) {
+		pthread_mutex_unlock(&shard->mutexpagelock);
+		log_critf("page fault with every slot locked");
+		return ODB_ECRIT;
+	}
+
+	edbp_slot *slot = edbp_slotof(shard, slotswap);
+	odb_pid oldid = slot->id;
+	// a dirty page has to stay findable until it's written back (or in mmap
+	// mode, sealed): otherwise someone could go and read it from the file
+	// before then and find the old checksum. They'll find this slot with a
+	// different id and wait.
+	//
+	// Same goes for a clean page going into the compressed tier, otherwise
+	// someone could load it, change it and write it out before the old copy
+	// goes into the tier.
+	int zwant = oldid != 0 && !slot->dirty && shard->zmax;
+	int writeback = oldid != 0 && (slot->dirty || zwant);
+	if(oldid != 0 && !writeback) {
+		bucket_delete(shard, oldid);
+	}
+	// the page might be in the compressed tier. (If so, its ours now)
+	edbp_zpage *z = ztier_find(shard, id);
+	if(z) {
+		ztier_unlink(shard, z);
+	}
+	bucket_insert(shard, id, slotswap);
+	slot->locks = 1;
+	slot->gen++;
+	// assign the new id
+	slot->id = id;
+	// with the lock field set we can unlock the mutex and perform the
+	// rest of our work in peace. Even though we didn't do the swap yet,
+	// we're not going to slow everyone else down by keeping this page mutex
+	// locked. So we set the futex_swap to 1 which will stop any subseqnet
+	// locks from returning until the swap is complete.
+	slot->futex_swap = 1;
+	pthread_mutex_unlock(&shard->mutexpagelock);
+
+	o_swap->slotid = slotswap;
+	o_swap->fault = 1;
+	o_swap->oldid = oldid;
+	o_swap->writeback = writeback;
+	o_swap->z = z;
+	o_swap->zwant = zwant;
+	return 0;
+}
+
+// helper to swapin: gets oldid (0 if the slot was empty) out of the slot.
+// If the page is still dirty (the writeback thread didn't get to it) it's
+// written out here.
+//
+// returns ODB_ECRIT if a dirty page failed to be written back (arena mode)
+static odb_err evict(edbpcache_t *cache, edbp_shard *shard, edbp_slot *slot,
+                     odb_pid oldid) {
+	unsigned int pagesize = edbd_size(cache->fd);
+	odb_err err = 0;
+
+	if(cache->arena ? oldid == 0 : slot->page == 0) {
+		// (if there was antyhing there)
+		return 0;
+	}
+	if(slot->dirty) {
+		// atp: in arena mode, if this fails the changes to oldid are lost,
+		// nothing we can do about it at this point but log it.
+		err = page_writeout(cache, slot, oldid);
+	}
+	if(!cache->arena) {
+		// do the actual unmap
+		munmap(slot->page, pagesize);
+		slot->page = 0;
+	}
+
+	// reset the slot hints
+	slot->pra_hints = 0;
+	slot_clean(shard, slot);
+	telemetry_pages_decached(oldid);
+	return err;
+}
+
+// helper to swapin: loads the pages of swapv (which are consecutive ids) into
+// their slots with a single mmap (or preadv in arena mode).
+//
+// returns ODB_ENOMEM or ODB_ECRIT
+static odb_err loadrun(edbpcache_t *cache, edbp_swap *swapv, int swapc) {
+	unsigned int pagesize = edbd_size(cache->fd);
+	int fd = cache->fd->descriptor;
+	off64_t off = edbd_pid2off(cache->fd, swapv[0].id);
+
+	if(!cache->arena) {
+		// note that they'll each be munmap'd one at a time.
+		void *pages = mmap64(0, (size_t)pagesize * swapc,
+		                     PROT_READ | PROT_WRITE,
+		                     MAP_SHARED, fd, off);
+		if(pages == MAP_FAILED) {
+			if(errno == ENOMEM) {
+				return ODB_ENOMEM;
+			}
+			return log_critf("failed to map page(s) into slot");
+		}
+		for(int i = 0; i < swapc; i++) {
+			edbp_slotof(swapv[i].shard, swapv[i].slotid)->page
+					= pages + (size_t)i * pagesize;
+		}
+		return 0;
+	}
+
+	struct iovec iov[EDBP_STRAITMAX];
+	for(int i = 0; i < swapc; i++) {
+		iov[i].iov_base = edbp_slotof(swapv[i].shard, swapv[i].slotid)->page;
+		iov[i].iov_len = pagesize;
+	}
+	struct iovec *iovp = iov;
+	int iovc = swapc;
+	while(iovc) {
+		ssize_t n = preadv64(fd, iovp, iovc, off);
+		if(n == -1 && errno == EINTR) {
+			continue;
+		}
+		if(n <= 0) {
+			return log_critf("failed to read page(s) %ld-%ld into slot",
+			                 swapv[0].id, swapv[swapc-1].id);
+		}
+		// short read, move up the iovecs.
+		off += n;
+		while(iovc && n >= iovp->iov_len) {
+			n -= iovp->iov_len;
+			iovp++;
+			iovc--;
+		}
+		if(iovc) {
+			iovp->iov_base += n;
+			iovp->iov_len -= n;
+		}
+	}
+	return 0;
+}
+
+// helper to swapin: marks the swap as done (or failed if err is not 0) and
+// wakes up anyone waiting on it. A failed swap is unpinned and its pin is set
+// to -1.
+static void swapdone(edbp_swap *swap, odb_err err) {
+	edbp_shard *shard = swap->shard;
+	edbp_slot *slot = edbp_slotof(shard, swap->slotid);
+	free(swap->z);
+
+	if(err) {
+		free(swap->zput);
+		pthread_mutex_lock(&shard->mutexpagelock);
+		// forget about the page so the next one to ask for it tries again
+		// rather than finding this failed slot.
+		bucket_delete(shard, swap->id);
+		if(swap->writeback) {
+			bucket_delete(shard, swap->oldid);
+		}
+		slot->id = 0;
+		slot_clean(shard, slot);
+		// handle nomem.
+		if(err == ODB_ENOMEM) {
+			slot->futex_swap = 3;
+		} else {
+			slot->futex_swap = 2;
+		}
+		syscall(SYS_futex, &slot->futex_swap, FUTEX_WAKE, INT_MAX, 0, 0, 0);
+		slot_release(shard, swap->slotid);
+		pthread_mutex_unlock(&shard->mutexpagelock);
+		*swap->pin = -1;
+		return;
+	}
+
+	if(swap->writeback) {
+		pthread_mutex_lock(&shard->mutexpagelock);
+		bucket_delete(shard, swap->oldid);
+		// (at the same time, so nobody could've loaded it in between)
+		if(swap->zput) {
+			ztier_put(shard, swap->zput);
+		}
+		pthread_mutex_unlock(&shard->mutexpagelock);
+	}
+
+	// swap is complete. let the futex know the page is loaded in now
+	slot->futex_swap = 0;
+	syscall(SYS_futex, &slot->futex_swap, FUTEX_WAKE, INT_MAX, 0, 0, 0);
+	telemetry_pages_cached(slot->id);
+}
+
+// adds n to one of the handle's counters. See edbp_stats.
+static inline void stats_add(uint64_t *counter, uint64_t n) {
+	__atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + n,
+	                 __ATOMIC_RELAXED);
+}
+
+static uint64_t stats_now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// counts a fault that started at stats_now() = since into the latency
+// histogram. See odbtelem_cachestats.faultlatencyv.
+static void stats_fault(edbp_stats *stats, uint64_t since) {
+	uint64_t usec = (stats_now() - since) / 1000;
+	int b = usec ? 64 - __builtin_clzll(usec) : 0;
+	if(b >= ODBTELEM_LATENCYC) b = ODBTELEM_LATENCYC - 1;
+	stats_add(&stats->faultlatencyv[b], 1);
+}
+
+// helper to swapin: compresses oldid's page for the compressed tier.
 //
-// returns only critical errors
+// returns null if it doesn't compress down to EDBP_ZRATIO (or no memory).
+static edbp_zpage *zcompress(const edbpcache_t *cache, const void *page,
+                             odb_pid id, edbp_stats *stats) {
+	unsigned int pagesize = edbd_size(cache->fd);
+	size_t max = (size_t)(pagesize * EDBP_ZRATIO);
+	edbp_zpage *z = malloc(sizeof(edbp_zpage) + max);
+	if(z == 0) {
+		return 0;
+	}
+	z->size = edbp_lz_compress(page, pagesize, z->data, max);
+	if(z->size == 0) {
+		free(z);
+		return 0;
+	}
+	edbp_zpage *shrunk = realloc(z, sizeof(edbp_zpage) + z->size);
+	if(shrunk) z = shrunk;
+	z->id = id;
+	stats_add(&stats->zstores, 1);
+	stats_add(&stats->zrawbytes, pagesize);
+	stats_add(&stats->zbytes, z->size);
+	return z;
+}
+
+// helper to swapin: decompresses swap->z into the slot instead of loading
+// the page from the file.
+//
+// returns 0 if the compressed page was corrupted (and frees it), the page
+// has to come from the file then.
+static int zload(const edbpcache_t *cache, edbp_swap *swap,
+                 edbp_stats *stats) {
+	uint64_t start = stats_now();
+	edbp_slot *slot = edbp_slotof(swap->shard, swap->slotid);
+	if(edbp_lz_decompress(swap->z->data, swap->z->size, slot->page,
+	                      edbd_size(cache->fd))) {
+		log_errorf("page %ld in the compressed tier was corrupted, loading "
+		           "it from the file instead", swap->id);
+		free(swap->z);
+		swap->z = 0;
+		return 0;
+	}
+	stats_add(&stats->zhits, 1);
+	stats_add(&stats->zdecompressns, stats_now() - start);
+	return 1;
+}
+
+// helper to lockpages: finishes all the swaps that claimpage started. Runs of
+// consecutive page ids are loaded in with a single call. Every swap is done
+// (one way or another) by the time this returns.
 //
-// todo: update documentation to reflect signature
+// returns the first error (ODB_ENOMEM or ODB_ECRIT).
+static odb_err swapin(edbpcache_t *cache, edbp_swap *swapv, int swapc,
+                      edbp_stats *stats) {
+	odb_err ret = 0;
+	for(int i = 0; i < swapc;) {
+		// (pages out of the compressed tier are done on their own)
+		int runc = 1;
+		while(!swapv[i].z && i + runc < swapc && !swapv[i + runc].z
+		      && swapv[i + runc].id == swapv[i].id + runc) {
+			runc++;
+		}
+
+		// perform the actual swap.
+		odb_err err = 0;
+		for(int j = i; j < i + runc; j++) {
+			edbp_slot *slot = edbp_slotof(swapv[j].shard, swapv[j].slotid);
+			if(slot->dirty) {
+				stats_add(&stats->dirtyevictions, 1);
+			}
+			if(swapv[j].zwant) {
+				swapv[j].zput = zcompress(cache, slot->page, swapv[j].oldid,
+				                          stats);
+			}
+			odb_err e = evict(cache, swapv[j].shard, slot, swapv[j].oldid);
+			if(e && !err) err = e;
+		}
+		if(!err && !(swapv[i].z && zload(cache, &swapv[i], stats))) {
+			err = loadrun(cache, &swapv[i], runc);
+		}
+		int eno = errno;
+		for(int j = i; j < i + runc; j++) {
+			odb_err e = err;
+			// (pages from the compressed tier were checked when they were
+			// loaded in the first time)
+			if(!e && !swapv[j].z) {
+				e = page_verify(cache, swapv[j].shard,
+				                edbp_slotof(swapv[j].shard, swapv[j].slotid),
+				                swapv[j].id);
+			}
+			swapdone(&swapv[j], e);
+			if(e && !ret) ret = e;
+		}
+		errno = eno;
+		i += runc;
+	}
+	return ret;
+}
+
+// gets the pagec pages starting at id from either the cache or the file and
+// pins them into the handle's lockedslotv/lockedshardv.
+//
+// Pages that have to be faulted in are claimed first and then loaded all at
+// once (see swapin). We never wait on anyone else's swap with a swap of our
+// own still pending, so two handles can't end up waiting on each other.
+//
+// returns only critical errors. If an error is returned, nothing is left
+// locked.
 static odb_err lockpages(edbpcache_t *cache,
                          odb_pid starting,
+                         int pagec,
                          edbphandle_t *h) {
-	// quick vars
-	edbp_slotid *o_pageslots = &h->lockedslotv;
-	int fd = cache->fd->descriptor;
+	edbp_swap swapv[EDBP_STRAITMAX];
+	int swapc = 0;
+	odb_err err;
+	edbp_stats *stats = &h->stats;
+	uint64_t faultstart = 0; // stats_now() at the first fault
+
+	h->lockedslotc = 0;
+	for(int i = 0; i < pagec;) {
+		edbp_swap c;
+		err = claimpage(cache, starting + i, &c);
+		if(err == ODB_EAGAIN) {
+			// (arena mode) the page is still being written back out of a
+			// slot to make room for another. Wait for that to finish and
+			// then we can read it in from the file. But first, finish our
+			// own swaps: whoever we're waiting on may be waiting on us.
+			if(swapc) {
+				err = swapin(cache, swapv, swapc, stats);
+				swapc = 0;
+				if(err) goto fail;
+			}
+			stats_add(&stats->swapwaits, 1);
+			edbp_slot *busy = edbp_slotof(c.shard, c.slotid);
+			syscall(SYS_futex, &busy->futex_swap, FUTEX_WAIT, 1, 0, 0, 0);
+			errno = 0;
+			continue;
+		}
+		if(err) goto fail;
+		h->lockedshardv[i] = c.shard;
+		h->lockedslotv[i] = c.slotid;
+		h->lockedslotc = i + 1;
+		if(c.fault) {
+			if(!faultstart) faultstart = stats_now();
+			stats_add(&stats->misses, 1);
+			c.pin = &h->lockedslotv[i];
+			swapv[swapc++] = c;
+		} else {
+			stats_add(&stats->hits, 1);
+		}
+		i++;
+	}
+	if(swapc) {
+		err = swapin(cache, swapv, swapc, stats);
+		if(err) goto fail;
+	}
+
+	// before we return: in the case that any of the pages were undergoing a
+	// swap by someone else we'll wait for them here.
+	for(int i = 0; i < pagec; i++) {
+		edbp_slot *slot = edbp_slotof(h->lockedshardv[i], h->lockedslotv[i]);
+		if(slot->futex_swap == 1) {
+			stats_add(&stats->swapwaits, 1);
+		}
+		while(slot->futex_swap == 1) {
+			syscall(SYS_futex, &slot->futex_swap, FUTEX_WAIT, 1, 0, 0, 0);
+		}
+		errno = 0;
+
+		// if the swap failed for whatever reason, we'll casecade fail. Sure we can try
+		// to do the swap again, but frankly if we're out of memory then we're out of memory.
+		switch (slot->futex_swap) {
+			case 3:
+				err = ODB_ENOMEM;
+				goto fail;
+			case 2:
+				log_critf("fail-cascading because waiting on swap to finish had failed");
+				err = ODB_ECRIT;
+				goto fail;
+			default:
+				break;
+		}
+	}
+	if(faultstart) {
+		stats_fault(stats, faultstart);
+	}
+	return 0;
+
+	fail:
+	for(int i = 0; i < h->lockedslotc; i++) {
+		if(h->lockedslotv[i] == -1) continue;
+		edbp_shard *shard = h->lockedshardv[i];
+		pthread_mutex_lock(&shard->mutexpagelock);
+		slot_release(shard, h->lockedslotv[i]);
+		pthread_mutex_unlock(&shard->mutexpagelock);
+	}
+	h->lockedslotc = 0;
+	return err;
+}
+
+// removes the lock the handle has on the slot. Once it's fully unlocked the
+// pra gets to see its pra_hints.
+//
+// if the slot is already unlocked, nothing happens (logs will tho)
+// will only ever return critical errors.
+void static unlockpage(edbp_shard *shard, edbp_slotid slotid) {
+	edbp_slot *slot = edbp_slotof(shard, slotid);
+
+	pthread_mutex_lock(&shard->mutexpagelock);
+	if(slot->locks == 0) {
+		// they're trying to unlock a page thats already unlocked.
+		// return early.
+		log_debugf("attempted to unlock a cache slot that was already completely unlocked (slot %d)", slot->locks);
+		goto unlock;
+	}
+
+	// decrement the locknum.
+	slot_release(shard, slotid);
+
+	// clean up
+	unlock:
+	pthread_mutex_unlock(&shard->mutexpagelock);
+}
+
+// the most dirty slots the shard can have before the writeback thread will
+// start cleaning them.
+static edbp_slotid shard_dirtymax(const edbpcache_t *cache,
+                                  const edbp_shard *shard) {
+	return (uint64_t)shard->slot_count * cache->dirtyratio / 100;
+}
+
+// helper to edbp_mod: marks the slot dirty and wakes up the writeback thread
+// if the shard is over the dirty ratio. (signaling the thread when its
+// already awake is cheap)
+static void page_dirtied(edbpcache_t *cache, edbp_shard *shard,
+                         edbp_slot *slot) {
+	if(slot_dirty(shard, slot) && cache->dirtyratio
+	   && __atomic_load_n(&shard->dirtyc, __ATOMIC_RELAXED)
+	      > shard_dirtymax(cache, shard)) {
+		pthread_cond_signal(&cache->wbcond);
+	}
+}
+
+// helper to writeback_main: cleans the shard's coldest dirty slots until
+// it's back under the dirty ratio.
+//
+// The slots are pinned while they're being written out so they can't be
+// swapped, but handles can still lock them. If one did (the slot's gen
+// changed) then the page may have been modified during the write so it stays
+// dirty.
+static void writeback_shard(edbpcache_t *cache, edbp_shard *shard) {
+	edbp_slotid dirtymax = shard_dirtymax(cache, shard);
+	while(__atomic_load_n(&shard->dirtyc, __ATOMIC_RELAXED) > dirtymax) {
+		edbp_slotid  slotv[EDBP_WBBATCH];
+		unsigned int genv[EDBP_WBBATCH];
+		odb_err      errv[EDBP_WBBATCH];
+
+		pthread_mutex_lock(&shard->mutexpagelock);
+		int slotc = shard->pra->cold(shard, slotv, EDBP_WBBATCH);
+		for(int i = 0; i < slotc; i++) {
+			edbp_slot *slot = edbp_slotof(shard, slotv[i]);
+			slot->locks++;
+			if(shard->pra->pin) shard->pra->pin(shard, slotv[i]);
+			genv[i] = slot->gen;
+		}
+		pthread_mutex_unlock(&shard->mutexpagelock);
+		if(slotc == 0) {
+			// everything dirty is locked or too hot, get it next time.
+			return;
+		}
+
+		for(int i = 0; i < slotc; i++) {
+			edbp_slot *slot = edbp_slotof(shard, slotv[i]);
+			errv[i] = page_writeout(cache, slot, slot->id);
+		}
+
+		int cleaned = 0;
+		pthread_mutex_lock(&shard->mutexpagelock);
+		for(int i = 0; i < slotc; i++) {
+			edbp_slot *slot = edbp_slotof(shard, slotv[i]);
+			if(!errv[i] && slot->gen == genv[i]) {
+				cleaned += slot_clean(shard, slot);
+			}
+			slot->locks--;
+			if(slot->locks == 0 && shard->pra->unpin) {
+				shard->pra->unpin(shard, slotv[i]);
+			}
+		}
+		pthread_mutex_unlock(&shard->mutexpagelock);
+		if(cleaned == 0) {
+			return;
+		}
+	}
+}
+
+static void *writeback_main(void *arg) {
+	edbpcache_t *cache = arg;
+	pthread_mutex_lock(&cache->wbmutex);
+	while(cache->dirtyratio) {
+		for(unsigned int i = 0; cache->shardv && i < cache->shardc; i++) {
+			writeback_shard(cache, &cache->shardv[i]);
+		}
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_nsec += (long)EDBP_WBINTERVAL * 1000000;
+		ts.tv_sec  += ts.tv_nsec / 1000000000;
+		ts.tv_nsec %= 1000000000;
+		pthread_cond_timedwait(&cache->wbcond, &cache->wbmutex, &ts);
+	}
+	pthread_mutex_unlock(&cache->wbmutex);
+	return 0;
+}
+
+// sets the dirty ratio, starting or stopping the writeback thread if need
+// be.
+static odb_err writeback_config(edbpcache_t *cache, unsigned int ratio) {
+	pthread_mutex_lock(&cache->wbmutex);
+	cache->dirtyratio = ratio;
+	pthread_cond_signal(&cache->wbcond);
+	pthread_mutex_unlock(&cache->wbmutex);
+
+	if(ratio && !cache->wbrunning) {
+		int err = pthread_create(&cache->wbthread, 0, writeback_main, cache);
+		if(err) {
+			cache->dirtyratio = 0;
+			return log_critf("failed to create writeback thread pthread_create(3) returned: %d", err);
+		}
+		cache->wbrunning = 1;
+	} else if(!ratio && cache->wbrunning) {
+		int err = pthread_join(cache->wbthread, 0);
+		if(err) {
+			log_critf("pthread_join(3) returned error: %d", err);
+		}
+		cache->wbrunning = 0;
+	}
+	return 0;
+}
+
+// helper to shard_reserve: allocates an arena for at least size bytes.
+static odb_err arena_alloc(unsigned int arena, size_t size,
+                           void **o_arenav, size_t *o_arenasize) {
+	void *arenav = MAP_FAILED;
+	if(arena == EDBP_ARENA_HUGE) {
+		// round up to the (default) huge page size.
+		size = (size + EDBP_HUGEPAGESIZE - 1) & ~(size_t)(EDBP_HUGEPAGESIZE - 1);
+		arenav = mmap64(0, size, PROT_READ | PROT_WRITE,
+		                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if(arenav == MAP_FAILED) {
+			// no huge pages reserved. Ask for transparent ones instead.
+			log_noticef("no huge pages available for the page cache arena, "
+			            "using regular pages");
+		}
+	}
+	if(arenav == MAP_FAILED) {
+		arenav = mmap64(0, size, PROT_READ | PROT_WRITE,
+		                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(arenav == MAP_FAILED) {
+			if(errno == ENOMEM)
+				return ODB_ENOMEM;
+			return log_critf("failed to mmap page cache arena");
+		}
+		if(arena == EDBP_ARENA_HUGE) {
+			madvise(arenav, size, MADV_HUGEPAGE);
+		}
+	}
+	*o_arenav = arenav;
+	*o_arenasize = size;
+	return 0;
+}
+
+// helper to edbp_cache_init: fills out the cache's nodemask and nodec with
+// the online NUMA nodes (from sysfs, "0-1,3" and so on). Without NUMA that's
+// just node 0.
+static void numa_nodes(edbpcache_t *cache) {
+	cache->nodemask = 1;
+	cache->nodec = 1;
+	char buf[256];
+	int fd = open("/sys/devices/system/node/online", O_RDONLY);
+	if(fd == -1) {
+		return;
+	}
+	ssize_t n = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if(n <= 0) {
+		return;
+	}
+	buf[n] = 0;
+	uint64_t mask = 0;
+	char *s = buf;
+	while(*s >= '0' && *s <= '9') {
+		unsigned long from = strtoul(s, &s, 10), to = from;
+		if(*s == '-') {
+			to = strtoul(s + 1, &s, 10);
+		}
+		for(unsigned long i = from; i <= to && i < EDBP_NUMAMAX; i++) {
+			mask |= (uint64_t)1 << i;
+		}
+		if(*s == ',') s++;
+	}
+	if(mask) {
+		cache->nodemask = mask;
+		cache->nodec = __builtin_popcountll(mask);
+	}
+}
+
+// helper to shards_alloc: the node that the i'th shard is kept on, -1 if
+// its not kept on one.
+static int numa_shardnode(const edbpcache_t *cache, unsigned int i) {
+	if(cache->numa != EDBP_NUMA_LOCAL || cache->nodec < 2) {
+		return -1;
+	}
+	// the (i % nodec)'th node in the mask.
+	uint64_t mask = cache->nodemask;
+	for(unsigned int n = i % cache->nodec; n; n--) {
+		mask &= mask - 1;
+	}
+	return __builtin_ctzll(mask);
+}
+
+// helper to shard_reserve: sets the memory policy of a freshly mapped (and
+// untouched) arena as per EDBP_CONFIG_NUMA. The pages will be put on the
+// right node(s) when they're first touched.
+static void arena_bind(const edbpcache_t *cache, const edbp_shard *shard,
+                       void *arenav, size_t size) {
+	uint64_t mask;
+	int mode;
+	if(shard->node != -1) {
+		// preferred rather than bound so that a node running out of
+		// memory just means remote pages instead of the oom killer.
+		mode = MPOL_PREFERRED;
+		mask = (uint64_t)1 << shard->node;
+	} else if(cache->numa == EDBP_NUMA_INTERLEAVE && cache->nodec > 1) {
+		mode = MPOL_INTERLEAVE;
+		mask = cache->nodemask;
+	} else {
+		return;
+	}
+	if(syscall(SYS_mbind, arenav, size, mode, &mask, EDBP_NUMAMAX + 1, 0)) {
+		// not fatal, the pages just end up wherever.
+		log_noticef("mbind(2) on the page cache arena failed, errno %d",
+		            errno);
+	}
+}
+
+// frees the chunks of the shard that only have slots from slotc onward
+// (and their arenas). None of those slots can have anything in them.
+static void shard_release(edbp_shard *shard, edbp_slotid slotc) {
+	for(unsigned int k = shard->slotchunkc;
+	    k > 0 && edbp_slotchunkstart(k - 1) >= slotc; k--) {
+		if(shard->arenav[k - 1]) {
+			munmap(shard->arenav[k - 1], shard->arenasizev[k - 1]);
+			shard->arenav[k - 1] = 0;
+		}
+	}
+	edbp_slots_release(shard, slotc);
+}
+
+// makes sure the shard has slots for slotc slots (with their pages if
+// arena isn't EDBP_ARENA_OFF) and a hash table big enough for them. The
+// hash table is sized for all the slots in the chunks so this rarely has to
+// rehash. Requires mutexpagelock once the shard is in use.
+//
+// returns ODB_ENOMEM or ODB_ECRIT
+static odb_err shard_reserve(const edbpcache_t *cache, unsigned int arena,
+                             edbp_shard *shard, edbp_slotid slotc) {
 	unsigned int pagesize = edbd_size(cache->fd);
+	unsigned int chunkc = shard->slotchunkc;
+	odb_err err = edbp_slots_reserve(shard, slotc);
+	if(err) {
+		return err;
+	}
+	if(arena != EDBP_ARENA_OFF) {
+		for(unsigned int k = chunkc; k < shard->slotchunkc; k++) {
+			edbp_slotid c = EDBP_SLOTCHUNK << k;
+			err = arena_alloc(arena, (size_t)c * pagesize,
+			                  &shard->arenav[k], &shard->arenasizev[k]);
+			if(err) {
+				shard->arenav[k] = 0;
+				shard_release(shard, edbp_slotchunkstart(k));
+				return err;
+			}
+			arena_bind(cache, shard, shard->arenav[k], shard->arenasizev[k]);
+			for(edbp_slotid i = 0; i < c; i++) {
+				shard->slotchunkv[k][i].page = shard->arenav[k]
+				                               + (size_t)i * pagesize;
+			}
+		}
+	}
 
-	// we need to get smart here...
-	// Theres a chance that some of our pages in our desired array are loaded and
-	// others are not. So we have to make sure we fault the missing ones while
-	// also taking advantage of loading them with minimum IO ops (mmap).
-	//
-	// ALL WHILE we do not over engineer this function to the point where
-	// it would be more efficient to be dumb about this whole process.
+	// the hash table needs to be a power of 2 and at least 4 times the slots:
+	// a slot can have 2 ids in the table while it's being written back (see
+	// lockpages) and the table can never be full.
+	uint64_t bucketc = 4;
+	while(bucketc < (uint64_t)edbp_slotchunkstart(shard->slotchunkc) * 4) {
+		bucketc <<= 1;
+	}
+	if(shard->bucketv && bucketc <= shard->bucket_mask + 1) {
+		return 0;
+	}
+	edbp_bucket *bucketv = malloc(sizeof(edbp_bucket) * bucketc);
+	if(bucketv == 0) {
+		// (the chunks can stay)
+		if(errno == ENOMEM)
+			return ODB_ENOMEM;
+		return log_critf("malloc");
+	}
+	bzero(bucketv, sizeof(edbp_bucket) * bucketc);
+	for(uint64_t i = 0; shard->bucketv && i <= shard->bucket_mask; i++) {
+		if(shard->bucketv[i].id) {
+			edbp_bucket_insert(bucketv, bucketc - 1, shard->bucketv[i].id,
+			                   shard->bucketv[i].slot);
+		}
+	}
+	free(shard->bucketv);
+	shard->bucketv = bucketv;
+	shard->bucket_mask = bucketc - 1;
+	return 0;
+}
 
-	// if we have a page fault this is the index of the slot we must replace
-	// These will be fully set after the for loop.
-	//
-	// Note that there should
-	// never be a circumstance where all slots are locked to which the
-	// for loop cannot find a possible replacement because the number of
-	// slots will always be equal or more than the number of workers and
-	// each worker can only lock a slot at a time. Thus, all workers will
-	// always have call this function with 1 page unlocked.
-	unsigned int slotswap;
-	unsigned int lowestscore = (unsigned int)(-1);
-
-	// lock the page mutex until we have our slot locked.
-	pthread_mutex_lock(&cache->mutexpagelock);
-	cache->opcoutner++; // increase the op counter
-
-	// lets loop through our cache and see if we have any of these pages loaded already.
-	// We can also take this time to find what pages we can likely replace.
-	for(unsigned int i = 0; i < cache->slot_count; i++) {
-		unsigned int mslot = (cache->slot_nextstart + i) % cache->slot_count;
-		edbp_slot *slot = &cache->slots[mslot];
-
-		if(slot->id != starting) {
-			// not the page we're looking for.
-			// but sense we're here, lets find do some calculations on which page to
-			// replace on the cance of a page fault.
-			if(slot->locks == 0 && slot->pra_score < lowestscore) {
-				lowestscore = slot->pra_score;
-				slotswap = mslot;
+// sets the shard's tiermax from cache->indextier, and gets the tier down to
+// it if its over. Requires mutexpagelock once the shard is in use.
+static void shard_tierconfig(const edbpcache_t *cache, edbp_shard *shard) {
+	shard->tiermax = (uint64_t)shard->slot_count * cache->indextier / 100;
+	tier_trim(shard);
+}
+
+// sets the shard's zmax from cache->zpool, and frees pages out of the
+// compressed tier if its over. Requires mutexpagelock once the shard is in
+// use.
+static void shard_zconfig(const edbpcache_t *cache, edbp_shard *shard) {
+	shard->zmax = cache->arena == EDBP_ARENA_OFF ? 0
+	              : (size_t)cache->zpool * 1024 * 1024 / cache->shardc;
+	ztier_trim(shard);
+}
+
+// helper to shards_alloc and edbp_cache_free. Unmaps every page the shard
+// has in it and frees its memory (but not the shard itself).
+static void shard_free(edbpcache_t *cache, edbp_shard *shard) {
+	pthread_mutex_destroy(&shard->mutexpagelock);
+
+	// write out whatever is dirty and munmap all slots that have data in
+	// them.
+	for(edbp_slotid i = 0; i < shard->slot_count; i++) {
+		edbp_slot *slot = edbp_slotof(shard, i);
+		if(slot->id != 0 && slot->dirty) {
+			page_writeout(cache, slot, slot->id);
+		}
+		if(!cache->arena && slot->page != 0) {
+			munmap(slot->page, edbd_size(cache->fd));
+			slot->page = 0;
+		}
+	}
+	shard->pra->free(shard);
+	shard_release(shard, 0);
+	free(shard->bucketv);
+	ztier_free(shard);
+}
+
+// helper to shards_alloc.
+static odb_err shard_init(edbpcache_t *cache, edbp_shard *shard,
+                          edbp_slotid slotcount, unsigned int arena,
+                          const edbp_praops *pra, int node) {
+	bzero(shard, sizeof(edbp_shard));
+	shard->node = node;
+
+	odb_err err = shard_reserve(cache, arena, shard, slotcount);
+	if(err) {
+		shard_release(shard, 0);
+		free(shard->bucketv);
+		return err;
+	}
+	shard->slot_count = slotcount;
+	shard->slot_target = slotcount;
+	shard->slotboost = (unsigned int) (cache->slotboostCc * (float) slotcount);
+	for(int i = 0; i < 3; i++) {
+		shard->tierv[i].head = -1;
+		shard->tierv[i].tail = -1;
+	}
+	shard_tierconfig(cache, shard);
+
+	// all slots start out empty and unlocked.
+	shard->pra = pra;
+	err = pra->init(shard);
+	if(err) {
+		shard_release(shard, 0);
+		free(shard->bucketv);
+		return err;
+	}
+
+	int perr = pthread_mutex_init(&shard->mutexpagelock, 0);
+	if (perr) {
+		pra->free(shard);
+		shard_release(shard, 0);
+		free(shard->bucketv);
+		return log_critf("failed to initialize pagelock mutex: %d", perr);
+	}
+	return 0;
+}
+
+// helper to shard_resize: adds slots to the shard until it has slotc.
+// Requires mutexpagelock.
+//
+// returns ODB_ENOMEM or ODB_ECRIT, in which case the shard keeps its size.
+static odb_err shard_grow(edbpcache_t *cache, edbp_shard *shard,
+                          edbp_slotid slotc) {
+	odb_err err = shard_reserve(cache, cache->arena, shard, slotc);
+	if(err) {
+		return err;
+	}
+	// (these could have been used before the shard last shrunk)
+	edbp_slotid oldcount = shard->slot_count;
+	for(edbp_slotid i = oldcount; i < slotc; i++) {
+		edbp_slot *slot = edbp_slotof(shard, i);
+		void *page = cache->arena ? slot->page : 0;
+		bzero(slot, sizeof(edbp_slot));
+		slot->page = page;
+	}
+	shard->slot_count = slotc;
+	err = shard->pra->grow(shard, oldcount);
+	if(err) {
+		shard->slot_count = oldcount;
+	}
+	shard->slotboost = (unsigned int) (cache->slotboostCc
+	                                   * (float) shard->slot_count);
+	shard_tierconfig(cache, shard);
+	return err;
+}
+
+// helper to shard_resize and claimpage: takes away the shard's last slot.
+// If the page in it is one the pra wants to keep, it's moved into the slot
+// of one it doesn't (which is swapped out). Requires mutexpagelock, which is
+// unlocked while the page is being written out / moved and locked again
+// before returning (so anything looked up before calling this must be
+// looked up again).
+//
+// returns ODB_EAGAIN if the last slot (or every other slot) is locked, or
+// another shrinkstep is already under way.
+// returns ODB_ECRIT if the page that was swapped out failed to be written
+// back (arena mode), the slot is still taken away.
+static odb_err shard_shrinkstep(edbpcache_t *cache, edbp_shard *shard) {
+	if(shard->futex_shrinking) {
+		return ODB_EAGAIN;
+	}
+	edbp_slotid lastid = shard->slot_count - 1;
+	edbp_slot *last = edbp_slotof(shard, lastid);
+	if(last->tier && last->locks == 1) {
+		tier_drop(shard, lastid, 0);
+	}
+	if(last->locks) {
+		return ODB_EAGAIN;
+	}
+	shard->slot_count--;
+	edbp_slotid to = shard->pra->shrink(shard);
+	if(to == -1) {
+		shard->slot_count++;
+		return ODB_EAGAIN;
+	}
+
+	// the pages are written out / moved with the mutex unlocked. Until
+	// they're done, anyone looking for the page going out finds its slot
+	// with a different id and waits on its futex_swap (see claimpage), and
+	// anyone looking for the page being moved finds it in its new slot and
+	// waits on the same.
+	odb_err err = 0;
+	odb_pid lastpage = last->id;
+	shard->futex_shrinking = 1;
+	last->locks = 1;
+	if(to == lastid) {
+		// the last slot's page is the one to go.
+		last->id = 0;
+		last->futex_swap = 1;
+		pthread_mutex_unlock(&shard->mutexpagelock);
+
+		err = evict(cache, shard, last, lastpage);
+
+		pthread_mutex_lock(&shard->mutexpagelock);
+		if(lastpage) {
+			bucket_delete(shard, lastpage);
+		}
+		last->futex_swap = 0;
+		syscall(SYS_futex, &last->futex_swap, FUTEX_WAKE, INT_MAX, 0, 0, 0);
+	} else {
+		// pin the slot the same way writeback_shard does so the pra won't
+		// hand it out while we're using it.
+		edbp_slot *slot = edbp_slotof(shard, to);
+		odb_pid oldid = slot->id;
+		slot->locks++;
+		if(shard->pra->pin) shard->pra->pin(shard, to);
+		slot->id = lastpage;
+		slot->gen = last->gen;
+		slot->futex_swap = 1;
+		if(lastpage) {
+			bucket_delete(shard, lastpage);
+			bucket_insert(shard, lastpage, to);
+		}
+		last->id = 0;
+		pthread_mutex_unlock(&shard->mutexpagelock);
+
+		err = evict(cache, shard, slot, oldid);
+		if(cache->arena) {
+			memcpy(slot->page, last->page, edbd_size(cache->fd));
+		} else {
+			slot->page = last->page;
+			last->page = 0;
+		}
+
+		pthread_mutex_lock(&shard->mutexpagelock);
+		slot->pra_hints = last->pra_hints;
+		if(slot_clean(shard, last)) {
+			slot_dirty(shard, slot);
+		}
+		if(oldid) {
+			bucket_delete(shard, oldid);
+		}
+		slot->locks--;
+		if(slot->locks == 0 && shard->pra->unpin) {
+			shard->pra->unpin(shard, to);
+		}
+		slot->futex_swap = 0;
+		syscall(SYS_futex, &slot->futex_swap, FUTEX_WAKE, INT_MAX, 0, 0, 0);
+	}
+	last->locks = 0;
+
+	shard->slotboost = (unsigned int) (cache->slotboostCc
+	                                   * (float) shard->slot_count);
+	shard_tierconfig(cache, shard);
+	// no one can have the slots past slot_count pinned, so chunks that are
+	// entirely past it can go.
+	shard_release(shard, shard->slot_count + 1);
+	shard->futex_shrinking = 0;
+	syscall(SYS_futex, &shard->futex_shrinking, FUTEX_WAKE, INT_MAX, 0, 0, 0);
+	return err;
+}
+
+// sets the shard's size to slotc. Growing is done all at once. When
+// shrinking, as many slots are taken away as can be right now (letting go of
+// the mutex in between each one) and the rest are taken away by the page
+// faults that come after (see claimpage).
+//
+// returns ODB_ENOMEM or ODB_ECRIT
+static odb_err shard_resize(edbpcache_t *cache, edbp_shard *shard,
+                            edbp_slotid slotc) {
+	odb_err err = 0;
+	pthread_mutex_lock(&shard->mutexpagelock);
+	shard->slot_target = slotc;
+	while(slotc > shard->slot_count && shard->futex_shrinking) {
+		// the slot past slot_count is still being emptied out.
+		pthread_mutex_unlock(&shard->mutexpagelock);
+		syscall(SYS_futex, &shard->futex_shrinking, FUTEX_WAIT, 1, 0, 0, 0);
+		pthread_mutex_lock(&shard->mutexpagelock);
+	}
+	if(slotc > shard->slot_count) {
+		err = shard_grow(cache, shard, slotc);
+		shard->slot_target = shard->slot_count;
+	}
+	while(!err && shard->slot_count > shard->slot_target) {
+		err = shard_shrinkstep(cache, shard);
+		pthread_mutex_unlock(&shard->mutexpagelock);
+		pthread_mutex_lock(&shard->mutexpagelock);
+	}
+	pthread_mutex_unlock(&shard->mutexpagelock);
+	if(err == ODB_EAGAIN) {
+		err = 0;
+	}
+	return err;
+}
+
+// resizes every shard so that there's slotcount slots in all (see
+// shard_resize). Requires wbmutex.
+//
+// returns ODB_EINVAL if the smallest shard would have less than straitmax
+// slots for every handle. ODB_ENOMEM or ODB_ECRIT.
+static odb_err cache_resize(edbpcache_t *cache, edbp_slotid slotcount) {
+	if(slotcount < cache->shardc
+	   || slotcount / cache->shardc < cache->handles * cache->straitmax) {
+		return ODB_EINVAL;
+	}
+	odb_err err = 0;
+	edbp_slotid total = 0;
+	for(unsigned int i = 0; i < cache->shardc; i++) {
+		// the first few shards get the remainder.
+		edbp_slotid c = slotcount / cache->shardc
+		                + (i < slotcount % cache->shardc);
+		edbp_shard *shard = &cache->shardv[i];
+		if(!err) {
+			err = shard_resize(cache, shard, c);
+		}
+		pthread_mutex_lock(&shard->mutexpagelock);
+		total += shard->slot_target;
+		pthread_mutex_unlock(&shard->mutexpagelock);
+	}
+	cache->slot_count = total;
+	return err;
+}
+
+// (re)allocates all the shards of the cache so that slotcount slots are
+// spread evenly across shardc shards. Anything that was in the cache before
+// is deloaded.
+static odb_err shards_alloc(edbpcache_t *pcache, edbp_slotid slotcount,
+                            unsigned int shardc, unsigned int arena,
+                            unsigned int pra) {
+	if(slotcount < shardc) return ODB_EINVAL;
+	const edbp_praops *praops = edbp_pra_ops(pra);
+	if(praops == 0) return ODB_EINVAL;
+	odb_err err;
+
+	edbp_shard *shardv = aligned_alloc(_Alignof(edbp_shard),
+	                                   sizeof(edbp_shard) * shardc);
+	if(shardv == 0) {
+		if(errno == ENOMEM)
+			return ODB_ENOMEM;
+		return log_critf("aligned_alloc");
+	}
+	for(unsigned int i = 0; i < shardc; i++) {
+		// the first few shards get the remainder.
+		edbp_slotid c = slotcount / shardc + (i < slotcount % shardc);
+		err = shard_init(pcache, &shardv[i], c, arena, praops,
+		                 numa_shardnode(pcache, i));
+		if(err) {
+			// (nothing has been loaded into these yet, so there's nothing
+			// to write back or munmap other than the arenas)
+			for(unsigned int j = 0; j < i; j++) {
+				pthread_mutex_destroy(&shardv[j].mutexpagelock);
+				praops->free(&shardv[j]);
+				shard_release(&shardv[j], 0);
+				free(shardv[j].bucketv);
 			}
-			continue;
+			free(shardv);
+			return err;
 		}
+	}
 
-		// we found our page in the cache at slot i. Add a lock so it doesn't deload
-		slot->locks++;
+	// free the old ones (out from under the writeback thread)
+	pthread_mutex_lock(&pcache->wbmutex);
+	for(unsigned int i = 0; pcache->shardv && i < pcache->shardc; i++) {
+		shard_free(pcache, &pcache->shardv[i]);
+	}
+	free(pcache->shardv);
 
-		// rotate the LRU-1/LRU-2 history.
-		slot->pra_k[1] = slot->pra_k[0];
-		slot->pra_k[0] = cache->opcoutner;
-		// quickly unlock the mutex because that's all we need to use it for.
-		pthread_mutex_unlock(&cache->mutexpagelock);
-		*o_pageslots = mslot;
+	// assignments
+	pcache->shardv = shardv;
+	pcache->shardc = shardc;
+	pcache->slot_count = slotcount;
+	pcache->arena = arena;
+	pcache->pra = pra;
+	for(unsigned int i = 0; i < shardc; i++) {
+		shard_zconfig(pcache, &shardv[i]);
+	}
+	pthread_mutex_unlock(&pcache->wbmutex);
+	return 0;
+}
 
-		// before we return: in the case that the page was currently undergoing a swap
-		// we'll wait for it here.
-		syscall(SYS_futex, &slot->futex_swap, FUTEX_WAIT, 1, 0, 0, 0);
-		errno = 0;
+edbp_slotid edbp_psi_step(edbpcache_t *cache, int pressure) {
+	pthread_mutex_lock(&cache->wbmutex);
+	edbp_slotid size = cache->slot_count;
+	if(pressure) {
+		edbp_slotid min = cache->slot_max / EDBP_PSIMIN;
+		size -= size / EDBP_PSISTEP;
+		if(size < min) size = min;
+	} else {
+		size += cache->slot_max / EDBP_PSISTEP;
+		if(size > cache->slot_max) size = cache->slot_max;
+	}
+	if(size && size != cache->slot_count) {
+		// (ODB_EINVAL: the handles need more than that, leave it be)
+		cache_resize(cache, size);
+	}
+	size = cache->slot_count;
+	pthread_mutex_unlock(&cache->wbmutex);
+	return size;
+}
 
-		// if the swap failed for whatever reason, we'll casecade fail. Sure we can try
-		// to do the swap again, but frankly if we're out of memory then we're out of memory.
-		switch (slot->futex_swap) {
-			case 3:
-				return ODB_ENOMEM;
-			case 2:
-				log_critf("fail-cascading because waiting on swap to finish had failed");
-				return ODB_ECRIT;
-			default:
-				// was not undergoing a swap.
-				return 0;
+// see EDBP_CONFIG_PSI. Shrinks the cache whenever the kernel says there's
+// memory pressure and grows it back once there hasn't been any for a while.
+static void *psi_main(void *arg) {
+	edbpcache_t *cache = arg;
+	struct pollfd fds[2] = {
+			{.fd = cache->psifd, .events = POLLPRI},
+			{.fd = cache->psistopfd, .events = POLLIN},
+	};
+	for(;;) {
+		int n = poll(fds, 2, EDBP_PSIQUIET);
+		if(n == -1) {
+			if(errno == EINTR) continue;
+			log_critf("poll(2) on memory pressure failed");
+			return 0;
+		}
+		if(fds[1].revents) {
+			return 0;
+		}
+		if(fds[0].revents & POLLERR) {
+			log_errorf("memory pressure trigger went away");
+			return 0;
+		}
+
+		if(fds[0].revents & POLLPRI) {
+			edbp_psi_step(cache, 1);
+		} else if(n == 0) {
+			edbp_psi_step(cache, 0);
+		}
+	}
+}
+
+// sets the memory pressure threshold, starting or stopping the psi thread if
+// need be.
+static odb_err psi_config(edbpcache_t *cache, unsigned int stallus) {
+	if(cache->psirunning) {
+		uint64_t one = 1;
+		write(cache->psistopfd, &one, sizeof(one));
+		int err = pthread_join(cache->psithread, 0);
+		if(err) {
+			log_critf("pthread_join(3) returned error: %d", err);
 		}
+		close(cache->psifd);
+		close(cache->psistopfd);
+		cache->psirunning = 0;
+		cache->psifd = -1;
+	}
+	if(stallus == 0) {
+		return 0;
 	}
 
-	// At this point: Page fault.
+	int fd = open("/proc/pressure/memory", O_RDWR | O_NONBLOCK);
+	if(fd == -1) {
+		log_errorf("failed to open /proc/pressure/memory");
+		return ODB_EERRNO;
+	}
+	char trigger[64];
+	int len = snprintf(trigger, sizeof(trigger), "some %u %u",
+	                   stallus, EDBP_PSIWINDOW);
+	if(write(fd, trigger, len + 1) == -1) {
+		int eno = errno;
+		close(fd);
+		errno = eno;
+		if(eno == EINVAL) return ODB_EINVAL;
+		return ODB_EERRNO;
+	}
+	int stopfd = eventfd(0, 0);
+	if(stopfd == -1) {
+		int eno = errno;
+		close(fd);
+		errno = eno;
+		return ODB_EERRNO;
+	}
+	cache->psifd = fd;
+	cache->psistopfd = stopfd;
+	int err = pthread_create(&cache->psithread, 0, psi_main, cache);
+	if(err) {
+		close(fd);
+		close(stopfd);
+		return log_critf("failed to create memory pressure thread pthread_create(3) returned: %d", err);
+	}
+	cache->psirunning = 1;
+	return 0;
+}
 
-	// see slot_nextstart doc.
-	cache->slot_nextstart = (cache->slot_nextstart + 1) % cache->slot_count;
+// has the kernel start reading in the pagec pages starting at id (without
+// waiting for it). See edbp_prefetch.
+static void page_readahead(const edbpcache_t *cache, odb_pid id, int pagec) {
+	posix_fadvise64(cache->fd->descriptor, edbd_pid2off(cache->fd, id),
+	                (off64_t)pagec * edbd_size(cache->fd),
+	                POSIX_FADV_WILLNEED);
+}
 
-	// At this point, however we have which slot we can swap stored in slotswap.
-	// So swap the slot with slotswap.
-	edbp_slot *slot = &cache->slots[slotswap];
-	slot->locks = 1;
-	// reset LRU-K history
-	slot->pra_k[1] = 0;
-	slot->pra_k[0] = cache->opcoutner;
-	// assign the new id
-	slot->id = starting;
-	// with the lock field set we can unlock the mutex and perform the
-	// rest of our work in peace. Even though we didn't do the swap yet,
-	// we're not going to slow everyone else down by keeping this page mutex
-	// locked. So we set the futex_swap to 1 which will stop any subseqnet
-	// locks from returning until the swap is complete.
-	slot->futex_swap = 1;
-	pthread_mutex_unlock(&cache->mutexpagelock);
-	*o_pageslots = slotswap;
-
-	// perform the actual swap.
-	// deload the page that was already there.
-	if(slot->page != 0) {// (if there was antyhing there)
-
-		// recalculate checksum only when the page has been marked
-		// as dirty.
-		// note w=1 because the first word of the page is the checksum itself.
-		if(slot->pra_hints & EDBP_HDIRTY) {
-			// even though its a no-op on linux. Lets be a good boy and
-			// explicitly call MS_ASYNC.
-			msync(slot->page, pagesize, MS_ASYNC);
-#ifdef EDB_OPT_CHECKSUMS
-			uint32_t sum = 0;
-			for (int w = 1; w < pagesize / sizeof(uint32_t); w++) {
-				sum += ((uint32_t *) (slot->page))[w];
+// orders edbp_hotpages hottest first.
+static int hotpage_cmp(const void *a, const void *b) {
+	const edbp_hotpage *x = a, *y = b;
+	if(x->score != y->score) {
+		return x->score < y->score ? 1 : -1;
+	}
+	return (x->id > y->id) - (x->id < y->id);
+}
+
+// orders edbp_hotpages by page id.
+static int hotpage_idcmp(const void *a, const void *b) {
+	const edbp_hotpage *x = a, *y = b;
+	return (x->id > y->id) - (x->id < y->id);
+}
+
+// saves every page in the cache (that's done loading) to fd as a hot set,
+// see EDBP_CONFIG_HOTSET.
+//
+// returns ODB_ENOMEM, ODB_EERRNO
+static odb_err hotset_save(edbpcache_t *cache, int fd) {
+	edbp_hotpage *pagev = 0;
+	uint64_t pagec = 0;
+
+	// (wbmutex so shardv stays put)
+	pthread_mutex_lock(&cache->wbmutex);
+	for(unsigned int i = 0; cache->shardv && i < cache->shardc; i++) {
+		edbp_shard *shard = &cache->shardv[i];
+		pthread_mutex_lock(&shard->mutexpagelock);
+		edbp_hotpage *p = realloc(pagev, sizeof(edbp_hotpage)
+		                                 * (pagec + shard->slot_count));
+		if(p == 0) {
+			pthread_mutex_unlock(&shard->mutexpagelock);
+			pthread_mutex_unlock(&cache->wbmutex);
+			free(pagev);
+			return ODB_ENOMEM;
+		}
+		pagev = p;
+		for(edbp_slotid j = 0; j < shard->slot_count; j++) {
+			edbp_slot *slot = edbp_slotof(shard, j);
+			if(slot->id == 0 || slot->futex_swap) {
+				continue;
 			}
-			_odb_stdhead *head = (_odb_stdhead *)(slot->page);
-			head->_checksum = sum;
-#endif
+			pagev[pagec].id = slot->id;
+			pagev[pagec].score = shard->pra->heat(shard, j);
+			// (EDBP_HINDEX0 | EDBP_HINDEX1 covers all the index hints)
+			pagev[pagec].hints = slot->pra_hints
+			                     & (EDBP_HUSESOON | EDBP_HINDEX0 | EDBP_HINDEX1);
+			pagec++;
 		}
+		pthread_mutex_unlock(&shard->mutexpagelock);
+	}
+	pthread_mutex_unlock(&cache->wbmutex);
 
-		// later: encrypt the body if page is supposed to be encrypted.
-
-		// reset the slot hints
-		slot->pra_hints = 0;
+	qsort(pagev, pagec, sizeof(edbp_hotpage), hotpage_cmp);
+	edbp_hotsethead head = {
+			.magic    = EDBP_HOTSETMAGIC,
+			.pagesize = edbd_size(cache->fd),
+			.pagec    = pagec,
+			.crc      = edbp_crc32c(0, pagev, sizeof(edbp_hotpage) * pagec),
+	};
 
-		// do the actual unmap
-		munmap(slot->page, pagesize);
-		telemetry_pages_decached(slot->id);
+	// overwritten in place. If we don't make it all the way through, the
+	// crc won't match and edbp_warmup will ignore it.
+	struct iovec iov[2] = {
+			{.iov_base = &head, .iov_len = sizeof(head)},
+			{.iov_base = pagev, .iov_len = sizeof(edbp_hotpage) * pagec},
+	};
+	size_t size = iov[0].iov_len + iov[1].iov_len;
+	ssize_t n;
+	while((n = pwritev64(fd, iov, 2, 0)) == -1 && errno == EINTR);
+	free(pagev);
+	if(n != size || ftruncate64(fd, size) == -1 || fdatasync(fd) == -1) {
+		if(n != -1 && n != size) {
+			errno = EIO;
+		}
+		log_errorf("failed to save the hot set");
+		return ODB_EERRNO;
 	}
+	return 0;
+}
 
-	// load in the new page
-	void *newpage = mmap64(0, pagesize,
-		 PROT_READ | PROT_WRITE,
-		                   MAP_SHARED, fd, edbd_pid2off(cache->fd, starting));
+// see EDBP_CONFIG_HOTSET.
+static void *hotset_main(void *arg) {
+	edbpcache_t *cache = arg;
+	struct pollfd pfd = {.fd = cache->hsstopfd, .events = POLLIN};
+	for(;;) {
+		int n = poll(&pfd, 1, EDBP_HOTSETINTERVAL);
+		if(n == -1 && errno == EINTR) {
+			continue;
+		}
+		if(n != 0) {
+			return 0;
+		}
+		hotset_save(cache, cache->hotsetfd);
+	}
+}
 
-	if(newpage == (void *)-1) {
-		// out of memory/some other critical error: bail out.
-		log_critf("failed to map page(s) into slot");
-		int eno = errno;
-		odb_err err;
-		pthread_mutex_lock(&cache->mutexpagelock);
-		slot->page = 0;
-		slot->pra_score = 0;
-		// handle nomem.
-		if(eno == ENOMEM) {
-			slot->futex_swap = 3;
-			err = ODB_ENOMEM;
-		} else {
-			slot->futex_swap = 2;
-			err = ODB_ECRIT;
+// sets the hot set file, starting or stopping the hot set thread if need be.
+static odb_err hotset_config(edbpcache_t *cache, int fd) {
+	if(cache->hsrunning) {
+		uint64_t one = 1;
+		write(cache->hsstopfd, &one, sizeof(one));
+		int err = pthread_join(cache->hsthread, 0);
+		if(err) {
+			log_critf("pthread_join(3) returned error: %d", err);
 		}
-		syscall(SYS_futex, &slot->futex_swap, FUTEX_WAKE, INT_MAX, 0, 0, 0);
-		pthread_mutex_unlock(&cache->mutexpagelock);
-		errno = eno;
-		return err;
+		close(cache->hsstopfd);
+		cache->hsrunning = 0;
+		cache->hotsetfd = -1;
+	}
+	if(fd == -1) {
+		return 0;
 	}
 
-	// assign other memebers of the page data
-	slot->page = newpage;
+	int stopfd = eventfd(0, 0);
+	if(stopfd == -1) {
+		return ODB_EERRNO;
+	}
+	cache->hotsetfd = fd;
+	cache->hsstopfd = stopfd;
+	int err = pthread_create(&cache->hsthread, 0, hotset_main, cache);
+	if(err) {
+		close(stopfd);
+		cache->hotsetfd = -1;
+		return log_critf("failed to create hot set thread pthread_create(3) returned: %d", err);
+	}
+	cache->hsrunning = 1;
+	return 0;
+}
 
+typedef struct {
+	edbpcache_t  *cache;
+	edbphandle_t *handle;
+	edbp_hotpage *pagev; // hottest first
+	uint64_t      pagec;
+} warmup_args;
 
-	// swap is complete. let the futex know the page is loaded in now
-	slot->futex_swap = 0;
-	syscall(SYS_futex, &slot->futex_swap, FUTEX_WAKE, INT_MAX, 0, 0, 0);
-	telemetry_pages_cached(slot->id);
+// see edbp_warmup.
+static void *warmup_main(void *arg) {
+	warmup_args *w = arg;
+	edbpcache_t *cache = w->cache;
+	edbphandle_t *h = w->handle;
+	uint64_t loaded = 0;
+	odb_err err = 0;
+
+	for(uint64_t i = 0; i < w->pagec && !err; i += EDBP_WARMWINDOW) {
+		edbp_hotpage *winv = &w->pagev[i];
+		int winc = EDBP_WARMWINDOW;
+		if(w->pagec - i < winc) {
+			winc = (int)(w->pagec - i);
+		}
+		qsort(winv, winc, sizeof(edbp_hotpage), hotpage_idcmp);
+
+		// let the kernel start reading the whole lot in (in as few reads as
+		// it can) before we ask for any of it.
+		for(int j = 0; j < winc;) {
+			int runc = 1;
+			while(j + runc < winc && winv[j + runc].id == winv[j].id + runc) {
+				runc++;
+			}
+			page_readahead(cache, winv[j].id, runc);
+			j += runc;
+		}
+
+		for(int j = 0; j < winc;) {
+			if(__atomic_load_n(&cache->warmstop, __ATOMIC_RELAXED)) {
+				goto done;
+			}
+			int runc = 1;
+			while(j + runc < winc && runc < cache->straitmax
+			      && winv[j + runc].id == winv[j].id + runc) {
+				runc++;
+			}
+			err = edbp_startv(h, winv[j].id, runc, 0);
+			if(err == ODB_ECRIT) {
+				// (such as a page that failed its checksum, it can be
+				// someone else's problem when they go to use it)
+				err = 0;
+				j += runc;
+				continue;
+			}
+			if(err) {
+				break;
+			}
+			for(int k = 0; k < runc; k++) {
+				edbp_slotof(h->lockedshardv[k], h->lockedslotv[k])->pra_hints
+						= winv[j + k].hints;
+			}
+			edbp_finish(h);
+			loaded += runc;
+			j += runc;
+		}
+	}
+
+	done:
+	if(err) {
+		log_errorf("cache warm-up stopped early: %s", odb_errstr(err));
+	}
+	log_infof("warmed up the cache with %lu pages", loaded);
+	edbp_handle_free(h);
+	free(w->pagev);
+	free(w);
+	__atomic_store_n(&cache->warmrunning, 2, __ATOMIC_RELEASE);
 	return 0;
 }
 
-// using pra_k and pra_hints this function will calculate and set pra_score
-// before unlocking the page. The calculation is not technically thread-safe,
-// but this is okay. The calculation will be a bit sloppy when doing intense
-// multithreading but nonetheless will often result in similar results in
-// terms of setting pra_score.
-//
-// Note to self: make sure that sloppyness doesn't impact performace too much
-// by testing moving the calculation inside the lock.
+// helper to edbp_warmup: pread(2)s all size bytes.
 //
-// if the slot is already unlocked, nothing happens (logs will tho)
-// will only ever return critical errors.
-void static unlockpage(edbpcache_t *cache, edbp_slotid slotid) {
-	edbp_slot *slot = &cache->slots[slotid];
-
-	// calculate the pra_score
-	//
-	// This is a complex operation that has a good degree
-	// of statsitical guess-work and will never be perfect.
-	// Let me note this step by step:
-	//
-	// EDBP_HUSESOON - this will cause the LRU-K algo to use
-	// LRU-1 instead of LRU-2.
-	//
-	// EDBP_HDIRTY and EDBP_HINDEX... will be added after the HINDEX is
-	// shifted over 4 bits. After added, it will be devided by the MAXLIF
-	// (which will always be bigger) and then multiplied by slotboost.
-	if(slot->pra_hints & EDBP_HRESET) {
-		slot->pra_score = 0;
-	} else {
-		slot->pra_score = slot->pra_k[1 - slot->pra_hints & 1] // see EDBP_HUSESOON
-				+ (
-						(slot->pra_hints&EDBP_HDIRTY) + (slot->pra_hints >> 4)
-				   )
-				   * cache->slotboost
-				   / EDBP_HMAXLIF;
+// returns ODB_EEOF if the file ends first, ODB_EERRNO
+static odb_err preadall(int fd, void *buf, size_t size, off64_t off) {
+	while(size) {
+		ssize_t n = pread64(fd, buf, size, off);
+		if(n == -1 && errno == EINTR) {
+			continue;
+		}
+		if(n == -1) {
+			return ODB_EERRNO;
+		}
+		if(n == 0) {
+			return ODB_EEOF;
+		}
+		buf += n;
+		size -= n;
+		off += n;
+	}
+	return 0;
+}
 
+odb_err edbp_warmup(edbpcache_t *cache, int fd) {
+	if(!cache || cache->slot_count == 0) return ODB_EINVAL;
+	if(cache->warmrunning) {
+		if(__atomic_load_n(&cache->warmrunning, __ATOMIC_ACQUIRE) == 1) {
+			return ODB_EOPEN;
+		}
+		pthread_join(cache->warmthread, 0);
+		cache->warmrunning = 0;
 	}
 
-	pthread_mutex_lock(&cache->mutexpagelock);
-	if(slot->locks == 0) {
-		// they're trying to unlock a page thats already unlocked.
-		// return early.
-		log_debugf("attempted to unlock a cache slot that was already completely unlocked (slot %d)", slot->locks);
-		goto unlock;
+	// read it in and make sure its all there.
+	edbp_hotsethead head;
+	odb_err err = preadall(fd, &head, sizeof(head), 0);
+	if(err == ODB_EEOF) {
+		// (could be an empty file, could be half a header. Either way,
+		// nothing to warm up)
+		return 0;
+	}
+	if(err) {
+		return err;
+	}
+	struct stat64 st;
+	if(fstat64(fd, &st) == -1) {
+		return ODB_EERRNO;
+	}
+	if(head.magic != EDBP_HOTSETMAGIC
+	   || head.pagesize != edbd_size(cache->fd)
+	   || head.pagec > (st.st_size - sizeof(head)) / sizeof(edbp_hotpage)) {
+		log_errorf("hot set file is not one or is from another file");
+		return ODB_EFILE;
+	}
+	if(head.pagec == 0) {
+		return 0;
+	}
+	edbp_hotpage *pagev = malloc(sizeof(edbp_hotpage) * head.pagec);
+	if(pagev == 0) {
+		return ODB_ENOMEM;
+	}
+	err = preadall(fd, pagev, sizeof(edbp_hotpage) * head.pagec,
+	               sizeof(head));
+	if(!err && edbp_crc32c(0, pagev, sizeof(edbp_hotpage) * head.pagec)
+	           != head.crc) {
+		log_errorf("hot set file was only partly saved");
+		err = ODB_EFILE;
+	}
+	if(err == ODB_EEOF) {
+		err = ODB_EFILE;
+	}
+	if(err) {
+		free(pagev);
+		return err;
 	}
 
-	// decrement the locknum.
-	slot->locks--;
+	// only keep what'll fit. Pages that don't fit in a shard would only
+	// swap out hotter pages we had just loaded in. Each shard's room is what
+	// the handles (and ours) don't need.
+	if(fstat64(cache->fd->descriptor, &st) == -1) {
+		free(pagev);
+		return ODB_EERRNO;
+	}
+	odb_pid filepagec = st.st_size / edbd_size(cache->fd);
+	int64_t roomv[EDBP_SHARDMAX];
+	for(unsigned int i = 0; i < cache->shardc; i++) {
+		roomv[i] = (int64_t)cache->shardv[i].slot_count
+		           - (int64_t)(cache->handles + 1) * cache->straitmax;
+	}
+	uint64_t pagec = 0;
+	for(uint64_t i = 0; i < head.pagec; i++) {
+		odb_pid id = pagev[i].id;
+		if(id == 0 || id >= filepagec) {
+			continue;
+		}
+		int64_t *room = &roomv[edbp_shardof(cache, id) - cache->shardv];
+		if(*room <= 0) {
+			continue;
+		}
+		(*room)--;
+		pagev[pagec++] = pagev[i];
+	}
 
-	// clean up
-	unlock:
-	pthread_mutex_unlock(&cache->mutexpagelock);
+	warmup_args *w = malloc(sizeof(warmup_args));
+	if(w == 0) {
+		free(pagev);
+		return ODB_ENOMEM;
+	}
+	w->cache = cache;
+	w->pagev = pagev;
+	w->pagec = pagec;
+	err = edbp_handle_init(cache, EDBP_WARMHANDLE, &w->handle);
+	if(err) {
+		free(pagev);
+		free(w);
+		return err;
+	}
+	cache->warmstop = 0;
+	cache->warmrunning = 1;
+	int perr = pthread_create(&cache->warmthread, 0, warmup_main, w);
+	if(perr) {
+		cache->warmrunning = 0;
+		edbp_handle_free(w->handle);
+		free(pagev);
+		free(w);
+		return log_critf("failed to create warm-up thread pthread_create(3) returned: %d", perr);
+	}
+	return 0;
 }
 
 odb_err edbp_cache_config(edbpcache_t *pcache, edbp_config_opts opts, ...) {
 
 	if(!pcache) return ODB_EINVAL;
-	if(pcache->handles != 0) return ODB_EOPEN;
 
 	va_list args;
 	va_start(args, opts);
+	unsigned int val = va_arg(args, unsigned int);
+	va_end(args);
+
+	// (these don't need the handles to be gone)
 	switch (opts) {
-		case EDBP_CONFIG_CACHESIZE:
-			break;
+		case EDBP_CONFIG_TRACE:
+			pcache->tracefd = (int)val;
+			return 0;
+		case EDBP_CONFIG_DIRTYRATIO:
+			if(val > 100) return ODB_EINVAL;
+			return writeback_config(pcache, val);
+		case EDBP_CONFIG_VERIFY:
+			if(val > EDBP_VERIFY_ALWAYS) return ODB_EINVAL;
+			pcache->verify = val;
+			return 0;
+		case EDBP_CONFIG_PSI:
+			return psi_config(pcache, val);
+		case EDBP_CONFIG_HOTSET:
+			return hotset_config(pcache, (int)val);
+		case EDBP_CONFIG_INDEXTIER:
+			if(val > EDBP_INDEXTIERMAX) return ODB_EINVAL;
+			pthread_mutex_lock(&pcache->wbmutex);
+			pcache->indextier = val;
+			for(unsigned int i = 0; pcache->shardv && i < pcache->shardc; i++) {
+				edbp_shard *shard = &pcache->shardv[i];
+				pthread_mutex_lock(&shard->mutexpagelock);
+				shard_tierconfig(pcache, shard);
+				pthread_mutex_unlock(&shard->mutexpagelock);
+			}
+			pthread_mutex_unlock(&pcache->wbmutex);
+			return 0;
+		case EDBP_CONFIG_ZPOOL:
+			pthread_mutex_lock(&pcache->wbmutex);
+			pcache->zpool = val;
+			for(unsigned int i = 0; pcache->shardv && i < pcache->shardc; i++) {
+				edbp_shard *shard = &pcache->shardv[i];
+				pthread_mutex_lock(&shard->mutexpagelock);
+				shard_zconfig(pcache, shard);
+				pthread_mutex_unlock(&shard->mutexpagelock);
+			}
+			pthread_mutex_unlock(&pcache->wbmutex);
+			return 0;
+		case EDBP_CONFIG_CACHESIZE: {
+			if(val == 0) return ODB_EINVAL;
+			odb_err err;
+			pthread_mutex_lock(&pcache->wbmutex);
+			int resize = pcache->slot_count != 0;
+			if(resize) {
+				err = cache_resize(pcache, val);
+				if(!err) pcache->slot_max = val;
+			}
+			pthread_mutex_unlock(&pcache->wbmutex);
+			if(!resize) {
+				// (no handles without slots)
+				err = shards_alloc(pcache, val, pcache->shardc,
+				                   pcache->arena, pcache->pra);
+				if(!err) pcache->slot_max = val;
+			}
+			return err;
+		}
 		default:
-			return ODB_EINVAL;
+			break;
 	}
-	unsigned int slotcount = va_arg(args, unsigned int);
-	va_end(args);
+	if(pcache->handles != 0) return ODB_EOPEN;
 
-	// (re)allocate slots
-	void *slots = realloc(pcache->slots,
-							sizeof(edbp_slot) * slotcount);
-	if (slots == 0) {
-		if(errno == ENOMEM)
-			return ODB_ENOMEM;
-		log_critf("realloc");
-		return ODB_ECRIT;
+	switch (opts) {
+		case EDBP_CONFIG_SHARDS:
+			if(val == 0 || val > EDBP_SHARDMAX) return ODB_EINVAL;
+			if(pcache->slot_count == 0) {
+				// cache size hasn't been set yet, it'll pick this up.
+				pcache->shardc = val;
+				return 0;
+			}
+			return shards_alloc(pcache, pcache->slot_count, val, pcache->arena,
+			                    pcache->pra);
+		case EDBP_CONFIG_STRAITMAX:
+			if(val == 0 || val > EDBP_STRAITMAX) return ODB_EINVAL;
+			pcache->straitmax = val;
+			return 0;
+		case EDBP_CONFIG_ARENA:
+			if(val > EDBP_ARENA_HUGE) return ODB_EINVAL;
+			if(pcache->slot_count == 0) {
+				pcache->arena = val;
+				return 0;
+			}
+			return shards_alloc(pcache, pcache->slot_count, pcache->shardc, val,
+			                    pcache->pra);
+		case EDBP_CONFIG_NUMA: {
+			if(val > EDBP_NUMA_LOCAL) return ODB_EINVAL;
+			unsigned int old = pcache->numa;
+			pcache->numa = val;
+			if(pcache->slot_count == 0 || pcache->arena == EDBP_ARENA_OFF) {
+				return 0;
+			}
+			// the arenas have to be remade for the new policy.
+			odb_err err = shards_alloc(pcache, pcache->slot_count,
+			                           pcache->shardc, pcache->arena,
+			                           pcache->pra);
+			if(err) {
+				pcache->numa = old;
+			}
+			return err;
+		}
+		case EDBP_CONFIG_PRA:
+			if(edbp_pra_ops(val) == 0) return ODB_EINVAL;
+			if(pcache->slot_count == 0) {
+				pcache->pra = val;
+				return 0;
+			}
+			return shards_alloc(pcache, pcache->slot_count, pcache->shardc,
+			                    pcache->arena, val);
+		default:
+			return ODB_EINVAL;
 	}
-	bzero(slots, sizeof(edbp_slot) * slotcount); // 0-out
-
-	// assignments
-	pcache->slots = slots;
-	pcache->slot_count = slotcount;
-	pcache->slotboostCc = EDBP_SLOTBOOSTPER;
-	pcache->slotboost = (unsigned int) (pcache->slotboostCc *
-	                                    (float) pcache->slot_count);
-	return 0;
 }
 
 // see conf->pra_algo
@@ -301,54 +2180,122 @@ odb_err edbp_cache_init(const edbd_t *file, edbpcache_t **o_cache) {
 
 	// initialize
 	bzero(pcache, sizeof(edbpcache_t));
-	odb_err err = 0;
 
 	// parent file
 	pcache->fd = file;
-
-	// mutexes
-	err = pthread_mutex_init(&pcache->mutexpagelock, 0);
-	if (err) {
-		log_critf("failed to initialize pagelock mutex: %d", err);
-		edbp_cache_free(pcache);
-		return ODB_ECRIT;
-	}
+	pcache->shardc = 1;
+	pcache->straitmax = 1;
+	pcache->slotboostCc = EDBP_SLOTBOOSTPER;
+	pcache->pra = EDBP_PRA_LRUK;
+	pcache->tracefd = -1;
+	pcache->verify = EDBP_VERIFY_SAMPLED;
+	pcache->psifd = -1;
+	pcache->hotsetfd = -1;
+	numa_nodes(pcache);
+	pthread_mutex_init(&pcache->wbmutex, 0);
+	pthread_cond_init(&pcache->wbcond, 0);
+	pthread_mutex_init(&pcache->statsmutex, 0);
 	pcache->initialized = 1;
 	return 0;
 }
 void    edbp_cache_free(edbpcache_t *cache) {
 	if(!cache) return;
 
-	// kill mutexes
-	pthread_mutex_destroy(&cache->mutexpagelock);
-
-	// munmap all slots that have data in them.
-	for(int i = 0; i < cache->slot_count; i++) {
-		if(cache->slots[i].page != 0) {
-			msync(cache->slots[i].page, edbd_size(cache->fd), MS_ASYNC);
-			munmap(cache->slots[i].page, edbd_size(cache->fd));
-			cache->slots[i].page = 0;
-		}
+	// stop the warm-up (it has a handle) and save the hot set one last time.
+	if(cache->warmrunning) {
+		__atomic_store_n(&cache->warmstop, 1, __ATOMIC_RELAXED);
+		pthread_join(cache->warmthread, 0);
+	}
+	int hotsetfd = cache->hotsetfd;
+	hotset_config(cache, -1);
+	if(hotsetfd != -1) {
+		hotset_save(cache, hotsetfd);
 	}
 
-	// free slot memory
-	if(cache->slots) free(cache->slots);
+	// stop the writeback thread, whatever it didn't get to is written out
+	// below. And the psi thread.
+	writeback_config(cache, 0);
+	psi_config(cache, 0);
+
+	// free all shards
+	for(unsigned int i = 0; cache->shardv && i < cache->shardc; i++) {
+		shard_free(cache, &cache->shardv[i]);
+	}
+	free(cache->shardv);
+	pthread_mutex_destroy(&cache->wbmutex);
+	pthread_cond_destroy(&cache->wbcond);
+	pthread_mutex_destroy(&cache->statsmutex);
 
 	// null out pointers
 	free(cache);
 }
 
+// adds src's counters to dst. src can be a handle's that's still in use.
+static void stats_sum(edbp_stats *dst, const edbp_stats *src) {
+	dst->hits += __atomic_load_n(&src->hits, __ATOMIC_RELAXED);
+	dst->misses += __atomic_load_n(&src->misses, __ATOMIC_RELAXED);
+	dst->dirtyevictions += __atomic_load_n(&src->dirtyevictions,
+	                                       __ATOMIC_RELAXED);
+	dst->swapwaits += __atomic_load_n(&src->swapwaits, __ATOMIC_RELAXED);
+	for(int i = 0; i < ODBTELEM_LATENCYC; i++) {
+		dst->faultlatencyv[i] += __atomic_load_n(&src->faultlatencyv[i],
+		                                         __ATOMIC_RELAXED);
+	}
+	dst->zhits += __atomic_load_n(&src->zhits, __ATOMIC_RELAXED);
+	dst->zstores += __atomic_load_n(&src->zstores, __ATOMIC_RELAXED);
+	dst->zrawbytes += __atomic_load_n(&src->zrawbytes, __ATOMIC_RELAXED);
+	dst->zbytes += __atomic_load_n(&src->zbytes, __ATOMIC_RELAXED);
+	dst->zdecompressns += __atomic_load_n(&src->zdecompressns,
+	                                      __ATOMIC_RELAXED);
+}
+
+odb_err edbp_cache_stats(edbpcache_t *cache,
+                         struct odbtelem_cachestats *o_stats) {
+	if(!cache || !o_stats) return ODB_EINVAL;
+	edbp_stats sum;
+	pthread_mutex_lock(&cache->statsmutex);
+	sum = cache->statsfreed;
+	for(edbphandle_t *h = cache->handlev; h; h = h->statsnext) {
+		stats_sum(&sum, &h->stats);
+	}
+	pthread_mutex_unlock(&cache->statsmutex);
+	o_stats->hits = sum.hits;
+	o_stats->misses = sum.misses;
+	o_stats->dirtyevictions = sum.dirtyevictions;
+	o_stats->swapwaits = sum.swapwaits;
+	memcpy(o_stats->faultlatencyv, sum.faultlatencyv,
+	       sizeof(o_stats->faultlatencyv));
+	o_stats->zhits = sum.zhits;
+	o_stats->zstores = sum.zstores;
+	o_stats->zrawbytes = sum.zrawbytes;
+	o_stats->zbytes = sum.zbytes;
+	o_stats->zdecompressns = sum.zdecompressns;
+	return 0;
+}
+
 // create handles for the cache
 odb_err edbp_handle_init(edbpcache_t *cache,
                          unsigned int name,
                          edbphandle_t **o_handle) {
 	if (!cache || !o_handle) return ODB_EINVAL;
-	if (cache->slot_count < cache->handles + 1) return ODB_ENOSPACE;
-	cache->handles++;
+	// every handle could be going after the same shard with a full strait,
+	// so the smallest shard must have straitmax slots for each of them.
+	// (wbmutex so this can't race with cache_resize checking the same)
+	pthread_mutex_lock(&cache->wbmutex);
+	if (cache->slot_count / cache->shardc
+	    < (cache->handles + 1) * cache->straitmax) {
+		pthread_mutex_unlock(&cache->wbmutex);
+		return ODB_ENOSPACE;
+	}
+	// (atomic for the warm-up thread, which frees its handle whenever its
+	// done)
+	__atomic_add_fetch(&cache->handles, 1, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&cache->wbmutex);
 
-	// malloc the actual handle
-	*o_handle = malloc(sizeof(edbphandle_t));
+	// malloc the actual handle (aligned, see edbphandle_t.stats)
+	*o_handle = aligned_alloc(_Alignof(edbphandle_t), sizeof(edbphandle_t));
 	if(*o_handle == 0) {
+		__atomic_sub_fetch(&cache->handles, 1, __ATOMIC_RELAXED);
 		if(errno == ENOMEM)
 			return ODB_ENOMEM;
 		log_critf("malloc failed");
@@ -360,84 +2307,169 @@ odb_err edbp_handle_init(edbpcache_t *cache,
 	bzero(phandle, sizeof(edbphandle_t));
 	phandle->parent = cache;
 	phandle->name = name;
-	phandle->lockedslotv = -1;
+	phandle->lockedslotc = 0;
+
+	pthread_mutex_lock(&cache->statsmutex);
+	phandle->statsnext = cache->handlev;
+	if(cache->handlev) cache->handlev->statsprev = phandle;
+	cache->handlev = phandle;
+	pthread_mutex_unlock(&cache->statsmutex);
 
 	return 0;
 }
+// helper to edbp_finish and edbp_handle_free: writes out the handle's trace
+// records (if the cache is still tracing).
+static void trace_flush(edbphandle_t *handle) {
+	int fd = handle->parent->tracefd;
+	size_t size = sizeof(edbp_trace) * handle->tracec;
+	handle->tracec = 0;
+	if(fd == -1) {
+		return;
+	}
+	// a single write so that handles' batches don't end up interleaved.
+	ssize_t n;
+	while((n = write(fd, handle->tracev, size)) == -1 && errno == EINTR);
+	if(n != size) {
+		log_errorf("failed to write %ld bytes of page trace", size);
+	}
+}
+
 void    edbp_handle_free(edbphandle_t *handle) {
 	if(!handle) return;
 	if(!handle->parent) return;
 	edbp_finish(handle);
-	handle->parent->handles--;
+	trace_flush(handle);
+
+	// keep its counters.
+	edbpcache_t *cache = handle->parent;
+	pthread_mutex_lock(&cache->statsmutex);
+	stats_sum(&cache->statsfreed, &handle->stats);
+	if(handle->statsprev) handle->statsprev->statsnext = handle->statsnext;
+	else cache->handlev = handle->statsnext;
+	if(handle->statsnext) handle->statsnext->statsprev = handle->statsprev;
+	pthread_mutex_unlock(&cache->statsmutex);
+
+	__atomic_sub_fetch(&handle->parent->handles, 1, __ATOMIC_RELAXED);
 	handle->parent = 0;
 	free(handle);
 }
 
+odb_err edbp_prefetch(edbphandle_t *handle, odb_pid id, int pagec) {
+	if(!handle || id == 0 || pagec <= 0) return ODB_EINVAL;
+	edbpcache_t *cache = handle->parent;
+
+	// runs of the pages that aren't in the cache.
+	odb_pid runstart = 0;
+	int runc = 0;
+	for(int i = 0; i < pagec; i++) {
+		edbp_shard *shard = edbp_shardof(cache, id + i);
+		pthread_mutex_lock(&shard->mutexpagelock);
+		int cached = bucket_find(shard, id + i) != -1
+		             || ztier_find(shard, id + i);
+		pthread_mutex_unlock(&shard->mutexpagelock);
+		if(!cached) {
+			if(runc == 0) runstart = id + i;
+			runc++;
+			continue;
+		}
+		if(runc) {
+			page_readahead(cache, runstart, runc);
+			runc = 0;
+		}
+	}
+	if(runc) {
+		page_readahead(cache, runstart, runc);
+	}
+	return 0;
+}
+
 odb_err edbp_start (edbphandle_t *handle, odb_pid id) {
+	return edbp_startv(handle, id, 1, 0);
+}
+
+odb_err edbp_startv(edbphandle_t *handle, odb_pid id, int pagec, void **o_pagev) {
+
+	// easy vars
+	edbpcache_t *parent = handle->parent;
+	int err = 0;
 
 	// invals
 	if(id == 0) {
 		log_critf("attempting to start id 0");
 		return ODB_EINVAL;
 	}
-	if(handle->lockedslotv != -1) {
+	if(pagec <= 0 || pagec > parent->straitmax) {
+		log_errorf("attempting to start %d pages, straitmax is %d",
+		           pagec, parent->straitmax);
+		return ODB_EINVAL;
+	}
+	if(handle->lockedslotc != 0) {
 		log_errorf("cache handle attempt to double-lock");
 		return ODB_EINVAL;
 	}
 
-
-	// easy vars
-	edbpcache_t *parent = handle->parent;
-	int err = 0;
-
 	// make sure the id is within range
 #ifdef EDB_FUCKUPS
 	off64_t size = lseek64(parent->fd->descriptor, 0, SEEK_END);
-	if((off64_t)id * (off64_t) edbd_size(parent->fd) > size) {
+	if((off64_t)(id + pagec) * (off64_t) edbd_size(parent->fd) > size) {
 		log_critf("attempting to access page id that doesn't exist");
 		return ODB_EEOF;
 	}
 #endif
 
 	// lock in the pages
-	err = lockpages(parent, id, handle);
+	err = lockpages(parent, id, pagec, handle);
 
 	// later: HIID stuff should go here.
 	if(!err) {
-		telemetry_workr_pload(handle->name, id);
+		for(int i = 0; i < pagec; i++) {
+			telemetry_workr_pload(handle->name, id + i);
+			if(o_pagev) {
+				o_pagev[i] = edbp_slotof(handle->lockedshardv[i],
+				                         handle->lockedslotv[i])->page;
+			}
+		}
 	}
 	return err;
 }
 
 void    edbp_finish(edbphandle_t *handle) {
-	if(handle->lockedslotv != -1) {
-		unlockpage(handle->parent,
-		           handle->lockedslotv);
-		telemetry_workr_punload(handle->name,
-								handle->parent->slots[handle->lockedslotv].id);
+	for(int i = 0; i < handle->lockedslotc; i++) {
+		edbp_shard *shard = handle->lockedshardv[i];
+		edbp_slot *slot = edbp_slotof(shard, handle->lockedslotv[i]);
+		odb_pid id = slot->id;
+		if(handle->parent->tracefd != -1) {
+			if(handle->tracec == EDBP_TRACEBUF) {
+				trace_flush(handle);
+			}
+			handle->tracev[handle->tracec++] = (edbp_trace){
+				.id = id,
+				.hints = slot->pra_hints,
+				.handle = handle->name,
+			};
+		}
+		unlockpage(shard, handle->lockedslotv[i]);
+		telemetry_workr_punload(handle->name, id);
 	}
-	handle->lockedslotv = -1;
+	handle->lockedslotc = 0;
 }
 
 odb_pid edbp_gpid(const edbphandle_t *handle) {
-	return handle->parent->slots[handle->lockedslotv].id;
+	return edbp_slotof(handle->lockedshardv[0], handle->lockedslotv[0])->id;
 }
 
 void *edbp_graw(const edbphandle_t *handle) {
-	if (handle->lockedslotv == -1) {
+	if (handle->lockedslotc == 0) {
 		log_errorf("call attempted to edbp_graw without having one locked");
 		return 0;
 	}
-	return handle->parent->slots[handle->lockedslotv].page;
+	return edbp_slotof(handle->lockedshardv[0], handle->lockedslotv[0])->page;
 }
 
 odb_err edbp_mod(edbphandle_t *handle, edbp_options opts, ...) {
-	if(handle->lockedslotv == -1)
+	if(handle->lockedslotc == 0)
 		return ODB_ENOENT;
 
-	// easy pointers
-	edbpcache_t *cache = handle->parent;
-
 	odb_err err = 0;
 	edbp_hint hints;
 	va_list args;
@@ -445,7 +2477,15 @@ odb_err edbp_mod(edbphandle_t *handle, edbp_options opts, ...) {
 	switch (opts) {
 		case EDBP_CACHEHINT:
 			hints = va_arg(args, edbp_hint);
-			cache->slots[handle->lockedslotv].pra_hints = hints;
+			for(int i = 0; i < handle->lockedslotc; i++) {
+				edbp_slot *slot = edbp_slotof(handle->lockedshardv[i],
+				                              handle->lockedslotv[i]);
+				slot->pra_hints = hints;
+				if(hints & EDBP_HDIRTY) {
+					page_dirtied(handle->parent,
+					             handle->lockedshardv[i], slot);
+				}
+			}
 			err = 0;
 			break;
 		case EDBP_ECRYPT:
@@ -455,4 +2495,4 @@ odb_err edbp_mod(edbphandle_t *handle, edbp_options opts, ...) {
 	}
 	va_end(args);
 	return err;
-}
\ No newline at end of file
+}
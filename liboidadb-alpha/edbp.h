@@ -3,6 +3,7 @@
 
 #include <oidadb-internal/odbfile.h>
 #include <oidadb/oidadb.h>
+#include <oidadb/telemetry.h>
 #include "edbd.h"
 #include "errors.h"
 
@@ -44,6 +45,14 @@ typedef enum edbp_hint {
 	// swapped out in the next operation.
 	EDBP_HRESET = 0x04,  // 0000 0100
 
+	// The page was one of many being gone through in order (a scan) and
+	// won't be needed again any time soon. If it wasn't used before the
+	// scan it's put at the end that gets swapped out first instead of
+	// pushing out pages that are actually being used. Pages that were
+	// already hot stay that way. Takes precedence over EDBP_HUSESOON and
+	// EDBP_HDIRTY (a dirty page still gets written out).
+	EDBP_HSEQUENTIAL = 0x08, // 0000 1000
+
 	// This page is specifically used for indexing/lookups and
 	// thus should be considered more important to hold into
 	// cache than normal pages sense the frequency of index pages
@@ -99,23 +108,308 @@ void    edbp_cache_free(edbpcache_t *cache);
 
 typedef enum edbp_config_opts {
 	EDBP_CONFIG_CACHESIZE,
+	EDBP_CONFIG_SHARDS,
+	EDBP_CONFIG_ARENA,
+	EDBP_CONFIG_STRAITMAX,
+	EDBP_CONFIG_PRA,
+	EDBP_CONFIG_TRACE,
+	EDBP_CONFIG_DIRTYRATIO,
+	EDBP_CONFIG_VERIFY,
+	EDBP_CONFIG_PSI,
+	EDBP_CONFIG_HOTSET,
+	EDBP_CONFIG_INDEXTIER,
+	EDBP_CONFIG_NUMA,
+	EDBP_CONFIG_ZPOOL,
 } edbp_config_opts;
 
+// the most pages a handle can have started at once (see edbp_startv).
+#define EDBP_STRAITMAX 16
+
+// the most shards a cache can be split into.
+#define EDBP_SHARDMAX 256
+
+// values for EDBP_CONFIG_ARENA
+#define EDBP_ARENA_OFF  0
+#define EDBP_ARENA_ON   1
+#define EDBP_ARENA_HUGE 2
+
+// values for EDBP_CONFIG_NUMA
+#define EDBP_NUMA_OFF        0
+#define EDBP_NUMA_INTERLEAVE 1
+#define EDBP_NUMA_LOCAL      2
+
+// values for EDBP_CONFIG_PRA
+#define EDBP_PRA_LRUK     0
+#define EDBP_PRA_CLOCKPRO 1
+#define EDBP_PRA_ARC      2
+
+// values for EDBP_CONFIG_VERIFY
+#define EDBP_VERIFY_OFF     0
+#define EDBP_VERIFY_SAMPLED 1
+#define EDBP_VERIFY_ALWAYS  2
+
+// with EDBP_VERIFY_SAMPLED, 1 out of this many page loads are verified.
+#define EDBP_VERIFYSAMPLE 16
+
+// a sensible EDBP_CONFIG_DIRTYRATIO
+#define EDBP_DIRTYRATIO_DEFAULT 10
+
+// a sensible EDBP_CONFIG_INDEXTIER, and the most it can be.
+#define EDBP_INDEXTIER_DEFAULT 10
+#define EDBP_INDEXTIERMAX      50
+
+// pages have to compress to this much of their size (or less) to go into
+// the compressed tier (see EDBP_CONFIG_ZPOOL)
+#define EDBP_ZRATIO 0.75
+
+// a single page access in a trace (see EDBP_CONFIG_TRACE). These are written
+// out as-is, so a trace file is just an array of them.
+typedef struct edbp_trace {
+	odb_pid  id;
+	uint32_t hints;  // the edbp_hints the page was finished with.
+	uint32_t handle; // the name of the handle that accessed it.
+} edbp_trace;
+
+// a page in a hot set (see EDBP_CONFIG_HOTSET).
+typedef struct edbp_hotpage {
+	odb_pid  id;
+	uint32_t score; // how hot the page was (higher is hotter)
+	uint32_t hints; // the EDBP_HUSESOON/EDBP_HINDEX... hints it had.
+} edbp_hotpage;
+
 // Configures a cache. Depending on the compile options, some configures may
-// be no-ops.
+// be no-ops. Reconfiguring a cache deloads everything that was in it (other
+// than the options noted below).
 //
 //  - EDBP_CONFIG_CACHESIZE (unsigned int): sets the amount of pages that can
 //    be held in cache at once. Not required when compiling with EDB_OPT_OSPRA.
+//    Once set, this can be changed with handles attached and does not deload
+//    the cache: growing it adds the new slots right away, shrinking it evicts
+//    the coldest pages a few at a time (the rest is done by the page faults
+//    that come after) so workers never wait on the whole thing. The hash
+//    table is never shrunk.
+//
+//  - EDBP_CONFIG_SHARDS (unsigned int): splits the cache into this many
+//    shards (1 by default, no more than EDBP_SHARDMAX). Each shard has its
+//    own lock and its own slots and a page id will only ever be cached in
+//    one of them, thus workers after different pages don't block each other.
+//    The cache size is split evenly between the shards, and note that every
+//    shard must have at least as many slots as there are handles (see
+//    edbp_handle_init).
+//
+//  - EDBP_CONFIG_ARENA (unsigned int): one of the EDBP_ARENA_... values.
+//    By default (EDBP_ARENA_OFF) every page fault will munmap the old page
+//    and mmap the new one, the kernel's page cache holds the actual data.
+//    With EDBP_ARENA_ON all slots live in a single anonymous region
+//    allocated up front and pages are copied in with pread(2) and only
+//    written back with pwrite(2) if they were given the EDBP_HDIRTY hint.
+//    EDBP_ARENA_HUGE is the same but will try to use huge pages for the
+//    region (falling back to regular pages if none are available).
+//
+//    In arena mode, the cache is not coherent with other mappings of the
+//    same pages, and any modification to a page that isn't hinted with
+//    EDBP_HDIRTY is lost when the page is swapped out.
+//
+//  - EDBP_CONFIG_STRAITMAX (unsigned int): the most pages a handle can have
+//    started at once with edbp_startv (1 by default, no more than
+//    EDBP_STRAITMAX). Every shard will need this many slots per handle.
+//
+//  - EDBP_CONFIG_PRA (unsigned int): the page replacement algorithm used
+//    to pick which page gets swapped out on a page fault. One of:
+//
+//      EDBP_PRA_LRUK (default): LRU-2 where the hints will boost the score
+//        of the page (see EDBP_HMAXLIF and EDBP_SLOTBOOSTPER).
+//      EDBP_PRA_CLOCKPRO: CLOCK-Pro. EDBP_HINDEX... pages are made hot,
+//        EDBP_HUSESOON and EDBP_HDIRTY pages get their reference bit set.
+//      EDBP_PRA_ARC: Adaptive Replacement Cache. EDBP_HINDEX... pages are
+//        moved into the frequency list, EDBP_HUSESOON and EDBP_HDIRTY pages
+//        to the front of whatever list they're in.
+//
+//    With all of them EDBP_HRESET will make the page the next to be swapped
+//    out (or close to it).
+//
+//  - EDBP_CONFIG_TRACE (int): a file descriptor (opened with O_APPEND) that
+//    every page access will be written to as an edbp_trace. -1 (the default)
+//    to stop tracing. Handles write them out in batches so a trace
+//    is only complete once all handles have been freed. Unlike the other
+//    options this can be set with handles attached and does not deload the
+//    cache. See edbp_pra_simulate.
+//
+//  - EDBP_CONFIG_DIRTYRATIO (unsigned int): the percentage (0 to 100) of
+//    each shard's slots that can be dirty (given EDBP_HDIRTY and not yet
+//    written out) before a background thread starts writing out the dirty
+//    pages that are closest to being swapped out. This way page faults
+//    rarely have to write out (and checksum) the page they're swapping out
+//    before they can load theirs in. 0 (the default) means no background
+//    thread, dirty pages are only written out when they're swapped out.
+//    Like EDBP_CONFIG_TRACE this can be set with handles attached.
+//
+//  - EDBP_CONFIG_VERIFY (unsigned int): one of the EDBP_VERIFY_... values.
+//    Pages get a crc32c checksum when they're written out (only pages given
+//    EDBP_HDIRTY are written out, so any page modified without it will have
+//    the wrong checksum). With EDBP_VERIFY_ALWAYS every page loaded into
+//    the cache has its checksum checked, EDBP_VERIFY_SAMPLED (the default)
+//    only does 1 in EDBP_VERIFYSAMPLE of them and EDBP_VERIFY_OFF none. In
+//    arena mode, checking a page can take half as long as reading it in if
+//    it was already in the kernel's page cache, so EDBP_VERIFY_ALWAYS is
+//    for when you'd rather be sure than fast. A
+//    page that fails is reported with ODBTELEM_PAGES_CORRUPT and the
+//    edbp_startv that was loading it in returns ODB_ECRIT. Pages that have
+//    never been written out through the cache (a checksum of 0) are not
+//    checked. Does nothing if not compiled with EDB_OPT_CHECKSUMS. Can be
+//    set with handles attached.
+//
+//  - EDBP_CONFIG_PSI (unsigned int): starts a thread that watches the
+//    system's memory pressure (/proc/pressure/memory, see the kernel's PSI
+//    documentation) and shrinks the cache whenever tasks spent more than
+//    this many microseconds stalled on memory in a 2 second window. Each
+//    time it shrinks by an eighth, never below a quarter of the size set
+//    with EDBP_CONFIG_CACHESIZE, and it grows back once there has been no
+//    pressure for 10 seconds. 0 (the default) stops it. Can be set with
+//    handles attached.
+//
+//  - EDBP_CONFIG_HOTSET (int): a file descriptor (opened with O_RDWR) that
+//    the cache's hot set is saved to every minute and once more when the
+//    cache is freed. The hot set is every page in the cache with how hot the
+//    page replacement algorithm thinks it is and its hints, hottest first.
+//    Give the same file to edbp_warmup next time around to load those
+//    pages back in. -1 (the default) stops saving. Can be set with handles
+//    attached.
+//
+//  - EDBP_CONFIG_INDEXTIER (unsigned int): the percentage (0 to
+//    EDBP_INDEXTIERMAX) of each shard's slots that are kept for index pages.
+//    A page goes into this tier when it is finished with one of the
+//    EDBP_HINDEX... hints, and the page replacement algorithm can't swap it
+//    out while it's there. EDBP_HINDEX0 and EDBP_HINDEX1 pages stay until
+//    they're finished without an index hint (or with EDBP_HRESET). Once the
+//    tier is full, EDBP_HINDEX2 and EDBP_HINDEX3 pages make room for new
+//    index pages least recently used first. Non-index pages (like the
+//    ones a big scan goes through) never push pages out of the tier. If
+//    every other slot is locked, the tier gives up slots for the handles.
+//    Dirty pages in the tier are only written out once they leave it. 0
+//    (the default) means no tier. Can be set with handles attached.
+//
+//  - EDBP_CONFIG_NUMA (unsigned int): one of the EDBP_NUMA_... values,
+//    where the arenas' memory goes on a machine with more than one NUMA
+//    node. Only does anything in arena mode (see EDBP_CONFIG_ARENA), with
+//    EDBP_ARENA_OFF the pages are wherever the kernel's page cache put
+//    them.
+//
+//      EDBP_NUMA_OFF (default): the kernel's default policy, each page of
+//        the arena goes on the node of whichever thread touched it first.
+//      EDBP_NUMA_INTERLEAVE: the arenas are spread page by page across all
+//        of the nodes. Every worker sees the same (average) latency.
+//      EDBP_NUMA_LOCAL: the shards are split between the nodes (shard i on
+//        node i % nodes) and each shard's arena is kept on its node (so long
+//        as the node has memory left). Use with at least as many shards as
+//        there are nodes.
+//
+//  - EDBP_CONFIG_ZPOOL (unsigned int): megabytes of memory for the
+//    compressed tier, 0 (the default) for none. Only in arena mode. When a
+//    page that isn't dirty is swapped out it's compressed and kept in the
+//    tier, and a page fault looks there before going to the file. Pages
+//    that don't compress down to EDBP_ZRATIO of their size aren't kept.
+//    Once the tier is full the pages that went in first go first. It's
+//    split evenly between the shards. Can be set with handles attached.
 //
 // ERRORS:
 //
 //  - ODB_EINVAL - cache is null, opts is invalid.
-//  - ODB_EOPEN - cache has handles attached
+//  - ODB_EINVAL - value is 0, the cache size is less than the shards, or
+//                 shards is more than EDBP_SHARDMAX. Or an unknown
+//                 EDBP_ARENA_... value. Or straitmax is more than
+//                 EDBP_STRAITMAX. Or an unknown EDBP_PRA_... value. Or
+//                 a dirty ratio more than 100. Or an unknown
+//                 EDBP_VERIFY_... value. Or an index tier more than
+//                 EDBP_INDEXTIERMAX. Or an unknown EDBP_NUMA_... value.
+//                 Or (EDBP_CONFIG_CACHESIZE) shrinking
+//                 would leave a shard with fewer slots than its handles need.
+//                 Or (EDBP_CONFIG_PSI) the kernel didn't like the threshold.
+//  - ODB_EOPEN - cache has handles attached (other than EDBP_CONFIG_TRACE,
+//                EDBP_CONFIG_DIRTYRATIO, EDBP_CONFIG_VERIFY, EDBP_CONFIG_PSI,
+//                EDBP_CONFIG_HOTSET, EDBP_CONFIG_INDEXTIER,
+//                EDBP_CONFIG_ZPOOL and EDBP_CONFIG_CACHESIZE)
 //  - ODB_ENOMEM - (EDBP_CONFIG_CACHESIZE) not enough memory needed to resize
-//                 the cache to this size.
+//                 the cache to this size. (EDBP_CONFIG_ARENA,
+//                 EDBP_CONFIG_NUMA) not enough memory to allocate the arena.
+//  - ODB_EERRNO - (EDBP_CONFIG_PSI) couldn't open /proc/pressure/memory (a
+//                 kernel without PSI).
+//  - ODB_ECRIT - (EDBP_CONFIG_DIRTYRATIO, EDBP_CONFIG_PSI,
+//                EDBP_CONFIG_HOTSET) failed to start the thread.
 //
 odb_err edbp_cache_config(edbpcache_t *cache, edbp_config_opts opts, ...);
 
+// replays a page access trace (such as one recorded with EDBP_CONFIG_TRACE)
+// against the page replacement algorithm pra (an EDBP_PRA_... value) as if
+// it were a single shard of slotcount slots. No pages are actually loaded,
+// this is only to compare the hit rates of algorithms offline.
+//
+// o_hits is set to how many of the tracec accesses would have been in the
+// cache already.
+//
+// ERRORS:
+//  - ODB_EINVAL - pra is unknown, slotcount is 0, or a page id in the trace
+//                 is 0.
+//  - ODB_ENOMEM
+//  - ODB_ECRIT
+//
+// THREADING: MT-safe.
+odb_err edbp_pra_simulate(unsigned int pra, unsigned int slotcount,
+                          const edbp_trace *tracev, uint64_t tracec,
+                          uint64_t *o_hits);
+
+// asks for the pagec pages starting at id to be read in the background so
+// that starting them later doesn't have to wait on the disk. Pages that are
+// already in the cache are skipped. This only has the kernel read them
+// into its page cache (posix_fadvise(2) with POSIX_FADV_WILLNEED, in as few
+// requests as it can): nothing is loaded into the cache's slots, so nothing
+// is swapped out for them. Pages past the end of the file are ignored.
+//
+// ERRORS:
+//  - ODB_EINVAL - handle is null, id is 0 or pagec is not positive.
+//
+// THREADING: same as edbp_startv.
+odb_err edbp_prefetch(edbphandle_t *handle, odb_pid id, int pagec);
+
+// loads the pages of a hot set saved with EDBP_CONFIG_HOTSET (fd) back into
+// the cache. The hot set is read in and checked right away, the pages are
+// then loaded in by a thread of its own, hottest first, with consecutive
+// pages read in together, while workers go about their business. It only
+// loads as many pages as will fit in each shard next to what the handles
+// need, and stops early if the cache is freed. Pages past the end of the
+// file are skipped.
+//
+// The thread uses a handle of its own (see edbp_handle_init) until its done,
+// so this must be called after (or with room for) the other handles.
+//
+// An empty file is not an error, there's just nothing to warm up.
+//
+// ERRORS:
+//  - ODB_EINVAL - cache is null or the cache size hasn't been set.
+//  - ODB_EOPEN - a warm-up is already running.
+//  - ODB_EFILE - the file isn't a hot set, was half written, or is from a
+//                file with a different page size.
+//  - ODB_ENOSPACE - no room for the warm-up thread's handle.
+//  - ODB_EERRNO - failed to read the file.
+//  - ODB_ENOMEM
+//  - ODB_ECRIT
+//
+// THREADING: Not MT safe (same as edbp_handle_init)
+odb_err edbp_warmup(edbpcache_t *cache, int fd);
+
+
+// adds up the counters of all of the cache's handles (including the ones
+// that have been freed) into o_stats. See odbtelem_cachestats.
+//
+// The handles keep counting while this goes, so the sum is only roughly of
+// a single moment. Doesn't slow the handles down.
+//
+// ERRORS:
+//  - ODB_EINVAL - cache or o_stats is null
+//
+// THREADING: MT-safe.
+odb_err edbp_cache_stats(edbpcache_t *cache,
+                         struct odbtelem_cachestats *o_stats);
 
 // create handles for the cache.
 //
@@ -128,6 +422,7 @@ odb_err edbp_cache_config(edbpcache_t *cache, edbp_config_opts opts, ...);
 //  - ODB_ENOMEM - not enough memory
 //  - ODB_ENOSPACE - cannot create another handle because not enough space in
 //                   the cache. (did you call edbp_cache_config w/ EDBP_CONFIG_CACHESIZE?)
+//                   Each shard needs straitmax slots per handle.
 //  - ODB_ECRIT
 //
 // THREADING: Not MT safe.
@@ -152,7 +447,12 @@ typedef enum {
 // are performed to their completeness without having the page kicked out of
 // cache.
 //
-// edbp_start will load an existing page of a given id.
+// edbp_start will load an existing page of a given id. edbp_startv will load
+// the strait of pagec pages starting at id (pagec no more than what was set
+// with EDBP_CONFIG_STRAITMAX) and if o_pagev is not null, write the pointers
+// to each page into it. Any of those pages that need to be read in from the
+// file are read with as few calls as possible. edbp_start is the same as
+// edbp_startv with a pagec of 1.
 //
 // calling edbp_finish without having started a page will do nothing.
 //
@@ -168,27 +468,30 @@ typedef enum {
 //   ODB_EINVAL - edbp_start id was 0.
 //   ODB_EINVAL - edbp_start was called twice without calling
 //                edbp_finish
+//   ODB_EINVAL - pagec is 0 or more than the cache's straitmax
 //   ODB_EEOF   - Supplied id does not exist.
 //   ODB_ENOMEM - no memory left
-//   ODB_ECRIT
+//   ODB_ECRIT  - (also) a page failed its checksum, see EDBP_CONFIG_VERIFY.
 //
 // UNDEFINED:
 //   - using an unitialized handle / uninitialized cache
 odb_err edbp_start (edbphandle_t *handle, odb_pid id);
+odb_err edbp_startv(edbphandle_t *handle, odb_pid id, int pagec, void **o_pagev);
 void    edbp_finish(edbphandle_t *handle);
 
 // called between edbp_start and edbp_finish. Simply returns the
-// page that was locked successfully by edbp_start.
+// page that was locked successfully by edbp_start (the first page if
+// edbp_startv was used).
 //
 // If you attempt to call this without having a page locked, null
 // is returned (which you should never do).
 void *edbp_graw(const edbphandle_t *handle);
 
-// get the pid of the currently loaded page.
+// get the pid of the currently loaded page (the first if edbp_startv).
 odb_pid edbp_gpid(const edbphandle_t *handle);
 
 // edbp_mod applies special modifiecations to the page. This function will effect the page
-// that was referenced in the most recent edbp_start and must be called before the
+// (or all of the pages) that was referenced in the most recent edbp_start and must be called before the
 // edbp_finish.
 //
 //   EDBP_ECRYPT todo: not implemented
@@ -6,15 +6,22 @@
 #include "edbd.h"
 #include "edbp.h"
 
+// the huge page size that EDBP_ARENA_HUGE arenas are rounded up to.
+#define EDBP_HUGEPAGESIZE (2 * 1024 * 1024)
+
+// the most NUMA nodes EDBP_CONFIG_NUMA knows about, nodes past this are
+// ignored.
+#define EDBP_NUMAMAX 64
+
 // a slot is an index within the cache to where the page is.
 typedef unsigned int edbp_slotid;
 typedef struct {
 	void *page;
-	odb_pid id; // cache's mutexpagelock must be locked to access
+	odb_pid id; // shard's mutexpagelock must be locked to access
 
 	// the amount of workers that have this page locked. 0 for none.
 	// you must use a futex call to wait until the swap is complete.
-	// must have the caches pagelock locked to access
+	// must have the shard's pagelock locked to access
 	unsigned int locks;
 
 	// if 1 that means its currently undergoing a swap.
@@ -23,40 +30,332 @@ typedef struct {
 	// if 3 then swap had failed due to ENOMEM
 	uint32_t futex_swap;
 
+	// pra_hints are a bitmask to modify the behaviour of what happens to
+	// the page replacement algorithm. This must be set before unlockpages.
+	// See the edbp_praops for what each algorithm does with them.
+	edbp_hint pra_hints;
+
+	// LRU-K only (see edbp_pra_lruk):
+	//
 	// the pra_k is the LRU-K algo that will be set to 1 or 2 numbers to which
 	// symbolize the opcouter to when they were locked. See LRU-K for more
 	// information. pra_k is only modified inside lockpages.
 	//
-	// pra_hints are a bitmask to modify the behaviour of what happens to
-	// the LRU-K algorythem. This must be set before unlockpages.
-	//
-	// pra_score is calculated inside of unlockpages based off of
+	// pra_score is calculated once the slot is fully unlocked based off of
 	// pra_hints and pra_k and what ultimiately determains the
 	// swapability of a particular slot.
 	unsigned int pra_k[2]; // [0]=LRU-1 and [1]=LRU-2
-	edbp_hint pra_hints;
 	unsigned int pra_score;
+
+	// set to 1 when the page is given EDBP_HDIRTY and stays that way until
+	// the page is written back out (by the writeback thread or because it's
+	// being swapped out). Unlike pra_hints, later hints will not clear it.
+	//
+	// Only ever changed with slot_dirty/slot_clean (atomically) so the
+	// shard's dirtyc stays right.
+	int dirty;
+
+	// incremented every time a handle locks the slot. The writeback thread
+	// uses this to know if anyone had the page while it was writing it out.
+	// mutexpagelock must be locked to access.
+	unsigned int gen;
+
+	// the index tier list the slot is in (EDBP_TIERUPPER/EDBP_TIERLOWER),
+	// 0 if its not, and its neighbours in it (see edbp_shard.tierv). Must
+	// have the shard's mutexpagelock locked to access.
+	uint8_t     tier;
+	edbp_slotid tier_prev, tier_next;
+
+	// LRU-K only: where this slot is in the heap. -1 if it isn't in there
+	// (because its locked). Must have the shard's mutexpagelock locked to
+	// access.
+	edbp_slotid pra_heapi;
 } edbp_slot;
 
+// a bucket in the page-id-to-slot hash table. id of 0 means empty
+// (page 0 is never loaded into the cache).
+typedef struct {
+	odb_pid     id;
+	edbp_slotid slot;
+} edbp_bucket;
+
+// hash table helpers for bucketv tables (mask+1 buckets, a power of 2). The
+// table must never be full.
+//
+// edbp_bucket_find returns -1 if the id isn't in the table.
+// edbp_bucket_delete does nothing if the id isn't in the table.
+edbp_slotid edbp_bucket_find(const edbp_bucket *bucketv, uint64_t mask,
+                             odb_pid id);
+void        edbp_bucket_insert(edbp_bucket *bucketv, uint64_t mask,
+                               odb_pid id, edbp_slotid slot);
+void        edbp_bucket_delete(edbp_bucket *bucketv, uint64_t mask,
+                               odb_pid id);
+
+typedef struct edbp_shard edbp_shard;
+
+// a shard's slots are kept in chunks that never move (unlike a realloc'd
+// array) so that the shard can grow and shrink while handles have slots
+// pinned. Chunk k has EDBP_SLOTCHUNK << k slots in it, so there's only ever a
+// handful of them. See edbp_slotof.
+#define EDBP_SLOTCHUNK  64
+#define EDBP_SLOTCHUNKS 26
+
+// makes sure the shard has chunks for at least slotc slots, new slots are
+// 0'd out. edbp_slots_release frees the chunks that only have slots from
+// slotc onward.
+//
+// returns ODB_ENOMEM or ODB_ECRIT
+odb_err edbp_slots_reserve(edbp_shard *shard, edbp_slotid slotc);
+void    edbp_slots_release(edbp_shard *shard, edbp_slotid slotc);
+
+// page replacement algorithm (pra) operations. Each of the EDBP_PRA_...
+// values has one of these (see edbp-pra.c). Every shard keeps its own state
+// for it in its prav.
+//
+// All of these are called with the shard's mutexpagelock locked.
+typedef struct edbp_praops {
+	const char *name;
+
+	// sets up shard->prav (and anything the algorithm keeps in the slots)
+	// once the shard's slots have been allocated. All slots are empty and
+	// unlocked at this point.
+	//
+	// returns ODB_ENOMEM or ODB_ECRIT
+	odb_err (*init)(edbp_shard *shard);
+	void    (*free)(edbp_shard *shard);
+
+	// the page in slotid was found in the cache and has been locked (locks
+	// was already incremented, so it may have been 0 before this).
+	void (*hit)(edbp_shard *shard, edbp_slotid slotid);
+
+	// page id is not in the cache. Returns an unlocked slot for it to be
+	// loaded into or -1 if there is none (every slot is locked). The
+	// slot's id is still what was in it before (0 if it was empty), the
+	// caller will lock it and set the id after.
+	edbp_slotid (*fault)(edbp_shard *shard, odb_pid id);
+
+	// the slot is no longer locked by anyone. The slot's pra_hints are what
+	// it was finished with. If the slot's id is 0 then the page failed to
+	// load in and the slot is empty again.
+	void (*unlocked)(edbp_shard *shard, edbp_slotid slotid);
+
+	// fills o_slotv with up to slotc slots that are unlocked and dirty,
+	// the ones that would be swapped out soonest first, and returns how
+	// many. Only the slots closest to being swapped out need to be looked
+	// at. Used by the writeback thread.
+	int (*cold)(edbp_shard *shard, edbp_slotid *o_slotv, int slotc);
+
+	// the writeback thread has locked (pin) / unlocked (unpin) the slot.
+	// This isn't a use of the page so it shouldn't count as one. May be
+	// null if the algorithm doesn't need to know.
+	void (*pin)(edbp_shard *shard, edbp_slotid slotid);
+	void (*unpin)(edbp_shard *shard, edbp_slotid slotid);
+
+	// the shard's slot_count has grown from oldcount, the new slots are empty
+	// and unlocked.
+	//
+	// returns ODB_ENOMEM or ODB_ECRIT, in which case the shard goes back to
+	// oldcount.
+	odb_err (*grow)(edbp_shard *shard, edbp_slotid oldcount);
+
+	// the shard's slot_count was just decremented and the slot at slot_count
+	// (which is unlocked) is being taken away. Returns the slot that its page
+	// should be moved into: an empty slot or the one that would be swapped
+	// out next (never a locked one), which takes the place of the slot being
+	// taken away from then on. Returns slot_count if the page should be
+	// swapped out instead (or the slot was empty) and -1 if every other slot
+	// is locked.
+	edbp_slotid (*shrink)(edbp_shard *shard);
+
+	// how much the algorithm wants to keep the page that's in the slot,
+	// higher is more. Only used to put the pages of a hot set in order (see
+	// hotset_save) so it needn't be exact.
+	unsigned int (*heat)(const edbp_shard *shard, edbp_slotid slotid);
+} edbp_praops;
+
+extern const edbp_praops edbp_pra_lruk;
+extern const edbp_praops edbp_pra_clockpro;
+extern const edbp_praops edbp_pra_arc;
+
+// returns the operations for the EDBP_PRA_... value, null if its not one.
+const edbp_praops *edbp_pra_ops(unsigned int pra);
+
+// crc32c of len bytes of buf, continuing on from crc (0 to start). See
+// edbp-crc.c.
+uint32_t edbp_crc32c(uint32_t crc, const void *buf, size_t len);
+
+// edbp_crc32c done with the slicing-by-8 tables and with the sse4.2
+// instruction no matter what the cpu has, so the two can be checked against
+// each other. edbp_crc32c_hw returns 0 (and leaves *o_crc alone) if the cpu
+// doesn't have sse4.2.
+uint32_t edbp_crc32c_sw(uint32_t crc, const void *buf, size_t len);
+int      edbp_crc32c_hw(uint32_t crc, const void *buf, size_t len,
+                        uint32_t *o_crc);
+
+// compresses srcc bytes of src into dst (see edbp-lz.c). Returns the size
+// it compressed down to, or 0 if that would've been more than dstc.
+size_t edbp_lz_compress(const void *src, size_t srcc, void *dst, size_t dstc);
+
+// decompresses what edbp_lz_compress made (srcc bytes of src) into dst,
+// which must be exactly dstc bytes. Returns -1 if src is corrupted.
+int edbp_lz_decompress(const void *src, size_t srcc, void *dst, size_t dstc);
+
+// a page in the compressed tier (see EDBP_CONFIG_ZPOOL)
+typedef struct edbp_zpage {
+	odb_pid            id;
+	size_t             size; // of data
+	struct edbp_zpage *hnext; // next in the same bucket of zbucketv
+	struct edbp_zpage *newer, *older;
+	uint8_t            data[];
+} edbp_zpage;
+
+// a shard is an independent piece of the cache with its own lock and its own
+// slots. Each page id will only ever be loaded into one shard (see
+// edbp_shardof) so workers going after different pages very rarely touch the
+// same mutex.
+//
+// Aligned so that two shards' mutexes never share a cache line.
+struct edbp_shard {
+	pthread_mutex_t mutexpagelock;
+
+	// mutexpagelock must be locked to access opcounter;
+	unsigned long int opcoutner;
+
+	// slots (see EDBP_SLOTCHUNK). slot_count of them are in use,
+	// slotchunkc chunks are allocated. slot_target is the slot_count the
+	// shard is shrinking down to (see shard_shrinkstep), the same as slot_count
+	// otherwise.
+	//
+	// In arena mode, the pages of each chunk's slots are in arenav.
+	//
+	// mutexpagelock must be locked to access slot_count and slot_target.
+	// The chunks themselves can be read without it so long as the slot is
+	// pinned.
+	edbp_slot     *slotchunkv[EDBP_SLOTCHUNKS];
+	void          *arenav[EDBP_SLOTCHUNKS];
+	size_t         arenasizev[EDBP_SLOTCHUNKS];
+	unsigned int   slotchunkc;
+	edbp_slotid    slot_count;
+	edbp_slotid    slot_target;
+
+	// set to 1 while shard_shrinkstep is moving a page with mutexpagelock
+	// unlocked, the slot past slot_count is still in use until then so
+	// there's no other shrinking or growing. Broadcasted when back to 0.
+	// mutexpagelock must be locked to set.
+	uint32_t       futex_shrinking;
+
+	// the NUMA node the arenas are kept on (EDBP_NUMA_LOCAL), -1 for none.
+	int            node;
+
+	// page id -> slot lookup so that finding a page doesn't mean walking
+	// every slot. Open addressing with linear probing, there's bucket_mask+1
+	// buckets (a power of 2 and at least 4 times slot_count so the probes stay
+	// short, each slot can be in here twice, see lockpages).
+	//
+	// mutexpagelock must be locked to access.
+	edbp_bucket *bucketv;
+	uint64_t     bucket_mask;
+
+	// the page replacement algorithm that decides which slot to swap out on
+	// a page fault, and its state.
+	//
+	// mutexpagelock must be locked to access prav.
+	const edbp_praops *pra;
+	void              *prav;
+
+	// see edbpcache_t.slotboostCc, this is the shard's slot_count times that.
+	unsigned int slotboost;
+
+	// how many slots have their dirty set. Atomic.
+	edbp_slotid dirtyc;
+
+	// counts page loads for EDBP_VERIFY_SAMPLED. Atomic.
+	unsigned int verifyc;
+
+	// the index tier (see EDBP_CONFIG_INDEXTIER). tierv[EDBP_TIERUPPER] has
+	// the slots with depth 0-1 index pages in them, tierv[EDBP_TIERLOWER]
+	// depth 2-3, most recently used first. The tier holds a lock on each of
+	// its slots so the pra will never swap them out. tierc is how many are
+	// in both lists, which is no more than tiermax (unless tiermax was just
+	// lowered and they're in use). mutexpagelock must be locked to access.
+	struct {
+		edbp_slotid head, tail;
+	}           tierv[3];
+	edbp_slotid tierc;
+	edbp_slotid tiermax;
+
+	// the compressed tier (see EDBP_CONFIG_ZPOOL): pages that were swapped
+	// out clean, compressed. zbucketv is a chained hash table with
+	// zbucket_mask+1 buckets (null when the tier has never been used),
+	// znewest/zoldest the order they went in. zbytes is how much they take
+	// up, no more than zmax. A page is never in both the tier and a slot.
+	// mutexpagelock must be locked to access.
+	edbp_zpage **zbucketv;
+	uint64_t     zbucket_mask;
+	edbp_zpage  *znewest, *zoldest;
+	edbp_slotid  zcount;
+	size_t       zbytes;
+	size_t       zmax;
+} __attribute__((aligned(64)));
+
+#define EDBP_TIERUPPER 1
+#define EDBP_TIERLOWER 2
+
+// the first slot in chunk k.
+static inline edbp_slotid edbp_slotchunkstart(unsigned int k) {
+	return EDBP_SLOTCHUNK * ((1u << k) - 1);
+}
+
+// the chunk that slot id is in.
+static inline unsigned int edbp_slotchunk(edbp_slotid id) {
+	return 31 - __builtin_clz(id / EDBP_SLOTCHUNK + 1);
+}
+
+static inline edbp_slot *edbp_slotof(const edbp_shard *shard, edbp_slotid id) {
+	unsigned int k = edbp_slotchunk(id);
+	return &shard->slotchunkv[k][id - edbp_slotchunkstart(k)];
+}
+
+// a handle's counters (see edbp_cache_stats). Only the handle's own thread
+// ever writes to them so they're just relaxed loads and stores, no locked
+// instructions.
+typedef struct {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t dirtyevictions;
+	uint64_t swapwaits;
+	uint64_t faultlatencyv[ODBTELEM_LATENCYC];
+	uint64_t zhits;
+	uint64_t zstores;
+	uint64_t zrawbytes;
+	uint64_t zbytes;
+	uint64_t zdecompressns;
+} edbp_stats;
+
 // the cahce, installed in the host
 typedef struct edbpcache_t {
 	int initialized; // 0 for not, 1 for yes.
 	const edbd_t *fd;
 
-	// slots
-	edbp_slot     *slots;
-	edbp_slotid    slot_count; // the total amount of slots regardless of width
+	// shards. shardc is never 0 after edbp_cache_init.
+	edbp_shard    *shardv;
+	unsigned int   shardc;
+	edbp_slotid    slot_count; // the total amount of slots in all shards.
+
+	// the cache size that was set with EDBP_CONFIG_CACHESIZE, slot_count is
+	// only ever less than this when the psi thread has shrunk the cache.
+	edbp_slotid    slot_max;
 
 	// used explicitly for returning ODB_EINVAL in edbp_newhandle when this
-	// exceeds slot_count.
+	// times straitmax exceeds the slot_count of the smallest shard: every
+	// handle could be after a full strait in the same shard at once.
+	// wbmutex must be locked to add to it (so it's checked together with
+	// slot_count), atomic otherwise.
 	unsigned int handles;
 
-	// Every time there's a page fault, we increment next start and modulus it
-	// against slot count. This will make the iterator start not at the
-	// same spot everytime. Adding a bit of randomness to the mix, which is
-	// helpful, the more spread out the workers are in the slots the more
-	// evenly slots will be used.
-	edbp_slotid    slot_nextstart;
+	// the most pages a handle can have pinned at once. See
+	// EDBP_CONFIG_STRAITMAX.
+	unsigned int straitmax;
 
 	// slotboostCc is a number from 0 to 1 that is multipled by
 	// slot_count and the result is stored in slotboost. This is done
@@ -69,27 +368,156 @@ typedef struct edbpcache_t {
 	// The exact details of this are murky. Honestly you should only play with
 	// these numbers for expermiental reaons.
 	float slotboostCc; //(assigned to constant on startup)
-	unsigned int   slotboost;
 
-	pthread_mutex_t mutexpagelock;
+	// see EDBP_CONFIG_ARENA. If arena is not EDBP_ARENA_OFF then every
+	// slot's page is in its shard's arenav and a slot's page pointer never
+	// changes.
+	unsigned int arena;
 
+	// see EDBP_CONFIG_NUMA. nodemask has a bit set for every online node,
+	// nodec of them.
+	unsigned int  numa;
+	uint64_t      nodemask;
+	unsigned int  nodec;
 
-	// mutexpagelock must be locked to access opcounter;
-	unsigned long int opcoutner;
+	// see EDBP_CONFIG_PRA
+	unsigned int pra;
+
+	// see EDBP_CONFIG_TRACE. -1 when not tracing.
+	int tracefd;
+
+	// see EDBP_CONFIG_VERIFY
+	unsigned int verify;
+
+	// see EDBP_CONFIG_INDEXTIER. wbmutex must be locked to change it.
+	unsigned int indextier;
+
+	// see EDBP_CONFIG_ZPOOL (megabytes). wbmutex must be locked to change it.
+	unsigned int zpool;
+
+	// the hot set thread (see EDBP_CONFIG_HOTSET) saves the hot set to
+	// hotsetfd every EDBP_HOTSETINTERVAL. Writing to hsstopfd (an eventfd)
+	// stops it. hotsetfd is -1 when its not running.
+	int       hotsetfd;
+	int       hsrunning;
+	pthread_t hsthread;
+	int       hsstopfd;
+
+	// the warm-up thread (see edbp_warmup). Setting warmstop makes it stop
+	// early.
+	int       warmrunning;
+	int       warmstop;
+	pthread_t warmthread;
+
+	// the writeback thread (see EDBP_CONFIG_DIRTYRATIO). It only runs when
+	// dirtyratio isn't 0. wbmutex is held by the thread while it goes
+	// through the shards (so must be locked to swap out shardv or resize the
+	// cache) and protects dirtyratio. wbcond wakes it up early.
+	unsigned int    dirtyratio;
+	int             wbrunning;
+	pthread_t       wbthread;
+	pthread_mutex_t wbmutex;
+	pthread_cond_t  wbcond;
+
+	// the psi thread (see EDBP_CONFIG_PSI). psifd is the trigger it polls
+	// on, -1 when its not running. Writing to psistopfd (an eventfd) stops
+	// it.
+	int       psirunning;
+	pthread_t psithread;
+	int       psifd;
+	int       psistopfd;
+
+	// every handle (for edbp_cache_stats), linked through statsnext. When a
+	// handle is freed its counters are added to statsfreed. statsmutex must
+	// be locked to access either.
+	struct edbphandle_t *handlev;
+	edbp_stats           statsfreed;
+	pthread_mutex_t      statsmutex;
 
 } edbpcache_t;
 
+// returns the shard that the page id belongs to.
+//
+// Not the same hash as the shard's bucketv uses, otherwise every page in a
+// shard would land in the same handful of buckets.
+static inline edbp_shard *edbp_shardof(const edbpcache_t *cache, odb_pid id) {
+	return &cache->shardv[((id * 0xC2B2AE3D27D4EB4FULL) >> 40) % cache->shardc];
+}
+
+// how many trace records a handle will hold before writing them out.
+#define EDBP_TRACEBUF 256
+
+// the most slots the writeback thread will pin at once, and how long (in
+// milliseconds) it sleeps between going through the shards.
+#define EDBP_WBBATCH 16
+#define EDBP_WBINTERVAL 100
+
+// the psi thread's trigger window (microseconds). With EDBP_CONFIG_PSI, every
+// time there's memory pressure the cache is shrunk by 1/EDBP_PSISTEP of its
+// size (never below 1/EDBP_PSIMIN of slot_max), and after EDBP_PSIQUIET
+// milliseconds without any it grows back by 1/EDBP_PSISTEP of slot_max.
+#define EDBP_PSIWINDOW 2000000
+#define EDBP_PSISTEP   8
+#define EDBP_PSIMIN    4
+#define EDBP_PSIQUIET  10000
+
+// what the psi thread does when it wakes up: shrinks the cache by a step if
+// pressure is non-0, otherwise grows it back by a step. Returns the cache's
+// size afterwards (which stays put if the handles need more slots than the
+// step would leave).
+//
+// THREADING: MT-safe, locks wbmutex.
+edbp_slotid edbp_psi_step(edbpcache_t *cache, int pressure);
+
+// the start of a hot set file (see EDBP_CONFIG_HOTSET), followed by pagec
+// edbp_hotpages hottest first. crc is the edbp_crc32c of those, so a hot set
+// that was only half written out is never used.
+typedef struct edbp_hotsethead {
+	uint32_t magic;    // EDBP_HOTSETMAGIC
+	uint32_t pagesize; // edbd_size of the file it was saved from
+	uint64_t pagec;
+	uint32_t crc;
+	uint32_t _reserved;
+} edbp_hotsethead;
+
+#define EDBP_HOTSETMAGIC 0x7465736f // "oset"
+
+// how often (milliseconds) the hot set thread saves the hot set.
+#define EDBP_HOTSETINTERVAL 60000
+
+// the warm-up thread goes through the hot set this many pages at a time,
+// each lot is sorted by page id so that consecutive pages are read in
+// together.
+#define EDBP_WARMWINDOW 256
+
+// the name the warm-up thread's handle goes by (in traces).
+#define EDBP_WARMHANDLE ((unsigned int)-1)
+
 // the handle, installed in the worker.
 typedef struct edbphandle_t {
 	edbpcache_t *parent;
 
-	// modified via edbp_start and edbp_finish.
-	// -1 means nothing is locked.
-	// later: this will remain one until I get strait-pras in.
-	//        but just assume this is always an array lockedslotc in size.
-	edbp_slotid lockedslotv;
+	// the cache's handlev list.
+	struct edbphandle_t *statsnext, *statsprev;
+
+	// modified via edbp_startv and edbp_finish. The slots (and the shards
+	// they're in) of the pages the handle has pinned, lockedslotc long.
+	// lockedslotc is 0 when nothing is pinned.
+	edbp_slotid lockedslotv[EDBP_STRAITMAX];
+	edbp_shard *lockedshardv[EDBP_STRAITMAX];
+	int         lockedslotc;
 
 	unsigned int name;
+
+	// pages that have been finished but not yet written to the parent's
+	// tracefd.
+	edbp_trace tracev[EDBP_TRACEBUF];
+	int        tracec;
+
+	// see edbp_stats. On cache lines of their own (the handle is allocated
+	// aligned) so edbp_cache_stats doesn't keep taking away the lines the
+	// handle is working out of.
+	edbp_stats stats __attribute__((aligned(64)));
 } edbphandle_t;
 
 
@@ -369,224 +369,543 @@ odb_err edbs_jobread(edbs_job_t jh, void *buff, int count) {
 
 }
 
-odb_err edbs_jobselect(const edbs_handle_t *shm, edbs_job_t *o_job,
-                       unsigned int ownerid) {
-	if(ownerid == 0) {
-		log_critf("jobselect has 0 ownerid");
-		return ODB_EINVAL;
+// helper to the reserve/commit functions: where the caller's head is as a
+// pointer. If there's no mirror and count bytes from there would wrap past
+// the end of the buffer, returns null.
+static uint8_t *jobbuff(edbs_job_t jh, uint32_t pos, int count) {
+	edbs_shmjob_t *job = &jh.shm->jobv[jh.jobpos];
+	if(jh.shm->transmirror) {
+		return (uint8_t *)jh.shm->transmirror + 2 * job->transferbuffoff
+		       + pos;
+	}
+	if(pos + count > job->transferbuffcapacity) {
+		return 0;
 	}
+	return (uint8_t *)jh.shm->transbuffer + job->transferbuffoff + pos;
+}
 
-	// save some pointers to the stack for easier access.
-	o_job->shm = shm;
-	o_job->descriptortype = 1;
-	edbs_shmhead_t *const head = shm->head;
-	const uint64_t jobc = head->jobc;
-	edbs_shmjob_t *const jobv = shm->jobv;
+odb_err edbs_jobwritereserve(edbs_job_t jh, int count, void **o_buff) {
+	edbs_shmjob_t *job = &jh.shm->jobv[jh.jobpos];
+	if(count < 0 || count > job->transferbuffcapacity) {
+		return ODB_EBUFFSIZE;
+	}
 
+	// get the descriptor (see edbs_jobwrite)
+	unsigned int *pos;
+	unsigned int *bytes, *obytes;
+	uint32_t *hold;
+	if(jh.descriptortype) {
+		if(!(job->transferbuff_FLAGS & EDBS_JFINSTALLWRITE)) {
+			log_critf("job executor's first directive was write, not read");
+			return ODB_EBADE;
+		}
+		pos = &job->executorhead;
+		bytes = &job->executorbytes;
+		obytes = &job->installerbytes;
+		hold = &job->futex_executorwritehold;
+	} else {
+		job->transferbuff_FLAGS |= EDBS_JFINSTALLWRITE;
+		pos = &job->installerhead;
+		bytes = &job->installerbytes;
+		obytes = &job->executorbytes;
+		hold = &job->futex_installerwritehold;
+	}
 
+	// if the installer has termed, the executor's writes are ignored. We
+	// still hand them somewhere to write and edbs_jobwritecommit won't do
+	// anything with it.
+	if(jh.descriptortype && job->transferbuff_FLAGS & EDBS_JINSTALLERTERM) {
+		uint8_t *b = jobbuff(jh, *pos, count);
+		if(!b) return ODB_EBUFFSIZE;
+		*o_buff = b;
+		return 0;
+	}
 
-	// we wait outside the mutex because if we were to wait inside of the
-	// mutex that would prevent any jobs from being installed, thus
-	// deadlocking us.
-	rehold:
-	futex_wait(&head->futex_selectorhold, 1);
+	// wait until there's count bytes of room in front of our head. If
+	// there's not, we put a write hold on ourselves which they'll clear when
+	// they read (we know they have something to read sense we're full
+	// enough to not fit count).
+	uint32_t at;
+	for(;;) {
+		futex_wait(hold, 1);
+		pthread_mutex_lock(&job->pipemutex);
+		if(job->transferbuff_FLAGS & EDBS_JEXECUTERTERM) {
+			pthread_mutex_unlock(&job->pipemutex);
+			return ODB_EPIPE;
+		}
+		if(*obytes) {
+			pthread_mutex_unlock(&job->pipemutex);
+			return ODB_EPROTO;
+		}
+		if(job->transferbuffcapacity - *bytes >= count) {
+			at = *pos;
+			pthread_mutex_unlock(&job->pipemutex);
+			break;
+		}
+		*hold = 1;
+		pthread_mutex_unlock(&job->pipemutex);
+	}
 
+	// atp: the count bytes in front of our head are ours until we commit,
+	//      they can't read them until then.
+	uint8_t *b = jobbuff(jh, at, count);
+	if(!b) return ODB_EBUFFSIZE;
+	*o_buff = b;
+	return 0;
+}
 
-	// atp: although our futex_selectorhold has returned, sense we're outside of a mutex,
-	//      there's a chance that another thread has already changed this value.
-	//      So you'll see the first if statement we ask
-	//      inside of the mutex is if we should re-hold.
+odb_err edbs_jobwritecommit(edbs_job_t jh, int count) {
+	edbs_shmjob_t *job = &jh.shm->jobv[jh.jobpos];
+	if(!count) return 0;
 
-	// now we need to find a new job.
-	// Firstly, we need to atomically lock all workers so that only one can accept a job at once to
-	// avoid the possibility that 2 workers accidentally take the same job.
-	pthread_mutex_lock(&head->jobmutex);
+	// get the descriptor (see edbs_jobwrite)
+	unsigned int *pos;
+	unsigned int *bytes;
+	uint32_t *hold, *ohold;
+	if(jh.descriptortype) {
+		if(job->transferbuff_FLAGS & EDBS_JINSTALLERTERM) {
+			return 0;
+		}
+		pos = &job->executorhead;
+		bytes = &job->executorbytes;
+		hold = &job->futex_executorwritehold;
+		ohold = &job->futex_installerreadhold;
+	} else {
+		pos = &job->installerhead;
+		bytes = &job->installerbytes;
+		hold = &job->futex_installerwritehold;
+		ohold = &job->futex_executorreadhold;
+	}
 
-	// check for ODB_ECLOSED.
-	if(!head->newjobs && head->futex_status != EDBS_SRUNNING) {
-		pthread_mutex_unlock(&head->jobmutex);
-		return ODB_ECLOSED;
+	pthread_mutex_lock(&job->pipemutex);
+	if(job->transferbuff_FLAGS & EDBS_JEXECUTERTERM) {
+		pthread_mutex_unlock(&job->pipemutex);
+		return ODB_EPIPE;
+	}
+	if(count < 0 || job->transferbuffcapacity - *bytes < count) {
+		pthread_mutex_unlock(&job->pipemutex);
+		log_critf("committed more bytes than were reserved");
+		return ODB_EINVAL;
 	}
 
-	// see above atp.
-	if(head->futex_selectorhold == 1) {
-		pthread_mutex_unlock(&head->jobmutex);
-		goto rehold;
+	// same as the end of edbs_jobwrite, but for all count bytes at once.
+	*bytes += count;
+	*pos = (*pos + count) % job->transferbuffcapacity;
+	*hold = *bytes == job->transferbuffcapacity;
+	if(*ohold) {
+		*ohold = 0;
+		futex_wake(ohold, 1);
+	}
+	if(jh.descriptortype) {
+		job->futex_exetermhold = 1;
 	}
+	pthread_mutex_unlock(&job->pipemutex);
+	return 0;
+}
 
-	// atp: the host is EDBS_SRUNNING and newjobs is at least 1.
-#ifdef EDB_FUCKUPS
-	if(head->newjobs == 0) {
-		log_critf("edbs_jobselect got in without any newjobs");
+odb_err edbs_jobreadreserve(edbs_job_t jh, int count, const void **o_buff) {
+	edbs_shmjob_t *job = &jh.shm->jobv[jh.jobpos];
+	if(count < 0 || count > job->transferbuffcapacity) {
+		return ODB_EBUFFSIZE;
 	}
-#endif
 
-	// if we're here that means we know that there's at least 1 new job.
-	// lets find it.
-	edbs_shmjob_t *job;
-	{
-		unsigned int i;
-		for (i = 0; i < jobc; i++) {
-			o_job->jobpos = head->jobacpt_next;
-			job = &jobv[head->jobacpt_next];
-			head->jobacpt_next = (head->jobacpt_next + 1) % jobc;
-			if (job->owner == 0 && job->jobtype != 0)  {
-				// if we're here then we know this job is not owned
-				// and has a job. We'll break out of the for loop.
-				break;
-			}
+	// get the descriptor (see edbs_jobread)
+	unsigned int *pos;
+	unsigned int *obytes;
+	uint32_t *hold;
+	if(jh.descriptortype) {
+		if(job->transferbuff_FLAGS & EDBS_JEXECUTERTERM) {
+			return ODB_ECLOSED;
+		}
+		pos = &job->executorhead;
+		obytes = &job->installerbytes;
+		hold = &job->futex_executorreadhold;
+	} else {
+		if(!(job->transferbuff_FLAGS & EDBS_JFINSTALLWRITE)) {
+			return ODB_EBADE;
+		}
+		if(job->transferbuff_FLAGS & EDBS_JINSTALLERTERM) {
+			return ODB_ECLOSED;
 		}
-		if (i == jobc) {
-			// this is a critical error. If we're here that meas we went through
-			// the entire stack and didn't find an open job. Sense newjobs
-			// was supposed to be at least 1 that means I programmed something wrong.
-			//
-			// The first thread that enters into here will not be the last as futher
-			// threads will discover the same thing.
-			pthread_mutex_unlock(&head->jobmutex);
-			log_critf("although newjobs was at least 1, an open job was not found in the stack.");
-			return ODB_ECRIT;
+		pos = &job->installerhead;
+		obytes = &job->executorbytes;
+		hold = &job->futex_installerreadhold;
+	}
+
+	// wait until they've written count bytes in front of our head. If they
+	// haven't, we put a read hold on ourselves which they'll clear on their
+	// next write (or term).
+	uint32_t at;
+	for(;;) {
+		futex_wait(hold, 1);
+		pthread_mutex_lock(&job->pipemutex);
+		if(*obytes >= count) {
+			at = *pos;
+			pthread_mutex_unlock(&job->pipemutex);
+			break;
+		}
+		if(job->transferbuff_FLAGS & EDBS_JEXECUTERTERM) {
+			// (installer) nothing else is coming.
+			if(*obytes) {
+				log_warnf("attempt to read from execution-terminated job "
+				          "pipe with expected payload not equal to "
+				          "remaining bytes (expected %d bytes, only %d "
+				          "available)", count, *obytes);
+			}
+			pthread_mutex_unlock(&job->pipemutex);
+			return ODB_EEOF;
 		}
+		*hold = 1;
+		pthread_mutex_unlock(&job->pipemutex);
 	}
 
-	// at this point, job is pointing to an open job.
-	// so lets go ahead and set the job ownership to us.
-	job->owner = ownerid;
-	head->newjobs--; // 1 less job that is without an owner.
-	if(head->newjobs == 0) {
-		head->futex_selectorhold = 1;
+	// atp: the count bytes in front of our head stay put until we commit,
+	//      they can't write over them until then.
+	uint8_t *b = jobbuff(jh, at, count);
+	if(!b) return ODB_EBUFFSIZE;
+	*o_buff = b;
+	return 0;
+}
+
+odb_err edbs_jobreadcommit(edbs_job_t jh, int count) {
+	edbs_shmjob_t *job = &jh.shm->jobv[jh.jobpos];
+	if(!count) return 0;
+
+	// get the descriptor (see edbs_jobread)
+	unsigned int *pos;
+	unsigned int *obytes;
+	uint32_t *hold, *ohold;
+	if(jh.descriptortype) {
+		pos = &job->executorhead;
+		obytes = &job->installerbytes;
+		hold = &job->futex_executorreadhold;
+		ohold = &job->futex_installerwritehold;
+	} else {
+		pos = &job->installerhead;
+		obytes = &job->executorbytes;
+		hold = &job->futex_installerreadhold;
+		ohold = &job->futex_executorwritehold;
 	}
 
-	// we're done filing all the paperwork to have ownership over this job. thus no more need to have
-	// the ownership logic locked for other thread. We can continue to do this job.
-	telemetry_workr_accepted(ownerid, o_job->jobpos);
-	pthread_mutex_unlock(&head->jobmutex);
+	pthread_mutex_lock(&job->pipemutex);
+	if(count < 0 || *obytes < count) {
+		pthread_mutex_unlock(&job->pipemutex);
+		log_critf("committed more bytes than were reserved");
+		return ODB_EINVAL;
+	}
 
-	// if we're here that means we've accepted the job at jobv[self->jobpos] and we've
-	// claimed it so other workers won't bother this job.
+	// same as the end of edbs_jobread, but for all count bytes at once.
+	*obytes -= count;
+	*pos = (*pos + count) % job->transferbuffcapacity;
+	if(*obytes == 0) {
+		*hold = 1;
+	}
+	*ohold = 0;
+	futex_wake(ohold, 1);
+	if(!jh.descriptortype && *obytes == 0) {
+		job->futex_exetermhold = 0;
+		futex_wake(&job->futex_exetermhold, 1);
+	}
+	pthread_mutex_unlock(&job->pipemutex);
 	return 0;
 }
 
-odb_err edbs_jobinstall(const edbs_handle_t *h,
-                        odb_jobtype_t jobclass,
-                        edbs_job_t *o_job) {
-	// easy ptrs
-	odb_err err;
-	edbs_shmjob_t *jobv = h->jobv;
-	edbs_shmhead_t *const head = h->head;
-	const uint64_t jobc = head->jobc;
-	o_job->shm = h;
-	o_job->descriptortype = 0;
+// pushes jobposc indexes from jobposv into ring. See edbs_shmring_t.
+//
+// They'll be in a row in the ring, the selectors will only see them once
+// they're all pushed.
+static void ring_pushv(const edbs_handle_t *h, edbs_shmring_t *ring,
+                       const uint32_t *jobposv, uint32_t jobposc) {
+	edbs_shmcell_t *const cellv = h->shm + ring->celloff;
+	const uint32_t mask = h->head->ringmask;
+	uint32_t pos = __atomic_load_n(&ring->enqueue, __ATOMIC_RELAXED);
+	for(;;) {
+		// all the cells from pos on need to be empty. There's more cells than
+		// there are job slots so the ring is never really full, but a cell
+		// can still have the older seq for a moment: a popper that has
+		// already moved dequeue past it may not have stored its new seq yet.
+		// Then we just spin until it does.
+		uint32_t i;
+		for(i = 0; i < jobposc; i++) {
+			uint32_t seq = __atomic_load_n(&cellv[(pos + i) & mask].seq,
+			                               __ATOMIC_ACQUIRE);
+			if(seq != pos + i) break;
+		}
+		if(i == jobposc) {
+			// try to get them before another pusher does.
+			if(__atomic_compare_exchange_n(&ring->enqueue, &pos, pos + jobposc,
+			                               1, __ATOMIC_RELAXED,
+			                               __ATOMIC_RELAXED)) {
+				break;
+			}
+			// (pos was reloaded by the failed exchange)
+		} else {
+			// someone else already got pos, or (see above) a popper is still
+			// on its way out of one of the cells.
+			pos = __atomic_load_n(&ring->enqueue, __ATOMIC_RELAXED);
+		}
+	}
+	for(uint32_t i = 0; i < jobposc; i++) {
+		edbs_shmcell_t *cell = &cellv[(pos + i) & mask];
+		cell->jobpos = jobposv[i];
+		__atomic_store_n(&cell->seq, pos + i + 1, __ATOMIC_RELEASE);
+	}
+}
 
-	rehold:
-	// if there's no open spots in the job buffer we wait. Yes, we are
-	// clogging up the mutex, but those threads will also have to wait.
-	futex_wait(&head->futex_installerhold, 1);
+// pops up to jobposc indexes out of ring and into o_jobposv. See
+// edbs_shmring_t.
+//
+// returns the amount popped, 0 if it was empty.
+static uint32_t ring_popv(const edbs_handle_t *h, edbs_shmring_t *ring,
+                          uint32_t *o_jobposv, uint32_t jobposc) {
+	edbs_shmcell_t *const cellv = h->shm + ring->celloff;
+	const uint32_t mask = h->head->ringmask;
+	uint32_t pos = __atomic_load_n(&ring->dequeue, __ATOMIC_RELAXED);
+	uint32_t c;
+	for(;;) {
+		// count how many cells from pos on have been pushed.
+		int32_t dif = 0;
+		for(c = 0; c < jobposc; c++) {
+			uint32_t seq = __atomic_load_n(&cellv[(pos + c) & mask].seq,
+			                               __ATOMIC_ACQUIRE);
+			dif = (int32_t)(seq - (pos + c + 1));
+			if(dif) break;
+		}
+		if(c) {
+			if(__atomic_compare_exchange_n(&ring->dequeue, &pos, pos + c, 1,
+			                               __ATOMIC_RELAXED,
+			                               __ATOMIC_RELAXED)) {
+				break;
+			}
+		} else if(dif < 0) {
+			// nothing has been pushed into pos yet (or it has been but the
+			// pusher hasn't gotten to setting seq, which we count as empty
+			// too: they'll bump the eventcount after they're done).
+			return 0;
+		} else {
+			pos = __atomic_load_n(&ring->dequeue, __ATOMIC_RELAXED);
+		}
+	}
+	for(uint32_t i = 0; i < c; i++) {
+		edbs_shmcell_t *cell = &cellv[(pos + i) & mask];
+		o_jobposv[i] = cell->jobpos;
+		__atomic_store_n(&cell->seq, pos + i + mask + 1, __ATOMIC_RELEASE);
+	}
+	return c;
+}
 
-	// atp: see the atp in edbs_jobselect after its futex_wait.
+// increments the eventcount and wakes up to count waiters, but only if
+// there's any.
+static void post(uint32_t *futex, uint32_t *waiters, uint32_t count) {
+	__atomic_add_fetch(futex, 1, __ATOMIC_SEQ_CST);
+	if(__atomic_load_n(waiters, __ATOMIC_SEQ_CST)) {
+		futex_wake(futex, count);
+	}
+}
 
-	// lock the job install mutex. So we don't try to install a job into a slot
-	// that's currently being cleared out as completed.
-	pthread_mutex_lock(&head->jobmutex);
-	//**defer: pthread_mutex_unlock(&head->jobmutex);
+// helper to edbs_jobinstall and edbs_jobclose: tells edbs_host_close that
+// something it's waiting on has changed. Must be called after the change.
+static void post_hasjobs(edbs_shmhead_t *head) {
+	if(__atomic_load_n(&head->futex_status, __ATOMIC_SEQ_CST)
+	   != EDBS_SRUNNING) {
+		__atomic_add_fetch(&head->futex_hasjobs, 1, __ATOMIC_SEQ_CST);
+		futex_wake(&head->futex_hasjobs, INT32_MAX);
+	}
+}
 
-	// check for ODB_ECLOSED
-	if(head->futex_status != EDBS_SRUNNING) {
-		pthread_mutex_unlock(&head->jobmutex);
-		return ODB_ECLOSED;
+// helper to edbs_jobinstall: undoes its increment of head->installing.
+static void install_done(edbs_shmhead_t *head) {
+	__atomic_sub_fetch(&head->installing, 1, __ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&head->futex_status, __ATOMIC_SEQ_CST)
+	   != EDBS_SRUNNING) {
+		// the selectors could be waiting for us to be the last install so
+		// they can return ODB_ECLOSED.
+		__atomic_add_fetch(&head->futex_selectors, 1, __ATOMIC_SEQ_CST);
+		futex_wake(&head->futex_selectors, INT32_MAX);
+		post_hasjobs(head);
 	}
+}
 
-	// see above atp
-	if(head->futex_installerhold == 1) {
-		pthread_mutex_unlock(&head->jobmutex);
-		goto rehold;
+odb_err edbs_jobselect(const edbs_handle_t *shm, edbs_job_t *o_job,
+                       unsigned int ownerid) {
+	if(ownerid == 0) {
+		log_critf("jobselect has 0 ownerid");
+		return ODB_EINVAL;
 	}
 
+	// save some pointers to the stack for easier access.
+	o_job->shm = shm;
+	o_job->descriptortype = 1;
+	edbs_shmhead_t *const head = shm->head;
+	edbs_shmjob_t *const jobv = shm->jobv;
 
-	// if we're here we know there's at least 1 empty job slot and status is
-	// EDBS_SRUNNING
-	int i;
-	edbs_shmjob_t *job;
-	for(i = 0; i < jobc; i++) {
-		o_job->jobpos = head->jobinst_next;
-		job = &jobv[head->jobinst_next];
-		head->jobinst_next = (head->jobinst_next + 1) % jobc;
-		if (job->owner == 0 && job->jobtype == 0) {
-			// here we have an empty job with no owner, we can install it here.
+	// find a new job. No locks needed: whoever pops the index owns the job.
+	uint32_t jobpos;
+	while(!ring_popv(shm, &head->newring, &jobpos, 1)) {
+
+		// nothing there. We'll have to wait for an install. We read the
+		// eventcount before we check again so we can't miss one that
+		// happens between the check and the wait.
+		__atomic_add_fetch(&head->selectorwaiters, 1, __ATOMIC_SEQ_CST);
+		uint32_t seq = __atomic_load_n(&head->futex_selectors,
+		                               __ATOMIC_SEQ_CST);
+		if(ring_popv(shm, &head->newring, &jobpos, 1)) {
+			__atomic_sub_fetch(&head->selectorwaiters, 1, __ATOMIC_SEQ_CST);
 			break;
 		}
+
+		// check for ODB_ECLOSED: the host has stopped and there's no installs
+		// left that could still push a job. Check one last time after
+		// that sense the last install could have pushed between our pop
+		// and seeing installing at 0.
+		if(__atomic_load_n(&head->futex_status, __ATOMIC_SEQ_CST)
+		   != EDBS_SRUNNING
+		   && __atomic_load_n(&head->installing, __ATOMIC_SEQ_CST) == 0) {
+			__atomic_sub_fetch(&head->selectorwaiters, 1, __ATOMIC_SEQ_CST);
+			if(ring_popv(shm, &head->newring, &jobpos, 1)) {
+				break;
+			}
+			return ODB_ECLOSED;
+		}
+
+		futex_wait(&head->futex_selectors, seq);
+		__atomic_sub_fetch(&head->selectorwaiters, 1, __ATOMIC_SEQ_CST);
 	}
 
+	// atp: we've popped the job at jobv[jobpos] and no other worker will.
+	o_job->jobpos = jobpos;
+	edbs_shmjob_t *job = &jobv[jobpos];
 #ifdef EDB_FUCKUPS
-	if (i == jobc) {
-		// this is a critical error. We should always have found an open
-		// job because the futex let us through.
-		pthread_mutex_unlock(&head->jobmutex);
-		log_critf("although empty was at least 1, an open job was not "
-		          "found in the stack.");
-		return ODB_ECRIT;
+	if(job->owner != 0 || job->jobtype == 0) {
+		log_critf("popped a job from newring that was owned or empty");
 	}
 #endif
+	job->owner = ownerid;
+	__atomic_sub_fetch(&head->newjobs, 1, __ATOMIC_RELAXED);
+	telemetry_workr_accepted(ownerid, o_job->jobpos);
 
-	// install the job
-	job->jobtype = jobclass;
-	job->jobid = h->head->nextjobid++;
+	// if we're here that means we've accepted the job at jobv[self->jobpos] and we've
+	// claimed it so other workers won't bother this job.
+	return 0;
+}
 
-	// futex signals
-	head->emptyjobs--; // 1 less empty job slot
-	// sense we know emptyjobs-- will always ensure that its not equal to
-	// jobc, we can set futex_hasjobs to 1.
-	if(!head->futex_hasjobs) {
-		head->futex_hasjobs = 1;
+odb_err edbs_jobinstallv(const edbs_handle_t *h,
+                         odb_jobtype_t jobclass,
+                         edbs_job_t *o_jobv,
+                         unsigned int jobc,
+                         unsigned int *o_installed) {
+	// easy ptrs
+	edbs_shmjob_t *jobv = h->jobv;
+	edbs_shmhead_t *const head = h->head;
+	*o_installed = 0;
+	if(jobc == 0) {
+		return 0;
 	}
-	// if empty jobs is now 0.
-	if(head->emptyjobs == 0) {
-		head->futex_installerhold = 1;
+	if(jobc > EDBS_INSTALLVMAX) {
+		jobc = EDBS_INSTALLVMAX;
 	}
-	if(head->futex_selectorhold) {
-		head->futex_selectorhold = 0;
-		futex_wake(&head->futex_selectorhold, 1);
+
+	// let the selectors and edbs_host_close know we're coming before we
+	// check for ODB_ECLOSED. This way, either we see the host has stopped,
+	// or edbs_host_close sees us and waits for our jobs to be done (see
+	// edbs_host_close).
+	__atomic_add_fetch(&head->installing, 1, __ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&head->futex_status, __ATOMIC_SEQ_CST)
+	   != EDBS_SRUNNING) {
+		install_done(head);
+		return ODB_ECLOSED;
+	}
+
+	// get as many empty slots as we can (up to jobc) in one go. If there's
+	// no open spots in the job buffer we wait. But only for the first one:
+	// the caller may be holding on to slots it hasn't read the replies of
+	// yet which won't be freed until it does.
+	// (see the same loop in edbs_jobselect)
+	uint32_t jobposv[EDBS_INSTALLVMAX];
+	uint32_t c;
+	while(!(c = ring_popv(h, &head->freering, jobposv, jobc))) {
+		__atomic_add_fetch(&head->installerwaiters, 1, __ATOMIC_SEQ_CST);
+		uint32_t seq = __atomic_load_n(&head->futex_installers,
+		                               __ATOMIC_SEQ_CST);
+		if((c = ring_popv(h, &head->freering, jobposv, jobc))) {
+			__atomic_sub_fetch(&head->installerwaiters, 1, __ATOMIC_SEQ_CST);
+			break;
+		}
+		// check for ODB_ECLOSED
+		if(__atomic_load_n(&head->futex_status, __ATOMIC_SEQ_CST)
+		   != EDBS_SRUNNING) {
+			__atomic_sub_fetch(&head->installerwaiters, 1, __ATOMIC_SEQ_CST);
+			install_done(head);
+			return ODB_ECLOSED;
+		}
+		futex_wait(&head->futex_installers, seq);
+		__atomic_sub_fetch(&head->installerwaiters, 1, __ATOMIC_SEQ_CST);
 	}
-	head->newjobs++;   // 1 more job for workers to adopt
+	__atomic_sub_fetch(&head->emptyjobs, c, __ATOMIC_SEQ_CST);
 
+	// atp: the slots in jobposv are ours until we push them into newring.
+	unsigned long int jobid = __atomic_fetch_add(&head->nextjobid, c,
+	                                             __ATOMIC_RELAXED);
+	for(uint32_t i = 0; i < c; i++) {
+		o_jobv[i].shm = h;
+		o_jobv[i].descriptortype = 0;
+		o_jobv[i].jobpos = jobposv[i];
+		edbs_shmjob_t *job = &jobv[jobposv[i]];
 
 #ifdef EDB_FUCKUPS
-	if(!(job->transferbuff_FLAGS & EDBS_JEXECUTERTERM)) {
-		log_critf("just accepted a job that has a buffer that wasn't marked "
-				  "as terminated by its last executor");
-	}
+		if(job->owner != 0 || job->jobtype != 0) {
+			log_critf("popped a job from freering that was owned or "
+			          "installed");
+		}
+		if(!(job->transferbuff_FLAGS & EDBS_JEXECUTERTERM)) {
+			log_critf("just accepted a job that has a buffer that wasn't "
+			          "marked as terminated by its last executor");
+		}
 #endif
 
-	// note to self: I had all the folowing "setup" logic in a weave lock as
-	// to not take too much time in jobmutex. I ended up getting rid of the
-	// weave lock because of an edge case where edbs_jobselect would return
-	// with the job that edbs_jobinstall has yet to return from.
-
-	// now reset all the descriptors for this job. that have nothing to do
-	// with the job installment algo.
-	job->executorbytes  = 0;
-	job->executorhead   = 0;
-	job->installerbytes = 0;
-	job->installerhead  = 0;
-	job->transferbuff_FLAGS = 0;
-	// sense we know they're going to call
-	// write first into a clean buffer
-	job->futex_installerreadhold = 1;
-	job->futex_installerwritehold = 0;
-	// sense we know they're going to call read
-	// first and they have to wait for the
-	// write anyways
-	job->futex_executorreadhold = 1;
-	job->futex_executorwritehold = 0;
-	job->name = h->name;
-
-
-	// sense we set the jobclass, we can unlock. We now have installed our job.
-	pthread_mutex_unlock(&head->jobmutex);
+		// install the job
+		job->jobtype = jobclass;
+		job->jobid = jobid + i;
+
+		// now reset all the descriptors for this job. that have nothing to
+		// do with the job installment algo. This all has to be done before
+		// the push as edbs_jobselect can return with the job the moment its
+		// in newring.
+		job->executorbytes  = 0;
+		job->executorhead   = 0;
+		job->installerbytes = 0;
+		job->installerhead  = 0;
+		job->transferbuff_FLAGS = 0;
+		// sense we know they're going to call
+		// write first into a clean buffer
+		job->futex_installerreadhold = 1;
+		job->futex_installerwritehold = 0;
+		// sense we know they're going to call read
+		// first and they have to wait for the
+		// write anyways
+		job->futex_executorreadhold = 1;
+		job->futex_executorwritehold = 0;
+		job->name = h->name;
+	}
+
+	// hand them all off to the selectors at once, and wake up as many of
+	// them as we have jobs for.
+	ring_pushv(h, &head->newring, jobposv, c);
+	__atomic_add_fetch(&head->newjobs, c, __ATOMIC_RELAXED);
+	*o_installed = c;
+	install_done(head);
+	post(&head->futex_selectors, &head->selectorwaiters, c);
 
 	return 0;
 }
 
+odb_err edbs_jobinstall(const edbs_handle_t *h,
+                        odb_jobtype_t jobclass,
+                        edbs_job_t *o_job) {
+	unsigned int installed;
+	return edbs_jobinstallv(h, jobclass, o_job, 1, &installed);
+}
+
 void  edbs_jobclose(edbs_job_t job) {
 	if(!job.descriptortype) {
 #ifdef EDB_FUCKUPS
@@ -598,49 +917,28 @@ void  edbs_jobclose(edbs_job_t job) {
 	// save some pointers to the stack for easier access.
 	const edbs_handle_t *shm = job.shm;
 	edbs_shmhead_t *const head = shm->head;
-	const uint64_t jobc = head->jobc;
 	edbs_shmjob_t *const jobv = &shm->jobv[job.jobpos];
 
 	// close the transfer if it hasn't already.
-	// note that per edb_jobclose's documentation on threading, edb_jobclose and edb_jobopen must
-	// only be called inside the comfort of the jobinstall mutex.
 	edbs_jobterm(job);
 
-	// job has been completed. relinquish ownership.
-	//
-	// to do this, we have to lock the job install mutex to avoid the possiblity of a
-	// handle trying to install a job mid-way through us relinqusihing it.
-	//
-	// (this can probably be done a bit more nicely if the jobinstall mutex was held per-job slot)
-	pthread_mutex_lock(&head->jobmutex);
-
 #ifdef EDB_FUCKUPS
 	if(!jobv->owner) {
 		log_critf("edbs_jobclose on a job that has already been closed");
 	}
 #endif
 
-	// set this job slot to be empty and unowned
+	// job has been completed. relinquish ownership: set this job slot to be
+	// empty and unowned and give it back to the installers.
 	jobv->jobtype = 0;
 	jobv->owner = 0;
-	head->emptyjobs++;
+	uint32_t jobpos = job.jobpos;
+	ring_pushv(shm, &head->freering, &jobpos, 1);
+	__atomic_add_fetch(&head->emptyjobs, 1, __ATOMIC_SEQ_CST);
 
 	// futex signalling
-	if(head->emptyjobs == jobc) {
-		// we now have NO jobs left.
-		head->futex_hasjobs = 0;
-		futex_wake(&head->futex_hasjobs, INT32_MAX);
-	}
-	if(head->futex_installerhold) {
-		// if we're in here, we know that per our structure definition for
-		// futex_installerreadhold, it must be set to 0 sense we know that
-		// emptyjobs is no longer 0.
-		head->futex_installerhold = 0;
-		futex_wake(&head->futex_installerhold, 1);
-	}
-
-
-	pthread_mutex_unlock(&head->jobmutex);
+	post(&head->futex_installers, &head->installerwaiters, 1);
+	post_hasjobs(head);
 }
 
 odb_err edbs_jobwritev(edbs_job_t j, ...) {
@@ -104,6 +104,31 @@ odb_err edbs_jobinstall(const edbs_handle_t *shm,
                         odb_jobtype_t jobclass,
                         edbs_job_t *o_job);
 
+// the most jobs edbs_jobinstallv will install in one call.
+#define EDBS_INSTALLVMAX 64
+
+// Same as edbs_jobinstall but installs up to jobc jobs (no more than
+// EDBS_INSTALLVMAX) of the same jobclass all at once. This is cheaper than
+// calling edbs_jobinstall jobc times: the slots are taken and handed to the
+// selectors in one pass and the idle selectors are woken up once.
+//
+// It will only block until it can install at least 1 job, then installs as
+// many as there are empty slots for. *o_installed is set to how many were
+// installed, and that many job descriptors will be in o_jobv. Call it again
+// for the rest once you've dealt with those (don't call it again while
+// holding on to jobs you haven't read the replies of, those slots won't be
+// freed until you do).
+//
+// ERRORS
+//  - ODB_ECLOSED - (*o_installed will be 0) see edbs_jobinstall
+//  - ODB_EJOBDESC - odb_jobtype_t is not valid
+//  - ODB_ECRIT
+odb_err edbs_jobinstallv(const edbs_handle_t *shm,
+                         odb_jobtype_t jobclass,
+                         edbs_job_t *o_jobv,
+                         unsigned int jobc,
+                         unsigned int *o_installed);
+
 // A transfer buffer is structured as a pipe, though bi-directional. If both
 // sides of the pipe do not follow specification, deadlocks will ensue. Here
 // are the basic rules about reading and writting to the transfer buffer:
@@ -207,6 +232,43 @@ odb_err edbs_jobreadv(edbs_job_t j, ...);
 odb_err edbs_jobwrite(edbs_job_t j, const void *buff, int count);
 odb_err edbs_jobwritev(edbs_job_t j, ...);
 odb_err edbs_jobterm(edbs_job_t j);
+
+// Reserve/commit versions of edbs_jobwrite and edbs_jobread that don't copy
+// anything: instead, *o_buff points straight into the transfer buffer. Worth
+// it for anything that can be built (or parsed) in place, or for big
+// payloads: a memcpy into the reserved bytes happens outside of the pipe
+// mutex, where edbs_jobwrite copies a byte at a time under it. (select and
+// update pages are sent this way by _jupdateselect, and the select callback
+// is handed them straight out of the buffer by _odbh_jobj_cb)
+//
+// edbs_jobwritereserve blocks until there's room for count bytes and points
+// *o_buff to them. Fill them in, then call edbs_jobwritecommit to send
+// them (you can commit less than you reserved). The other side won't see
+// any of it until then. Note that it waits for room for all count bytes at
+// once, where edbs_jobwrite streams: it writes what fits and keeps going as
+// the reader frees up more. So reserving close to the whole buffer means
+// waiting for the reader to empty it first.
+//
+// edbs_jobreadreserve blocks until count bytes have been written and points
+// *o_buff to them. Once you're done with them, call edbs_jobreadcommit to
+// free them up for the writer. They'll stay put until you do.
+//
+// The pointer is good until the commit. Even if the bytes wrap around the
+// end of the buffer they're in one piece (see edbs_handle_t.transmirror). It
+// follows all the same rules as edbs_jobread/edbs_jobwrite and returns the
+// same errors, plus:
+//
+//  - ODB_EBUFFSIZE - count is bigger than the whole transfer buffer. Or
+//                    the bytes wrap around the end of the buffer and
+//                    job_transfersize isn't a multiple of the page size so
+//                    there's no mirror. Use edbs_jobwrite/edbs_jobread for
+//                    these.
+//  - ODB_EINVAL - (crit logged) commit is more than what's there.
+odb_err edbs_jobwritereserve(edbs_job_t j, int count, void **o_buff);
+odb_err edbs_jobwritecommit(edbs_job_t j, int count);
+odb_err edbs_jobreadreserve(edbs_job_t j, int count, const void **o_buff);
+odb_err edbs_jobreadcommit(edbs_job_t j, int count);
+
 static odb_err edbs_joberr_trunc(odb_err err) {
 	switch (err) {
 		case ODB_EPIPE:
@@ -14,6 +14,42 @@
 #include <linux/futex.h>
 #include <sys/syscall.h>
 
+// helper function to edbs_host_init and edbs_handle_init: sets
+// h->transmirror (see edbs_handle_t). head is from shmfd but doesn't have
+// to be mapped.
+//
+// A failure to map is logged and leaves transmirror at 0.
+static void mirrortrans(edbs_handle_t *h, int shmfd,
+                        const edbs_shmhead_t *head) {
+	h->transmirror = 0;
+	if(head->jobc == 0) return;
+	uint64_t size = head->jobtransc / head->jobc;
+	long pagesize = sysconf(_SC_PAGE_SIZE);
+	if(size % pagesize || head->jobtransoff % pagesize) {
+		return;
+	}
+
+	// get enough address space for all of them, then map each job's buffer
+	// over it twice.
+	uint8_t *va = mmap(0, head->jobtransc * 2, PROT_NONE,
+	                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(va == MAP_FAILED) {
+		log_errorf("mmap(2) failed to reserve transfer mirror: %d", errno);
+		return;
+	}
+	for(uint64_t i = 0; i < head->jobc * 2; i++) {
+		void *m = mmap(va + i * size, size, PROT_READ | PROT_WRITE,
+		               MAP_SHARED | MAP_FIXED, shmfd,
+		               (off_t)(head->jobtransoff + (i / 2) * size));
+		if(m == MAP_FAILED) {
+			log_errorf("mmap(2) failed to map transfer mirror: %d", errno);
+			munmap(va, head->jobtransc * 2);
+			return;
+		}
+	}
+	h->transmirror = va;
+}
+
 // helper function to hostclose, createshm, edb_host_shmunlink, edb_host_shmlink
 //
 //
@@ -40,14 +76,9 @@ void deleteshm(edbs_handle_t *h, int ishost) {
 			pthread_mutex_destroy(&h->jobv[i].pipemutex);
 		}
 	}
-	uint32_t remaining = __sync_sub_and_fetch(&h->head->connected, 1);
-	if(!remaining) {
-
-		// "Last man out hit the lights"
-
-		// we're the last one to disconnect, clean up all the
-		// shm-malloc-specific data. This includes any shm mutexes.
-		pthread_mutex_destroy(&h->head->jobmutex);
+	__sync_sub_and_fetch(&h->head->connected, 1);
+	if(h->transmirror) {
+		munmap(h->transmirror, h->head->jobtransc * 2);
 	}
 	munmap(h->shm, h->head->shmc);
 	shm_unlink(h->shm_name);
@@ -77,17 +108,28 @@ odb_err edbs_host_init(edbs_handle_t **o_shm, struct odb_hostconfig config) {
 		stackhead.eventc = config.event_bufferq;
 		stackhead.jobtransc = config.job_transfersize * stackhead.jobc;
 
+		// each job ring needs room for every job, rounded up to a power of 2
+		// so positions can be masked.
+		uint32_t ringc = 1;
+		while(ringc < stackhead.jobc) ringc <<= 1;
+		stackhead.ringmask = ringc - 1;
+
 		// we need to make sure that the transfer buffer gets place on a fresh page.
 		// so lets start by getting the size of the first page(s) and round up.
 		uint64_t p1 = sizeof (edbs_shmhead_t)
-		              + config.job_buffq * sizeof (edbs_shmjob_t);
+		              + config.job_buffq * sizeof (edbs_shmjob_t)
+		              + 2 * ringc * sizeof (edbs_shmcell_t)
 		              + config.event_bufferq * sizeof (struct odb_event);
-		unsigned int p1padding = p1 % sysconf(_SC_PAGE_SIZE);
+		long pagesize = sysconf(_SC_PAGE_SIZE);
+		unsigned int p1padding = (pagesize - p1 % pagesize) % pagesize;
 		stackhead.shmc = p1 + p1padding + stackhead.jobtransc;
 
 		// offsets
 		stackhead.joboff      = sizeof(edbs_shmhead_t);
-		stackhead.eventoff    = sizeof (edbs_shmhead_t) + config.job_buffq * sizeof (edbs_shmjob_t);
+		stackhead.ringoff     = sizeof (edbs_shmhead_t) + config.job_buffq * sizeof (edbs_shmjob_t);
+		stackhead.eventoff    = stackhead.ringoff + 2 * ringc * sizeof (edbs_shmcell_t);
+		stackhead.freering.celloff = stackhead.ringoff;
+		stackhead.newring.celloff  = stackhead.ringoff + ringc * sizeof (edbs_shmcell_t);
 		stackhead.jobtransoff = p1 + p1padding;
 	}
 
@@ -133,6 +175,9 @@ odb_err edbs_host_init(edbs_handle_t **o_shm, struct odb_hostconfig config) {
 	                 PROT_READ | PROT_WRITE,
 	                MAP_SHARED,
 	                shmfd, 0);
+	if(shm->shm != MAP_FAILED) {
+		mirrortrans(shm, shmfd, &stackhead);
+	}
 	// sense it is documented in the manual, so long that we have it
 	// mmap'd, we can close the descriptor. We'll do that now
 	// so we don't have to worry about it later.
@@ -171,13 +216,6 @@ odb_err edbs_host_init(edbs_handle_t **o_shm, struct odb_hostconfig config) {
 		goto clean_map;
 	}
 	pthread_mutexattr_setpshared(&mutexattr, PTHREAD_PROCESS_SHARED);
-	if((err = pthread_mutex_init(&shm->head->jobmutex, &mutexattr))) {
-		if (err == ENOMEM) eerr = ODB_ENOMEM;
-		else eerr = ODB_ECRIT;
-		log_critf("pthread_mutex_init(3): %d", err);
-		goto clean_mutex;
-	}
-
 
 	// initialize the head with expected values
 	shm->head->newjobs   = 0;
@@ -202,6 +240,23 @@ odb_err edbs_host_init(edbs_handle_t **o_shm, struct odb_hostconfig config) {
 	}
 	pthread_mutexattr_destroy(&mutexattr);
 
+	// initialize the job rings (see edbs_shmring_t): newring starts empty
+	// and freering starts with every slot in it.
+	{
+		edbs_shmcell_t *freev = shm->shm + shm->head->freering.celloff;
+		edbs_shmcell_t *newv  = shm->shm + shm->head->newring.celloff;
+		for(uint32_t i = 0; i <= shm->head->ringmask; i++) {
+			newv[i].seq = i;
+			if(i < shm->head->jobc) {
+				freev[i].jobpos = i;
+				freev[i].seq = i + 1;
+			} else {
+				freev[i].seq = i;
+			}
+		}
+		shm->head->freering.enqueue = (uint32_t)shm->head->jobc;
+	}
+
 	// initialize event buffer
 	// todo
 
@@ -213,21 +268,17 @@ odb_err edbs_host_init(edbs_handle_t **o_shm, struct odb_hostconfig config) {
 	// shm.
 	__sync_add_and_fetch(&shm->head->connected, 1);
 
-	// finally, before returning as the host, we must make sure to enable selectorhold
-	// sense its conditions have been met.
-	shm->head->futex_selectorhold = 1;
-
 	return 0;
 	// everything past here are bail-outs.
 
 	clean_mutex:
 	for(int i = 0; i < shm->head->jobc; i++) pthread_mutex_destroy(&shm->jobv[i].pipemutex);
-	pthread_mutex_destroy(&shm->head->jobmutex);
 	pthread_mutexattr_destroy(&mutexattr);
 	shm->head->futex_status = EDBS_SSTOPPED;
 	futex_wake(&shm->head->futex_status, INT32_MAX);
 
 	clean_map:
+	if(shm->transmirror) munmap(shm->transmirror, shm->head->jobtransc * 2);
 	munmap(shm->shm, shm->head->shmc);
 
 	clean_shm:
@@ -239,28 +290,41 @@ odb_err edbs_host_init(edbs_handle_t **o_shm, struct odb_hostconfig config) {
 }
 
 void    edbs_host_close(edbs_handle_t *h) {
+	edbs_shmhead_t *head = h->head;
+
 	// set to be in stopping mode. This will prevent any further jobs
 	// from being installed.
-	pthread_mutex_lock(&h->head->jobmutex);
-	h->head->futex_status = EDBS_SSTOPPED;
-
-	// sense we changed our futex_status, we must broadcast this to the
-	// hold futexes.
-	h->head->futex_selectorhold = 0;
-	h->head->futex_installerhold = 0;
-	futex_wake(&h->head->futex_selectorhold, INT32_MAX);
-	futex_wake(&h->head->futex_installerhold, INT32_MAX);
-	pthread_mutex_unlock(&h->head->jobmutex);
-
-	if(h->head->futex_hasjobs) {
-		// we use ~%d because we don't have a mutex lock so the number
-		// could have changed sense this log would have got to the front.
+	//
+	// edbs_jobinstall increments installing and then checks futex_status. We
+	// set futex_status and then check installing. So either they see that
+	// we've stopped, or we see them and wait for them.
+	__atomic_store_n(&head->futex_status, EDBS_SSTOPPED, __ATOMIC_SEQ_CST);
+
+	// sense we changed our futex_status, we must wake everyone waiting so
+	// they see it.
+	__atomic_add_fetch(&head->futex_selectors, 1, __ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&head->futex_installers, 1, __ATOMIC_SEQ_CST);
+	futex_wake(&head->futex_selectors, INT32_MAX);
+	futex_wake(&head->futex_installers, INT32_MAX);
+
+	uint32_t emptyjobs = __atomic_load_n(&head->emptyjobs, __ATOMIC_SEQ_CST);
+	if(emptyjobs != head->jobc) {
+		// we use ~%d because the number could have changed sense this log
+		// would have got to the front.
 		log_infof("haulting transfer buffer free: ~%ld jobs still left",
-		          h->head->jobc - h->head->emptyjobs);
+		          head->jobc - emptyjobs);
 	}
 
 	// wait for all jobs to be closed.
-	futex_wait(&h->head->futex_hasjobs, 1);
+	for(;;) {
+		uint32_t seq = __atomic_load_n(&head->futex_hasjobs, __ATOMIC_SEQ_CST);
+		if(__atomic_load_n(&head->installing, __ATOMIC_SEQ_CST) == 0
+		   && __atomic_load_n(&head->emptyjobs, __ATOMIC_SEQ_CST)
+		      == head->jobc) {
+			break;
+		}
+		futex_wait(&head->futex_hasjobs, seq);
+	}
 }
 
 int edbs_host_closed(const edbs_handle_t *h) {
@@ -346,6 +410,9 @@ odb_err edbs_handle_init(edbs_handle_t **o_shm, pid_t hostpid) {
 	                MAP_SHARED,
 	                shmfd, 0);
 	shm->head = shm->shm;
+	if(shm->shm != MAP_FAILED) {
+		mirrortrans(shm, shmfd, &tmphead);
+	}
 
 
 	// see the comment in createshm regarding the closing of the fd.
@@ -370,6 +437,7 @@ odb_err edbs_handle_init(edbs_handle_t **o_shm, pid_t hostpid) {
 	if(shm->head->futex_status == EDBS_SSTOPPED) {
 		// this is a weird edge case if we're in here. But basically the host
 		// had shut down while we were trying to connect to it.
+		if(shm->transmirror) munmap(shm->transmirror, shm->head->jobtransc * 2);
 		munmap(shm->shm, shm->head->shmc);
 		shm_unlink(shm->shm_name);
 		free(shm);
@@ -388,6 +456,7 @@ odb_err edbs_handle_init(edbs_handle_t **o_shm, pid_t hostpid) {
 		// other memebers on it, this means know the shm has been dismantled
 		// between this if statement and the futex_status check. It can
 		// theoretically happen.
+		if(shm->transmirror) munmap(shm->transmirror, shm->head->jobtransc * 2);
 		munmap(shm->shm, shm->head->shmc);
 		shm_unlink(shm->shm_name);
 		free(shm);
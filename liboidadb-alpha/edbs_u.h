@@ -15,6 +15,34 @@
 #define EDBS_SRUNNING 1
 #define EDBS_SSTOPPED 3
 
+// a cell in one of the job rings. See edbs_shmring_t.
+typedef struct edbs_shmcell_t {
+	uint32_t seq;    // see edbs_shmring_t
+	uint32_t jobpos; // index into jobv
+} edbs_shmcell_t;
+
+// A bounded lock-free queue of job slot indexes (the sequence-number kind,
+// Vyukov's). Any amount of processes can push and pop at the same time.
+//
+// Each cell's seq says what its waiting for: if seq == pos then it's empty
+// and the pusher who gets pos can write it, if seq == pos+1 then it's been
+// written and the popper who gets pos can read it. After reading, the popper
+// sets seq to pos+ringc so the pushers will see it empty a lap later.
+//
+// The cells are stored in the shm at celloff. There's a cell for every job
+// slot so a push always has room, though it may have to spin for a moment
+// on a cell that a popper has claimed (moved dequeue past) but not yet
+// given back. Pops that find the ring empty futex_wait on the eventcounts
+// in edbs_shmhead_t.
+typedef struct edbs_shmring_t {
+	uint64_t celloff;   // offset from shm until the cells. constant.
+
+	// the next position to push/pop. Kept on their own cache lines sense
+	// one is for the installers and the other is for the selectors.
+	uint32_t enqueue __attribute__((aligned(64)));
+	uint32_t dequeue __attribute__((aligned(64)));
+} __attribute__((aligned(64))) edbs_shmring_t;
+
 typedef struct edbs_shmhead_t {
 
 	////////////////////////////////////////////////////////////////////////////
@@ -27,8 +55,8 @@ typedef struct edbs_shmhead_t {
 	uint64_t joboff;    // offset from shm until the the start of jobv.
 	uint64_t jobc;      // total count of jobs in jobv.
 
-	uint32_t jobinst_next; // next-index-to-start: requires jobinstall.lock
-	uint32_t jobacpt_next; // next-index-to-start: requires jobaccept.lock
+	uint64_t ringoff;   // offset from shm until the cells of both job rings
+	uint32_t ringmask;  // count of cells in each ring minus 1 (power of 2)
 
 	uint64_t eventoff;  // offset from shm until the start of eventv
 	uint64_t eventc;    // total count of events in eventv.
@@ -40,22 +68,33 @@ typedef struct edbs_shmhead_t {
 	// Inventory control
 	////////////////////////////////////////////////////////////////////////////
 
-	// the amount of empty slots in the job buffer.
-	// futex vars will broadcast a futex after they have been changed
-	// threading: requires jobmutex to read/write too.
+	// Every job slot index is always in exactly one of these places:
+	//   - freering: the slot is empty. edbs_jobclose pushes, edbs_jobinstall
+	//     pops.
+	//   - newring: the slot has a job that isn't owned. edbs_jobinstall
+	//     pushes, edbs_jobselect pops.
+	//   - with an installer between its pops and pushes, or with its
+	//     executor between edbs_jobselect and edbs_jobclose.
+	edbs_shmring_t freering;
+	edbs_shmring_t newring;
+
+	// the amount of empty slots in the job buffer and the amount of new jobs
+	// that are not owned. These are only counts, they trail behind the rings
+	// a bit so don't use them to decide if there's something to pop.
+	// threading: __atomic only.
 	uint32_t emptyjobs;
-
-	// The amount of new jobs that are not owned.
-	// threading: requires jobmutex to read/write too.
 	uint32_t newjobs;
 
-	// number of handles (including the host) connected to this shm. If
-	// you're the last one out, you're responsible for cleaning up the
-	// pthread stuff.
-	// This is for the lingering handles that still hold on to this shm even
-	// though the host has closed. Without this, the host would free the
-	// jobmutex and would cause handles unknowningly run into segfaults when
-	// trying to lock it.
+	// the amount of edbs_jobinstall calls that have made it past their
+	// EDBS_SRUNNING check but haven't pushed their job into newring yet.
+	// Selectors can't give up with ODB_ECLOSED until this is 0, and neither
+	// can edbs_host_close.
+	// threading: __atomic only.
+	uint32_t installing;
+
+	// number of handles (including the host) connected to this shm. This is
+	// for the lingering handles that still hold on to this shm even though
+	// the host has closed.
 	// THREADING:
 	//  To increment, get, decrement, use __sync_fetch_and_add/_sub
 	uint32_t connected;
@@ -66,58 +105,41 @@ typedef struct edbs_shmhead_t {
 	// EDBS_SSTOPPED for shut down
 	//
 	// THREADING
-	//  - for setting, waking: lock connectedmutex
-	//  - for getting: no mutex required
-	//  - for waiting: must not be in mutex.
+	//  - for getting, setting: __atomic (its half of the handshake with
+	//    installing, see edbs_host_close)
+	//  - for waiting: no locks required.
 	uint32_t futex_status;
 
 	////////////////////////////////////////////////////////////////////////////
-	// Traffic control. Lots of brain-hurt here. Just read the field-comments
-	// and accept it.
+	// Traffic control. These are eventcounts, not holds: they're only ever
+	// incremented. A waiter reads the count, double checks it has nothing
+	// to do, then futex_waits on the count it read. Anything that happened
+	// in between will have changed the count so the wait won't sleep.
 	////////////////////////////////////////////////////////////////////////////
 
-	// job mutex for workers and handlers (process shared).
-	pthread_mutex_t jobmutex;
-
-	// Used to track when all jobs have been closed during shutdown.
-	//
-	// Will be 1 if the following are true:
-	//   - emptyjobs != jobc
-	//
-	// Will only broadcast when set to 0.
+	// incremented after a push into newring (for selectors) or freering
+	// (for installers), and by edbs_host_close. They will only be woken if
+	// their waiters count is not 0 so the uncontended paths don't make
+	// syscalls.
 	//
 	// THREADING
-	//   - for setting, waking: jobmutex must be locked
-	//   - for getting: no locks required
-	//   - for waiting: jobmutex must not be locked.
+	//  - for incrementing, waking, waiters: __atomic
+	//  - for waiting: no locks required.
+	uint32_t futex_selectors, selectorwaiters;
+	uint32_t futex_installers, installerwaiters;
+
+	// incremented and broadcasted when emptyjobs or installing changes after
+	// the host has stopped. Used by edbs_host_close to wait for all the jobs
+	// to be closed.
 	uint32_t futex_hasjobs;
 
-
-	// for futex_selectorhold: set to 1 if the following is is true:
-	//   - futex_status == EDBS_SRUNNING
-	//   - AND newjobs == 0
-	//
-	// for futex_installerreadhold: set to 1 if the following are true:
-	//   - futex_status == EDBS_SRUNNING
-	//   - AND emptyjobs == 0
-	//
-	// will only broadcast when its set to 0.
-	//
-	// THREADING
-	//  - for setting, waking: lock jobmutex (except in edbs_host_init)
-	//  - for getting: no locks required
-	//  - for waiting: jobmutex must not be locked
-	uint32_t futex_selectorhold;
-	uint32_t futex_installerhold;
-
-
 	////////////////////////////////////////////////////////////////////////////
 	// politics/analytics:
 	////////////////////////////////////////////////////////////////////////////
 
 	// the next jobid. It is not strict that jobs need to have sequencial jobids
 	// they just need to be unique.
-	// requires jobinstall.lock to increment
+	// threading: __atomic
 	unsigned long int nextjobid;
 } edbs_shmhead_t;
 
@@ -157,16 +179,15 @@ typedef struct edbs_shmjob_t {
 	////////////////////////////////////////////////////////////////////////////
 	// regarding job ownership
 	//
-	// these require edbs_shmhead_t.
+	// these are only touched by who ever popped this slot's index from one
+	// of the rings in edbs_shmhead_t. The push/pop hands them over.
 	//
 	////////////////////////////////////////////////////////////////////////////
 
-	// threading: requires jobmutex
 	// Job desc is a xor'd value between 1 odb_jobclass, 1 edb_cmd.
 	// if 0 then empty job.
 	odb_jobtype_t jobtype;
 
-	// threading: requires jobmutex
 	// used by the worker pool.
 	// 0 means its not owned.
 	unsigned int owner;
@@ -263,6 +284,7 @@ typedef struct edbs_handle_t {
 	// This shared memoeyr stores the following in this order:
 	//   - head
 	//   - jobv
+	//   - the cells of head->freering then head->newring
 	//   - eventv
 	//   - (some padding until the next page)
 	//   - jobtransferbuf
@@ -278,6 +300,15 @@ typedef struct edbs_handle_t {
 	struct edb_event *eventv;  // events buffer.
 	void        *transbuffer; // start of transfer buffer
 
+	// the transfer buffer again but with each job's buffer mapped twice in a
+	// row: a job's buffer starts at transmirror + 2 * transferbuffoff and
+	// the transferbuffcapacity bytes after it are the same bytes again. So
+	// anything that wraps around the end of the buffer can still be pointed
+	// to as if it were all in one piece (see edbs_jobwritereserve).
+	//
+	// 0 if job_transfersize isn't a multiple of the page size.
+	void        *transmirror;
+
 	// shared memory file name. not stored in the shm itself.
 	char shm_name[32];
 
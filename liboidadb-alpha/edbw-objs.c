@@ -249,8 +249,9 @@ odb_err static _jupdateselect(edb_worker_t *self, int jselect) {
 		return err;
 	}
 
-	// open the first page.
-	err = edba_pageopen(handle, eid, page_start, EDBA_FREAD);
+	// open the first page. (jupdate writes their changes back into it)
+	err = edba_pageopen(handle, eid, page_start
+			, jselect ? EDBA_FREAD : EDBA_FREAD | EDBA_FWRITE);
 	if (err) {
 		dieerror(job, err);
 		return ODB_EUSER;
@@ -281,22 +282,37 @@ odb_err static _jupdateselect(edb_worker_t *self, int jselect) {
 		// get the objects on this page.
 		uint32_t object_count = edba_pageobjectv_count(handle);
 
-		// now send them the entire page body.
-		// get the object body.
+		// now send them all the objects on the page. Only the objects
+		// themselves (object_count * fixedc), not whatever is left over at
+		// the end of the page body: that's all the handle knows to expect.
 		// note: objectv can be const, used for both jselect and jupdate.
 		void *objecv;
-		unsigned int objectc = edba_pageobjectc(handle);
+		int objectc = (int)(object_count * stk->fixedc);
 		if(jselect) {
-			// get write-ready page
-			objecv = edba_pageobjectv(handle);
-		} else {
 			// get read-only page.
 			objecv = (void *)edba_pageobjectv_get(handle);
+		} else {
+			// get write-ready page
+			objecv = edba_pageobjectv(handle);
+		}
+
+		// serialize the page straight into the transfer buffer: one memcpy
+		// outside of the pipe mutex instead of edbs_jobwritev's byte at a
+		// time under it. Only if it doesn't fit in there all at once do we
+		// let edbs_jobwritev stream it.
+		void *out;
+		int sendc = (int)sizeof(object_count) + objectc;
+		err = edbs_jobwritereserve(job, sendc, &out);
+		if(!err) {
+			memcpy(out, &object_count, sizeof(object_count));
+			memcpy((uint8_t *)out + sizeof(object_count), objecv, objectc);
+			err = edbs_jobwritecommit(job, sendc);
+		} else if(err == ODB_EBUFFSIZE) {
+			err = edbs_jobwritev(job
+					, &object_count, sizeof(object_count)
+					, objecv, objectc
+					, 0);
 		}
-		err = edbs_jobwritev(job
-				, &object_count, sizeof(object_count)
-				, objecv, objectc
-				, 0);
 		if(err) {
 			// elevate to critical error
 			err = log_critf("unhandled network error in jupdate/jselect: %d",
@@ -306,7 +322,7 @@ odb_err static _jupdateselect(edb_worker_t *self, int jselect) {
 
 		if(!jselect) {
 			// we're doing a jupdate, we have to read-back their response.
-			err = edbs_jobread(job, &objecv, (int)objectc);
+			err = edbs_jobread(job, objecv, objectc);
 			if(err) {
 				// elevate to critical error
 				err = log_critf("unhandled network error in jupdate: %d",
@@ -8,6 +8,8 @@
 #include "edba.h"
 #include "edbs.h"
 #include "wrappers.h"
+#include "options.h"
+#include "telemetry.h"
 
 #include <sys/types.h>
 #include <stdlib.h>
@@ -15,6 +17,7 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <stdio.h>
+#include <limits.h>
 #include <linux/futex.h>
 #include <sys/syscall.h>
 
@@ -50,6 +53,10 @@ typedef struct edb_host_st {
 	edba_host_t *ahost;
 	edbpcache_t *pcache;
 
+	// the cache's hot set, saved next to the file (see EDBP_CONFIG_HOTSET).
+	// -1 if it couldn't be opened.
+	int hotsetfd;
+
 
 } edb_host_t;
 static edb_host_t host = {0};
@@ -92,7 +99,10 @@ static odb_err validatehostops(const char *path
 // places a lock on the file according to locking spec. If a lock has already
 // been placed on this file, ODB_EOPEN is returned and o_curhost is written too.
 //
-// Also retursn
+// The lock covers the entire file (and anything it grows into) and not just
+// the first byte: the host's handles keep their locks in the in-host lock
+// table without EDBL_CONFIG_OFD, which is only sound if no other opener
+// can place a lock anywhere in the file while we're hosting it.
 //
 // See unlock file to remove the lock
 odb_err static lockfile(pid_t *o_curhost) {
@@ -101,8 +111,7 @@ odb_err static lockfile(pid_t *o_curhost) {
 			.l_type = F_WRLCK,
 			.l_whence = SEEK_SET,
 			.l_start = 0,
-			.l_len = 1, // first byte but mind you any host should have
-			// locked the entire first page
+			.l_len = 0, // entire file, see above.
 			.l_pid = 0,
 	};
 	// note we use OFD locks becuase the host can be started in the same
@@ -125,8 +134,7 @@ void static unlockfile() {
 			.l_type = F_UNLCK,
 			.l_whence = SEEK_SET,
 			.l_start = 0,
-			.l_len = 1, // first byte but mind you any host should have
-			// locked the entire first page
+			.l_len = 0, // entire file, see lockfile
 			.l_pid = 0,
 	};
 	int err = fcntl(host.fdescriptor, F_OFD_SETLK, &dblock);
@@ -165,6 +173,7 @@ odb_err odb_host(const char *path, struct odb_hostconfig hostops) {
 	// easy vals
 	host.config = hostops;
 	host.fname = path;
+	host.hotsetfd = -1;
 	host.state = HOST_OPENING_DESCRIPTOR;
 
 	// open the actual file descriptor.
@@ -251,11 +260,34 @@ odb_err odb_host(const char *path, struct odb_hostconfig hostops) {
 	if(eerr) {
 		goto ret;
 	}
+	// a shard per worker so long that every shard can still fit all the
+	// workers at once.
+	unsigned int shards = host.config.worker_poolsize;
+	if(shards > host.config.slot_count / host.config.worker_poolsize)
+		shards = host.config.slot_count / host.config.worker_poolsize;
+	if(shards > EDBP_SHARDMAX)
+		shards = EDBP_SHARDMAX;
+	eerr = edbp_cache_config(host.pcache, EDBP_CONFIG_SHARDS, shards);
+	if(eerr) {
+		goto ret;
+	}
+	eerr = edbp_cache_config(host.pcache, EDBP_CONFIG_DIRTYRATIO,
+	                         EDBP_DIRTYRATIO_DEFAULT);
+	if(eerr) {
+		goto ret;
+	}
+	eerr = edbp_cache_config(host.pcache, EDBP_CONFIG_INDEXTIER,
+	                         EDBP_INDEXTIER_DEFAULT);
+	if(eerr) {
+		goto ret;
+	}
+	telemetry_image_cache(host.pcache);
 
 	eerr = edba_host_init(&host.ahost, host.pcache, &host.file);
 	if(eerr) {
 		goto ret;
 	}
+	telemetry_image_locks(host.ahost->lockhost);
 	// **defer: edba_host_free(edba_host_t *host);
 	host.state = HOST_OPENING_WORKERS;
 
@@ -283,6 +315,32 @@ odb_err odb_host(const char *path, struct odb_hostconfig hostops) {
 	}
 	// **defer: edb_workerdecom(&(host.workerv[0->host.workerc]));
 
+	// warm the cache back up with whatever was hot the last time this file
+	// was hosted (the workers can get going in the meantime) and keep saving
+	// it for next time. None of this is worth failing over.
+	{
+		char hotsetpath[PATH_MAX];
+		snprintf(hotsetpath, sizeof(hotsetpath), "%s.hotset", path);
+		host.hotsetfd = open(hotsetpath, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+		if(host.hotsetfd == -1) {
+			log_errorf("failed to open %s, the cache will start cold",
+			           hotsetpath);
+		} else {
+			eerr = edbp_warmup(host.pcache, host.hotsetfd);
+			if(eerr) {
+				log_noticef("not warming up the cache: %s", odb_errstr(eerr));
+			}
+			eerr = edbp_cache_config(host.pcache, EDBP_CONFIG_HOTSET,
+			                         host.hotsetfd);
+			if(eerr) {
+				log_noticef("not saving the cache's hot set: %s",
+				            odb_errstr(eerr));
+			}
+			eerr = 0;
+		}
+	}
+	// **defer: close(host.hotsetfd)
+
 	// enter hosting cycle
 	// start all the workers.
 	for(int i = 0; i < host.workerc; i++) {
@@ -340,11 +398,14 @@ odb_err odb_host(const char *path, struct odb_hostconfig hostops) {
 			// fallthrough
 		case HOST_OPENING_WORKERS:
 			log_infof("decommissioning file articulator...");
+			telemetry_image_locks(0);
 			edba_host_free(host.ahost);
 			// fallthrough
 		case HOST_OPENING_ARTICULATOR:
 			log_infof("decommissioning page buffer...");
+			telemetry_image_cache(0);
 			edbp_cache_free(host.pcache);
+			if(host.hotsetfd != -1) close(host.hotsetfd);
 			// fallthrough
 		case HOST_OPENING_PAGEBUFF:
 			log_infof("closing shared memory...");
@@ -3,6 +3,8 @@
 #include "telemetry.h"
 #include "errors.h"
 #include "wrappers.h"
+#include "edbp.h"
+#include "edbl.h"
 #include <oidadb-internal/odbfile.h>
 
 #include <strings.h>
@@ -14,12 +16,21 @@
 #include <fcntl.h>
 #include <memory.h>
 #include <malloc.h>
+#include <poll.h>
+#include <errno.h>
+#include <sys/eventfd.h>
 
 static int telemenabled = 0;
 struct odbtelem_params startedparams;
 static odbtelem_cb cbs[_ODBTELEM_LAST] = {0};
+static edbpcache_t *imagecache = 0; // see telemetry_image_cache
+static edbl_host_t *imagelocks = 0; // see telemetry_image_locks
 static void odbtelem_install(struct odbtelem_data data);
 
+// how often (milliseconds) the counters in the image are refreshed, see
+// image_main.
+#define EDBTELEM_IMAGEINTERVAL 100
+
 #ifdef EDBTELEM_DEBUG
 static const char *class2str(odbtelem_class c) {
 	switch (c) {
@@ -41,6 +52,8 @@ static const char *class2str(odbtelem_class c) {
 		return "ODBTELEM_JOBS_ADDED";
 	case ODBTELEM_JOBS_COMPLETED:
 		return "ODBTELEM_JOBS_COMPLETED";
+	case ODBTELEM_PAGES_CORRUPT:
+		return "ODBTELEM_PAGES_CORRUPT";
 		default:return "UNKNOWN";
 	}
 }
@@ -302,8 +315,9 @@ static void odbtelem_install(struct odbtelem_data data) {
 	shm->futex_raster++;
 	shm_datav[shm->index] = data;
 
-	// todo image
-
+	// todo image (the rest of it). The counters are not added up here, that
+	// would have every page load of every worker wait on this mutex (and
+	// the cache's and lock host's). See image_main.
 
 	// update the image raster
 	shm->image_raster++;
@@ -312,6 +326,86 @@ static void odbtelem_install(struct odbtelem_data data) {
 	futex_wake(&shm->futex_raster, INT32_MAX);
 }
 
+// see image_main
+static struct {
+	int       running;
+	pthread_t thread;
+	int       stopfd;
+} telemetry_imager = {0};
+
+// adds up the cache's and lock host's counters into the image every
+// EDBTELEM_IMAGEINTERVAL. The listeners only ever see what was put in here
+// last.
+static void *image_main(void *arg) {
+	telemetry_shm *shm = telemtry_shared.shm;
+	struct pollfd pfd = {.fd = telemetry_imager.stopfd, .events = POLLIN};
+	for(;;) {
+		int n = poll(&pfd, 1, EDBTELEM_IMAGEINTERVAL);
+		if(n == -1 && errno == EINTR) {
+			continue;
+		}
+		if(n != 0) {
+			return 0;
+		}
+
+		// add them up on the stack first so the mutex is only held for the
+		// copy.
+		struct odbtelem_cachestats cachestats = {0};
+		struct odbtelem_lockstats lockstats = {0};
+		struct odbtelem_lockprofile lockprofile = {0};
+		edbpcache_t *cache = __atomic_load_n(&imagecache, __ATOMIC_ACQUIRE);
+		if(cache) {
+			edbp_cache_stats(cache, &cachestats);
+		}
+		edbl_host_t *locks = __atomic_load_n(&imagelocks, __ATOMIC_ACQUIRE);
+		if(locks) {
+			edbl_host_stats(locks, &lockstats);
+			edbl_host_profile(locks, &lockprofile);
+		}
+
+		// image_raster is off from futex_raster while we're writing so
+		// odbtelem_image will try again. (futex_raster itself is left alone,
+		// that would look like a new event to the listeners)
+		pthread_mutex_lock(&telemetry_host.mutex);
+		shm->image_raster = shm->futex_raster - 1;
+		shm->image.cachestats = cachestats;
+		shm->image.lockstats = lockstats;
+		shm->image.lockprofile = lockprofile;
+		__atomic_store_n(&shm->image_raster, shm->futex_raster,
+		                 __ATOMIC_RELEASE);
+		pthread_mutex_unlock(&telemetry_host.mutex);
+	}
+}
+
+// starts or stops the image thread (see image_main).
+static odb_err image_config(int enabled) {
+	if(telemetry_imager.running) {
+		uint64_t one = 1;
+		write(telemetry_imager.stopfd, &one, sizeof(one));
+		int err = pthread_join(telemetry_imager.thread, 0);
+		if(err) {
+			log_critf("pthread_join(3) returned error: %d", err);
+		}
+		close(telemetry_imager.stopfd);
+		telemetry_imager.running = 0;
+	}
+	if(!enabled) {
+		return 0;
+	}
+	int stopfd = eventfd(0, 0);
+	if(stopfd == -1) {
+		return ODB_EERRNO;
+	}
+	telemetry_imager.stopfd = stopfd;
+	int err = pthread_create(&telemetry_imager.thread, 0, image_main, 0);
+	if(err) {
+		close(stopfd);
+		return log_critf("failed to create telemetry image thread pthread_create(3) returned: %d", err);
+	}
+	telemetry_imager.running = 1;
+	return 0;
+}
+
 inline static void destroyshmbuffer() {
 	telemtry_shared.shm->hosted = 0;
 
@@ -399,6 +493,7 @@ odb_err odbtelem(int enabled, struct odbtelem_params params) {
 	if(!telemenabled && !enabled) return 0;
 	if(!enabled) {
 		// We are going from enabled to disabled.
+		image_config(0);
 		destroyshmbuffer();
 	} else {
 		// We are going from disabled to enabled.
@@ -411,11 +506,31 @@ odb_err odbtelem(int enabled, struct odbtelem_params params) {
 		if((err = setshmbuffer())) {
 			return err;
 		}
+		if((err = image_config(1))) {
+			destroyshmbuffer();
+			return err;
+		}
 	}
 	telemenabled = enabled;
+
+	// the lock profile is only kept while telemetry is on.
+	edbl_host_t *locks = __atomic_load_n(&imagelocks, __ATOMIC_ACQUIRE);
+	if(locks) {
+		edbl_host_config(locks, EDBL_CONFIG_PROFILE, enabled);
+	}
 	return 0;
 }
 
+void telemetry_image_cache(struct edbpcache_t *cache) {
+	__atomic_store_n(&imagecache, cache, __ATOMIC_RELEASE);
+}
+void telemetry_image_locks(struct edbl_host_t *locks) {
+	__atomic_store_n(&imagelocks, locks, __ATOMIC_RELEASE);
+	if(locks && telemenabled) {
+		edbl_host_config(locks, EDBL_CONFIG_PROFILE, 1);
+	}
+}
+
 void telemetry_pages_newobj(unsigned int entryid,
                             odb_pid startpid, unsigned int straitc) {
 	if(!telemenabled) return;
@@ -451,6 +566,14 @@ void telemetry_pages_decached(odb_pid pid) {
 	};
 	odb_data_process(d);
 }
+void telemetry_pages_corrupt(odb_pid pid) {
+	if(!telemenabled) return;
+	struct odbtelem_data d = {
+			.class = ODBTELEM_PAGES_CORRUPT,
+			.pageid = pid,
+	};
+	odb_data_process(d);
+}
 void telemetry_workr_accepted(unsigned int workerid, unsigned int jobslot) {
 	if(!telemenabled) return;
 	struct odbtelem_data d = {
@@ -17,12 +17,23 @@ void telemetry_pages_newobj(unsigned int entryid, odb_pid startpid, unsigned int
 void telemetry_pages_newdel(odb_pid startpid);
 void telemetry_pages_cached(odb_pid pid);
 void telemetry_pages_decached(odb_pid pid);
+void telemetry_pages_corrupt(odb_pid pid);
 void telemetry_workr_accepted(unsigned int workerid, unsigned int jobslot);
 void telemetry_workr_pload(unsigned int workerid, odb_pid pageid);
 void telemetry_workr_punload(unsigned int workerid, odb_pid pageid);
 //void telemetry_job_added(unsigned int workerid, unsigned int jobslot); // later
 void telemetry_job_complete(unsigned int workerid, unsigned int jobslot);
 
+// the page cache whose counters go in the image (see
+// odbtelem_image_t.cachestats). Set it back to null before freeing the cache.
+struct edbpcache_t;
+void telemetry_image_cache(struct edbpcache_t *cache);
+
+// same as telemetry_image_cache but for the lock waits
+// (odbtelem_image_t.lockstats).
+struct edbl_host_t;
+void telemetry_image_locks(struct edbl_host_t *locks);
+
 
 //todo:
 //void telemetry_jobs_added(unsigned int jobslot);
@@ -35,11 +46,14 @@ void telemetry_job_complete(unsigned int workerid, unsigned int jobslot);
 #define telemetry_pages_newdel(...)
 #define telemetry_pages_cached(...)
 #define telemetry_pages_decached(...)
+#define telemetry_pages_corrupt(...)
 #define telemetry_workr_accepted(...)
 #define telemetry_workr_pload(...)
 #define telemetry_workr_punload(...)
 #define telemetry_jobs_added(...)
 #define telemetry_jobs_completed(...)
+#define telemetry_image_cache(...)
+#define telemetry_image_locks(...)
 #endif // EDBTELEM
 
 
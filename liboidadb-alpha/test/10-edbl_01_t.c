@@ -1,3 +1,5 @@
+#define _GNU_SOURCE
+
 #include "../edbl.h"
 #include <oidadb/telemetry.h>
 #include <oidadb/oidadb.h>
@@ -5,6 +7,38 @@
 
 
 #include <stdio.h>
+#include <pthread.h>
+
+struct setarg {
+	edbl_handle_t *h;
+	edbl_lock lock;
+	odb_err err;
+	int done; // set once edbl_set has returned
+};
+
+static void *setthread(void *a) {
+	struct setarg *arg = a;
+	arg->err = edbl_set(arg->h, EDBL_AXL, arg->lock);
+	__atomic_store_n(&arg->done, 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+// the type of OFD lock that another open file description of the file
+// would run into on the byte at off, F_UNLCK if none.
+static int ofdlocked(off64_t off) {
+	int fd = open(test_filenmae, O_RDWR);
+	struct flock64 f = {
+			.l_type = F_WRLCK,
+			.l_whence = SEEK_SET,
+			.l_start = off,
+			.l_len = 1,
+	};
+	if(fd == -1 || fcntl64(fd, F_OFD_GETLK, &f) == -1) {
+		test_error("F_OFD_GETLK");
+	}
+	close(fd);
+	return f.l_type;
+}
 
 void test_main() {
 
@@ -97,9 +131,280 @@ void test_main() {
 		return ;
 	}
 
+	// h1 has row 69 and waits on row 70, h2 has row 70 and then waits on 69.
+	// h2 was the last to start waiting so it should be the one to give up.
+	edbl_lock lock2 = lock;
+	lock2.page_ioffset = 70;
+	if((err = edbl_set(h1, EDBL_AXL, lock))
+	   || (err = edbl_set(h2, EDBL_AXL, lock2))) {
+		test_error("edbl_set 3");
+		return ;
+	}
+	pthread_t thread;
+	struct setarg h1set = {.h = h1, .lock = lock2};
+	pthread_create(&thread, 0, setthread, &h1set);
+	usleep(10000);
+	if(edbl_set(h2, EDBL_AXL, lock) != ODB_EDEADLK) {
+		test_error("deadlock not detected");
+		return ;
+	}
+	edbl_set(h2, EDBL_ARELEASE, lock2);
+	pthread_join(thread, 0);
+	if(h1set.err) {
+		test_error("h1 should have got row 70 after h2 gave up");
+		return ;
+	}
+
+	// h1 still has both, h2 gives up after 10ms.
+	edbl_host_config(host, EDBL_CONFIG_TIMEOUT, EDBL_LROW, 10);
+	if(edbl_set(h2, EDBL_ASH, lock2) != ODB_ETIMEDOUT) {
+		test_error("lock wait didn't time out");
+		return ;
+	}
+	struct odbtelem_lockstats stats;
+	edbl_host_stats(host, &stats);
+	if(stats.deadlocks != 1 || stats.timeouts != 1 || stats.waits < 3) {
+		test_error("lock stats: %ld waits, %ld deadlocks, %ld timeouts",
+		           stats.waits, stats.deadlocks, stats.timeouts);
+	}
+	edbl_set(h1, EDBL_ARELEASE, lock);
+	edbl_set(h1, EDBL_ARELEASE, lock2);
+
+	// intention locks: h1 writing rows in the entity lets h2 read other rows
+	// in it, but not SH the whole entity.
+	edbl_lock ent = {.type = EDBL_LENTRY, .eid = EDBD_EIDSTART};
+	if((err = edbl_set(h1, EDBL_AIX, ent))
+	   || (err = edbl_set(h1, EDBL_AXL, lock))) {
+		test_error("edbl_set 4");
+		return ;
+	}
+	if(edbl_test(h2, EDBL_AIS, ent) || edbl_test(h2, EDBL_ASH, lock2)) {
+		test_error("IX conflicted with IS");
+		return ;
+	}
+	if(edbl_test(h2, EDBL_ASH, ent) != ODB_EAGAIN) {
+		test_error("IX didn't conflict with SH");
+		return ;
+	}
+	edbl_set(h1, EDBL_ARELEASE, lock);
+	edbl_set(h1, EDBL_ARELEASE, ent);
+
+	// intention locks are only for entries.
+	if(edbl_set(h1, EDBL_AIS, lock) != ODB_EINVAL
+	   || edbl_set(h1, EDBL_AIX, lock) != ODB_EINVAL) {
+		test_error("intention lock on a row wasn't ODB_EINVAL");
+		return ;
+	}
+
+	// with the entity XL, the rows in it are covered. But only the ones that
+	// say they're in it.
+	lock.entity = EDBD_EIDSTART;
+	lock2.entity = EDBD_EIDSTART + 1;
+	edbl_set(h1, EDBL_AXL, ent);
+	edbl_set(h1, EDBL_AXL, lock);
+	edbl_set(h1, EDBL_AXL, lock2);
+	edbl_set(h1, EDBL_ARELEASE, ent);
+	if(edbl_test(h2, EDBL_AXL, lock)) {
+		test_error("row under LENTRY(xl) was placed");
+		return ;
+	}
+	if(edbl_test(h2, EDBL_AXL, lock2) != ODB_EAGAIN) {
+		test_error("row of another entity was covered by LENTRY(xl)");
+		return ;
+	}
+	edbl_set(h1, EDBL_ARELEASE, lock2);
+
+	// across threads: h1 and h3 share a row, h2 waits to XL it until both
+	// have let go. While h2 is waiting, new shared lockers (h4) wait behind
+	// it. (no more timing out)
+	edbl_host_config(host, EDBL_CONFIG_TIMEOUT, EDBL_LROW, 0);
+	edbl_handle_t *h3, *h4;
+	if((err = edbl_handle_init(host, &h3))
+	   || (err = edbl_handle_init(host, &h4))) {
+		test_error("edbl_handle_init");
+		return ;
+	}
+	edbl_lock lock3 = {.type = EDBL_LROW, .object_pid = 3, .page_ioffset = 10};
+	if((err = edbl_set(h1, EDBL_ASH, lock3))
+	   || (err = edbl_set(h3, EDBL_ASH, lock3))) {
+		test_error("2 handles couldn't share a row");
+		return ;
+	}
+	struct setarg h2set = {.h = h2, .lock = lock3};
+	pthread_create(&thread, 0, setthread, &h2set);
+	usleep(10000);
+	if(__atomic_load_n(&h2set.done, __ATOMIC_ACQUIRE)) {
+		test_error("XL was placed over 2 SH");
+		return ;
+	}
+	if(edbl_test(h4, EDBL_ASH, lock3) != ODB_EAGAIN) {
+		test_error("SH didn't queue behind a waiting XL");
+		return ;
+	}
+	edbl_set(h1, EDBL_ARELEASE, lock3);
+	usleep(10000);
+	if(__atomic_load_n(&h2set.done, __ATOMIC_ACQUIRE)) {
+		test_error("XL was placed over 1 SH");
+		return ;
+	}
+	edbl_set(h3, EDBL_ARELEASE, lock3);
+	pthread_join(thread, 0);
+	if(h2set.err) {
+		test_error("h2 should have got the XL once the SH were released");
+		return ;
+	}
+	if(edbl_test(h1, EDBL_ASH, lock3) != ODB_EAGAIN) {
+		test_error("SH didn't conflict with XL held by another thread");
+		return ;
+	}
+	edbl_set(h2, EDBL_ARELEASE, lock3);
+	if((err = edbl_test(h4, EDBL_ASH, lock3))) {
+		test_error("row still locked after XL was released");
+		return ;
+	}
+
+	// EDBL_CONFIG_PROFILE: some entry locks nobody waits on, then rounds of
+	// h2 and h3 both waiting on h1's row.
+	if((err = edbl_host_config(host, EDBL_CONFIG_PROFILE, 1))) {
+		test_error("EDBL_CONFIG_PROFILE");
+		return ;
+	}
+	const int entryc = 10, rounds = 3;
+	for(int i = 0; i < entryc; i++) {
+		edbl_set(h4, EDBL_AXL, ent);
+		edbl_set(h4, EDBL_ARELEASE, ent);
+	}
+	for(int i = 0; i < rounds; i++) {
+		edbl_set(h1, EDBL_AXL, lock3);
+		struct setarg setv[2] = {{.h = h2, .lock = lock3},
+		                         {.h = h3, .lock = lock3}};
+		pthread_t threadv[2];
+		for(int j = 0; j < 2; j++) {
+			pthread_create(&threadv[j], 0, setthread, &setv[j]);
+			usleep(10000);
+		}
+		edbl_set(h1, EDBL_ARELEASE, lock3);
+		// whichever got it lets go for the other.
+		int first = 0;
+		while(!__atomic_load_n(&setv[first].done, __ATOMIC_ACQUIRE)) {
+			first = !first;
+			usleep(1000);
+		}
+		edbl_set(setv[first].h, EDBL_ARELEASE, lock3);
+		pthread_join(threadv[0], 0);
+		pthread_join(threadv[1], 0);
+		edbl_set(setv[!first].h, EDBL_ARELEASE, lock3);
+		if(setv[0].err || setv[1].err) {
+			test_error("profiled edbl_set");
+			return ;
+		}
+	}
+	struct odbtelem_lockprofile prof;
+	if((err = edbl_host_profile(host, &prof))) {
+		test_error("edbl_host_profile");
+		return ;
+	}
+	struct odbtelem_locktype *pent = &prof.typev[EDBL_LENTRY];
+	struct odbtelem_locktype *prow = &prof.typev[EDBL_LROW];
+	if(pent->acquires != entryc || pent->releases != entryc
+	   || pent->waits != 0) {
+		test_error("entry profile: %ld acquires, %ld releases, %ld waits",
+		           pent->acquires, pent->releases, pent->waits);
+	}
+	if(prow->acquires != rounds * 3 || prow->releases != rounds * 3
+	   || prow->waits != rounds * 2 || prow->maxwaiters < 1
+	   || prow->holdns == 0) {
+		test_error("row profile: %ld acquires, %ld releases, %ld waits, "
+		           "%ld max waiters", prow->acquires, prow->releases,
+		           prow->waits, prow->maxwaiters);
+	}
+	uint64_t latencyc = 0;
+	for(int i = 0; i < ODBTELEM_LATENCYC; i++) {
+		latencyc += prow->acquirelatencyv[i];
+	}
+	if(latencyc != prow->acquires) {
+		test_error("%ld row acquires in the histogram (%ld expected)",
+		           latencyc, prow->acquires);
+	}
+	// the row is the only thing that was waited on.
+	struct odbtelem_lockhot *hot = &prof.hotv[0];
+	if(hot->type != EDBL_LROW
+	   || hot->offset != (uint64_t)edbd_size(p_dfile) * 3 + 10
+	   || hot->waits < rounds * 2 || hot->waits - hot->error > rounds * 2
+	   || hot->waitns == 0 || prof.hotv[1].waits != 0) {
+		test_error("top lock: type %d, offset %ld, %ld waits (%ld error)",
+		           hot->type, hot->offset, hot->waits, hot->error);
+	}
+	// and nothing more is counted once its off.
+	edbl_host_config(host, EDBL_CONFIG_PROFILE, 0);
+	edbl_set(h4, EDBL_AXL, ent);
+	edbl_set(h4, EDBL_ARELEASE, ent);
+	edbl_host_profile(host, &prof);
+	if(prof.typev[EDBL_LENTRY].acquires != entryc) {
+		test_error("profile kept counting after it was turned off");
+	}
+
+	// locks between handles never make it to the kernel...
+	edbl_lock arb = {.type = EDBL_LARBITRARY, .l_start = 3 * 4096 + 5,
+	                 .l_len = 1};
+	edbl_set(h1, EDBL_AXL, arb);
+	if(ofdlocked(arb.l_start) != F_UNLCK) {
+		test_error("lock table placed an OFD lock");
+		return ;
+	}
+	edbl_set(h1, EDBL_ARELEASE, arb);
+
+	// ...unless EDBL_CONFIG_OFD is on, then other processes can see them and
+	// we see theirs.
+	edbl_host_t *ofdhost;
+	edbl_handle_t *oh;
+	if((err = edbl_host_init(&ofdhost, p_dfile))
+	   || (err = edbl_host_config(ofdhost, EDBL_CONFIG_OFD, 1))
+	   || (err = edbl_handle_init(ofdhost, &oh))) {
+		test_error("ofd host");
+		return ;
+	}
+	if((err = edbl_set(oh, EDBL_AXL, arb)) || ofdlocked(arb.l_start) != F_WRLCK) {
+		test_error("EDBL_CONFIG_OFD didn't place XL as F_WRLCK");
+		return ;
+	}
+	if((err = edbl_set(oh, EDBL_ASH, arb)) || ofdlocked(arb.l_start) != F_RDLCK) {
+		test_error("EDBL_CONFIG_OFD didn't place SH as F_RDLCK");
+		return ;
+	}
+	edbl_set(oh, EDBL_ARELEASE, arb);
+	if(ofdlocked(arb.l_start) != F_UNLCK) {
+		test_error("EDBL_CONFIG_OFD didn't release the OFD lock");
+		return ;
+	}
+	int otherfd = open(test_filenmae, O_RDWR);
+	struct flock64 other = {
+			.l_type = F_WRLCK,
+			.l_whence = SEEK_SET,
+			.l_start = arb.l_start,
+			.l_len = 1,
+	};
+	if(otherfd == -1 || fcntl64(otherfd, F_OFD_SETLK, &other) == -1) {
+		test_error("couldn't place the other process' lock");
+		return ;
+	}
+	if(edbl_test(oh, EDBL_ASH, arb) != ODB_EAGAIN) {
+		test_error("EDBL_CONFIG_OFD didn't see another process' lock");
+		return ;
+	}
+	if((err = edbl_test(h1, EDBL_ASH, arb))) {
+		test_error("without EDBL_CONFIG_OFD the lock table saw an OFD lock");
+		return ;
+	}
+	close(otherfd);
+	edbl_handle_free(oh);
+	edbl_host_free(ofdhost);
+
 	// close handles
 	edbl_handle_free(h1);
 	edbl_handle_free(h2);
+	edbl_handle_free(h3);
+	edbl_handle_free(h4);
 
 	edbl_host_free(host);
 
@@ -5,6 +5,7 @@
 #include <oidadb/telemetry.h>
 #include "teststuff.h"
 #include "../edbp.h"
+#include "../edbp_u.h"
 #include "../edbd.h"
 #include "../edbh.h"
 
@@ -17,6 +18,9 @@
 
 atomic_int *page_loaded_amount;
 atomic_int *page_cached_amount;
+// ODBTELEM_PAGES_CORRUPT events, and the page of the last one.
+atomic_int corrupt_amount;
+odb_pid corrupt_last;
 
 // total time inside of edbp_start (microseconds)
 unsigned long totalspent = 0;
@@ -26,6 +30,7 @@ typedef struct {
 	int pagec;
 	odb_pid *pagev;
 	int tests;
+	int clean; // don't dirty the pages
 }threadstruct;
 
 void pload(struct odbtelem_data d) {
@@ -36,6 +41,10 @@ void pload(struct odbtelem_data d) {
 		case ODBTELEM_PAGES_CACHED:
 			page_cached_amount[d.pageid-65]++;
 			break;
+		case ODBTELEM_PAGES_CORRUPT:
+			corrupt_last = d.pageid;
+			corrupt_amount++;
+			break;
 	}
 }
 
@@ -54,10 +63,12 @@ void *gothread(void *args) {
 			continue;
 		}
 		// dirty the page for worst case-senario.
-		unsigned int *page = edbp_graw(h) + ODB_SPEC_HEADSIZE;
-		page[0x0]++;
-		page[0x1] = 0x69697777;
-		edbp_mod(h, EDBP_CACHEHINT, EDBP_HDIRTY);
+		if(!t->clean) {
+			unsigned int *page = edbp_graw(h) + ODB_SPEC_HEADSIZE;
+			page[0x0]++;
+			page[0x1] = 0x69697777;
+			edbp_mod(h, EDBP_CACHEHINT, EDBP_HDIRTY);
+		}
 		unsigned long int startt, finisht;
 		startt = (uint64_t)start.tv_sec*1000000 + start.tv_usec;
 		finisht = (uint64_t)end.tv_sec*1000000 + end.tv_usec;
@@ -68,6 +79,961 @@ void *gothread(void *args) {
 	return (void *)test_waserror;
 }
 
+// testing configs. Play with these for science.
+const int pagec = 15000; // pages to create
+const int page_strait = 1; // strait of pages
+const int cachesize = 256; // pra cache
+const int resizeto = 128; // cache size once the threads are going
+const int shards = 4; // cache shards (each needs >= threads slots)
+const int dirtyratio = EDBP_DIRTYRATIO_DEFAULT; // see EDBP_CONFIG_DIRTYRATIO
+const int verify = EDBP_VERIFY_ALWAYS; // see EDBP_CONFIG_VERIFY
+#define threads 16 // threads to start
+#define threads_tests 100 // page count each thread should test
+
+// the threaded run is done once for each of these.
+struct cacheconfig {
+	int arena; // see EDBP_CONFIG_ARENA
+	int zpool; // megabytes, see EDBP_CONFIG_ZPOOL (needs arena)
+	int pra;   // see EDBP_CONFIG_PRA
+	int clean; // read the pages without dirtying them (only clean pages
+	           // are put in the zpool)
+};
+const struct cacheconfig configv[] = {
+		{EDBP_ARENA_OFF, 0, EDBP_PRA_LRUK,     0},
+		{EDBP_ARENA_OFF, 0, EDBP_PRA_CLOCKPRO, 0},
+		{EDBP_ARENA_OFF, 0, EDBP_PRA_ARC,      0},
+		{EDBP_ARENA_ON,  1, EDBP_PRA_LRUK,     1},
+};
+
+// starts up a cache with config c and has all the threads go through
+// pageidorder with it while it's being shrunk. printtable prints out how many
+// times each page was loaded/faulted.
+static void runcache(edbd_t *dfile, const odb_pid *pages,
+                     odb_pid *pageidorder, struct cacheconfig c,
+                     int printtable) {
+	pthread_t threadv[threads];
+	edbphandle_t *handle[threads];
+	threadstruct t[threads];
+	bzero(page_loaded_amount, sizeof(atomic_int) * pagec);
+	bzero(page_cached_amount, sizeof(atomic_int) * pagec);
+	totalspent = 0;
+	printf("pra %d, arena %d, zpool %d, clean %d\n", c.pra, c.arena, c.zpool,
+	       c.clean);
+
+	// init the cache
+	edbpcache_t *cache;
+	err = edbp_cache_init(dfile, &cache);
+	if(err) {
+		test_error("edbp_cache_init");
+		return;
+	}
+	err = edbp_cache_config(cache, EDBP_CONFIG_CACHESIZE, cachesize);
+	if(err) {
+		test_error("edbp_cache_config");
+		goto ret;
+	}
+	err = edbp_cache_config(cache, EDBP_CONFIG_SHARDS, shards);
+	if(err) {
+		test_error("edbp_cache_config shards");
+		goto ret;
+	}
+	err = edbp_cache_config(cache, EDBP_CONFIG_ARENA, c.arena);
+	if(err) {
+		test_error("edbp_cache_config arena");
+		goto ret;
+	}
+	err = edbp_cache_config(cache, EDBP_CONFIG_ZPOOL, c.zpool);
+	if(err) {
+		test_error("edbp_cache_config zpool");
+		goto ret;
+	}
+	err = edbp_cache_config(cache, EDBP_CONFIG_PRA, c.pra);
+	if(err) {
+		test_error("edbp_cache_config pra");
+		goto ret;
+	}
+	err = edbp_cache_config(cache, EDBP_CONFIG_DIRTYRATIO, dirtyratio);
+	if(err) {
+		test_error("edbp_cache_config dirtyratio");
+		goto ret;
+	}
+	err = edbp_cache_config(cache, EDBP_CONFIG_VERIFY, verify);
+	if(err) {
+		test_error("edbp_cache_config verify");
+		goto ret;
+	}
+
+	// create handles
+	int handlec = 0;
+	for(int i = 0;i  < threads; i++) {
+		err = edbp_handle_init(cache, i, &handle[i]);
+		if(err) {
+			test_error("new handle");
+			break;
+		}
+		handlec++;
+		threadstruct *tr = &t[i];
+		tr->pagec = threads_tests;
+		tr->pagev = &pageidorder[threads_tests*i];
+		tr->h = handle[i];
+		tr->tests = threads_tests;
+		tr->clean = c.clean;
+		pthread_create(&threadv[i], 0, gothread, tr);
+	}
+
+	// shrink the cache out from under them.
+	err = edbp_cache_config(cache, EDBP_CONFIG_CACHESIZE, resizeto);
+	if(err) {
+		test_error("edbp_cache_config resize");
+	}
+
+	// join threads
+	for(int i = 0;i  < handlec; i++) {
+		void *tret;
+		pthread_join(threadv[i], &tret);
+		if(tret) {
+			test_error("pthread return");
+		}
+	}
+
+
+	printf("results\n");
+	int sumloads = 0;
+	int sumfaults = 0;
+	if(printtable) {
+		printf("| PID     | LOADED  | FAULT   |\n");
+		printf("|---------|---------|---------|\n");
+	}
+	for(int i = 0; i < pagec; i++) {
+		if(printtable) {
+			printf("| %7ld | %7d | %7d |\n",
+			       pages[i],
+			       page_loaded_amount[i],
+			       page_cached_amount[i]);
+		}
+		sumloads += page_loaded_amount[i];
+		sumfaults += page_cached_amount[i];
+	}
+	printf("sum loads: %d\n", sumloads);
+	printf("sum faults: %d\n", sumfaults);
+	printf("PRA Inefficiency: %f\n", (float)sumfaults / (float)sumloads);
+	printf("PRA total time (seconds): %f\n", (double)totalspent/1000000);
+	printf("PRA avg time per thread (seconds): %f\n", (double)
+			(totalspent)/(double)threads/1000000);
+	printf("PRA avg total time per call (usec): %f\n",
+		   (double)(totalspent)/(double)sumloads);
+	if(sumloads != threads * threads_tests) {
+		test_error("total loads: %d (%d expected)", sumloads, threads *
+		threads_tests);
+	}
+
+	// the cache's own counters should agree.
+	struct odbtelem_cachestats stats;
+	err = edbp_cache_stats(cache, &stats);
+	if(err) {
+		test_error("edbp_cache_stats");
+	} else {
+		uint64_t faults = 0;
+		for(int i = 0; i < ODBTELEM_LATENCYC; i++) {
+			faults += stats.faultlatencyv[i];
+		}
+		printf("cache hits: %ld, misses: %ld, dirty evictions: %ld, "
+		       "swap waits: %ld, compressed tier hits: %ld\n",
+		       stats.hits, stats.misses, stats.dirtyevictions, stats.swapwaits,
+		       stats.zhits);
+		if(stats.hits + stats.misses != threads * threads_tests) {
+			test_error("cache counted %ld loads (%d expected)",
+			           stats.hits + stats.misses, threads * threads_tests);
+		}
+		if(faults > stats.misses || (stats.misses && faults == 0)) {
+			test_error("%ld faults in the histogram for %ld misses",
+			           faults, stats.misses);
+		}
+		// pageidorder keeps coming back to the low pages while the cache is
+		// a fraction of them, so some of them have to come back out of the
+		// compressed tier.
+		if(c.zpool && stats.zhits == 0) {
+			test_error("no compressed tier hits with a %dMB zpool", c.zpool);
+		}
+	}
+
+	for(int i = 0;i  < handlec; i++) {
+		edbp_handle_free(handle[i]);
+	}
+
+	ret:
+	edbp_cache_free(cache);
+}
+
+// starts up a single shard cache of slots slots for the tests below. Pages
+// aren't checked against their checksums because the tests write straight
+// into the file.
+static odb_err smallcache(edbd_t *dfile, int slots, int pra,
+                          edbpcache_t **o_cache) {
+	if((err = edbp_cache_init(dfile, o_cache))) {
+		test_error("edbp_cache_init");
+		return err;
+	}
+	if((err = edbp_cache_config(*o_cache, EDBP_CONFIG_CACHESIZE, slots))
+	   || (err = edbp_cache_config(*o_cache, EDBP_CONFIG_PRA, pra))
+	   || (err = edbp_cache_config(*o_cache, EDBP_CONFIG_VERIFY,
+	                               EDBP_VERIFY_OFF))) {
+		test_error("edbp_cache_config");
+		edbp_cache_free(*o_cache);
+		return err;
+	}
+	return 0;
+}
+
+// edbp_start and edbp_finish id without any hints.
+static odb_err touch(edbphandle_t *h, odb_pid id) {
+	if((err = edbp_start(h, id))) {
+		test_error("edbp_start %ld", id);
+		return err;
+	}
+	edbp_finish(h);
+	return 0;
+}
+
+// writes the page's id into its body (see marked) straight to the file.
+static void markpage(edbd_t *dfile, odb_pid id) {
+	if(pwrite(dfile->descriptor, &id, sizeof(id),
+	          edbd_pid2off(dfile, id) + ODB_SPEC_HEADSIZE + 8)
+	   != sizeof(id)) {
+		test_error("pwrite");
+	}
+}
+
+// is page the page with id (as per markpage).
+static int marked(const void *page, odb_pid id) {
+	return *(const odb_pid *)(page + ODB_SPEC_HEADSIZE + 8) == id;
+}
+
+// the page id -> slot hash table, and lru-k's victim heap: pages that
+// keep being used should never be the ones swapped out for a scan.
+static void testvictims(edbd_t *dfile, const odb_pid *pages) {
+	// the hash table on its own first. Small enough that everything runs
+	// into everything else, so deleting has to shift buckets back.
+	edbp_bucket bucketv[16] = {0};
+	for(int i = 0; i < 12; i++) {
+		edbp_bucket_insert(bucketv, 15, pages[i], i);
+	}
+	for(int i = 0; i < 12; i += 2) {
+		edbp_bucket_delete(bucketv, 15, pages[i]);
+	}
+	edbp_bucket_delete(bucketv, 15, pages[12]); // not in there
+	for(int i = 0; i < 12; i++) {
+		edbp_slotid expect = i % 2 ? (edbp_slotid)i : (edbp_slotid)-1;
+		if(edbp_bucket_find(bucketv, 15, pages[i]) != expect) {
+			test_error("bucket of page %ld is wrong after deletes", pages[i]);
+		}
+	}
+
+	const int slots = 8, hotc = 4, scanc = 32;
+	edbpcache_t *cache;
+	edbphandle_t *h = 0;
+	if(smallcache(dfile, slots, EDBP_PRA_LRUK, &cache)) {
+		return;
+	}
+	if((err = edbp_handle_init(cache, 0, &h))) {
+		test_error("edbp_handle_init");
+		goto ret;
+	}
+
+	// a few rounds on the hot pages so they have an LRU-2 history, then a
+	// scan that's 4 times bigger than the cache.
+	for(int r = 0; r < 3; r++) {
+		for(int i = 0; i < hotc; i++) {
+			if(touch(h, pages[i])) goto ret;
+		}
+	}
+	for(int i = 0; i < scanc; i++) {
+		if(touch(h, pages[100 + i])) goto ret;
+	}
+
+	// the hash table has to agree with the slots, and the hot pages should
+	// still be there.
+	edbp_shard *shard = &cache->shardv[0];
+	int cached = 0;
+	for(edbp_slotid i = 0; i < shard->slot_count; i++) {
+		edbp_slot *slot = edbp_slotof(shard, i);
+		if(slot->id == 0) {
+			continue;
+		}
+		cached++;
+		if(edbp_bucket_find(shard->bucketv, shard->bucket_mask, slot->id) != i) {
+			test_error("page %ld in slot %d isn't hashed to it", slot->id, i);
+		}
+	}
+	if(cached != slots) {
+		test_error("%d pages cached after the scan (%d expected)", cached,
+		           slots);
+	}
+	for(int i = 0; i < hotc; i++) {
+		edbp_slotid s = edbp_bucket_find(shard->bucketv, shard->bucket_mask,
+		                                 pages[i]);
+		if(s == (edbp_slotid)-1 || edbp_slotof(shard, s)->id != pages[i]) {
+			test_error("hot page %ld was swapped out for the scan",
+			           pages[i]);
+		}
+	}
+
+	// thus going back to them is all hits.
+	struct odbtelem_cachestats before, after;
+	edbp_cache_stats(cache, &before);
+	for(int i = 0; i < hotc; i++) {
+		if(touch(h, pages[i])) goto ret;
+	}
+	edbp_cache_stats(cache, &after);
+	if(after.hits - before.hits != hotc || after.misses != before.misses) {
+		test_error("hot pages: %ld hits, %ld misses",
+		           after.hits - before.hits, after.misses - before.misses);
+	}
+
+	ret:
+	if(h) edbp_handle_free(h);
+	edbp_cache_free(cache);
+}
+
+// edbp_startv: the whole strait is loaded and pinned at once, and every
+// shard has to keep straitmax slots for each handle.
+static void teststrait(edbd_t *dfile, const odb_pid *pages) {
+	const int slots = 8, strait = 4;
+	const odb_pid first = pages[0];
+	for(int i = 0; i < slots * 2; i++) {
+		markpage(dfile, first + i);
+	}
+	edbpcache_t *cache;
+	edbphandle_t *h[3] = {0};
+	if(smallcache(dfile, slots, EDBP_PRA_LRUK, &cache)) {
+		return;
+	}
+	if(edbp_cache_config(cache, EDBP_CONFIG_STRAITMAX, EDBP_STRAITMAX + 1)
+	   != ODB_EINVAL) {
+		test_error("straitmax past EDBP_STRAITMAX should be EINVAL");
+	}
+	if((err = edbp_cache_config(cache, EDBP_CONFIG_STRAITMAX, strait))) {
+		test_error("edbp_cache_config straitmax");
+		goto ret;
+	}
+
+	// 8 slots is enough for 2 handles' straits, not 3. Nor can the cache
+	// be shrunk out from under the 2.
+	for(int i = 0; i < 2; i++) {
+		if((err = edbp_handle_init(cache, i, &h[i]))) {
+			test_error("edbp_handle_init %d", i);
+			goto ret;
+		}
+	}
+	if(edbp_handle_init(cache, 2, &h[2]) != ODB_ENOSPACE) {
+		test_error("third handle should be ENOSPACE");
+	}
+	if(edbp_cache_config(cache, EDBP_CONFIG_CACHESIZE, slots - 1)
+	   != ODB_EINVAL) {
+		test_error("shrinking below handles * straitmax should be EINVAL");
+	}
+
+	if(edbp_startv(h[0], first, strait + 1, 0) != ODB_EINVAL) {
+		test_error("starting more than straitmax should be EINVAL");
+	}
+
+	// both handles take a full strait, filling the cache with pinned pages.
+	void *pagev[2][EDBP_STRAITMAX];
+	for(int i = 0; i < 2; i++) {
+		odb_pid id = first + i * strait;
+		if((err = edbp_startv(h[i], id, strait, pagev[i]))) {
+			test_error("edbp_startv %d", i);
+			if(i) edbp_finish(h[0]);
+			goto ret;
+		}
+		if(edbp_graw(h[i]) != pagev[i][0] || edbp_gpid(h[i]) != id) {
+			test_error("graw/gpid aren't the first page of the strait");
+		}
+	}
+	edbp_shard *shard = &cache->shardv[0];
+	for(int i = 0; i < 2; i++) {
+		for(int j = 0; j < strait; j++) {
+			odb_pid id = first + i * strait + j;
+			if(!marked(pagev[i][j], id)) {
+				test_error("page %d of strait %d isn't page %ld", j, i, id);
+			}
+			edbp_slotid s = edbp_bucket_find(shard->bucketv,
+			                                 shard->bucket_mask, id);
+			if(s == (edbp_slotid)-1 || edbp_slotof(shard, s)->locks == 0) {
+				test_error("page %ld isn't pinned", id);
+			}
+		}
+	}
+	edbp_finish(h[0]);
+	edbp_finish(h[1]);
+
+	// once they're finished the next strait can swap them out.
+	if((err = edbp_startv(h[0], first + slots, strait, pagev[0]))) {
+		test_error("edbp_startv after finish");
+		goto ret;
+	}
+	for(int j = 0; j < strait; j++) {
+		if(!marked(pagev[0][j], first + slots + j)) {
+			test_error("page %d of the last strait is wrong", j);
+		}
+	}
+	edbp_finish(h[0]);
+
+	ret:
+	for(int i = 0; i < 3; i++) {
+		if(h[i]) edbp_handle_free(h[i]);
+	}
+	edbp_cache_free(cache);
+}
+
+// EDBP_CONFIG_HOTSET and edbp_warmup: the hot set saved when one cache is
+// freed loads the same pages back into the next.
+static void testhotset(edbd_t *dfile, const odb_pid *pages) {
+	enum {slots = 16, hotc = 6, coldc = 4};
+	const odb_pid *hot = &pages[200], *cold = &pages[300];
+	char path[sizeof(test_filenmae) + 8];
+	snprintf(path, sizeof(path), "%s.hot", test_filenmae);
+	int hfd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+	if(hfd == -1) {
+		test_error("open hot set");
+		return;
+	}
+	edbpcache_t *cache;
+	edbphandle_t *h = 0;
+	if(smallcache(dfile, slots, EDBP_PRA_LRUK, &cache)) {
+		close(hfd);
+		return;
+	}
+	if((err = edbp_cache_config(cache, EDBP_CONFIG_HOTSET, hfd))
+	   || (err = edbp_handle_init(cache, 0, &h))) {
+		test_error("hot set cache");
+		goto ret;
+	}
+	for(int i = 0; i < coldc; i++) {
+		if(touch(h, cold[i])) goto ret;
+	}
+	for(int r = 0; r < 3; r++) {
+		for(int i = 0; i < hotc; i++) {
+			if(touch(h, hot[i])) goto ret;
+		}
+	}
+	if((err = edbp_start(h, hot[0]))) {
+		test_error("edbp_start");
+		goto ret;
+	}
+	edbp_mod(h, EDBP_CACHEHINT, EDBP_HUSESOON);
+	edbp_finish(h);
+	edbp_handle_free(h);
+	h = 0;
+	edbp_cache_free(cache); // (saves the hot set)
+
+	// every page should be in there, the hot ones first.
+	edbp_hotsethead head;
+	edbp_hotpage hotpagev[hotc + coldc];
+	if(pread(hfd, &head, sizeof(head), 0) != sizeof(head)) {
+		test_error("hot set wasn't saved");
+		close(hfd);
+		return;
+	}
+	if(head.magic != EDBP_HOTSETMAGIC || head.pagesize != edbd_size(dfile)
+	   || head.pagec != hotc + coldc) {
+		test_error("hot set head: magic %x, pagesize %d, %ld pages",
+		           head.magic, head.pagesize, head.pagec);
+		close(hfd);
+		return;
+	}
+	if(pread(hfd, hotpagev, sizeof(hotpagev), sizeof(head))
+	   != sizeof(hotpagev)) {
+		test_error("hot set was cut short");
+		close(hfd);
+		return;
+	}
+	for(int i = 0; i < hotc + coldc; i++) {
+		int ishot = 0;
+		for(int j = 0; j < hotc; j++) {
+			ishot |= hotpagev[i].id == hot[j];
+		}
+		if(ishot != (i < hotc)) {
+			test_error("page %ld is %d in the hot set", hotpagev[i].id, i);
+		}
+		if(hotpagev[i].id == hot[0]
+		   && !(hotpagev[i].hints & EDBP_HUSESOON)) {
+			test_error("hot set lost page %ld's hints", hot[0]);
+		}
+	}
+
+	// warm a new cache up with it.
+	if(smallcache(dfile, slots, EDBP_PRA_LRUK, &cache)) {
+		close(hfd);
+		return;
+	}
+	if((err = edbp_handle_init(cache, 0, &h))) {
+		test_error("edbp_handle_init");
+		goto ret;
+	}
+	if((err = edbp_warmup(cache, hfd))) {
+		test_error("edbp_warmup");
+		goto ret;
+	}
+	while(__atomic_load_n(&cache->warmrunning, __ATOMIC_ACQUIRE) == 1) {
+		usleep(1000);
+	}
+	if(cache->handles != 1) {
+		test_error("warm-up left %d handles", cache->handles);
+	}
+	struct odbtelem_cachestats before, after;
+	edbp_cache_stats(cache, &before);
+	for(int i = 0; i < hotc + coldc; i++) {
+		if(touch(h, hotpagev[i].id)) goto ret;
+	}
+	edbp_cache_stats(cache, &after);
+	if(after.misses != before.misses) {
+		test_error("%ld of the hot set weren't warmed up",
+		           after.misses - before.misses);
+	}
+
+	// a hot set that was cut short is no good, an empty file is nothing to
+	// warm up.
+	ftruncate(hfd, sizeof(head) + sizeof(edbp_hotpage));
+	if(edbp_warmup(cache, hfd) != ODB_EFILE) {
+		test_error("a cut short hot set should be EFILE");
+	}
+	ftruncate(hfd, 0);
+	if((err = edbp_warmup(cache, hfd))) {
+		test_error("an empty hot set should be nothing");
+	}
+
+	ret:
+	if(h) edbp_handle_free(h);
+	edbp_cache_free(cache);
+	close(hfd);
+	unlink(path);
+}
+
+// EDBP_CONFIG_INDEXTIER: index pages stay put no matter how much a scan
+// goes through, with every page replacement algorithm.
+static void testindextier(edbd_t *dfile, const odb_pid *pages) {
+	const int slots = 16, indexc = 4, scanc = 64;
+	const odb_pid *index = &pages[400], *scan = &pages[500];
+	for(unsigned int pra = EDBP_PRA_LRUK; pra <= EDBP_PRA_ARC; pra++) {
+		edbpcache_t *cache;
+		edbphandle_t *h = 0;
+		if(smallcache(dfile, slots, pra, &cache)) {
+			return;
+		}
+		if(edbp_cache_config(cache, EDBP_CONFIG_INDEXTIER,
+		                     EDBP_INDEXTIERMAX + 1) != ODB_EINVAL) {
+			test_error("index tier past EDBP_INDEXTIERMAX should be EINVAL");
+		}
+		// (a quarter of the slots, just enough for the index pages)
+		if((err = edbp_cache_config(cache, EDBP_CONFIG_INDEXTIER, 25))
+		   || (err = edbp_handle_init(cache, 0, &h))) {
+			test_error("index tier cache");
+			goto ret;
+		}
+		for(int i = 0; i < indexc; i++) {
+			if((err = edbp_start(h, index[i]))) {
+				test_error("edbp_start");
+				goto ret;
+			}
+			edbp_mod(h, EDBP_CACHEHINT, EDBP_HINDEX0);
+			edbp_finish(h);
+		}
+		// the scan goes through every page twice, some with the hint and
+		// some without.
+		for(int r = 0; r < 2; r++) {
+			for(int i = 0; i < scanc; i++) {
+				if((err = edbp_start(h, scan[i]))) {
+					test_error("edbp_start");
+					goto ret;
+				}
+				if(i % 2) edbp_mod(h, EDBP_CACHEHINT, EDBP_HSEQUENTIAL);
+				edbp_finish(h);
+			}
+		}
+
+		edbp_shard *shard = &cache->shardv[0];
+		if(shard->tierc != indexc) {
+			test_error("pra %d: %d pages in the tier (%d expected)", pra,
+			           shard->tierc, indexc);
+		}
+		for(int i = 0; i < indexc; i++) {
+			edbp_slotid s = edbp_bucket_find(shard->bucketv,
+			                                 shard->bucket_mask, index[i]);
+			if(s == (edbp_slotid)-1) {
+				test_error("pra %d: index page %ld was swapped out by the "
+				           "scan", pra, index[i]);
+			} else if(edbp_slotof(shard, s)->tier != EDBP_TIERUPPER) {
+				test_error("pra %d: index page %ld isn't in the tier", pra,
+				           index[i]);
+			}
+		}
+
+		// and finishing one with EDBP_HRESET lets it go.
+		if((err = edbp_start(h, index[0]))) {
+			test_error("edbp_start");
+			goto ret;
+		}
+		edbp_mod(h, EDBP_CACHEHINT, EDBP_HRESET);
+		edbp_finish(h);
+		edbp_slotid s = edbp_bucket_find(shard->bucketv, shard->bucket_mask,
+		                                 index[0]);
+		if(shard->tierc != indexc - 1
+		   || (s != (edbp_slotid)-1 && edbp_slotof(shard, s)->tier)) {
+			test_error("pra %d: reset index page is still in the tier", pra);
+		}
+
+		ret:
+		if(h) edbp_handle_free(h);
+		edbp_cache_free(cache);
+	}
+}
+
+// EDBP_CONFIG_NUMA: with EDBP_NUMA_LOCAL each shard is kept on a node of its
+// own, and pages still come out right whichever policy the arena has.
+static void testnuma(edbd_t *dfile, const odb_pid *pages) {
+	const int slots = 16, shardc = 4;
+	const odb_pid first = pages[600];
+	for(int i = 0; i < slots * 2; i++) {
+		markpage(dfile, first + i);
+	}
+	for(unsigned int numa = EDBP_NUMA_OFF; numa <= EDBP_NUMA_LOCAL; numa++) {
+		edbpcache_t *cache;
+		edbphandle_t *h = 0;
+		if(smallcache(dfile, slots, EDBP_PRA_LRUK, &cache)) {
+			return;
+		}
+		if(edbp_cache_config(cache, EDBP_CONFIG_NUMA, EDBP_NUMA_LOCAL + 1)
+		   != ODB_EINVAL) {
+			test_error("unknown numa policy should be EINVAL");
+		}
+		// on a machine with only the one node, pretend there's 2 so that
+		// the shards are split up. (binding to a node that isn't there
+		// isn't fatal, the pages just go wherever)
+		if(cache->nodec < 2) {
+			cache->nodec = 2;
+			cache->nodemask = 0x3;
+		}
+		if((err = edbp_cache_config(cache, EDBP_CONFIG_SHARDS, shardc))
+		   || (err = edbp_cache_config(cache, EDBP_CONFIG_ARENA,
+		                               EDBP_ARENA_ON))
+		   || (err = edbp_cache_config(cache, EDBP_CONFIG_NUMA, numa))
+		   || (err = edbp_handle_init(cache, 0, &h))) {
+			test_error("numa %d cache", numa);
+			goto ret;
+		}
+		for(int i = 0; i < shardc; i++) {
+			int node = -1;
+			if(numa == EDBP_NUMA_LOCAL) {
+				// (the i % nodec'th node in the mask)
+				uint64_t mask = cache->nodemask;
+				for(int n = i % cache->nodec; n; n--) mask &= mask - 1;
+				node = __builtin_ctzll(mask);
+			}
+			if(cache->shardv[i].node != node) {
+				test_error("numa %d: shard %d on node %d (%d expected)", numa,
+				           i, cache->shardv[i].node, node);
+			}
+		}
+		for(int i = 0; i < slots * 2; i++) {
+			if((err = edbp_start(h, first + i))) {
+				test_error("edbp_start");
+				goto ret;
+			}
+			if(!marked(edbp_graw(h), first + i)) {
+				test_error("numa %d: page %ld is wrong", numa, first + i);
+			}
+			edbp_finish(h);
+		}
+
+		ret:
+		if(h) edbp_handle_free(h);
+		edbp_cache_free(cache);
+	}
+}
+
+// EDBP_CONFIG_DIRTYRATIO: once more of the shard is dirty than the ratio
+// allows, the writeback thread cleans the coldest pages on its own (nothing
+// has to be swapped out for that to happen) and what it writes out is what
+// was in the cache.
+static void testwriteback(edbd_t *dfile, const odb_pid *pages) {
+	enum {slots = 16, dirtyc = 12, ratio = 25};
+	const edbp_slotid dirtymax = slots * ratio / 100;
+	const odb_pid first = pages[800];
+	edbpcache_t *cache;
+	edbphandle_t *h = 0;
+	if(smallcache(dfile, slots, EDBP_PRA_LRUK, &cache)) {
+		return;
+	}
+	if((err = edbp_cache_config(cache, EDBP_CONFIG_ARENA, EDBP_ARENA_ON))
+	   || (err = edbp_handle_init(cache, 0, &h))) {
+		test_error("writeback cache");
+		goto ret;
+	}
+
+	// dirty them with the thread off so they all stay dirty.
+	for(int i = 0; i < dirtyc; i++) {
+		if((err = edbp_start(h, first + i))) {
+			test_error("edbp_start");
+			goto ret;
+		}
+		*(odb_pid *)(edbp_graw(h) + ODB_SPEC_HEADSIZE + 8) = ~(first + i);
+		edbp_mod(h, EDBP_CACHEHINT, EDBP_HDIRTY);
+		edbp_finish(h);
+	}
+	edbp_shard *shard = &cache->shardv[0];
+	if(shard->dirtyc != dirtyc) {
+		test_error("%d dirty pages (%d expected)", shard->dirtyc, dirtyc);
+		goto ret;
+	}
+
+	struct odbtelem_cachestats before, after;
+	edbp_cache_stats(cache, &before);
+	if((err = edbp_cache_config(cache, EDBP_CONFIG_DIRTYRATIO, ratio))) {
+		test_error("edbp_cache_config dirtyratio");
+		goto ret;
+	}
+	for(int i = 0; i < 50 && __atomic_load_n(&shard->dirtyc, __ATOMIC_RELAXED)
+	                         > dirtymax; i++) {
+		usleep(EDBP_WBINTERVAL * 1000);
+	}
+	if(shard->dirtyc > dirtymax) {
+		test_error("writeback left %d dirty pages (%d at most)",
+		           shard->dirtyc, dirtymax);
+	}
+	edbp_cache_stats(cache, &after);
+	if(after.misses != before.misses
+	   || after.dirtyevictions != before.dirtyevictions) {
+		test_error("writeback went through %ld faults, %ld dirty evictions",
+		           after.misses - before.misses,
+		           after.dirtyevictions - before.dirtyevictions);
+	}
+
+	// the pages it cleaned are in the file.
+	int written = 0;
+	for(int i = 0; i < dirtyc; i++) {
+		odb_pid mark;
+		if(pread(dfile->descriptor, &mark, sizeof(mark),
+		         edbd_pid2off(dfile, first + i) + ODB_SPEC_HEADSIZE + 8)
+		   != sizeof(mark)) {
+			test_error("pread");
+			goto ret;
+		}
+		written += mark == ~(first + i);
+	}
+	if(written < dirtyc - shard->dirtyc) {
+		test_error("%d pages written out for %d cleaned", written,
+		           dirtyc - shard->dirtyc);
+	}
+
+	ret:
+	if(h) edbp_handle_free(h);
+	edbp_cache_free(cache);
+}
+
+// EDBP_CONFIG_PSI: the psi thread's steps, driven by hand sense there's no
+// telling when the machine will be under memory pressure. Each step down
+// takes an eighth but never goes under a quarter, and the steps back up stop
+// at the size it was set to.
+static void testpsi(edbd_t *dfile, const odb_pid *pages) {
+	enum {slots = 64};
+	const odb_pid first = pages[900];
+	edbpcache_t *cache;
+	edbphandle_t *h = 0;
+	for(int i = 0; i < slots; i++) {
+		markpage(dfile, first + i);
+	}
+	if(smallcache(dfile, slots, EDBP_PRA_LRUK, &cache)) {
+		return;
+	}
+	if((err = edbp_handle_init(cache, 0, &h))) {
+		test_error("edbp_handle_init");
+		goto ret;
+	}
+	for(int i = 0; i < slots; i++) {
+		if(touch(h, first + i)) goto ret;
+	}
+
+	edbp_slotid size = slots;
+	for(int i = 0; i < 16; i++) {
+		edbp_slotid want = size - size / EDBP_PSISTEP;
+		if(want < slots / EDBP_PSIMIN) want = slots / EDBP_PSIMIN;
+		size = edbp_psi_step(cache, 1);
+		if(size != want) {
+			test_error("psi shrink %d: %d slots (%d expected)", i, size, want);
+			goto ret;
+		}
+	}
+	if(size != slots / EDBP_PSIMIN) {
+		test_error("psi shrunk down to %d", size);
+	}
+
+	// still works at that size.
+	for(int i = 0; i < slots; i++) {
+		if((err = edbp_start(h, first + i))) {
+			test_error("edbp_start");
+			goto ret;
+		}
+		if(!marked(edbp_graw(h), first + i)) {
+			test_error("page %ld is wrong after shrinking", first + i);
+		}
+		edbp_finish(h);
+	}
+
+	for(int i = 0; i < 16; i++) {
+		edbp_slotid want = size + slots / EDBP_PSISTEP;
+		if(want > slots) want = slots;
+		size = edbp_psi_step(cache, 0);
+		if(size != want) {
+			test_error("psi grow %d: %d slots (%d expected)", i, size, want);
+			goto ret;
+		}
+	}
+	if(size != slots || cache->shardv[0].slot_count != slots) {
+		test_error("psi grew back to %d", size);
+	}
+
+	// and the thread itself starts and stops (if the kernel has psi).
+	err = edbp_cache_config(cache, EDBP_CONFIG_PSI, 100000);
+	if(err == 0) {
+		if(!cache->psirunning) {
+			test_error("psi thread isn't running");
+		}
+		if((err = edbp_cache_config(cache, EDBP_CONFIG_PSI, 0))
+		   || cache->psirunning) {
+			test_error("psi thread didn't stop");
+		}
+	} else if(err != ODB_EERRNO) {
+		test_error("edbp_cache_config psi");
+	}
+	err = 0;
+
+	ret:
+	if(h) edbp_handle_free(h);
+	edbp_cache_free(cache);
+}
+
+// the page checksums: crc32c itself, and a page that was changed on disk
+// behind the cache's back is caught when it's loaded in.
+static void testchecksum(edbd_t *dfile, const odb_pid *pages) {
+	if(edbp_crc32c(0, "123456789", 9) != 0xE3069283
+	   || edbp_crc32c_sw(0, "123456789", 9) != 0xE3069283) {
+		test_error("crc32c of \"123456789\": %08x (sw %08x)",
+		           edbp_crc32c(0, "123456789", 9),
+		           edbp_crc32c_sw(0, "123456789", 9));
+		return;
+	}
+
+	// sse4.2 against the tables: lengths around the 3 stream cut off and
+	// starts that aren't 8 byte aligned, and in pieces.
+	enum {bufc = 3 * 4096};
+	uint8_t *buf = malloc(bufc + 8);
+	srand(3535);
+	for(int i = 0; i < bufc + 8; i++) {
+		buf[i] = (uint8_t)rand();
+	}
+	uint32_t hw;
+	if(!edbp_crc32c_hw(0, buf, 1, &hw)) {
+		test_log("no sse4.2, only checking the tables");
+	}
+	for(int i = 0; i < 300; i++) {
+		size_t off = rand() % 8;
+		size_t len = i < 100 ? (size_t)i : rand() % bufc;
+		uint32_t sw = edbp_crc32c_sw(0, buf + off, len);
+		if(edbp_crc32c_hw(0, buf + off, len, &hw) && hw != sw) {
+			test_error("crc32c of %ld bytes at %ld: sse4.2 %08x, tables %08x",
+			           len, off, hw, sw);
+			break;
+		}
+		size_t cut = len ? rand() % len : 0;
+		if(edbp_crc32c(edbp_crc32c(0, buf + off, cut), buf + off + cut,
+		               len - cut) != sw) {
+			test_error("crc32c of %ld bytes at %ld cut at %ld", len, off, cut);
+			break;
+		}
+	}
+	free(buf);
+
+	// write a page out through the cache so it gets its checksum.
+	const odb_pid id = pages[960];
+	edbpcache_t *cache;
+	edbphandle_t *h = 0;
+	uint32_t sum = 0;
+	if(smallcache(dfile, 8, EDBP_PRA_LRUK, &cache)) {
+		return;
+	}
+	if((err = edbp_cache_config(cache, EDBP_CONFIG_VERIFY,
+	                            EDBP_VERIFY_ALWAYS))
+	   || (err = edbp_handle_init(cache, 0, &h))) {
+		test_error("checksum cache");
+		goto ret;
+	}
+	if((err = edbp_start(h, id))) {
+		test_error("edbp_start");
+		goto ret;
+	}
+	*(odb_pid *)(edbp_graw(h) + ODB_SPEC_HEADSIZE + 8) = id;
+	edbp_mod(h, EDBP_CACHEHINT, EDBP_HDIRTY);
+	edbp_finish(h);
+	edbp_handle_free(h);
+	h = 0;
+	edbp_cache_free(cache);
+	cache = 0;
+	int64_t off = edbd_pid2off(dfile, id);
+	if(pread(dfile->descriptor, &sum, sizeof(sum), off) != sizeof(sum)
+	   || sum == 0) {
+		test_error("page %ld wasn't given a checksum", id);
+		return;
+	}
+
+	// loads fine as is, but not with a byte of its body changed.
+	for(int corrupt = 0; corrupt < 2; corrupt++) {
+		if(corrupt) {
+			uint8_t b;
+			pread(dfile->descriptor, &b, 1, off + edbd_size(dfile) - 1);
+			b ^= 0x10;
+			pwrite(dfile->descriptor, &b, 1, off + edbd_size(dfile) - 1);
+		}
+		if(smallcache(dfile, 8, EDBP_PRA_LRUK, &cache)) {
+			return;
+		}
+		if((err = edbp_cache_config(cache, EDBP_CONFIG_VERIFY,
+		                            EDBP_VERIFY_ALWAYS))
+		   || (err = edbp_handle_init(cache, 0, &h))) {
+			test_error("checksum cache");
+			goto ret;
+		}
+		int corruptc = corrupt_amount;
+		err = edbp_start(h, id);
+		if(!corrupt) {
+			if(err || !marked(edbp_graw(h), id)) {
+				test_error("sealed page didn't load: %d", err);
+				goto ret;
+			}
+			edbp_finish(h);
+		} else {
+			if(err != ODB_ECRIT) {
+				test_error("corrupt page loaded: %d", err);
+				if(!err) edbp_finish(h);
+				goto ret;
+			}
+			if(corrupt_amount != corruptc + 1 || corrupt_last != id) {
+				test_error("corrupt page wasn't reported (%d events, page %ld)",
+				           corrupt_amount - corruptc, corrupt_last);
+			}
+			err = 0;
+		}
+		edbp_handle_free(h);
+		h = 0;
+		edbp_cache_free(cache);
+		cache = 0;
+	}
+
+	ret:
+	if(h) edbp_handle_free(h);
+	if(cache) edbp_cache_free(cache);
+}
+
 void test_main() {
 	// create an empty file
 	struct odb_createparams createparams  =odb_createparams_defaults;
@@ -87,6 +1053,7 @@ void test_main() {
 	odbtelem(1, (struct odbtelem_params){.buffersize_exp=5});
 	odbtelem_bind(ODBTELEM_WORKR_PLOAD, pload);
 	odbtelem_bind(ODBTELEM_PAGES_CACHED, pload);
+	odbtelem_bind(ODBTELEM_PAGES_CORRUPT, pload);
 	edbd_t dfile;
 	edbd_config config = edbd_config_default;
 	config.delpagewindowsize = 1;
@@ -96,16 +1063,6 @@ void test_main() {
 		return;
 	}
 
-	////////////////////////////////////////////////////////////////////////////
-	//
-	// testing configs. Play with these for science.
-	//
-	////////////////////////////////////////////////////////////////////////////
-	const int pagec = 15000; // pages to create
-	const int page_strait = 1; // strait of pages
-	const int cachesize = 256; // pra cache
-	const int threads = 16; // threads to start
-	const int threads_tests = 100; // page count each thread should test
 	// I'm not sure what this means. But I try to make this a percent.
 	//
 	// When I set it to 0.7 this makes 30% of the pages loaded 70% of the time.
@@ -120,14 +1077,9 @@ void test_main() {
 
 	// working vars.
 	odb_pid pages[pagec];
-	pthread_t threadv[threads];
-	edbphandle_t *handle[threads];
-	threadstruct t[threads];
 	odb_pid pageidorder[threads_tests * threads];
 	page_loaded_amount = malloc(sizeof(atomic_int) * pagec);
 	page_cached_amount = malloc(sizeof(atomic_int) * pagec);
-	bzero(page_loaded_amount, sizeof(atomic_int) * pagec);
-	bzero(page_cached_amount, sizeof(atomic_int) * pagec);
 
 	// create pages
 	for(int i = 0; i < pagec; i++) {
@@ -138,19 +1090,6 @@ void test_main() {
 		}
 	}
 
-	// init the cache
-	edbpcache_t *cache;
-	err = edbp_cache_init(&dfile, &cache);
-	if(err) {
-		test_error("edbp_cache_init");
-		goto ret;
-	}
-	err = edbp_cache_config(cache, EDBP_CONFIG_CACHESIZE, cachesize);
-	if(err) {
-		test_error("edbp_cache_config");
-		goto ret;
-	}
-
 	// create page list: the full list of all pages that will be loaded in
 	// which order (save for multithreading). Here is where you apply
 	// preferences to pages.
@@ -167,68 +1106,22 @@ void test_main() {
 
 	}
 
-	// create handles
-	for(int i = 0;i  < threads; i++) {
-		err = edbp_handle_init(cache, i, &handle[i]);
-		if(err) {
-			test_error("new handle");
-			break;
-		}
-		threadstruct *tr = &t[i];
-		tr->pagec = threads_tests;
-		tr->pagev = &pageidorder[threads_tests*i];
-		tr->h = handle[i];
-		tr->tests = threads_tests;
-		pthread_create(&threadv[i], 0, gothread, tr);
-	}
-
-	// join threads
-	for(int i = 0;i  < threads; i++) {
-		void *ret;
-		pthread_join(threadv[i], &ret);
-		if(ret) {
-			test_error("pthread return");
-			goto ret;
-		}
+	// once per pra, and once more with the arena (and the compressed tier).
+	for(int i = 0; i < sizeof(configv) / sizeof(configv[0]); i++) {
+		runcache(&dfile, pages, pageidorder, configv[i], i == 0);
 	}
 
+	testvictims(&dfile, pages);
+	teststrait(&dfile, pages);
+	testhotset(&dfile, pages);
+	testindextier(&dfile, pages);
+	testnuma(&dfile, pages);
+	testwriteback(&dfile, pages);
+	testpsi(&dfile, pages);
+	testchecksum(&dfile, pages);
 
-	printf("results\n");
-	int sumloads = 0;
-	int sumfaults = 0;
-	printf("| PID     | LOADED  | FAULT   |\n");
-	printf("|---------|---------|---------|\n");
-	for(int i = 0; i < pagec; i++) {
-		printf("| %7ld | %7d | %7d |\n",
-			   pages[i],
-			   page_loaded_amount[i],
-			   page_cached_amount[i]);
-		sumloads += page_loaded_amount[i];
-		sumfaults += page_cached_amount[i];
-	}
-	printf("sum loads: %d\n", sumloads);
-	printf("sum faults: %d\n", sumfaults);
-	printf("PRA Inefficiency: %f\n", (float)sumfaults / (float)sumloads);
-	printf("PRA total time (seconds): %f\n", (double)totalspent/1000000);
-	printf("PRA avg time per thread (seconds): %f\n", (double)
-			(totalspent)/(double)threads/1000000);
-	printf("PRA avg total time per call (usec): %f\n",
-		   (double)(totalspent)/(double)sumloads);
-	if(sumloads != threads * threads_tests) {
-		test_error("total loads: %d (%d expected)", sumloads, threads *
-		threads_tests);
-	}
-
+	ret:
 	free(page_loaded_amount);
 	free(page_cached_amount);
-	for(int i = 0;i  < threads; i++) {
-		edbp_handle_free(handle[i]);
-	}
-
-
-	edbp_cache_free(cache);
 	edbd_close(&dfile);
-
-	ret:
-	return;
-}
\ No newline at end of file
+}
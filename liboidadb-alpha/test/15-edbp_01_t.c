@@ -0,0 +1,113 @@
+#include "../edbp.h"
+#include <oidadb/oidadb.h>
+#include "teststuff.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// replays made-up traces through each page replacement algorithm with
+// edbp_pra_simulate.
+
+#define SLOTS 64
+#define TRACEC 100000
+
+static const char *pranames[] = {"lru-k", "clock-pro", "arc"};
+
+void test_main() {
+	edbp_trace *tracev = malloc(sizeof(edbp_trace) * TRACEC);
+	if(tracev == 0) {
+		test_error("malloc");
+		return;
+	}
+	uint64_t hits;
+
+	// invals
+	tracev[0] = (edbp_trace){.id = 1};
+	if(edbp_pra_simulate(99, SLOTS, tracev, 1, &hits) != ODB_EINVAL) {
+		test_error("unknown pra should be EINVAL");
+	}
+	if(edbp_pra_simulate(EDBP_PRA_LRUK, 0, tracev, 1, &hits) != ODB_EINVAL) {
+		test_error("0 slots should be EINVAL");
+	}
+	tracev[0].id = 0;
+	if(edbp_pra_simulate(EDBP_PRA_ARC, SLOTS, tracev, 1, &hits) != ODB_EINVAL) {
+		test_error("page id 0 should be EINVAL");
+	}
+
+	// a loop that fits in the cache: only the first time around is a miss.
+	for(int i = 0; i < TRACEC; i++) {
+		tracev[i] = (edbp_trace){.id = 1 + i % (SLOTS - 14)};
+	}
+	for(unsigned int pra = EDBP_PRA_LRUK; pra <= EDBP_PRA_ARC; pra++) {
+		err = edbp_pra_simulate(pra, SLOTS, tracev, TRACEC, &hits);
+		if(err) {
+			test_error("%s: simulate", pranames[pra]);
+			continue;
+		}
+		if(hits != TRACEC - (SLOTS - 14)) {
+			test_error("%s: working set fits but got %ld hits",
+			           pranames[pra], hits);
+		}
+	}
+
+	// half of the accesses go to a hot set 3/4 the size of the cache, the
+	// other half is a scan that never comes back. A scan-resistant algorithm
+	// should keep nearly all of the hot set in.
+	unsigned int seed = 1;
+	for(int i = 0; i < TRACEC; i++) {
+		if(i % 2) {
+			tracev[i] = (edbp_trace){.id = 1000 + i};
+		} else {
+			tracev[i] = (edbp_trace){.id = 1 + rand_r(&seed) % (SLOTS * 3 / 4)};
+		}
+	}
+	for(unsigned int pra = EDBP_PRA_LRUK; pra <= EDBP_PRA_ARC; pra++) {
+		err = edbp_pra_simulate(pra, SLOTS, tracev, TRACEC, &hits);
+		if(err) {
+			test_error("%s: simulate", pranames[pra]);
+			continue;
+		}
+		test_log("%s: scan + hot set: %.1f%% hits", pranames[pra],
+		         100.0 * (double)hits / TRACEC);
+		if(hits < TRACEC / 2 * 9 / 10) {
+			test_error("%s: kept less than 90%% of the hot set", pranames[pra]);
+		}
+	}
+
+	// hints: same as above but the scan is told its not coming back.
+	for(int i = 1; i < TRACEC; i += 2) {
+		tracev[i].hints = EDBP_HRESET;
+	}
+	for(unsigned int pra = EDBP_PRA_LRUK; pra <= EDBP_PRA_ARC; pra++) {
+		err = edbp_pra_simulate(pra, SLOTS, tracev, TRACEC, &hits);
+		if(err) {
+			test_error("%s: simulate", pranames[pra]);
+			continue;
+		}
+		test_log("%s: hinted scan + hot set: %.1f%% hits", pranames[pra],
+		         100.0 * (double)hits / TRACEC);
+		if(hits < TRACEC / 2 * 99 / 100) {
+			test_error("%s: hinted scan pushed out the hot set", pranames[pra]);
+		}
+	}
+
+	// same again but hinted the way edba_pageadvance does it.
+	for(int i = 1; i < TRACEC; i += 2) {
+		tracev[i].hints = EDBP_HSEQUENTIAL;
+	}
+	for(unsigned int pra = EDBP_PRA_LRUK; pra <= EDBP_PRA_ARC; pra++) {
+		err = edbp_pra_simulate(pra, SLOTS, tracev, TRACEC, &hits);
+		if(err) {
+			test_error("%s: simulate", pranames[pra]);
+			continue;
+		}
+		test_log("%s: sequential scan + hot set: %.1f%% hits", pranames[pra],
+		         100.0 * (double)hits / TRACEC);
+		if(hits < TRACEC / 2 * 99 / 100) {
+			test_error("%s: sequential scan pushed out the hot set",
+			           pranames[pra]);
+		}
+	}
+
+	free(tracev);
+}
@@ -0,0 +1,79 @@
+#include "../edbp_u.h"
+#include <oidadb/oidadb.h>
+#include "teststuff.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// round trips made-up pages through the compressed tier's codec
+// (edbp_lz_compress / edbp_lz_decompress).
+
+#define PAGESIZE 4096
+
+void test_main() {
+	uint8_t page[PAGESIZE], comp[PAGESIZE * 2], back[PAGESIZE];
+	unsigned int seed = 1;
+	size_t total = 0, totalc = 0;
+
+	for(int t = 0; t < 4000; t++) {
+		// mostly pages like the real ones: fixed size objects with most of
+		// them zero padding. Then random junk, then a repeating pattern.
+		int kind = t % 4;
+		for(int i = 0; i < PAGESIZE; i++) {
+			switch(kind) {
+				case 0:
+				case 1:
+					page[i] = i % 64 < 12 ? rand_r(&seed) % 4 : 0;
+					break;
+				case 2:
+					page[i] = rand_r(&seed);
+					break;
+				default:
+					page[i] = "oidadb"[i % 6];
+					break;
+			}
+		}
+
+		size_t c = edbp_lz_compress(page, PAGESIZE, comp, sizeof(comp));
+		if(c == 0) {
+			test_error("page %d (kind %d) didn't fit in twice its size", t, kind);
+			continue;
+		}
+		if(kind != 2) {
+			total += PAGESIZE;
+			totalc += c;
+		}
+		memset(back, 0xAA, PAGESIZE);
+		if(edbp_lz_decompress(comp, c, back, PAGESIZE)) {
+			test_error("page %d (kind %d) failed to decompress", t, kind);
+			continue;
+		}
+		if(memcmp(page, back, PAGESIZE)) {
+			test_error("page %d (kind %d) came back different", t, kind);
+			continue;
+		}
+
+		// random data won't compress to EDBP_ZRATIO.
+		if(kind == 2 && edbp_lz_compress(page, PAGESIZE, comp,
+		                                 (size_t)(PAGESIZE * EDBP_ZRATIO))) {
+			test_error("random page compressed to EDBP_ZRATIO");
+		}
+
+		// cut off or with the wrong size: must fail rather than overrun.
+		if(c > 1 && edbp_lz_decompress(comp, c - 1, back, PAGESIZE) == 0) {
+			test_error("page %d decompressed with its last byte missing", t);
+		}
+		if(edbp_lz_decompress(comp, c, back, PAGESIZE - 1) == 0) {
+			test_error("page %d decompressed into a smaller page", t);
+		}
+		// flipped bits can't be detected, but they mustn't crash.
+		comp[rand_r(&seed) % c] ^= 1 << (rand_r(&seed) % 8);
+		edbp_lz_decompress(comp, c, back, PAGESIZE);
+	}
+
+	test_log("compressible pages: %.1f:1", (double)total / (double)totalc);
+	if(total < totalc * 4) {
+		test_error("zero padded pages compressed less than 4:1");
+	}
+}
@@ -96,6 +96,33 @@ void test_main() {
 		goto ret;
 	}
 
+	// now do it again but install them all in one go.
+	test_log("installing jobs in a batch...");
+	unsigned int installed;
+	err = edbs_jobinstallv(shm_handle, ODB_JWRITE, jobbuff, job_buffq,
+	                       &installed);
+	if(err || installed != job_buffq) {
+		test_error("edbs_jobinstallv installed %d of %d", installed,
+		           job_buffq);
+		goto ret;
+	}
+	if(shm_host->head->newjobs != job_buffq
+	   || shm_host->head->emptyjobs != 0) {
+		test_error("newjobs/emptyjobs not as expected after batch");
+		goto ret;
+	}
+	for(int i = 0; i < job_buffq; i++) {
+		if((err = edbs_jobselect(shm_handle, &jobbuff[i], i+100))) {
+			test_error("edbs_jobselect after batch");
+			goto ret;
+		}
+		edbs_jobclose(jobbuff[i]);
+	}
+	if(shm_host->head->emptyjobs != job_buffq) {
+		test_error("emptyjobs not as expected after closing batch");
+		goto ret;
+	}
+
 
 	// free the handle
 	ret:
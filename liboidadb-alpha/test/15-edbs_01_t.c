@@ -108,6 +108,20 @@ void *gothread(void *v) {
 	return 0;
 }
 
+// moves all of ring's positions (and the seq of its cells along with them)
+// to start lap laps before they overflow uint32_t. Must be done before
+// anyone else is using the shm.
+void ringrebase(edbs_handle_t *host, edbs_shmring_t *ring, uint32_t laps) {
+	edbs_shmcell_t *cellv = host->shm + ring->celloff;
+	// a multiple of the cell count so each pos stays on the same cell.
+	uint32_t base = 0 - laps * (host->head->ringmask + 1);
+	for(uint32_t i = 0; i <= host->head->ringmask; i++) {
+		cellv[i].seq += base;
+	}
+	ring->enqueue += base;
+	ring->dequeue += base;
+}
+
 void test_main() {
 
 	////////////////////////////////////////////////////////////////////////////
@@ -118,6 +132,9 @@ void test_main() {
 	const int jobs_to_install_per_handle = 1000;
 	const int bytes_to_write_to_buff_per = 4096;
 	const int bytes_to_write_to_buff_mul = 12;
+	// the job rings are started this many laps before their positions
+	// overflow so the handles push and pop across the wraparound.
+	const uint32_t ringlaps = 2;
 
 	// so the handles will install a bunch of jobs, and write
 	// bytes_to_write_to_buff of the number '12' to the buffer, then read
@@ -178,6 +195,10 @@ void test_main() {
 		struct odb_hostconfig config = odb_hostconfig_default;
 		config.job_buffq = job_buffq;
 		err = edbs_host_init(&host, config);
+		if(!err) {
+			ringrebase(host, &host->head->freering, ringlaps);
+			ringrebase(host, &host->head->newring, ringlaps);
+		}
 		shmobj->futex_ready = 1;
 		futex_wake(&shmobj->futex_ready, INT32_MAX);
 		if(err) {
@@ -297,6 +318,41 @@ void test_main() {
 		pthread_join(payloads[i].thread, 0);
 	}
 
+	// every job went through each ring exactly once, and the positions
+	// went past the overflow to get there.
+	{
+		const uint32_t jobs = jobs_to_install_per_handle * handles;
+		const uint32_t base = 0 - ringlaps * (host->head->ringmask + 1);
+		edbs_shmring_t *newring = &host->head->newring;
+		edbs_shmring_t *freering = &host->head->freering;
+		if(jobs <= ringlaps * (host->head->ringmask + 1)) {
+			test_error("not enough jobs to wrap the rings around");
+		}
+		if(newring->enqueue != base + jobs || newring->dequeue != base + jobs) {
+			test_error("newring pushed %u popped %u, expected %u",
+			           newring->enqueue - base, newring->dequeue - base, jobs);
+		}
+		if(freering->dequeue != base + jobs
+		   || freering->enqueue != base + jobs + host->head->jobc) {
+			test_error("freering pushed %u popped %u, expected %u and %u",
+			           freering->enqueue - base, freering->dequeue - base,
+			           jobs + (uint32_t)host->head->jobc, jobs);
+		}
+		// and the slots that are back in freering are all different ones.
+		edbs_shmcell_t *cellv = host->shm + freering->celloff;
+		uint8_t *seen = calloc(host->head->jobc, 1);
+		for(uint32_t pos = freering->dequeue; pos != freering->enqueue; pos++) {
+			edbs_shmcell_t *cell = &cellv[pos & host->head->ringmask];
+			if(cell->seq != pos + 1 || cell->jobpos >= host->head->jobc
+			   || seen[cell->jobpos]++) {
+				test_error("freering cell at %u (seq %u, job slot %u)",
+				           pos - base, cell->seq, cell->jobpos);
+				break;
+			}
+		}
+		free(seen);
+	}
+
 	edbs_host_free(host);
 
 	// results
@@ -142,6 +142,37 @@ void test_main() {
 		return;
 	}
 
+	// reply in place with enough bytes that they wrap around the end of the
+	// transfer buffer.
+	int replyc = (int)host->jobv[hostjob.jobpos].transferbuffcapacity - 8;
+	uint8_t *out;
+	const uint8_t *in;
+	err = edbs_jobwritereserve(hostjob, replyc, (void **)&out);
+	if(err) {
+		test_error("failed to reserve write");
+		return;
+	}
+	for(int i = 0; i < replyc; i++) out[i] = (uint8_t)i;
+	if((err = edbs_jobwritecommit(hostjob, replyc))) {
+		test_error("failed to commit write");
+		return;
+	}
+	err = edbs_jobreadreserve(handlejob, replyc, (const void **)&in);
+	if(err) {
+		test_error("failed to reserve read");
+		return;
+	}
+	for(int i = 0; i < replyc; i++) {
+		if(in[i] != (uint8_t)i) {
+			test_error("reserved read mismatch at %d", i);
+			return;
+		}
+	}
+	if((err = edbs_jobreadcommit(handlejob, replyc))) {
+		test_error("failed to commit read");
+		return;
+	}
+
 
 	err = edbs_jobterm(hostjob);
 	if(err) {
@@ -1,10 +1,15 @@
 #include "../edbd.h"
 #include "../edba.h"
+#include "../edba_u.h"
 #include <oidadb/telemetry.h>
 #include <oidadb/oidadb.h>
 #include "teststuff.h"
 
 #include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <unistd.h>
 #include <mariadb/mysql.h>
 #include <stdio.h>
 #include <malloc.h>
@@ -46,6 +51,180 @@ void scramble(odb_oid *oids, odb_oid *o_random, int records) {
 	}
 }
 
+struct lookuparg {
+	edba_handle_t *h;
+	odb_spec_index_entry *entry;
+	odb_pid off;
+	odb_pid pid;
+	odb_err err;
+	int done;
+};
+void *lookupthread(void *v) {
+	struct lookuparg *a = v;
+	a->err = edba_u_lookupoid(a->h, a->entry, a->off, &a->pid);
+	atomic_store(&a->done, 1);
+	return 0;
+}
+struct writerarg {
+	edba_handle_t *h;
+	odb_pid lookuppid;
+	int stop;
+	int rounds;
+};
+void *writerthread(void *v) {
+	struct writerarg *a = v;
+	while(!atomic_load(&a->stop)) {
+		edba_u_lookupwritebegin(a->h, a->lookuppid);
+		edba_u_lookupwriteend(a->h, a->lookuppid);
+		atomic_fetch_add(&a->rounds, 1);
+	}
+	return 0;
+}
+
+// lookups read the lookup pages without locking them and go by the version
+// counters to know if a writer was in there. Make sure that a lookup never
+// reads through a writer and still comes out right when one keeps going in
+// and out of the root.
+void testlookupretry(edba_host_t *host, edba_handle_t *h, edbd_t *dfile,
+                     odb_eid eid) {
+	odb_spec_index_entry *entry;
+	if((err = edbd_index(dfile, eid, &entry))) {
+		test_error("edbd_index");
+		return;
+	}
+	odb_pid *pidv = malloc(sizeof(odb_pid) * entry->ref0c);
+	for(odb_pid c = 0; c < entry->ref0c; c++) {
+		if((err = edba_u_lookupoid(h, entry, c, &pidv[c]))) {
+			test_error("lookup of %ld", c);
+			free(pidv);
+			return;
+		}
+	}
+
+	edba_handle_t *writer;
+	if((err = edba_handle_init(host, 70, &writer))) {
+		test_error("writer handle");
+		free(pidv);
+		return;
+	}
+
+	// a writer that stays in the root: the lookup retries, gives up and
+	// then has to wait on LLOOKUP_NEW until the writer is done.
+	edbl_lock rootlock = {
+			.type = EDBL_LLOOKUP_NEW,
+			.lookup_pid = entry->ref1,
+	};
+	if((err = edbl_set(writer->lockh, EDBL_AXL, rootlock))) {
+		test_error("writer XL");
+		goto ret;
+	}
+	edba_u_lookupwritebegin(writer, entry->ref1);
+	struct lookuparg la = {
+			.h = h,
+			.entry = entry,
+			.off = entry->ref0c - 1,
+	};
+	pthread_t thread;
+	pthread_create(&thread, 0, lookupthread, &la);
+	usleep(10000);
+	int early = atomic_load(&la.done);
+	edba_u_lookupwriteend(writer, entry->ref1);
+	edbl_set(writer->lockh, EDBL_ARELEASE, rootlock);
+	pthread_join(thread, 0);
+	if(early) {
+		test_error("lookup read through a writer in the root");
+		goto ret;
+	}
+	if(la.err || la.pid != pidv[la.off]) {
+		test_error("lookup after the writer was done: %ld (expected %ld)",
+		           la.pid, pidv[la.off]);
+		goto ret;
+	}
+
+	// a writer that keeps bumping the root's version: lookups retry (or
+	// fall back to the lock) and still find the same pages.
+	struct writerarg wa = {
+			.h = writer,
+			.lookuppid = entry->ref1,
+	};
+	pthread_create(&thread, 0, writerthread, &wa);
+	while(!atomic_load(&wa.rounds)) {
+		sched_yield();
+	}
+	for(int round = 0; round < 20; round++) {
+		for(odb_pid c = 0; c < entry->ref0c; c++) {
+			odb_pid pid;
+			if((err = edba_u_lookupoid(h, entry, c, &pid))) {
+				test_error("lookup of %ld with a writer", c);
+				break;
+			}
+			if(pid != pidv[c]) {
+				test_error("lookup of %ld with a writer: %ld (expected %ld)",
+				           c, pid, pidv[c]);
+				break;
+			}
+		}
+		if(test_waserror) break;
+	}
+	atomic_store(&wa.stop, 1);
+	pthread_join(thread, 0);
+	if(test_waserror) {
+		goto ret;
+	}
+
+	// with EDBL_CONFIG_OFD the writer can be in another process, whose
+	// version counters the lookup never sees. A second host has counters of
+	// its own just the same, so the lookup has to wait on the lock.
+	edba_host_t *ofdhostv[2] = {0};
+	edba_handle_t *ofdh = 0, *ofdwriter = 0;
+	for(int i = 0; i < 2; i++) {
+		if((err = edba_host_init(&ofdhostv[i], host->pagecache, dfile))
+		   || (err = edbl_host_config(ofdhostv[i]->lockhost,
+		                              EDBL_CONFIG_OFD, 1))) {
+			test_error("ofd host");
+			goto ofdret;
+		}
+	}
+	if((err = edba_handle_init(ofdhostv[0], 71, &ofdh))
+	   || (err = edba_handle_init(ofdhostv[1], 72, &ofdwriter))) {
+		test_error("ofd handles");
+		goto ofdret;
+	}
+	if((err = edbl_set(ofdwriter->lockh, EDBL_AXL, rootlock))) {
+		test_error("ofd writer XL");
+		goto ofdret;
+	}
+	edba_u_lookupwritebegin(ofdwriter, entry->ref1);
+	la = (struct lookuparg){
+			.h = ofdh,
+			.entry = entry,
+			.off = entry->ref0c - 1,
+	};
+	pthread_create(&thread, 0, lookupthread, &la);
+	usleep(10000);
+	early = atomic_load(&la.done);
+	edba_u_lookupwriteend(ofdwriter, entry->ref1);
+	edbl_set(ofdwriter->lockh, EDBL_ARELEASE, rootlock);
+	pthread_join(thread, 0);
+	if(early) {
+		test_error("OFD lookup read through a writer of another host");
+	} else if(la.err || la.pid != pidv[la.off]) {
+		test_error("OFD lookup after the writer was done: %ld (expected %ld)",
+		           la.pid, pidv[la.off]);
+	}
+
+	ofdret:
+	if(ofdwriter) edba_handle_decom(ofdwriter);
+	if(ofdh) edba_handle_decom(ofdh);
+	for(int i = 0; i < 2; i++) {
+		if(ofdhostv[i]) edba_host_free(ofdhostv[i]);
+	}
+
+	ret:
+	edba_handle_decom(writer);
+	free(pidv);
+}
+
 void test_main() {
 	srand(47237427);
 
@@ -232,6 +411,11 @@ void test_main() {
 	}
 	time_individual_random_read = timerend(t);
 
+	testlookupretry(edbahost, edbahandle, &dfile, eid);
+	if(test_waserror) {
+		return;
+	}
+
 	// delete the records in random order
 	odb_oid *oids_random = malloc(sizeof(odb_oid ) * records);
 	scramble(oids, oids_random, records);
@@ -7,6 +7,7 @@
 #include <oidadb/oidadb.h>
 #include <oidadb/telemetry.h>
 #include "../wrappers.h"
+#include "../edbh_u.h"
 
 struct userd {
 	char username[50];
@@ -288,6 +289,53 @@ void *handlethread(void *payload) {
 		}
 	}
 
+	// read users and orders in one batch, with an oid of an entity that
+	// doesn't exist in the middle (index 4): only that one fails, the rest
+	// should come out the same as they do one at a time.
+	odb_oid batchoidv[9];
+	struct userd batchuserv[4];
+	struct orders batchorderv[4];
+	void *batchobjv[9];
+	struct odbh_jobret batchretv[9];
+	for(int i = 0; i < 4; i++) {
+		batchoidv[i] = uids[rand_r(&randr) % userlen];
+		batchobjv[i] = &batchuserv[i];
+		batchoidv[5 + i] = orderids[rand_r(&randr) % orderslen];
+		batchobjv[5 + i] = &batchorderv[i];
+	}
+	struct userd baduser;
+	batchoidv[4] = ((odb_oid) 0xFFFF) << 0x30;
+	batchobjv[4] = &baduser;
+	err1 = odbh_jobj_readv(handle, batchoidv, batchobjv, batchretv, 9);
+	if(err1) {
+		test_error("jobj readv %d", err1);
+		goto close;
+	}
+	if(batchretv[4].err != ODB_ENOENT) {
+		test_error("jobj readv of a bad eid: %d (expected ODB_ENOENT)",
+		           batchretv[4].err);
+	}
+	for(int i = 0; i < 9; i++) {
+		if(i == 4) continue;
+		if(batchretv[i].err) {
+			test_error("jobj readv %d: %d", i, batchretv[i].err);
+			continue;
+		}
+		if(i < 4) {
+			struct userd u;
+			jret = odbh_jobj_read(handle, batchoidv[i], &u);
+			if(jret.err || memcmp(&u, batchobjv[i], sizeof(u)) != 0) {
+				test_error("jobj readv %d doesn't match jobj read", i);
+			}
+		} else {
+			struct orders o;
+			jret = odbh_jobj_read(handle, batchoidv[i], &o);
+			if(jret.err || memcmp(&o, batchobjv[i], sizeof(o)) != 0) {
+				test_error("jobj readv %d doesn't match jobj read", i);
+			}
+		}
+	}
+
 	close:
 	odb_handleclose(handle);
 	return 0;
@@ -6,6 +6,7 @@
 #include <syscall.h>
 #include <linux/futex.h>
 #include <errno.h>
+#include <time.h>
 
 // wrappers. See futex(2)
 //
@@ -24,6 +25,21 @@ static int futex_wait(uint32_t *uaddr, uint32_t val) {
 	return err;
 }
 
+// same as futex_wait but gives up after timeout (a relative time, null to
+// wait forever). Returns -1 and leaves errno as ETIMEDOUT if it gave up.
+static int futex_wait_timeout(uint32_t *uaddr, uint32_t val,
+                              const struct timespec *timeout) {
+	int err = (int)syscall(SYS_futex, uaddr, FUTEX_WAIT, val, timeout, 0, 0);
+	if (err == -1 && errno != EAGAIN && errno != ETIMEDOUT && errno != EINTR) {
+		log_critf("futex returned errno: %d", errno);
+		return -1;
+	}
+	if(err == -1 && errno != ETIMEDOUT) {
+		errno = 0;
+	}
+	return err;
+}
+
 // same as futex_wait, except if it ends up waiting will be equiped with a
 // bitset, see futex_wake_bitset to learn about that.
 //
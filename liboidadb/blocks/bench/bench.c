@@ -0,0 +1,765 @@
+#define _GNU_SOURCE
+
+#include <oidadb/oidadb.h>
+#include <oidadb/blocks.h>
+#include <oidadb/buffers.h>
+
+#include "../blocks.h"
+#include "../errors.h"
+#include "../mmap.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <wait.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+/*
+ blocks_bench: multi-process/multi-thread throughput and latency benchmark
+ for checkouts and commits.
+
+ Every combination of the swept parameters (see usage()) is ran for a fixed
+ duration against a fresh volume. Each worker (a thread inside of a process)
+ loops over random operations:
+
+  - a read is a checkout of blockc blocks.
+  - a write is a checkout, an increment of every block, and a commit. If the
+    commit comes back with ODB_EVERSION then the whole thing is retried. The
+    latency of a write includes its retries.
+
+ Which blocks are operated on: the first `shared` blocks of the volume are
+ shared by all workers, the rest of the keyspace is split evenly between the
+ workers. An operation will go to the shared blocks with the probability of
+ the conflict rate, otherwise to the worker's own. Within either, the starting
+ block is picked by a zipfian distribution of the given theta (0 = uniform).
+
+ Syscalls per op are counted with perf_event_open(2) on the
+ raw_syscalls:sys_enter tracepoint, one counter per worker thread so only
+ the workers' own syscalls are counted (not the parent's polling). If that's
+ not available (no tracefs, or perf_event_paranoid says no) we fall back to
+ the syscr+syscw fields of /proc/thread-self/io, which only counts read and
+ write type syscalls. The syscall_src column says which one was used:
+ "perf" or "procio-rw".
+
+ Results are written out as CSV or JSON. If a baseline (a CSV previously
+ written by this program) is given, any configuration whose ops/s dropped
+ or whose p99 rose beyond the threshold is reported and we exit with 1.
+ */
+
+#define HIST_SUB    16
+#define HIST_BUCKETS 1024
+#define SWEEP_MAX   16
+
+struct config {
+	int    procs;
+	int    threads;
+	int    blockc;
+	double write;
+	double zipf;
+	double conflict;
+};
+
+struct result {
+	struct config c;
+	uint64_t      ops;
+	double        ops_per_sec;
+	double        p50_us;
+	double        p99_us;
+	double        p999_us;
+	double        syscalls_per_op;
+	double        retries_per_op;
+	const char    *syscall_src;
+};
+
+// lives in a MAP_SHARED map so all processes can see it.
+struct shm {
+	volatile int ready;
+	volatile int start;
+	volatile int stop;
+	volatile int done;
+
+	uint64_t ops;
+	uint64_t retries;
+	uint64_t syscalls;     // from /proc/thread-self/io (reads/writes only)
+	uint64_t perfsyscalls; // from the workers' perf counters
+	uint64_t perfworkers;  // how many workers had a perf counter
+	uint64_t hist[HIST_BUCKETS];
+};
+
+static struct {
+	const char *file;
+	int        keyspace;
+	int        shared;
+	double     duration;
+	const char *format;
+	const char *output;
+	const char *baseline;
+	double     threshold;
+
+	int    procv[SWEEP_MAX], procc;
+	int    threadv[SWEEP_MAX], threadc;
+	int    blockv[SWEEP_MAX], blockc;
+	double writev[SWEEP_MAX];
+	int    writec;
+	double zipfv[SWEEP_MAX];
+	int    zipfc;
+	double conflictv[SWEEP_MAX];
+	int    conflictc;
+} opts = {
+		.file      = "blocks_bench.odb",
+		.keyspace  = 8192,
+		.shared    = 64,
+		.duration  = 1,
+		.format    = "csv",
+		.output    = 0,
+		.baseline  = 0,
+		.threshold = 0.10,
+		.procv     = {1, 4}, .procc = 2,
+		.threadv   = {1, 2}, .threadc = 2,
+		.blockv    = {1, 8}, .blockc = 2,
+		.writev    = {0, 0.5}, .writec = 2,
+		.zipfv     = {0, 0.99}, .zipfc = 2,
+		.conflictv = {0, 0.5}, .conflictc = 2,
+};
+
+static struct shm *shm;
+
+////////////////////////////////////////////////////////////////////////////////
+// histogram (log-linear: 16 sub-buckets per power of 2, ~6% precision)
+
+static int hist_index(uint64_t v) {
+	if (v < HIST_SUB) {
+		return (int) v;
+	}
+	int msb = 63 - __builtin_clzll(v);
+	int sub = (int) ((v >> (msb - 4)) & (HIST_SUB - 1));
+	return (msb - 3) * HIST_SUB + sub;
+}
+
+static uint64_t hist_value(int i) {
+	if (i < HIST_SUB) {
+		return i;
+	}
+	int msb = i / HIST_SUB + 3;
+	int sub = i % HIST_SUB;
+	return (uint64_t) (HIST_SUB + sub) << (msb - 4);
+}
+
+static double hist_percentile(const uint64_t *hist, uint64_t total, double p) {
+	uint64_t want = (uint64_t) ceil(p * (double) total);
+	uint64_t seen = 0;
+	for (int i = 0; i < HIST_BUCKETS; i++) {
+		seen += hist[i];
+		if (seen >= want && hist[i]) {
+			return (double) hist_value(i) / 1000.0;
+		}
+	}
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// random numbers
+
+static uint64_t rng_next(uint64_t *s) {
+	// xorshift64*
+	uint64_t x = *s;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*s = x;
+	return x * 0x2545F4914F6CDD1DULL;
+}
+
+static double rng_double(uint64_t *s) {
+	return (double) (rng_next(s) >> 11) / (double) (1ULL << 53);
+}
+
+// zipfian generator as described by Gray et al. "Quickly generating
+// billion-record synthetic databases".
+struct zipf {
+	uint64_t n;
+	double   theta, alpha, zetan, eta;
+};
+
+static void zipf_init(struct zipf *z, uint64_t n, double theta) {
+	z->n     = n;
+	z->theta = theta;
+	if (theta <= 0 || n < 2) {
+		return;
+	}
+	double zeta2 = 0;
+	z->zetan = 0;
+	for (uint64_t i = 1; i <= n; i++) {
+		z->zetan += 1.0 / pow((double) i, theta);
+		if (i == 2) zeta2 = z->zetan;
+	}
+	z->alpha = 1.0 / (1.0 - theta);
+	z->eta   = (1 - pow(2.0 / (double) n, 1 - theta)) / (1 - zeta2 / z->zetan);
+}
+
+static uint64_t zipf_next(const struct zipf *z, uint64_t *s) {
+	if (z->theta <= 0 || z->n < 2) {
+		return rng_next(s) % (z->n ? z->n : 1);
+	}
+	double u  = rng_double(s);
+	double uz = u * z->zetan;
+	if (uz < 1.0) return 0;
+	if (uz < 1.0 + pow(0.5, z->theta)) return 1;
+	uint64_t r = (uint64_t) ((double) z->n * pow(z->eta * u - z->eta + 1, z->alpha));
+	return r < z->n ? r : z->n - 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// syscall counting
+
+// set if perf_open worked in the parent, so the workers should try too.
+static int perf_ok = 0;
+
+// opens a (disabled) counter of the calling thread's syscalls. Returns -1 if
+// perf isn't available.
+static int perf_open() {
+	const char *idpaths[] = {
+			"/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+			"/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id",
+	};
+	long long id = -1;
+	for (int i = 0; i < 2 && id == -1; i++) {
+		FILE *f = fopen(idpaths[i], "r");
+		if (!f) continue;
+		if (fscanf(f, "%lld", &id) != 1) id = -1;
+		fclose(f);
+	}
+	if (id == -1) {
+		return -1;
+	}
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.type     = PERF_TYPE_TRACEPOINT;
+	attr.size     = sizeof(attr);
+	attr.config   = (uint64_t) id;
+	attr.disabled = 1;
+	return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static uint64_t procio_syscalls() {
+	FILE *f = fopen("/proc/thread-self/io", "r");
+	if (!f) return 0;
+	char     key[32];
+	uint64_t val, total = 0;
+	while (fscanf(f, "%31[^:]: %lu\n", key, &val) == 2) {
+		if (!strcmp(key, "syscr") || !strcmp(key, "syscw")) {
+			total += val;
+		}
+	}
+	fclose(f);
+	return total;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// workers
+
+struct worker {
+	const struct config *c;
+	odb_desc            *desc;
+	int                 index;      // global index amongst all workers
+	int                 workerc;    // total amount of workers
+	const struct zipf   *zshared;
+	const struct zipf   *zprivate;
+	pthread_t           thread;
+};
+
+static uint64_t now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *worker_main(void *arg) {
+	struct worker       *w = arg;
+	const struct config *c = w->c;
+	uint64_t            seed = 0x9E3779B97F4A7C15ULL * (w->index + 1);
+	uint64_t            hist[HIST_BUCKETS] = {0};
+	uint64_t            ops = 0, retries = 0;
+	odb_err             err;
+
+	struct odb_buffer_info binf = {
+			.flags = ODB_UCOMMITS,
+			.bcount = c->blockc,
+	};
+	odb_buf *buf;
+	if ((err = odb_buffer_new(binf, &buf))) {
+		fprintf(stderr, "odb_buffer_new: %s\n", odb_errstr(err));
+		exit(1);
+	}
+
+	// the private region of this worker
+	int     private_len   = (opts.keyspace - opts.shared) / w->workerc;
+	odb_bid private_start = opts.shared + (odb_bid) private_len * w->index;
+
+	int perf_fd = perf_ok ? perf_open() : -1;
+
+	__atomic_add_fetch(&shm->ready, 1, __ATOMIC_SEQ_CST);
+	while (!shm->start) {
+		usleep(100);
+	}
+
+	if (perf_fd != -1) {
+		ioctl(perf_fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+	uint64_t sys_start = procio_syscalls();
+	while (!shm->stop) {
+		odb_bid bid;
+		if (rng_double(&seed) < c->conflict) {
+			bid = zipf_next(w->zshared, &seed);
+		} else {
+			bid = private_start + zipf_next(w->zprivate, &seed);
+		}
+		int write = rng_double(&seed) < c->write;
+
+		uint64_t t = now_ns();
+		for (;;) {
+			odbb_seek(w->desc, bid);
+			if ((err = blocks_checkout(w->desc, buf, c->blockc))) {
+				fprintf(stderr, "checkout: %s\n", odb_errstr(err));
+				exit(1);
+			}
+			if (!write) {
+				break;
+			}
+			uint64_t *data;
+			odbv_buffer_map(buf, (void **) &data, 0, c->blockc);
+			for (int i = 0; i < c->blockc; i++) {
+				data[i * (ODB_BLOCKSIZE / sizeof(uint64_t))]++;
+			}
+			odbv_buffer_unmap(buf, 0, c->blockc);
+			odbb_seek(w->desc, bid);
+			err = blocks_commit(w->desc, buf, c->blockc);
+			if (err == ODB_EVERSION) {
+				retries++;
+				continue;
+			}
+			if (err) {
+				fprintf(stderr, "commit: %s\n", odb_errstr(err));
+				exit(1);
+			}
+			break;
+		}
+		hist[hist_index(now_ns() - t)]++;
+		ops++;
+	}
+	uint64_t sys_end = procio_syscalls();
+	if (perf_fd != -1) {
+		ioctl(perf_fd, PERF_EVENT_IOC_DISABLE, 0);
+		uint64_t count;
+		if (read(perf_fd, &count, sizeof(count)) == sizeof(count)) {
+			__atomic_add_fetch(&shm->perfsyscalls, count, __ATOMIC_SEQ_CST);
+			__atomic_add_fetch(&shm->perfworkers, 1, __ATOMIC_SEQ_CST);
+		}
+		close(perf_fd);
+	}
+
+	__atomic_add_fetch(&shm->ops, ops, __ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&shm->retries, retries, __ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&shm->syscalls, sys_end - sys_start, __ATOMIC_SEQ_CST);
+	for (int i = 0; i < HIST_BUCKETS; i++) {
+		if (hist[i]) {
+			__atomic_add_fetch(&shm->hist[i], hist[i], __ATOMIC_SEQ_CST);
+		}
+	}
+	__atomic_add_fetch(&shm->done, 1, __ATOMIC_SEQ_CST);
+	odb_buffer_free(buf);
+	return 0;
+}
+
+// the body of each forked process.
+static void proc_main(const struct config *c, int proc) {
+	odb_desc *desc;
+	odb_err  err;
+	if ((err = odb_open(opts.file, ODB_PREAD | ODB_PWRITE, &desc))) {
+		fprintf(stderr, "odb_open: %s\n", odb_errstr(err));
+		exit(1);
+	}
+
+	int         workerc = c->procs * c->threads;
+	struct zipf zshared, zprivate;
+	zipf_init(&zshared, opts.shared - c->blockc + 1, c->zipf);
+	zipf_init(&zprivate, (opts.keyspace - opts.shared) / workerc - c->blockc + 1, c->zipf);
+
+	struct worker workers[c->threads];
+	for (int i = 0; i < c->threads; i++) {
+		workers[i].c        = c;
+		workers[i].index    = proc * c->threads + i;
+		workers[i].workerc  = workerc;
+		workers[i].zshared  = &zshared;
+		workers[i].zprivate = &zprivate;
+
+		// each thread needs its own locks, so its own descriptor.
+		workers[i].desc = odb_malloc(sizeof(odb_desc));
+		if ((err = desc_clone(desc, workers[i].desc))) {
+			fprintf(stderr, "desc_clone: %s\n", odb_errstr(err));
+			exit(1);
+		}
+		pthread_create(&workers[i].thread, 0, worker_main, &workers[i]);
+	}
+	for (int i = 0; i < c->threads; i++) {
+		pthread_join(workers[i].thread, 0);
+		odb_close(workers[i].desc);
+	}
+	odb_close(desc);
+}
+
+static int run(const struct config *c, struct result *o_result) {
+	odb_err err;
+
+	// fresh volume for every configuration, pre-sized to the keyspace so we
+	// aren't benchmarking ftruncate.
+	unlink(opts.file);
+	odb_desc *desc;
+	if ((err = odb_open(opts.file, ODB_PREAD | ODB_PWRITE | ODB_PCREAT, &desc))) {
+		fprintf(stderr, "odb_open(create): %s\n", odb_errstr(err));
+		return 1;
+	}
+	struct odb_buffer_info binf = {.flags = 0, .bcount = 1};
+	odb_buf                *buf;
+	odb_buffer_new(binf, &buf);
+	odbb_bind_buffer(desc, buf);
+	odbb_seek(desc, opts.keyspace - 1);
+	if ((err = odbb_checkout(desc, 1))) {
+		fprintf(stderr, "presize: %s\n", odb_errstr(err));
+		return 1;
+	}
+	odb_buffer_free(buf);
+	odb_close(desc);
+
+	memset(shm, 0, sizeof(*shm));
+	int workerc = c->procs * c->threads;
+
+	for (int p = 0; p < c->procs; p++) {
+		pid_t pid = fork();
+		if (pid == -1) {
+			perror("fork");
+			return 1;
+		}
+		if (!pid) {
+			proc_main(c, p);
+			exit(0);
+		}
+	}
+
+	// if a process dies before it's ready/done we'd wait forever, so keep an
+	// eye out.
+	int exited = 0;
+	while (shm->ready != workerc) {
+		if (waitpid(-1, 0, WNOHANG) > 0) {
+			fprintf(stderr, "a worker process died during setup\n");
+			exited = 1;
+			break;
+		}
+		usleep(1000);
+	}
+	if (exited) {
+		shm->start = shm->stop = 1;
+		while (wait(0) > 0);
+		return 1;
+	}
+	uint64_t t = now_ns();
+	shm->start = 1;
+	usleep((useconds_t) (opts.duration * 1000000));
+	shm->stop = 1;
+	int status, failed = 0, reaped = 0;
+	while (shm->done != workerc) {
+		if (waitpid(-1, &status, WNOHANG) > 0) {
+			reaped++;
+			if (status) {
+				failed = 1;
+				break;
+			}
+		}
+		usleep(100);
+	}
+	double elapsed = (double) (now_ns() - t) / 1e9;
+
+	for (int p = reaped; p < c->procs && !failed; p++) {
+		wait(&status);
+		if (status) failed = 1;
+	}
+	if (failed) {
+		fprintf(stderr, "a worker process failed\n");
+		return 1;
+	}
+
+	// only use perf if every worker had it, otherwise it's not comparable.
+	uint64_t syscalls = shm->syscalls;
+	o_result->syscall_src = "procio-rw";
+	if (shm->perfworkers == workerc) {
+		syscalls = shm->perfsyscalls;
+		o_result->syscall_src = "perf";
+	}
+
+	uint64_t ops = shm->ops ? shm->ops : 1;
+	o_result->c               = *c;
+	o_result->ops             = shm->ops;
+	o_result->ops_per_sec     = (double) shm->ops / elapsed;
+	o_result->p50_us          = hist_percentile(shm->hist, shm->ops, 0.50);
+	o_result->p99_us          = hist_percentile(shm->hist, shm->ops, 0.99);
+	o_result->p999_us         = hist_percentile(shm->hist, shm->ops, 0.999);
+	o_result->syscalls_per_op = (double) syscalls / (double) ops;
+	o_result->retries_per_op  = (double) shm->retries / (double) ops;
+	unlink(opts.file);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// output and baselines
+
+#define CSV_HEADER "procs,threads,blocks,write,zipf,conflict,ops,ops_per_sec," \
+                   "p50_us,p99_us,p999_us,syscalls_per_op,retries_per_op," \
+                   "syscall_src\n"
+
+static void write_results(FILE *f, const struct result *rv, int rc) {
+	int json = !strcmp(opts.format, "json");
+	if (json) {
+		fprintf(f, "[\n");
+	} else {
+		fprintf(f, CSV_HEADER);
+	}
+	for (int i = 0; i < rc; i++) {
+		const struct result *r = &rv[i];
+		if (json) {
+			fprintf(f, "  {\"procs\": %d, \"threads\": %d, \"blocks\": %d, "
+			           "\"write\": %g, \"zipf\": %g, \"conflict\": %g, "
+			           "\"ops\": %lu, \"ops_per_sec\": %.1f, \"p50_us\": %.2f, "
+			           "\"p99_us\": %.2f, \"p999_us\": %.2f, "
+			           "\"syscalls_per_op\": %.2f, \"retries_per_op\": %.4f, "
+			           "\"syscall_src\": \"%s\"}%s\n"
+			        , r->c.procs, r->c.threads, r->c.blockc, r->c.write
+			        , r->c.zipf, r->c.conflict, r->ops, r->ops_per_sec
+			        , r->p50_us, r->p99_us, r->p999_us, r->syscalls_per_op
+			        , r->retries_per_op, r->syscall_src
+			        , i + 1 == rc ? "" : ",");
+		} else {
+			fprintf(f, "%d,%d,%d,%g,%g,%g,%lu,%.1f,%.2f,%.2f,%.2f,%.2f,%.4f,%s\n"
+			        , r->c.procs, r->c.threads, r->c.blockc, r->c.write
+			        , r->c.zipf, r->c.conflict, r->ops, r->ops_per_sec
+			        , r->p50_us, r->p99_us, r->p999_us, r->syscalls_per_op
+			        , r->retries_per_op, r->syscall_src);
+		}
+	}
+	if (json) {
+		fprintf(f, "]\n");
+	}
+}
+
+static int same_config(const struct config *a, const struct config *b) {
+	return a->procs == b->procs && a->threads == b->threads
+	       && a->blockc == b->blockc && fabs(a->write - b->write) < 1e-9
+	       && fabs(a->zipf - b->zipf) < 1e-9
+	       && fabs(a->conflict - b->conflict) < 1e-9;
+}
+
+// returns the amount of regressions, or -1 if the baseline couldn't be read.
+static int compare_baseline(const struct result *rv, int rc) {
+	FILE *f = fopen(opts.baseline, "r");
+	if (!f) {
+		perror(opts.baseline);
+		return -1;
+	}
+	char line[512];
+	int  regressions = 0, matched = 0;
+	if (!fgets(line, sizeof(line), f)) {
+		fclose(f);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		struct result b;
+		if (sscanf(line, "%d,%d,%d,%lf,%lf,%lf,%lu,%lf,%lf,%lf,%lf"
+		           , &b.c.procs, &b.c.threads, &b.c.blockc, &b.c.write
+		           , &b.c.zipf, &b.c.conflict, &b.ops, &b.ops_per_sec
+		           , &b.p50_us, &b.p99_us, &b.p999_us) != 11) {
+			continue;
+		}
+		for (int i = 0; i < rc; i++) {
+			const struct result *r = &rv[i];
+			if (!same_config(&r->c, &b.c)) continue;
+			matched++;
+			int slower = r->ops_per_sec < b.ops_per_sec * (1 - opts.threshold);
+			int laggier = r->p99_us > b.p99_us * (1 + opts.threshold);
+			if (slower || laggier) {
+				regressions++;
+				fprintf(stderr, "regression: procs=%d threads=%d blocks=%d "
+				                "write=%g zipf=%g conflict=%g: "
+				                "ops/s %.1f -> %.1f, p99 %.2fus -> %.2fus\n"
+				        , r->c.procs, r->c.threads, r->c.blockc, r->c.write
+				        , r->c.zipf, r->c.conflict, b.ops_per_sec
+				        , r->ops_per_sec, b.p99_us, r->p99_us);
+			}
+		}
+	}
+	fclose(f);
+	fprintf(stderr, "baseline: %d configurations compared, %d regressed "
+	                "(threshold %.0f%%)\n"
+	        , matched, regressions, opts.threshold * 100);
+	return regressions;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// main
+
+static void usage(const char *argv0) {
+	fprintf(stderr,
+	        "usage: %s [options]\n"
+	        "sweeps (comma seperated lists):\n"
+	        "  -p procs       processes (default 1,4)\n"
+	        "  -t threads     threads per process (default 1,2)\n"
+	        "  -b blocks      blocks per operation (default 1,8)\n"
+	        "  -w ratios      fraction of operations that are writes (default 0,0.5)\n"
+	        "  -z thetas      zipfian skew, 0 = uniform (default 0,0.99)\n"
+	        "  -c rates       fraction of operations on the shared blocks (default 0,0.5)\n"
+	        "other:\n"
+	        "  -n blocks      keyspace size (default 8192)\n"
+	        "  -s blocks      shared blocks, the start of the keyspace (default 64)\n"
+	        "  -d seconds     duration of each configuration (default 1)\n"
+	        "  -f csv|json    output format (default csv)\n"
+	        "  -o file        output file (default stdout)\n"
+	        "  -B file        baseline CSV to compare against\n"
+	        "  -T fraction    regression threshold (default 0.10)\n"
+	        "  -F file        volume to benchmark with (default blocks_bench.odb)\n"
+	        , argv0);
+}
+
+static int parse_ints(const char *s, int *v) {
+	int c = 0;
+	char *end;
+	while (*s && c < SWEEP_MAX) {
+		v[c++] = (int) strtol(s, &end, 10);
+		if (end == s) return -1;
+		s = *end == ',' ? end + 1 : end;
+	}
+	return c;
+}
+
+static int parse_doubles(const char *s, double *v) {
+	int c = 0;
+	char *end;
+	while (*s && c < SWEEP_MAX) {
+		v[c++] = strtod(s, &end);
+		if (end == s) return -1;
+		s = *end == ',' ? end + 1 : end;
+	}
+	return c;
+}
+
+int main(int argc, char **argv) {
+	int opt;
+	while ((opt = getopt(argc, argv, "p:t:b:w:z:c:n:s:d:f:o:B:T:F:h")) != -1) {
+		int bad = 0;
+		switch (opt) {
+		case 'p': bad = (opts.procc = parse_ints(optarg, opts.procv)) <= 0; break;
+		case 't': bad = (opts.threadc = parse_ints(optarg, opts.threadv)) <= 0; break;
+		case 'b': bad = (opts.blockc = parse_ints(optarg, opts.blockv)) <= 0; break;
+		case 'w': bad = (opts.writec = parse_doubles(optarg, opts.writev)) <= 0; break;
+		case 'z': bad = (opts.zipfc = parse_doubles(optarg, opts.zipfv)) <= 0; break;
+		case 'c': bad = (opts.conflictc = parse_doubles(optarg, opts.conflictv)) <= 0; break;
+		case 'n': opts.keyspace = atoi(optarg); break;
+		case 's': opts.shared = atoi(optarg); break;
+		case 'd': opts.duration = atof(optarg); break;
+		case 'f': opts.format = optarg; break;
+		case 'o': opts.output = optarg; break;
+		case 'B': opts.baseline = optarg; break;
+		case 'T': opts.threshold = atof(optarg); break;
+		case 'F': opts.file = optarg; break;
+		default: usage(argv[0]); return 2;
+		}
+		if (bad) {
+			usage(argv[0]);
+			return 2;
+		}
+	}
+	if (strcmp(opts.format, "csv") && strcmp(opts.format, "json")) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	shm = mmap(0, sizeof(struct shm), PROT_READ | PROT_WRITE
+	           , MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shm == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+	int perf_fd = perf_open();
+	perf_ok = perf_fd != -1;
+	if (perf_ok) {
+		close(perf_fd);
+	} else {
+		fprintf(stderr, "perf_event_open unavailable, syscalls counted via "
+		                "/proc/thread-self/io (reads and writes only)\n");
+	}
+
+	int total = opts.procc * opts.threadc * opts.blockc * opts.writec
+	            * opts.zipfc * opts.conflictc;
+	struct result *rv = calloc(total, sizeof(struct result));
+	int           rc  = 0;
+
+	for (int a = 0; a < opts.procc; a++)
+	for (int b = 0; b < opts.threadc; b++)
+	for (int d = 0; d < opts.blockc; d++)
+	for (int e = 0; e < opts.writec; e++)
+	for (int g = 0; g < opts.zipfc; g++)
+	for (int h = 0; h < opts.conflictc; h++) {
+		struct config c = {
+				.procs = opts.procv[a],
+				.threads = opts.threadv[b],
+				.blockc = opts.blockv[d],
+				.write = opts.writev[e],
+				.zipf = opts.zipfv[g],
+				.conflict = opts.conflictv[h],
+		};
+		int workerc = c.procs * c.threads;
+		if (c.procs <= 0 || c.threads <= 0 || c.blockc <= 0
+		    || opts.shared < c.blockc
+		    || (opts.keyspace - opts.shared) / workerc < c.blockc) {
+			fprintf(stderr, "configuration does not fit in the keyspace\n");
+			return 2;
+		}
+		fprintf(stderr, "[%d/%d] procs=%d threads=%d blocks=%d write=%g "
+		                "zipf=%g conflict=%g\n"
+		        , rc + 1, total, c.procs, c.threads, c.blockc, c.write
+		        , c.zipf, c.conflict);
+		if (run(&c, &rv[rc])) {
+			return 1;
+		}
+		rc++;
+	}
+
+	FILE *out = stdout;
+	if (opts.output) {
+		out = fopen(opts.output, "w");
+		if (!out) {
+			perror(opts.output);
+			return 1;
+		}
+	}
+	write_results(out, rv, rc);
+	if (out != stdout) {
+		fclose(out);
+	}
+
+	int ret = 0;
+	if (opts.baseline) {
+		int regressions = compare_baseline(rv, rc);
+		if (regressions) {
+			ret = 1;
+		}
+	}
+	free(rv);
+	return ret;
+}
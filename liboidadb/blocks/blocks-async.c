@@ -0,0 +1,311 @@
+#define _LARGEFILE64_SOURCE
+
+#include "blocks.h"
+#include "errors.h"
+#include "mmap.h"
+
+#include <oidadb/buffers.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+// a submission
+struct cq_sqe {
+	int     commit;
+	odb_buf *buffer;
+	odb_bid bid;
+	int     blockc;
+	void    *userdata;
+};
+
+struct cq_worker {
+	odb_cq    *cq;
+	pthread_t thread;
+
+	// the worker's own clone of the descriptor, see desc_clone.
+	odb_desc  *desc;
+};
+
+struct odb_cq {
+	pthread_mutex_t mutex;
+
+	// workers wait on cond_sq for submissions, odb_cq_wait waits on cond_cq
+	// for completions.
+	pthread_cond_t cond_sq;
+	pthread_cond_t cond_cq;
+
+	// readable so long that cqc != 0.
+	int efd;
+
+	// submitted but not yet reaped. Never more than depth. Thus sqv and cqv
+	// (both of depth length) can never overflow.
+	int depth;
+	int outstanding;
+
+	// both are rings.
+	struct cq_sqe  *sqv;
+	int            sq_head, sqc;
+	struct odb_cqe *cqv;
+	int            cq_head, cqc;
+
+	int              stopping;
+	int              workerc;
+	struct cq_worker *workerv;
+};
+
+static void *cq_worker_main(void *arg) {
+	struct cq_worker *w  = arg;
+	odb_cq           *cq = w->cq;
+	odb_err          err;
+
+	pthread_mutex_lock(&cq->mutex);
+	for (;;) {
+		while (!cq->sqc && !cq->stopping) {
+			pthread_cond_wait(&cq->cond_sq, &cq->mutex);
+		}
+		// when stopping, whatever was already submitted is still seen
+		// through so no buffer is left half way.
+		if (!cq->sqc) {
+			break;
+		}
+		struct cq_sqe sqe = cq->sqv[cq->sq_head];
+		cq->sq_head = (cq->sq_head + 1) % cq->depth;
+		cq->sqc--;
+		pthread_mutex_unlock(&cq->mutex);
+
+		// atp: we have the submission, do the work outside of the mutex.
+		odbb_seek(w->desc, sqe.bid);
+		if (sqe.commit) {
+			err = blocks_commit(w->desc, sqe.buffer, sqe.blockc);
+		} else {
+			err = blocks_checkout(w->desc, sqe.buffer, sqe.blockc);
+		}
+
+		pthread_mutex_lock(&cq->mutex);
+		struct odb_cqe *cqe = &cq->cqv[(cq->cq_head + cq->cqc) % cq->depth];
+		cqe->userdata = sqe.userdata;
+		cqe->err      = err;
+		cqe->commit   = sqe.commit;
+		cqe->buffer   = sqe.buffer;
+		cqe->bid      = sqe.bid;
+		cqe->blockc   = sqe.blockc;
+		cqe->versionv = sqe.commit
+		                ? sqe.buffer->buffer_versionv
+		                : sqe.buffer->user_versionv;
+		cq->cqc++;
+		uint64_t one = 1;
+		if (write(cq->efd, &one, sizeof(one)) == -1) {
+			log_critf("failed to signal eventfd");
+		}
+		pthread_cond_signal(&cq->cond_cq);
+	}
+	pthread_mutex_unlock(&cq->mutex);
+	return 0;
+}
+
+odb_err odb_cq_new(odb_desc *desc
+                   , int depth
+                   , int workerc
+                   , odb_cq **o_cq) {
+	if (!desc || !o_cq || depth <= 0 || workerc <= 0) {
+		return ODB_EINVAL;
+	}
+	if (desc->state != ODB_SREADY) {
+		return ODB_EINVAL;
+	}
+
+	odb_err err;
+	odb_cq  *cq = odb_malloc(sizeof(odb_cq));
+	if (!cq) {
+		return odb_mmap_errno;
+	}
+	memset(cq, 0, sizeof(odb_cq));
+	cq->efd   = -1;
+	cq->depth = depth;
+
+	// past this point, any non-successful return statement must be after
+	// odb_cq_free(cq);
+
+	pthread_mutex_init(&cq->mutex, 0);
+	pthread_cond_init(&cq->cond_sq, 0);
+	pthread_cond_init(&cq->cond_cq, 0);
+
+	cq->efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (cq->efd == -1) {
+		odb_cq_free(cq);
+		return ODB_EERRNO;
+	}
+
+	cq->sqv     = odb_malloc(sizeof(struct cq_sqe) * depth);
+	cq->cqv     = odb_malloc(sizeof(struct odb_cqe) * depth);
+	cq->workerv = odb_malloc(sizeof(struct cq_worker) * workerc);
+	if (!cq->sqv || !cq->cqv || !cq->workerv) {
+		err = odb_mmap_errno;
+		odb_cq_free(cq);
+		return err;
+	}
+
+	for (int i = 0; i < workerc; i++) {
+		struct cq_worker *w = &cq->workerv[i];
+		w->cq   = cq;
+		w->desc = odb_malloc(sizeof(odb_desc));
+		if (!w->desc) {
+			err = odb_mmap_errno;
+			odb_cq_free(cq);
+			return err;
+		}
+		err = desc_clone(desc, w->desc);
+		if (err) {
+			odb_close(w->desc);
+			odb_cq_free(cq);
+			return err;
+		}
+		if (pthread_create(&w->thread, 0, cq_worker_main, w)) {
+			odb_close(w->desc);
+			odb_cq_free(cq);
+			return log_critf("failed to create worker thread");
+		}
+		// note we only count the worker once its thread is running, that's
+		// what odb_cq_free goes off of.
+		cq->workerc++;
+	}
+
+	*o_cq = cq;
+	return 0;
+}
+
+void odb_cq_free(odb_cq *cq) {
+	if (!cq) return;
+
+	// the workers finish off anything left in sqv before they exit. Their
+	// completions are never reaped.
+
+	pthread_mutex_lock(&cq->mutex);
+	cq->stopping = 1;
+	pthread_cond_broadcast(&cq->cond_sq);
+	pthread_mutex_unlock(&cq->mutex);
+
+	for (int i = 0; i < cq->workerc; i++) {
+		pthread_join(cq->workerv[i].thread, 0);
+		odb_close(cq->workerv[i].desc);
+	}
+
+	if (cq->efd != -1) {
+		close(cq->efd);
+	}
+	odb_free(cq->workerv);
+	odb_free(cq->cqv);
+	odb_free(cq->sqv);
+	pthread_cond_destroy(&cq->cond_cq);
+	pthread_cond_destroy(&cq->cond_sq);
+	pthread_mutex_destroy(&cq->mutex);
+	odb_free(cq);
+}
+
+int odb_cq_fd(odb_cq *cq) {
+	return cq->efd;
+}
+
+static odb_err cq_submit(odb_cq *cq, struct cq_sqe sqe) {
+	if (!cq || !sqe.buffer || sqe.blockc <= 0) {
+		return ODB_EINVAL;
+	}
+
+	pthread_mutex_lock(&cq->mutex);
+	if (cq->outstanding == cq->depth) {
+		pthread_mutex_unlock(&cq->mutex);
+		return ODB_EAGAIN;
+	}
+	cq->sqv[(cq->sq_head + cq->sqc) % cq->depth] = sqe;
+	cq->sqc++;
+	cq->outstanding++;
+	pthread_cond_signal(&cq->cond_sq);
+	pthread_mutex_unlock(&cq->mutex);
+	return 0;
+}
+
+odb_err odbb_checkout_async(odb_cq *cq
+                            , odb_buf *buffer
+                            , odb_bid bid
+                            , int blockc
+                            , void *userdata) {
+	struct cq_sqe sqe = {
+			.commit = 0,
+			.buffer = buffer,
+			.bid = bid,
+			.blockc = blockc,
+			.userdata = userdata,
+	};
+	return cq_submit(cq, sqe);
+}
+
+odb_err odbb_commit_async(odb_cq *cq
+                          , odb_buf *buffer
+                          , odb_bid bid
+                          , int blockc
+                          , void *userdata) {
+	struct cq_sqe sqe = {
+			.commit = 1,
+			.buffer = buffer,
+			.bid = bid,
+			.blockc = blockc,
+			.userdata = userdata,
+	};
+	return cq_submit(cq, sqe);
+}
+
+// helper to odb_cq_poll and odb_cq_wait. Must have the mutex.
+static int cq_reap(odb_cq *cq, struct odb_cqe *o_cqev, int cqec) {
+	int n = cq->cqc < cqec ? cq->cqc : cqec;
+	for (int i = 0; i < n; i++) {
+		o_cqev[i] = cq->cqv[cq->cq_head];
+		cq->cq_head = (cq->cq_head + 1) % cq->depth;
+	}
+	cq->cqc -= n;
+	cq->outstanding -= n;
+
+	// keep the eventfd honest: only readable when there's something here.
+	if (!cq->cqc) {
+		uint64_t discard;
+		if (read(cq->efd, &discard, sizeof(discard)) == -1 && errno != EAGAIN) {
+			log_critf("failed to reset eventfd");
+		}
+	}
+	return n;
+}
+
+odb_err odb_cq_poll(odb_cq *cq
+                    , struct odb_cqe *o_cqev
+                    , int cqec
+                    , int *o_cqec) {
+	if (!cq || !o_cqev || !o_cqec || cqec <= 0) {
+		return ODB_EINVAL;
+	}
+	pthread_mutex_lock(&cq->mutex);
+	*o_cqec = cq_reap(cq, o_cqev, cqec);
+	pthread_mutex_unlock(&cq->mutex);
+	return 0;
+}
+
+odb_err odb_cq_wait(odb_cq *cq
+                    , struct odb_cqe *o_cqev
+                    , int cqec
+                    , int *o_cqec) {
+	if (!cq || !o_cqev || !o_cqec || cqec <= 0) {
+		return ODB_EINVAL;
+	}
+	pthread_mutex_lock(&cq->mutex);
+	if (!cq->outstanding) {
+		// nothing is coming, we'd wait forever.
+		pthread_mutex_unlock(&cq->mutex);
+		return ODB_EEOF;
+	}
+	while (!cq->cqc) {
+		pthread_cond_wait(&cq->cond_cq, &cq->mutex);
+	}
+	*o_cqec = cq_reap(cq, o_cqev, cqec);
+	pthread_mutex_unlock(&cq->mutex);
+	return 0;
+}
@@ -1,4 +1,5 @@
 #define _LARGEFILE64_SOURCE
+#define _GNU_SOURCE
 
 #include "blocks.h"
 #include "errors.h"
@@ -10,6 +11,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <string.h>
+#include <stdio.h>
 
 
 struct checkout_options {
@@ -35,78 +37,98 @@ struct checkout_frame {
 	int                  data_count;
 };
 
-odb_err _odb_open(const char *path
+// converts our flags to open(2) flags
+static int desc_open_flags(odb_ioflags flags) {
+	int open_flags = 0;
+	if (flags & ODB_PREAD) {
+		open_flags = O_RDONLY;
+	}
+	if (flags & ODB_PWRITE) {
+		open_flags = O_RDWR;
+	}
+	if (flags & ODB_PCREAT) {
+		open_flags |= O_CREAT | O_EXCL;
+	}
+	open_flags |= O_CLOEXEC | O_LARGEFILE | O_SYNC;
+	return open_flags;
+}
+
+odb_err _odb_open(const char *const *pathv
+                  , int pathc
                   , odb_ioflags flags
                   , mode_t mode
                   , odb_desc *desc) {
 
 	odb_err err;
 
+	// set the structure to a 0val.
+	memset(desc, 0, sizeof(*desc));
+
 	// invals
-	if (!strlen(path)) {
+	if (pathc <= 0 || pathc > ODB_STRIPEMAX) {
 		return ODB_EINVAL;
 	}
+	for (int i = 0; i < pathc; i++) {
+		if (!pathv[i] || !strlen(pathv[i])) {
+			return ODB_EINVAL;
+		}
+	}
 	if ((flags & ODB_PWRITE) && !(flags & ODB_PREAD)) {
 		return ODB_EINVAL;
 	}
 
-	// set the structure to a 0val.
-	memset(desc, 0, sizeof(*desc));
-
 	desc->state = ODB_SNEW;
 	desc->flags = flags;
 
+	desc->lockcmd = F_OFD_SETLKW;
+
 	// convert our flags to mmap(2)/open(2) flags
-	int open_flags = 0;
-	if (flags & ODB_PREAD) {
-		open_flags = O_RDONLY;
-	}
-	if (flags & ODB_PWRITE) {
-		open_flags = O_RDWR;
-	}
-	if (flags & ODB_PCREAT) {
-		open_flags |= O_CREAT | O_EXCL;
-	}
-	open_flags |= O_CLOEXEC | O_LARGEFILE | O_SYNC;
+	int open_flags = desc_open_flags(flags);
 
-	// open (and create if specified) the file
+	// open (and create if specified) the files
 	desc->state = ODB_SFILE;
 	unsigned int created = flags & ODB_PCREAT;
-	desc->fd = open64(path, open_flags, mode);
-	if (desc->fd == -1) {
-		switch (errno) {
-		case ENOENT: return ODB_ENOENT;
-		case EEXIST: return ODB_EEXIST;
-		default: return ODB_EERRNO;
+	for (int i = 0; i < pathc; i++) {
+		int fd = open64(pathv[i], open_flags, mode);
+		if (fd == -1) {
+			switch (errno) {
+			case ENOENT: return ODB_ENOENT;
+			case EEXIST: return ODB_EEXIST;
+			default: return ODB_EERRNO;
+			}
+		}
+		desc->fdv[i] = fd;
+		desc->fdc++;
+
+		// If we just created the file, we are obligated to initialize the
+		// first descriptor block. If anything goes wrong between now and
+		// then the bail-out call to odb_close will delete it.
+		if (created) {
+			desc->unitializedv[i] = pathv[i];
 		}
-	}
-
-	// If we just created the file, we are obligated to initialize the first
-	// descriptor block. We need to upgrade our magic number lock to a exclusive
-	// lock.
-	if (created) {
-		desc->unitialized = path;
 	}
 	if (created) {
 
-		// initialize the odb file. We are only obligated to initialize the
+		// initialize the odb files. We are only obligated to initialize the
 		// first meta pages.
-		err = volume_initialize(desc->fd);
-		if (err) {
-			// we make sure that if the volume failed to initialize under the
-			// circumstance of cricital or if it already exist, make sure the
-			// bail-out call to odb-close doesn't delete the file.
-			switch (err) {
-			case ODB_EEXIST:
-			case ODB_ECRIT: desc->unitialized = 0;
-			default: break;
+		for (int i = 0; i < pathc; i++) {
+			err = volume_initialize(desc->fdv[i]);
+			if (err) {
+				// we make sure that if the volume failed to initialize under
+				// the circumstance of cricital or if it already exist, make sure
+				// the bail-out call to odb-close doesn't delete the file.
+				switch (err) {
+				case ODB_EEXIST:
+				case ODB_ECRIT: desc->unitializedv[i] = 0;
+				default: break;
+				}
+				return err;
 			}
-			return err;
 		}
 
 		// after we leave this if statement, we can continue on to load it as
 		// normal.
-		desc->unitialized = 0;
+		memset(desc->unitializedv, 0, sizeof(desc->unitializedv));
 	}
 
 	// map the first super block
@@ -130,10 +152,13 @@ odb_err _odb_open(const char *path
 
 // not thread/process safe when creating
 // otherwise, if file exists (is initialized) then this function is therad and process safe
-odb_err odb_open(const char *file, odb_ioflags flags, odb_desc **o_descriptor) {
+odb_err odb_openv(const char *const *filev
+                  , int filec
+                  , odb_ioflags flags
+                  , odb_desc **o_descriptor) {
 	odb_desc *desc = odb_malloc(sizeof(odb_desc));
 	*o_descriptor = desc;
-	odb_err err = _odb_open(file, flags, 0777, desc);
+	odb_err err = _odb_open(filev, filec, flags, 0777, desc);
 	if (err) {
 		odb_close(*o_descriptor);
 		return err;
@@ -141,18 +166,57 @@ odb_err odb_open(const char *file, odb_ioflags flags, odb_desc **o_descriptor) {
 	return 0;
 }
 
+odb_err odb_open(const char *file, odb_ioflags flags, odb_desc **o_descriptor) {
+	return odb_openv(&file, 1, flags, o_descriptor);
+}
+
+
+odb_err desc_clone(const odb_desc *desc, odb_desc *o_desc) {
+	memset(o_desc, 0, sizeof(*o_desc));
+	o_desc->state   = ODB_SFILE;
+	o_desc->flags   = desc->flags;
+	o_desc->lockcmd = F_OFD_SETLKW;
+	o_desc->cursor  = desc->cursor;
+
+	// we cannot just dup(2) here because that would share the open file
+	// description, and thus the locks. Going through /proc gets us a
+	// brand-new one of the same file.
+	int open_flags = desc_open_flags(desc->flags & ~ODB_PCREAT);
+	for (int i = 0; i < desc->fdc; i++) {
+		char path[32];
+		snprintf(path, sizeof(path), "/proc/self/fd/%d", desc->fdv[i]);
+		int fd = open64(path, open_flags);
+		if (fd == -1) {
+			switch (errno) {
+			case ENOENT: return log_critf("cannot reopen volume: /proc not mounted?");
+			default: return ODB_EERRNO;
+			}
+		}
+		o_desc->fdv[i] = fd;
+		o_desc->fdc++;
+	}
+	o_desc->state = ODB_SREADY;
+	return 0;
+}
 
 void odb_close(odb_desc *descriptor) {
 	if (!descriptor) return;
 	switch (descriptor->state) {
 	case ODB_SREADY:
 	case ODB_SPREP: volume_unload(descriptor);
-	case ODB_SALLOC: close(descriptor->fd);
+	case ODB_SALLOC:
 	case ODB_SFILE:
+		// fdc is only ever the amount of files we had opened, so this is
+		// safe to do even if we didn't get through all of them.
+		for (int i = 0; i < descriptor->fdc; i++) {
+			close(descriptor->fdv[i]);
+		}
 	case ODB_SNEW: break;
 	}
-	if (descriptor->unitialized) {
-		unlink(descriptor->unitialized);
+	for (int i = 0; i < descriptor->fdc; i++) {
+		if (descriptor->unitializedv[i]) {
+			unlink(descriptor->unitializedv[i]);
+		}
 	}
 	odb_free(descriptor);
 }
@@ -172,13 +236,15 @@ odb_err odbb_bind_buffer(odb_desc *desc, odb_buf *buffer) {
 }
 
 odb_err odbb_checkout(odb_desc *desc, int blockc) {
-
-	odb_err err;
-
 	if (!desc->boundBuffer) {
 		return ODB_EBUFF;
 	}
-	odb_buf *buffer = desc->boundBuffer;
+	return blocks_checkout(desc, desc->boundBuffer, blockc);
+}
+
+odb_err blocks_checkout(odb_desc *desc, odb_buf *buffer, int blockc) {
+
+	odb_err err;
 
 	err = block_truncate(desc, desc->cursor.cursor_bid + blockc - 1);
 	if (err) {
@@ -204,6 +270,7 @@ odb_err odbb_checkout(odb_desc *desc, int blockc) {
 
 	void *buffer_group_descm = odb_mmap_alloc(1);
 	if (buffer_group_descm == MAP_FAILED) {
+		blocks_unlock(desc, bid_start, blockc);
 		return odb_mmap_errno;
 	}
 	err = blocks_copy(desc, blockc, buffer_group_descm, dpagev, blockv);
@@ -221,6 +288,16 @@ odb_err odbb_checkout(odb_desc *desc, int blockc) {
 //
 // when commit sees a conflict it sees what pages need to be merged.
 odb_err odbb_commit(odb_desc *desc, int blockc) {
+	if(!(desc->flags & ODB_PWRITE)) {
+		return ODB_EBADF;
+	}
+	if (!desc->boundBuffer) {
+		return ODB_EBUFF;
+	}
+	return blocks_commit(desc, desc->boundBuffer, blockc);
+}
+
+odb_err blocks_commit(odb_desc *desc, odb_buf *buffer, int blockc) {
 
 	odb_err err;
 
@@ -228,10 +305,6 @@ odb_err odbb_commit(odb_desc *desc, int blockc) {
 		return ODB_EBADF;
 	}
 
-	if (!desc->boundBuffer) {
-		return ODB_EBUFF;
-	}
-	odb_buf                *buffer = desc->boundBuffer;
 	struct odb_buffer_info bufinf  = buffer->info;
 	if (!(bufinf.flags & ODB_UCOMMITS)) {
 		return ODB_EBUFF;
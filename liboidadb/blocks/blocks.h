@@ -80,13 +80,27 @@ typedef struct odb_buf {
 } odb_buf;
 
 typedef struct odb_desc {
-	int fd;
 
-	// special flag set to 1
-	const char *unitialized;
+	// the files the volume is striped across (see odb_openv). group g is
+	// found in fdv[g % fdc]. fdc is the amount of files that have been
+	// opened successfully thus far.
+	int fdv[ODB_STRIPEMAX];
+	int fdc;
+
+	// set to the path of each file we had created but have yet to initialize.
+	const char *unitializedv[ODB_STRIPEMAX];
 
 	odb_ioflags flags;
 
+	// the fcntl(2) command used for page locks. Always F_OFD_SETLKW: the
+	// locks belong to the open file description so descriptors cloned with
+	// desc_clone exclude each other (and this one) within the same process,
+	// and closing a clone's files doesn't let go of anyone else's locks like
+	// it would with process-associated (F_SETLKW64) ones. (so a forked child
+	// must open the volume itself rather than use its parent's descriptor,
+	// see man/odb_open.org)
+	int lockcmd;
+
 	enum hoststate state;
 
 	odb_buf *boundBuffer;
@@ -112,7 +126,8 @@ typedef struct odb_desc {
 odb_err volume_initialize(int fd);
 
 /**
- * will fail if the meta is not valid.
+ * will fail if the meta is not valid. This includes each file's first group
+ * reporting a stripe layout that doesn't match the order of desc->fdv.
  *
  * Handles process locking.
  */
@@ -188,12 +203,44 @@ odb_err blocks_copy(odb_desc *desc
                     , odb_datapage *restrict o_dpagev
                     , odb_ver *restrict o_blockv);
 
+/**
+ * blocks_checkout and blocks_commit are odbb_checkout and odbb_commit without
+ * requiring a bound buffer. The blocks start at desc->cursor.
+ */
+odb_err blocks_checkout(odb_desc *desc, odb_buf *buffer, int blockc);
+
+odb_err blocks_commit(odb_desc *desc, odb_buf *buffer, int blockc);
+
+/**
+ * desc_clone will initialize o_desc as a ready-to-use copy of desc with its own
+ * open file descriptions (reopened via /proc/self/fd) and OFD page locks. Thus
+ * o_desc can be used by another thread while locks held through it will
+ * still exclude desc and any other clone. Use odb_close on o_desc as normal.
+ *
+ * o_desc is assumed to be allocated with odb_malloc.
+ */
+odb_err desc_clone(const odb_desc *desc, odb_desc *o_desc);
+
 // utility
-void page_lock(int fd, odb_pid page, int xl);
+void page_lock(int fd, int lockcmd, odb_pid page, int xl);
+
+void page_unlock(int fd, int lockcmd, odb_pid page);
+
+/**
+ * bid2pid returns the page id of the block's data page relative to the start
+ * of the file that holds it. Use gid2fd(desc, bid2gid(bid)) to find said file.
+ */
+odb_pid bid2pid(const odb_desc *desc, odb_bid bid);
+
+odb_gid bid2gid(odb_bid bid);
 
-void page_unlock(int fd, odb_pid page);
+/**
+ * gid2fd returns the file that holds the group. gid2pid returns the page id of
+ * the group's descriptor relative to the start of that file.
+ */
+int gid2fd(const odb_desc *desc, odb_gid gid);
 
-odb_pid bid2pid(odb_bid bid);
+odb_pid gid2pid(const odb_desc *desc, odb_gid gid);
 
 /**
  * descriptor_buffer_needed is a small helper function that will calculate the
@@ -111,6 +111,8 @@ const char *odb_errstr(odb_err error) {
 		case ODB_EBUFFSIZE: return "ODB_EBUFFSIZE";
 		case ODB_ECONFLICT: return "ODB_ECONFLICT";
 		case ODB_EUSER:     return "ODB_EUSER";
+		case ODB_EDEADLK:   return "ODB_EDEADLK";
+		case ODB_ETIMEDOUT: return "ODB_ETIMEDOUT";
 		default: return "UNDOCUMENTEDERROR";
 	}
 }
\ No newline at end of file
@@ -6,6 +6,8 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <string.h>
+#include <unistd.h>
+#include <aio.h>
 
 #include "mmap.h"
 #include "blocks.h"
@@ -39,10 +41,24 @@ struct blockmap {
 	int _groups_loaded;
 };
 
-odb_pid bid2pid(odb_bid bid) {
-	uint64_t full_groups          = bid / ODB_SPEC_BLOCKS_PER_GROUP;
+odb_gid bid2gid(odb_bid bid) {
+	uint64_t group_index = bid / ODB_SPEC_BLOCKS_PER_GROUP;
+	return group_index;
+}
+
+int gid2fd(const odb_desc *desc, odb_gid gid) {
+	return desc->fdv[gid % desc->fdc];
+}
+
+odb_pid gid2pid(const odb_desc *desc, odb_gid gid) {
+	// groups are dealt out round-robin, so the group's index within its own
+	// file is just how many times we've went around.
+	return (gid / desc->fdc) * ODB_SPEC_PAGES_PER_GROUP;
+}
+
+odb_pid bid2pid(const odb_desc *desc, odb_bid bid) {
 	uint64_t blocks_in_last_group = (bid % ODB_SPEC_BLOCKS_PER_GROUP);
-	uint64_t pid = (full_groups * ODB_SPEC_PAGES_PER_GROUP) + blocks_in_last_group + ODB_SPEC_METAPAGES_PER_GROUP;
+	uint64_t pid = gid2pid(desc, bid2gid(bid)) + blocks_in_last_group + ODB_SPEC_METAPAGES_PER_GROUP;
 #ifdef EDB_FUCKUPS
 	if (!(pid % ODB_SPEC_PAGES_PER_GROUP)) {
 		log_critf("block locking mis-calculation: points to group page");
@@ -51,11 +67,6 @@ odb_pid bid2pid(odb_bid bid) {
 	return pid;
 }
 
-static odb_gid bid2gid(odb_bid bid) {
-	uint64_t group_index = bid / ODB_SPEC_BLOCKS_PER_GROUP;
-	return group_index;
-}
-
 unsigned int static blocks_remaining_in_group(unsigned int blockc
 								 , unsigned int blocks_mapped
 								 , unsigned int blockoff_group) {
@@ -69,8 +80,8 @@ unsigned int static blocks_remaining_in_group(unsigned int blockc
 odb_err blocks_lock(odb_desc *desc, odb_bid bid, int blockc, int xl) {
 	odb_bid block_end = blockc + bid;
 	for (; bid < block_end; bid++) {
-		odb_pid pid = bid2pid(bid);
-		page_lock(desc->fd, pid, xl);
+		odb_pid pid = bid2pid(desc, bid);
+		page_lock(gid2fd(desc, bid2gid(bid)), desc->lockcmd, pid, xl);
 	}
 	return 0;
 }
@@ -78,88 +89,115 @@ odb_err blocks_lock(odb_desc *desc, odb_bid bid, int blockc, int xl) {
 void blocks_unlock(odb_desc *desc, odb_bid bid, int blockc) {
 	odb_bid block_end = blockc + bid;
 	for (; bid < block_end; bid++) {
-		odb_pid pid = bid2pid(bid);
-		page_unlock(desc->fd, pid);
+		odb_pid pid = bid2pid(desc, bid);
+		page_unlock(gid2fd(desc, bid2gid(bid)), desc->lockcmd, pid);
 	}
 }
 
-/**
- *
- * Copies block information from a loaded group.
- *
- * @param desc note: const
- * @param group note: const
- * @param group_off 0 = first group of volume
- * @param block_off 0 = first block of group, max of ODB_SPEC_BLOCKS_PER_GROUP - 1
- * @param blockc amount of blocks to copy, max of ODB_SPEC_BLOCKS_PER_GROUP
- * @param o_blockv output pointer to write blocks to. If null, blocks are not
- *                 loaded
- * @param o_versionv output pointer to write block versions to
- */
-static odb_err blocks_copy_from_group(const odb_desc *desc
-                                      , const struct odb_block_group_desc *groupm
-                                      , odb_gid group_off
-                                      , int block_off
-                                      , int blockc
-                                      , odb_datapage *o_blockv
-                                      , odb_ver *o_versionv) {
-#ifdef EDB_FUCKUPS
-	// invals
-	if (blockc > ODB_SPEC_BLOCKS_PER_GROUP) {
-		return log_critf("cannot copy blocks more than what is in group");
+// helper to blocks_copy and blocks_write_groups: fills out the aiocb that will
+// read blockc data pages starting at block_off of the given group into
+// o_blockv (set aio_lio_opcode to LIO_WRITE to write them from it instead).
+static void blocks_read_prep(const odb_desc *desc
+                             , odb_gid gid
+                             , int block_off
+                             , int blockc
+                             , odb_datapage *o_blockv
+                             , struct aiocb *o_cb) {
+	memset(o_cb, 0, sizeof(*o_cb));
+	o_cb->aio_fildes     = gid2fd(desc, gid);
+	o_cb->aio_offset     = ((off64_t) gid2pid(desc, gid)
+	                        + ODB_SPEC_METAPAGES_PER_GROUP
+	                        + block_off) * ODB_PAGESIZE;
+	o_cb->aio_buf        = o_blockv;
+	o_cb->aio_nbytes     = (size_t) blockc * ODB_BLOCKSIZE;
+	o_cb->aio_lio_opcode = LIO_READ;
+}
+
+// helper to blocks_copy and blocks_commit_attempt: does the read (or write,
+// per cb->aio_lio_opcode) described by cb synchronously.
+//
+// later: implement my own page caching using read(2) here fails to
+//  utilize proper copy-on-write behaviour. But, we cannot use mmap due
+//  to the fact that a copy-on-write is "unspecified" to occur when
+//  another process writes to the block we map.
+//  But I won't let this slow me down, I'll just use reads for now, it'll
+//  eat up ram, but we can fix it eventually without messing with the API
+static odb_err blocks_read(const struct aiocb *cb) {
+	// pread rather than lseek+read so we're not fighting with anyone else
+	// over the file's offset.
+	ssize_t n;
+	if (cb->aio_lio_opcode == LIO_WRITE) {
+		n = pwrite64(cb->aio_fildes
+		             , (const void *) cb->aio_buf
+		             , cb->aio_nbytes
+		             , cb->aio_offset);
+	} else {
+		n = pread64(cb->aio_fildes
+		            , (void *) cb->aio_buf
+		            , cb->aio_nbytes
+		            , cb->aio_offset);
 	}
-	if (block_off >= ODB_SPEC_BLOCKS_PER_GROUP) {
-		return log_critf("block offset over or equal to blocks per group");
+	if (n == -1) {
+		switch (errno) {
+		case EBADF: return ODB_EBADF;
+		default: return log_critf("failed call to pread/pwrite");
+		}
 	}
-#endif
-
-	odb_err err               = 0;
-	int     fd                = desc->fd;
-	// convert the block offset to a page offset, we just need to add the
-	// meta pages.
-	int     block_page_offset = ODB_SPEC_METAPAGES_PER_GROUP + block_off;
+	if (n != cb->aio_nbytes) {
+		// block_truncate should have made sure the file was long enough.
+		return log_critf("short read/write on data pages");
+	}
+	return 0;
+}
 
-	// later: implement my own page caching using read(2) here fails to
-	//  utilize proper copy-on-write behaviour. But, we cannot use mmap due
-	//  to the fact that a copy-on-write is "unspecified" to occur when
-	//  another process writes to the block we map.
-	//  But I won't let this slow me down, I'll just use reads for now, it'll
-	//  eat up ram, but we can fix it eventually without messing with the API
+// helper to blocks_copy and blocks_commit_attempt: submits all the reads (or
+// writes) at once so that each stripe's device is working at the same time
+// and waits for them all. If the kernel won't take them or any of them come
+// back short we just redo that one ourselves with blocks_read.
+//
+// The aiocbs point into the caller's buffers, so this never returns while
+// any of them are still in flight, even if one of them failed.
+static odb_err blocks_read_all(struct aiocb *cbv, int cbc) {
+	if (cbc <= 0) {
+		return 0;
+	}
+	struct aiocb *listv[cbc];
+	for (int i = 0; i < cbc; i++) {
+		listv[i] = &cbv[i];
+	}
 
-	if (o_blockv) {
-		// copy the blocks
-		if (lseek64(fd
-		            , ((off64_t) group_off * ODB_SPEC_PAGES_PER_GROUP
-		               + (off64_t) block_page_offset)
-		              * ODB_PAGESIZE
-		            , SEEK_SET) == -1) {
-			err = log_critf("failed call to lseek");
-			return err;
-		}
-		if (read(fd
-		         , o_blockv
-		         , blockc * ODB_BLOCKSIZE) == -1) {
-			switch (errno) {
-			case EBADF: err = ODB_EBADF;
-			default: err    = log_critf("failed call to read");
-			}
-			return err;
+	// we don't care about the return value of lio_listio itself, as it only
+	// tells us that at least one of them had failed. We check them
+	// individually.
+	lio_listio(LIO_WAIT, listv, cbc, 0);
+
+	// wait for all of them before looking at any of them.
+	for (int i = 0; i < cbc; i++) {
+		while (aio_error(&cbv[i]) == EINPROGRESS) {
+			// we were interrupted by a signal before they all finished.
+			const struct aiocb *wait[1] = {&cbv[i]};
+			aio_suspend(wait, 1, 0);
 		}
 	}
 
-	// copy the versions
-	if (lseek64(fd
-	            , ((off64_t) group_off * ODB_SPEC_PAGES_PER_GROUP)
-	              * ODB_PAGESIZE
-	            , SEEK_SET) == -1) {
-		err = log_critf("failed call to lseek");
-		return err;
-	}
-	for (int i = 0; i < blockc; i++) {
-		o_versionv[i] = groupm->blocks[block_off + i].block_ver;
+	odb_err err = 0;
+	for (int i = 0; i < cbc; i++) {
+		int e = aio_error(&cbv[i]);
+		if (e == 0 && aio_return(&cbv[i]) == cbv[i].aio_nbytes) {
+			continue;
+		}
+		if (e == 0 || e == ECANCELED || e == EAGAIN || e == EINTR) {
+			err = blocks_read(&cbv[i]);
+		} else if (e == EBADF) {
+			err = ODB_EBADF;
+		} else {
+			err = log_critf("failed async read/write on data pages");
+		}
+		if (err) {
+			break;
+		}
 	}
-
-	return 0;
+	return err;
 }
 
 odb_err blocks_copy(odb_desc *desc
@@ -167,19 +205,26 @@ odb_err blocks_copy(odb_desc *desc
                     , struct odb_block_group_desc *restrict buff_group_descm
                     , odb_datapage *restrict o_dpagev
                     , odb_ver *restrict o_blockv) {
-	odb_err err;
+	odb_err err = 0;
 
 	odb_bid block_start = desc->cursor.cursor_bid;
 
 	int     blocks_copied = 0;
+	int     groupc        = descriptor_buffer_needed(block_start, blockc);
 	odb_gid group_start   = bid2gid(block_start);
-	odb_gid group_end     = group_start + descriptor_buffer_needed(block_start, blockc);
+	odb_gid group_end     = group_start + groupc;
 
 	// starting_group_block: if they wanted to copy blocks that start in the
 	// middle of the group.
 	int blockoff_group = (int) (block_start % ODB_SPEC_BLOCKS_PER_GROUP);
 
-	void *o_blockv_adjusted;
+	// if we're copying blocks out of more than one stripe then we want all
+	// stripes reading at the same time rather than one after another. So we
+	// collect all the reads first and then submit them together.
+	// Otherwise, a plain pread is all we need.
+	int          parallel = o_dpagev && desc->fdc > 1 && groupc > 1;
+	struct aiocb cbv[parallel ? groupc : 1];
+	int          cbc      = 0;
 
 	for (odb_gid group_off = group_start; group_off < group_end; group_off++) {
 		err = group_loadg(desc, group_off, buff_group_descm);
@@ -193,21 +238,27 @@ odb_err blocks_copy(odb_desc *desc
 		                                                         , blocks_copied
 		                                                         , blockoff_group);
 
-		if (o_dpagev) {
-			o_blockv_adjusted = o_dpagev + blocks_copied * ODB_BLOCKSIZE;
-		} else {
-			o_blockv_adjusted = 0;
+		// copy the versions
+		for (int i = 0; i < blocks_in_group; i++) {
+			o_blockv[blocks_copied + i] = buff_group_descm->blocks[blockoff_group + i].block_ver;
 		}
 
-		err = blocks_copy_from_group(desc
-		                             , buff_group_descm
-		                             , group_off
-		                             , blockoff_group
-		                             , blocks_in_group
-		                             , o_blockv_adjusted
-		                             , &o_blockv[blocks_copied]);
-		if (err) {
-			break;
+		// copy the blocks
+		if (o_dpagev) {
+			blocks_read_prep(desc
+			                 , group_off
+			                 , blockoff_group
+			                 , (int) blocks_in_group
+			                 , o_dpagev + blocks_copied * ODB_BLOCKSIZE
+			                 , &cbv[cbc]);
+			if (parallel) {
+				cbc++;
+			} else {
+				err = blocks_read(&cbv[0]);
+				if (err) {
+					break;
+				}
+			}
 		}
 		blocks_copied += blocks_in_group;
 
@@ -216,7 +267,9 @@ odb_err blocks_copy(odb_desc *desc
 		blockoff_group = 0;
 	}
 
-
+	if (!err && cbc) {
+		err = blocks_read_all(cbv, cbc);
+	}
 
 	if (err) {
 		return err;
@@ -351,14 +404,14 @@ static odb_err data_map(const odb_desc *desc
 		odb_datapage *dest_addr = bmap->data_pagem +
 		                          ODB_PAGESIZE * blocks_mapped;
 		odb_gid current_group          = group_start + group_index;
-		odb_pid first_data_page_offset = current_group * ODB_SPEC_PAGES_PER_GROUP
+		odb_pid first_data_page_offset = gid2pid(desc, current_group)
 		                                 + ODB_SPEC_METAPAGES_PER_GROUP
 		                                 + blockoff_group;
 		if (odb_mmap(dest_addr
 		             , blocks_in_group
 		             , PROT_WRITE
 		             , MAP_SHARED | MAP_FIXED
-		             , desc->fd
+		             , gid2fd(desc, current_group)
 		             , first_data_page_offset) == MAP_FAILED) {
 			return odb_mmap_errno;
 		}
@@ -377,6 +430,37 @@ static odb_err data_map(const odb_desc *desc
 	return err;
 }
 
+// helper function to blocks_commit_attempt
+//
+// requires group_map be called first. Writes user_datam into the data pages
+// of bmap's blocks with a write per group, all submitted together.
+static odb_err blocks_write_groups(const odb_desc *desc
+                                   , const struct blockmap *bmap
+                                   , const odb_datapage *user_datam) {
+	int          groupc = bmap->groupc;
+	struct aiocb cbv[groupc];
+	unsigned int blocks_written = 0;
+	odb_gid      group_start    = bid2gid(bmap->block_start);
+	int blockoff_group = (int) (bmap->block_start % ODB_SPEC_BLOCKS_PER_GROUP);
+
+	for (int group_index = 0; group_index < groupc; group_index++) {
+		unsigned int blocks_in_group = blocks_remaining_in_group(bmap->blockc
+				, blocks_written
+				, blockoff_group);
+		blocks_read_prep(desc
+		                 , group_start + group_index
+		                 , blockoff_group
+		                 , (int) blocks_in_group
+		                 , (odb_datapage *) user_datam
+		                   + blocks_written * ODB_BLOCKSIZE
+		                 , &cbv[group_index]);
+		cbv[group_index].aio_lio_opcode = LIO_WRITE;
+		blocks_written += blocks_in_group;
+		blockoff_group = 0;
+	}
+	return blocks_read_all(cbv, groupc);
+}
+
 odb_err blocks_commit_attempt(const odb_desc *desc
                               , struct block_commit_buffers commit) {
 
@@ -420,23 +504,28 @@ odb_err blocks_commit_attempt(const odb_desc *desc
 		return err;
 	}
 
-	// versions OK. Map the data pages.
-	err = data_map(desc, &bmap);
+	// later: if I need to implement any journalling, it will be about here.
+
+	if (desc->fdc > 1 && bmap.groupc > 1) {
+		// the blocks are spread over more than one stripe, so write them all
+		// at once (same as blocks_copy does with its reads) rather than
+		// mapping and copying them one stripe after another.
+		err = blocks_write_groups(desc, &bmap, commit.user_datam);
+	} else {
+		// versions OK. Map the data pages and copy them over.
+		err = data_map(desc, &bmap);
+		if (!err) {
+			memcpy(bmap.data_pagem, commit.user_datam
+			       , (size_t) ODB_PAGESIZE * blockc);
+		}
+	}
 	if (err) {
 		odb_free(bmap.blockv);
 		return err;
 	}
 
-	// later: if I need to implement any journalling, it will be about here.
-
+	// the data is in, now update the versions.
 	for (int i = 0; i < blockc; i++) {
-
-		// copy the page over
-		void       *dest = (void *)bmap.data_pagem + ODB_PAGESIZE * i;
-		const void *src  = (void *)commit.user_datam + ODB_PAGESIZE * i;
-		memcpy(dest, src, ODB_PAGESIZE);
-
-		// update the version
 		bmap.blockv[i]->block_ver++;
 		commit.buffer_versionv[i] = bmap.blockv[i]->block_ver;
 	}
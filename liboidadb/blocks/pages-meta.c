@@ -1,15 +1,17 @@
 #define _LARGEFILE64_SOURCE
+#define _GNU_SOURCE
 
 #include <stdlib.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <unistd.h>
 
 #include "mmap.h"
 #include "blocks.h"
 #include "errors.h"
 #include "errno.h"
 
-void page_lock(int fd, odb_pid page, int xl) {
+void page_lock(int fd, int lockcmd, odb_pid page, int xl) {
 	struct flock64 flock = {
 			.l_type = F_RDLCK,
 			.l_start = (off64_t) page * ODB_PAGESIZE,
@@ -20,7 +22,7 @@ void page_lock(int fd, odb_pid page, int xl) {
 	if (xl) {
 		flock.l_type = F_WRLCK;
 	}
-	int err = fcntl64(fd, F_SETLKW64, &flock);
+	int err = fcntl64(fd, lockcmd, &flock);
 	if (err == -1) {
 		log_critf("fcntl lock failed");
 	}
@@ -37,9 +39,10 @@ void page_lock(int fd, odb_pid page, int xl) {
  *
  * To unlock, use page_unlock_eof
  * @param fd
+ * @param lockcmd see odb_desc.lockcmd
  * @param xl
  */
-off64_t page_lock_eof(int fd, int xl) {
+off64_t page_lock_eof(int fd, int lockcmd, int xl) {
 	struct flock64 flock = {
 			.l_type = F_RDLCK,
 			.l_start = 0,
@@ -50,14 +53,14 @@ off64_t page_lock_eof(int fd, int xl) {
 	if (xl) {
 		flock.l_type = F_WRLCK;
 	}
-	int err = fcntl64(fd, F_SETLKW64, &flock);
+	int err = fcntl64(fd, lockcmd, &flock);
 	if (err == -1) {
 		log_critf("fcntl lock failed");
 	}
 	return lseek64(fd, 0, SEEK_END);
 }
 
-void page_unlock_eof(int fd, off64_t lock_result) {
+void page_unlock_eof(int fd, int lockcmd, off64_t lock_result) {
 	struct flock64 flock = {
 			.l_type = F_UNLCK,
 			.l_start = lock_result,
@@ -65,13 +68,13 @@ void page_unlock_eof(int fd, off64_t lock_result) {
 			.l_len = 0,
 			.l_pid = 0,
 	};
-	int            err   = fcntl64(fd, F_SETLKW64, &flock);
+	int            err   = fcntl64(fd, lockcmd, &flock);
 	if (err == -1) {
 		log_critf("fcntl lock failed");
 	}
 }
 
-void page_unlock(int fd, odb_pid page) {
+void page_unlock(int fd, int lockcmd, odb_pid page) {
 	struct flock64 flock = {
 			.l_type = F_UNLCK,
 			.l_start = (off64_t) page * ODB_PAGESIZE,
@@ -79,7 +82,7 @@ void page_unlock(int fd, odb_pid page) {
 			.l_len = ODB_PAGESIZE,
 			.l_pid = 0,
 	};
-	int            err   = fcntl64(fd, F_SETLKW64, &flock);
+	int            err   = fcntl64(fd, lockcmd, &flock);
 	if (err == -1) {
 		log_critf("fcntl lock failed");
 	}
@@ -87,28 +90,60 @@ void page_unlock(int fd, odb_pid page) {
 
 odb_err volume_initialize(int fd) {
 
-	page_lock(fd, 0, 1);
+	page_lock(fd, F_SETLKW64, 0, 1);
 	struct stat64 sbuf;
 	if (fstat64(fd, &sbuf) == -1) {
-		page_unlock(fd, 0);
+		page_unlock(fd, F_SETLKW64, 0);
 		return log_critf("failed to stat file");
 	}
 	if ((sbuf.st_mode & S_IFMT) != S_IFREG) {
 		// later: need to add block device support.
-		page_unlock(fd, 0);
+		page_unlock(fd, F_SETLKW64, 0);
 		return log_critf("only regular files supported");
 	}
 	off_t size = sbuf.st_size;
 	if (size != 0) {
-		page_unlock(fd, 0);
+		page_unlock(fd, F_SETLKW64, 0);
 		return ODB_EEXIST;
 	}
 
-	page_unlock(fd, 0);
+	page_unlock(fd, F_SETLKW64, 0);
 	return 0;
 }
 
+// helper to volume_load and group_loadg: makes sure the stripe layout
+// recorded in a group descriptor matches what we opened it with.
+static int group_stripe_valid(const odb_desc *desc
+                              , const struct odb_block_group_desc *group
+                              , odb_gid gid) {
+	int stripec = group->stripec ? group->stripec : 1;
+	return stripec == desc->fdc && group->stripei == gid % desc->fdc;
+}
+
 odb_err volume_load(odb_desc *desc) {
+
+	// Check each file's first group (so long that it has been initialized) to
+	// make sure we've been given the files in the right order. Otherwise we'd
+	// find out the hard way when we go to load the group.
+	for (int i = 0; i < desc->fdc; i++) {
+		struct odb_block_group_desc head;
+		ssize_t n = pread64(desc->fdv[i]
+		                    , &head
+		                    , sizeof(head)
+		                    , 0);
+		if (n == -1) {
+			return log_critf("failed to read group descriptor");
+		}
+		if (n != sizeof(head) || !(head.flags & ODB_SPEC_FLAG_GROUP_INIT)) {
+			// not yet initialized.
+			continue;
+		}
+		if (!group_stripe_valid(desc, &head, i)) {
+			log_errorf("file %d of the volume has a mis-matched stripe layout"
+			           , i);
+			return ODB_ENOTDB;
+		}
+	}
 	return 0;
 }
 
@@ -117,9 +152,13 @@ void volume_unload(odb_desc *desc) {
 }
 
 // helper to group_load.
-static void group_initialize(struct odb_block_group_desc *new_desc, odb_gid goff) {
+static void group_initialize(const odb_desc *desc
+                             , struct odb_block_group_desc *new_desc
+                             , odb_gid goff) {
 	new_desc->magic[0] = (uint8_t[2]) ODB_SPEC_HEADER_MAGIC[0];
 	new_desc->magic[1] = (uint8_t[2]) ODB_SPEC_HEADER_MAGIC[1];
+	new_desc->stripec  = (uint16_t) desc->fdc;
+	new_desc->stripei  = (uint16_t) (goff % desc->fdc);
 	new_desc->flags = ODB_SPEC_FLAG_GROUP_INIT | ODB_SPEC_FLAG_BLOCK_GROUP;
 }
 
@@ -128,8 +167,8 @@ odb_err group_loadg(const odb_desc *desc
                     , odb_gid gid
                     , struct odb_block_group_desc *buff_group_descm) {
 
-	int     fd         = desc->fd;
-	odb_pid pid        = gid * ODB_SPEC_PAGES_PER_GROUP;
+	int     fd         = gid2fd(desc, gid);
+	odb_pid pid        = gid2pid(desc, gid);
 	int     prot       = (int) desc->flags & 0x3;
 	void    *metapages = odb_mmap(buff_group_descm
 	                              , 1
@@ -149,18 +188,19 @@ odb_err group_loadg(const odb_desc *desc
 	if (!(*gflags & ODB_SPEC_FLAG_GROUP_INIT)) {
 		// group has (probably) not been initialized... we need to XL lock it
 		// to be sure.
-		page_lock(fd, pid, 1);
+		page_lock(fd, desc->lockcmd, pid, 1);
 		if (!(*gflags & ODB_SPEC_FLAG_GROUP_INIT)) {
 			// yup, certainly not initialized, go ahead and do so.
-			group_initialize(buff_group_descm, gid);
+			group_initialize(desc, buff_group_descm, gid);
 		}
-		page_unlock(fd, pid);
+		page_unlock(fd, desc->lockcmd, pid);
 	}
 
 	// double-check the magic number
 	if ((buff_group_descm->magic[0] != (uint8_t[2]) ODB_SPEC_HEADER_MAGIC[0]
 	    || buff_group_descm->magic[1] != (uint8_t[2]) ODB_SPEC_HEADER_MAGIC[1])
-		|| !(buff_group_descm->flags & ODB_SPEC_FLAG_BLOCK_GROUP)) {
+		|| !(buff_group_descm->flags & ODB_SPEC_FLAG_BLOCK_GROUP)
+		|| !group_stripe_valid(desc, buff_group_descm, gid)) {
 		return ODB_ENOTDB;
 	}
 
@@ -168,13 +208,15 @@ odb_err group_loadg(const odb_desc *desc
 	return 0;
 }
 
-odb_err block_truncate(odb_desc *desc, odb_bid block_off) {
-	int     fd = desc->fd;
-	odb_pid needed_page_count, current_page_count;
+// helper to block_truncate: makes sure a single file is at least
+// needed_page_count pages long.
+static odb_err file_truncate(const odb_desc *desc
+                             , int fd
+                             , odb_pid needed_page_count) {
+	odb_pid current_page_count;
 	off64_t size;
 	size = lseek64(fd, 0, SEEK_END);
 
-	needed_page_count = bid2pid(block_off) + 1;
 	current_page_count = (size / ODB_PAGESIZE);
 
 	// first, check if we need to initialize any new groups.
@@ -193,17 +235,17 @@ odb_err block_truncate(odb_desc *desc, odb_bid block_off) {
 		// what we currently think is the end of file and make sure to
 		// remeasure.
 
-		size               = page_lock_eof(fd, 1);
+		size               = page_lock_eof(fd, desc->lockcmd, 1);
 		current_page_count = (size / ODB_PAGESIZE);
 
 		if (needed_page_count <= current_page_count) {
-			page_unlock_eof(fd, size);
+			page_unlock_eof(fd, desc->lockcmd, size);
 			return 0;
 		}
 
 		off64_t newSize = (off64_t) needed_page_count * ODB_PAGESIZE;
 		int     err     = ftruncate64(fd, newSize);
-		page_unlock_eof(fd, size);
+		page_unlock_eof(fd, desc->lockcmd, size);
 		if (err == -1) {
 			switch (errno) {
 			case EFBIG:
@@ -217,3 +259,35 @@ odb_err block_truncate(odb_desc *desc, odb_bid block_off) {
 	return 0;
 }
 
+odb_err block_truncate(odb_desc *desc, odb_bid block_off) {
+	odb_err err;
+	odb_gid gid = bid2gid(block_off);
+	int     stripe_of_gid = (int) (gid % desc->fdc);
+
+	// every stripe needs to hold all of its groups up to and including gid.
+	// The stripe that holds gid only needs to go as far as the block, the
+	// stripes before it need their last group in full. The stripes after it
+	// only need up to the group they had on the previous go-around (if any).
+	for (int i = 0; i < desc->fdc; i++) {
+		odb_pid needed_page_count;
+		if (i == stripe_of_gid) {
+			needed_page_count = bid2pid(desc, block_off) + 1;
+		} else {
+			odb_gid last;
+			if (i < stripe_of_gid) {
+				last = gid - (stripe_of_gid - i);
+			} else if (gid >= (odb_gid) (stripe_of_gid + desc->fdc - i)) {
+				last = gid - (stripe_of_gid + desc->fdc - i);
+			} else {
+				// this stripe doesn't have any groups yet.
+				continue;
+			}
+			needed_page_count = gid2pid(desc, last) + ODB_SPEC_PAGES_PER_GROUP;
+		}
+		err = file_truncate(desc, desc->fdv[i], needed_page_count);
+		if (err) {
+			return err;
+		}
+	}
+	return 0;
+}
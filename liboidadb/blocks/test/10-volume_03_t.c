@@ -0,0 +1,148 @@
+#include "teststuff.h"
+
+#include <oidadb/blocks.h>
+#include <oidadb/buffers.h>
+#include <oidadb-internal/odbfile.h>
+
+#include "../errors.h"
+
+
+/*
+ The purpose of this test is to test striped volumes: that blocks spanning
+ several groups end up spread across the files and that they come back in
+ one piece, and that opening the files in the wrong order is caught.
+ */
+
+#define stripec 3
+
+// starts at the tail of group 0 and ends in the middle of group 2, so every
+// stripe gets touched.
+const odb_bid block_start = 1000;
+const int     blockc      = 1100;
+
+void test_main() {
+
+	char names[stripec][120];
+	const char *filev[stripec];
+	for(int i = 0; i < stripec; i++) {
+		sprintf(names[i], "%s.%d", test_filenmae, i);
+		unlink(names[i]);
+		filev[i] = names[i];
+	}
+
+	// create a fresh database
+	odb_desc *desc;
+	err = odb_openv(filev, stripec, ODB_PREAD | ODB_PWRITE | ODB_PCREAT, &desc);
+	if(err) {
+		test_error("odb_openv");
+		return;
+	}
+
+	struct odb_buffer_info binf = {
+			.flags = ODB_UCOMMITS,
+			.bcount = blockc,
+	};
+	odb_buf *buf;
+	if((err = odb_buffer_new(binf, &buf))) {
+		test_error("buffer new");
+		return;
+	}
+	if((err = odbb_bind_buffer(desc, buf))) {
+		test_error("bind buffer");
+		return;
+	}
+	if ((err = odbb_seek(desc, block_start))) {
+		test_error("seek");
+		return;
+	}
+	if ((err = odbb_checkout(desc, blockc))) {
+		test_error("checkout");
+		return;
+	}
+
+	// stamp each block with its own id.
+	uint64_t *pagedata;
+	odbv_buffer_map(buf, (void **) &pagedata, 0, blockc);
+	for(int i = 0; i < blockc; i++) {
+		pagedata[i * (ODB_PAGESIZE / sizeof(uint64_t))] = block_start + i;
+	}
+	odbv_buffer_unmap(buf, 0, blockc);
+
+	if ((err = odbb_commit(desc, blockc))) {
+		test_error("commit");
+		return;
+	}
+	odb_buffer_free(buf);
+	odb_close(desc);
+
+	// each file should hold its own groups: file 0 and 1 hold their group in
+	// full, file 2 only up to the last block.
+	struct stat st;
+	for(int i = 0; i < stripec; i++) {
+		stat(filev[i], &st);
+		off_t expected = ODB_SPEC_PAGES_PER_GROUP * ODB_PAGESIZE;
+		if(i == 2) {
+			expected = (ODB_SPEC_METAPAGES_PER_GROUP
+			            + (block_start + blockc - 1) % ODB_SPEC_BLOCKS_PER_GROUP
+			            + 1) * ODB_PAGESIZE;
+		}
+		if(st.st_size != expected) {
+			test_error("stripe %d has size %ld, expected %ld"
+					   , i, st.st_size, expected);
+		}
+	}
+
+	// read it back
+	err = odb_openv(filev, stripec, ODB_PREAD, &desc);
+	if(err) {
+		test_error("odb_openv2");
+		return;
+	}
+	binf.flags = 0;
+	if((err = odb_buffer_new(binf, &buf))) {
+		test_error("buffer new2");
+		return;
+	}
+	if((err = odbb_bind_buffer(desc, buf))) {
+		test_error("bind buffer2");
+		return;
+	}
+	if ((err = odbb_seek(desc, block_start))) {
+		test_error("seek2");
+		return;
+	}
+	if ((err = odbb_checkout(desc, blockc))) {
+		test_error("checkout2");
+		return;
+	}
+	odbv_buffer_map(buf, (void **) &pagedata, 0, blockc);
+	for(int i = 0; i < blockc; i++) {
+		if(pagedata[i * (ODB_PAGESIZE / sizeof(uint64_t))] != block_start + i) {
+			test_error("block %ld has wrong contents", block_start + i);
+			break;
+		}
+	}
+	odbv_buffer_unmap(buf, 0, blockc);
+	odb_buffer_free(buf);
+	odb_close(desc);
+
+	// the wrong order should be caught.
+	const char *swappedv[stripec] = {filev[1], filev[0], filev[2]};
+	err = odb_openv(swappedv, stripec, ODB_PREAD, &desc);
+	if(err != ODB_ENOTDB) {
+		test_error("swapped stripes did not return ODB_ENOTDB");
+		return;
+	}
+
+	// as should opening just one of them.
+	err = odb_open(filev[0], ODB_PREAD, &desc);
+	if(err != ODB_ENOTDB) {
+		test_error("single stripe did not return ODB_ENOTDB");
+		return;
+	}
+	err = 0;
+
+	for(int i = 0; i < stripec; i++) {
+		unlink(filev[i]);
+	}
+}
@@ -0,0 +1,169 @@
+#include "teststuff.h"
+
+#include <oidadb/blocks.h>
+#include <oidadb/buffers.h>
+#include <poll.h>
+
+#include "../errors.h"
+
+
+/*
+ The purpose of this test is to test the completion queue: that many
+ outstanding checkouts/commits from a single thread all go through, that the
+ workers exclude each other when committing the same blocks (same as
+ 10-volume_02_t.c does with processes), and that the eventfd behaves.
+ */
+
+const int buffers = 64;
+const int workers = 4;
+const int rounds  = 0x10;
+const int blockc  = 4;
+
+struct op {
+	odb_buf *buf;
+	int     done;
+};
+
+void test_main() {
+
+	// create a fresh database
+	odb_desc *desc;
+	err = odb_open(test_filenmae, ODB_PREAD | ODB_PWRITE | ODB_PCREAT, &desc);
+	if(err) {
+		test_error("odb_open");
+		return;
+	}
+
+	odb_cq *cq;
+	if((err = odb_cq_new(desc, buffers, workers, &cq))) {
+		test_error("odb_cq_new");
+		return;
+	}
+
+	struct odb_buffer_info binf = {
+			.flags = ODB_UCOMMITS,
+			.bcount = blockc,
+	};
+	struct op ops[buffers];
+	for(int i = 0; i < buffers; i++) {
+		ops[i].done = 0;
+		if((err = odb_buffer_new(binf, &ops[i].buf))) {
+			test_error("buffer new");
+			return;
+		}
+		if((err = odbb_checkout_async(cq, ops[i].buf, 0, blockc, &ops[i]))) {
+			test_error("checkout_async");
+			return;
+		}
+	}
+
+	// the queue is full now.
+	if(odbb_checkout_async(cq, ops[0].buf, 0, blockc, 0) != ODB_EAGAIN) {
+		test_error("expected ODB_EAGAIN on a full queue");
+		return;
+	}
+
+	// every checkout that comes back gets incremented and committed, every
+	// commit that comes back with ODB_EVERSION is checked out again.
+	int remaining = buffers;
+	struct odb_cqe cqev[16];
+	while(remaining) {
+		struct pollfd pfd = {.fd = odb_cq_fd(cq), .events = POLLIN};
+		if(poll(&pfd, 1, 5000) != 1) {
+			test_error("eventfd never became readable");
+			return;
+		}
+		int cqec;
+		if((err = odb_cq_poll(cq, cqev, 16, &cqec))) {
+			test_error("odb_cq_poll");
+			return;
+		}
+		for(int i = 0; i < cqec; i++) {
+			struct op *op = cqev[i].userdata;
+			int committed = cqev[i].commit;
+			if(cqev[i].err == ODB_EVERSION) {
+				err = odbb_checkout_async(cq, op->buf, 0, blockc, op);
+			} else if(cqev[i].err) {
+				err = cqev[i].err;
+				test_error("completion");
+				return;
+			} else if(committed && ++op->done == rounds) {
+				remaining--;
+				continue;
+			} else if(committed) {
+				err = odbb_checkout_async(cq, op->buf, 0, blockc, op);
+			} else {
+				int *pagedata;
+				odbv_buffer_map(op->buf, (void **) &pagedata, 0, blockc);
+				for(int j = 0; j < (ODB_PAGESIZE*blockc)/sizeof(int); j++) {
+					pagedata[j]++;
+				}
+				odbv_buffer_unmap(op->buf, 0, blockc);
+				err = odbb_commit_async(cq, op->buf, 0, blockc, op);
+			}
+			if(err) {
+				test_error("resubmit");
+				return;
+			}
+		}
+	}
+
+	// nothing outstanding: the eventfd should be quiet and wait should not
+	// block.
+	struct pollfd pfd = {.fd = odb_cq_fd(cq), .events = POLLIN};
+	if(poll(&pfd, 1, 0) != 0) {
+		test_error("eventfd readable with nothing to reap");
+	}
+	int cqec;
+	if(odb_cq_wait(cq, cqev, 16, &cqec) != ODB_EEOF) {
+		test_error("expected ODB_EEOF with nothing outstanding");
+	}
+
+	// check the results with a plain checkout.
+	if((err = odbb_bind_buffer(desc, ops[0].buf))) {
+		test_error("bind buffer");
+		return;
+	}
+	if ((err = odbb_seek(desc, 0))) {
+		test_error("seek");
+		return;
+	}
+	if ((err = odbb_checkout(desc, blockc))) {
+		test_error("checkout");
+		return;
+	}
+	int *pagedata;
+	odbv_buffer_map(ops[0].buf, (void **) &pagedata, 0, blockc);
+	for(int i = 0; i < (ODB_PAGESIZE*blockc)/sizeof(int); i++) {
+		if(pagedata[i] != buffers * rounds) {
+			test_error("unexpected value %d", pagedata[i]);
+			break;
+		}
+	}
+
+	// a commit that's still sitting in the queue when the cq is freed must
+	// still go through.
+	for(int i = 0; i < (ODB_PAGESIZE*blockc)/sizeof(int); i++) {
+		pagedata[i]++;
+	}
+	odbv_buffer_unmap(ops[0].buf, 0, blockc);
+	if((err = odbb_commit_async(cq, ops[0].buf, 0, blockc, 0))) {
+		test_error("commit_async before free");
+		return;
+	}
+	odb_cq_free(cq);
+	if ((err = odbb_checkout(desc, blockc))) {
+		test_error("checkout after free");
+		return;
+	}
+	odbv_buffer_map(ops[0].buf, (void **) &pagedata, 0, blockc);
+	if(pagedata[0] != buffers * rounds + 1) {
+		test_error("commit dropped by odb_cq_free: %d", pagedata[0]);
+	}
+	odbv_buffer_unmap(ops[0].buf, 0, blockc);
+
+	for(int i = 0; i < buffers; i++) {
+		odb_buffer_free(ops[i].buf);
+	}
+	odb_close(desc);
+}
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <oidadb/telemetry.h>
+#include "odbs.h"
+
+// same order as edbl_type.
+static const char *locktypes[] = {
+		"LFILE",
+		"LENTCREAT",
+		"LSTRUCTCREAT",
+		"LENTRY",
+		"LENTTRASH",
+		"LREF0C",
+		"LLOOKUP_EXISTING",
+		"LLOOKUP_NEW",
+		"LTRASHOFF",
+		"LOBJPRIGHT",
+		"LOBJBODY",
+		"LROW",
+		"arbitrary",
+};
+#define locktypec (sizeof(locktypes) / sizeof(locktypes[0]))
+
+// the acquire latency (in microseconds) that p percent of them got in
+// under, going by the buckets of acquirelatencyv.
+static uint64_t latencypercent(const struct odbtelem_locktype *t, int p) {
+	uint64_t want = (t->acquires * p + 99) / 100;
+	uint64_t seen = 0;
+	for(int b = 0; b < ODBTELEM_LATENCYC; b++) {
+		seen += t->acquirelatencyv[b];
+		if(seen >= want) {
+			return b ? 1 << b : 1;
+		}
+	}
+	return 1 << (ODBTELEM_LATENCYC - 1);
+}
+
+int locks_print() {
+	odb_err err = odbtelem_attach(cmd_arg.file);
+	if(err) {
+		printf("failed to attach to the host of %s: %s\n"
+			   "(is it hosted, with telemetry enabled?)\n",
+			   cmd_arg.file, odb_errstr(err));
+		return err;
+	}
+	odbtelem_image_t image;
+	err = odbtelem_image(&image);
+	odbtelem_detach();
+	if(err) {
+		printf("failed to get the image: %s\n", odb_errstr(err));
+		return err;
+	}
+	const struct odbtelem_lockprofile *prof = &image.lockprofile;
+
+	printf("| %-16s | %9s | %9s | %7s | %7s | %9s | %7s | %9s |\n"
+		   , "lock"
+		   , "acquires"
+		   , "waits"
+		   , "p50(us)"
+		   , "p99(us)"
+		   , "avg-acq"
+		   , "waiters"
+		   , "avg-hold");
+	for(int i = 0; i < locktypec; i++) {
+		const struct odbtelem_locktype *t = &prof->typev[i];
+		if(!t->acquires) {
+			continue;
+		}
+		printf("| %-16s |", locktypes[i]);
+		printf(" %9ld |", t->acquires);
+		printf(" %9ld |", t->waits);
+		printf(" %7ld |", latencypercent(t, 50));
+		printf(" %7ld |", latencypercent(t, 99));
+		printf(" %7ldus |", t->acquirens / t->acquires / 1000);
+		printf(" %3.1f/%-3ld |", t->waits ? (double)t->waiters / t->waits : 0.0
+			   , t->maxwaiters);
+		printf(" %7ldus |", t->releases ? t->holdns / t->releases / 1000 : 0);
+		printf("\n");
+	}
+
+	printf("\nmost waited on:\n");
+	printf("| %-16s | %14s | %11s | %11s |\n"
+		   , "lock"
+		   , "offset"
+		   , "waits"
+		   , "avg-wait");
+	for(int i = 0; i < ODBTELEM_LOCKHOTC; i++) {
+		const struct odbtelem_lockhot *hot = &prof->hotv[i];
+		if(!hot->waits) {
+			break;
+		}
+		printf("| %-16s |", hot->type < locktypec ? locktypes[hot->type] : "?");
+		printf(" %14ld |", hot->offset);
+		printf(" %5ld(+-%ld) |", hot->waits, hot->error);
+		printf(" %9ldus |", hot->waitns / (hot->waits - hot->error) / 1000);
+		printf("\n");
+	}
+	printf("\n");
+	return 0;
+}
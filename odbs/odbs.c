@@ -52,6 +52,13 @@ struct cmd cmds[] = {
 				.func        = print_btree,
 				.argc        = 1,
 				.argv        = {&cmd_arg.pid},
+		},
+		{
+				.command     = "locks",
+				.description = "show where the host of the opened file waits on locks",
+				.func        = locks_print,
+				.argc        = 0,
+				.argv        = 0,
 		}
 };
 
@@ -17,6 +17,7 @@ int index_print();
 int page_print();
 int print_btree();
 int print_obj();
+int locks_print();
 
 
 #endif
\ No newline at end of file